@@ -6,6 +6,8 @@
 
 #pragma once
 
+#include <span>
+#include <string_view>
 #include "esp_modem_dte.hpp"
 #include "esp_modem_dce_module.hpp"
 #include "esp_modem_types.hpp"
@@ -32,8 +34,8 @@ namespace dce_commands {
  * @param timeout_ms Timeout in ms
  */
 command_result generic_command(CommandableIf *t, const std::string &command,
-                               const std::string &pass_phrase,
-                               const std::string &fail_phrase, uint32_t timeout_ms);
+                               std::string_view pass_phrase,
+                               std::string_view fail_phrase, uint32_t timeout_ms);
 
 /**
  * @brief Declaration of all commands is generated from esp_modem_command_declare.inc
@@ -57,6 +59,17 @@ command_result power_down_sim8xx(CommandableIf *t);
 command_result set_data_mode_alt(CommandableIf *t);
 command_result set_pdp_context(CommandableIf *t, PdpContext &pdp, uint32_t timeout_ms);
 
+/**
+ * @brief Overloads of the string output commands copying the reply into the caller's buffer
+ * instead of a std::string, so they don't allocate. The span shrinks to the length of the reply;
+ * if the reply doesn't fit, the command fails
+ */
+command_result at(CommandableIf *t, const std::string &cmd, std::span<char> &out, int timeout);
+command_result get_imsi(CommandableIf *t, std::span<char> &imsi_number);
+command_result get_imei(CommandableIf *t, std::span<char> &out);
+command_result get_module_name(CommandableIf *t, std::span<char> &out);
+command_result get_operator_name(CommandableIf *t, std::span<char> &name, int &act);
+
 /**
  * @}
  */
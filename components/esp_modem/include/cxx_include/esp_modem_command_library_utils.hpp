@@ -6,6 +6,9 @@
 
 #pragma once
 
+#include <span>
+#include <string_view>
+
 namespace esp_modem::dce_commands {
 
 /**
@@ -18,14 +21,27 @@ namespace esp_modem::dce_commands {
  * @return Generic command return type (OK, FAIL, TIMEOUT)
  */
 command_result generic_command(CommandableIf *t, const std::string &command,
-                               const std::string &pass_phrase,
-                               const std::string &fail_phrase, uint32_t timeout_ms);
+                               std::string_view pass_phrase,
+                               std::string_view fail_phrase, uint32_t timeout_ms);
+
+/**
+ * @brief Generic command that passes on any of the pass phrases, and fails on any of the fail phrases
+ * @param t Any "Command-able" class that implements "command()" method
+ * @param command Command to issue
+ * @param pass_phrase Patterns to find in replies to complete the command successfully (e.g. a constexpr std::array)
+ * @param fail_phrase If any of these patterns found the command fails immediately
+ * @param timeout_ms Command timeout in ms
+ * @return Generic command return type (OK, FAIL, TIMEOUT)
+ */
+command_result generic_command(CommandableIf *t, const std::string &command,
+                               std::span<const std::string_view> pass_phrase,
+                               std::span<const std::string_view> fail_phrase, uint32_t timeout_ms);
 
 /**
  * @brief Utility command to send command and return reply (after DCE says OK)
  * @param t Anything that is "command-able"
  * @param command Command to issue
- * @param output String to return (could be either std::string& or std::string_view&)
+ * @param output String to return (could be either std::string& or std::span<char>&, the span shrinks to the reply)
  * @param timeout_ms Command timeout in ms
  * @return Generic command return type (OK, FAIL, TIMEOUT)
  */
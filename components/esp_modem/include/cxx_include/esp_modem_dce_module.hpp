@@ -7,6 +7,7 @@
 #pragma once
 
 #include <memory>
+#include <span>
 #include <utility>
 #include "generate/esp_modem_command_declare.inc"
 #include "cxx_include/esp_modem_command_library.hpp"
@@ -107,6 +108,22 @@ public:
         return get_operator_name(name, dummy_act);
     }
 
+    /**
+     * @brief Allocation free variants of the string output commands, writing into the caller's buffer
+     * @note The span shrinks to the length of the reply; the command fails if it doesn't fit
+     */
+    command_result at(const std::string &cmd, std::span<char> &out, int timeout);
+    command_result get_imsi(std::span<char> &imsi_number);
+    command_result get_imei(std::span<char> &imei);
+    command_result get_module_name(std::span<char> &name);
+    command_result get_operator_name(std::span<char> &name, int &act);
+
+    command_result get_operator_name(std::span<char> &name)
+    {
+        int dummy_act;
+        return get_operator_name(name, dummy_act);
+    }
+
     /**
      * @brief Common DCE commands generated from the API AT list
      */
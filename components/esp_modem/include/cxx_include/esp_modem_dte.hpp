@@ -6,6 +6,7 @@
 
 #pragma once
 
+#include <array>
 #include <memory>
 #include <utility>
 #include <cstddef>
@@ -122,6 +123,23 @@ public:
      */
     bool recover();
 
+    /**
+     * @brief Sizes of the AT replies processed so far, to configure the DTE buffers from field data
+     */
+    struct buffer_stats {
+        size_t peak{0};                                     /*!< Longest reply (in bytes) */
+        uint32_t overflows{0};                              /*!< Replies which didn't fit and failed their command */
+    };
+
+    /**
+     * @brief Copies the stats under the lock the reply processing updates them with
+     */
+    [[nodiscard]] buffer_stats get_buffer_stats()
+    {
+        Scoped<Lock> l(command_cb.line_lock);
+        return stats;
+    }
+
 protected:
     /**
      * @brief Allows for locking the DTE
@@ -138,6 +156,7 @@ protected:
 private:
 
     void handle_error(terminal_error err);                  /*!< Performs internal error handling */
+    void give_up_overflow();                                /*!< Fails the command of a reply which doesn't fit */
     [[nodiscard]] bool setup_cmux();                        /*!< Internal setup of CMUX mode */
     [[nodiscard]] bool exit_cmux();                         /*!< Exit of CMUX mode and cleanup  */
     void exit_cmux_internal();                              /*!< Cleanup CMUX */
@@ -150,6 +169,17 @@ private:
     modem_mode mode;                                        /*!< DTE operation mode */
     std::function<bool(uint8_t *data, size_t len)> on_data; /*!< on data callback for current terminal */
     std::function<void(terminal_error err)> user_error_cb;  /*!< user callback on error event from attached terminals */
+    buffer_stats stats;                                     /*!< Reply sizes, updated under command_cb.line_lock */
+
+    /**
+     * @brief Updates the peak reply size
+     */
+    void note_reply(size_t len)
+    {
+        if (len > stats.peak) {
+            stats.peak = len;
+        }
+    }
 
 #ifdef CONFIG_ESP_MODEM_USE_INFLATABLE_BUFFER_IF_NEEDED
     /**
@@ -164,7 +194,7 @@ private:
         }
         std::vector<uint8_t> *buffer;
         size_t consumed{0};
-        void grow(size_t need_size);
+        bool grow(size_t need_size);
         void deflate()
         {
             grow(0);
@@ -179,6 +209,31 @@ private:
             return &buffer->at(0) + consumed;
         }
     } inflatable;
+#elif defined(CONFIG_ESP_MODEM_USE_FIXED_EXTRA_BUFFER)
+    /**
+     * @brief Same as the inflatable buffer above, but with fixed capacity and stored inline,
+     * so that processing long or fragmented replies doesn't touch the heap
+     */
+    struct extra_buffer {
+        std::array<uint8_t, CONFIG_ESP_MODEM_EXTRA_BUFFER_SIZE> buffer;
+        size_t consumed{0};
+        [[nodiscard]] bool grow(size_t need_size)               /*!< false if need_size exceeds the capacity */
+        {
+            return need_size <= buffer.size();
+        }
+        void deflate()
+        {
+            consumed = 0;
+        }
+        [[nodiscard]] uint8_t *begin()
+        {
+            return buffer.data();
+        }
+        [[nodiscard]] uint8_t *current()
+        {
+            return buffer.data() + consumed;
+        }
+    } inflatable;
 #endif // CONFIG_ESP_MODEM_USE_INFLATABLE_BUFFER_IF_NEEDED
 
     /**
@@ -111,6 +111,18 @@ void esp_modem_destroy(esp_modem_dce_t *dce);
  */
 esp_err_t esp_modem_set_error_cb(esp_modem_dce_t *dce, esp_modem_terminal_error_cbt err_cb);
 
+/**
+ * @brief Get the sizes of the AT replies processed by the DTE so far
+ *
+ * Use it to size the DTE buffer (and ESP_MODEM_EXTRA_BUFFER_SIZE) from the replies seen in the field
+ *
+ * @param dce Modem DCE handle
+ * @param[out] peak Longest reply in bytes
+ * @param[out] overflows Number of replies which didn't fit the buffers and failed their command
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on invalid arguments
+ */
+esp_err_t esp_modem_get_buffer_stats(esp_modem_dce_t *dce, size_t *peak, uint32_t *overflows);
+
 /**
  * @brief Set operation mode for this DCE
  * @param dce Modem DCE handle
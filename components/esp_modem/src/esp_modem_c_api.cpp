@@ -6,6 +6,7 @@
 
 #include <cstring>
 #include <cassert>
+#include <span>
 #include "cxx_include/esp_modem_dte.hpp"
 #include "uart_terminal.hpp"
 #include "esp_log.h"
@@ -91,6 +92,17 @@ extern "C" esp_err_t esp_modem_set_error_cb(esp_modem_dce_t *dce_wrap, esp_modem
     return ESP_OK;
 }
 
+extern "C" esp_err_t esp_modem_get_buffer_stats(esp_modem_dce_t *dce_wrap, size_t *peak, uint32_t *overflows)
+{
+    if (dce_wrap == nullptr || dce_wrap->dte == nullptr || peak == nullptr || overflows == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    auto stats = dce_wrap->dte->get_buffer_stats();
+    *peak = stats.peak;
+    *overflows = stats.overflows;
+    return ESP_OK;
+}
+
 extern "C" esp_err_t esp_modem_sync(esp_modem_dce_t *dce_wrap)
 {
     if (dce_wrap == nullptr || dce_wrap->dce == nullptr) {
@@ -176,11 +188,12 @@ extern "C" esp_err_t esp_modem_at(esp_modem_dce_t *dce_wrap, const char *at, cha
     if (dce_wrap == nullptr || dce_wrap->dce == nullptr) {
         return ESP_ERR_INVALID_ARG;
     }
-    std::string out;
+    char scratch[ESP_MODEM_C_API_STR_MAX];
+    std::span<char> out(p_out != NULL ? p_out : scratch, ESP_MODEM_C_API_STR_MAX - 1);
     std::string at_str(at);
     auto ret = command_response_to_esp_err(dce_wrap->dce->at(at_str, out, timeout));
-    if ((p_out != NULL) && (!out.empty())) {
-        strlcpy(p_out, out.c_str(), ESP_MODEM_C_API_STR_MAX);
+    if ((p_out != NULL) && (ret == ESP_OK || ret == ESP_FAIL)) {
+        p_out[out.size()] = '\0';
     }
     return ret;
 }
@@ -198,10 +211,10 @@ extern "C" esp_err_t esp_modem_get_imsi(esp_modem_dce_t *dce_wrap, char *p_imsi)
     if (dce_wrap == nullptr || dce_wrap->dce == nullptr) {
         return ESP_ERR_INVALID_ARG;
     }
-    std::string imsi;
+    std::span<char> imsi(p_imsi, ESP_MODEM_C_API_STR_MAX - 1);
     auto ret = command_response_to_esp_err(dce_wrap->dce->get_imsi(imsi));
-    if (ret == ESP_OK && !imsi.empty()) {
-        strlcpy(p_imsi, imsi.c_str(), ESP_MODEM_C_API_STR_MAX);
+    if (ret == ESP_OK) {
+        p_imsi[imsi.size()] = '\0';
     }
     return ret;
 }
@@ -241,10 +254,10 @@ extern "C" esp_err_t esp_modem_get_imei(esp_modem_dce_t *dce_wrap, char *p_imei)
     if (dce_wrap == nullptr || dce_wrap->dce == nullptr) {
         return ESP_ERR_INVALID_ARG;
     }
-    std::string imei;
+    std::span<char> imei(p_imei, ESP_MODEM_C_API_STR_MAX - 1);
     auto ret = command_response_to_esp_err(dce_wrap->dce->get_imei(imei));
-    if (ret == ESP_OK && !imei.empty()) {
-        strlcpy(p_imei, imei.c_str(), ESP_MODEM_C_API_STR_MAX);
+    if (ret == ESP_OK) {
+        p_imei[imei.size()] = '\0';
     }
     return ret;
 }
@@ -254,11 +267,11 @@ extern "C" esp_err_t esp_modem_get_operator_name(esp_modem_dce_t *dce_wrap, char
     if (dce_wrap == nullptr || dce_wrap->dce == nullptr || p_name == nullptr || p_act == nullptr) {
         return ESP_ERR_INVALID_ARG;
     }
-    std::string name;
+    std::span<char> name(p_name, ESP_MODEM_C_API_STR_MAX - 1);
     int act;
     auto ret = command_response_to_esp_err(dce_wrap->dce->get_operator_name(name, act));
-    if (ret == ESP_OK && !name.empty()) {
-        strlcpy(p_name, name.c_str(), ESP_MODEM_C_API_STR_MAX);
+    if (ret == ESP_OK) {
+        p_name[name.size()] = '\0';
         *p_act = act;
     }
     return ret;
@@ -269,10 +282,10 @@ extern "C" esp_err_t esp_modem_get_module_name(esp_modem_dce_t *dce_wrap, char *
     if (dce_wrap == nullptr || dce_wrap->dce == nullptr) {
         return ESP_ERR_INVALID_ARG;
     }
-    std::string name;
+    std::span<char> name(p_name, ESP_MODEM_C_API_STR_MAX - 1);
     auto ret = command_response_to_esp_err(dce_wrap->dce->get_module_name(name));
-    if (ret == ESP_OK && !name.empty()) {
-        strlcpy(p_name, name.c_str(), ESP_MODEM_C_API_STR_MAX);
+    if (ret == ESP_OK) {
+        p_name[name.size()] = '\0';
     }
     return ret;
 }
@@ -4,8 +4,9 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#include <array>
 #include <charconv>
-#include <list>
+#include <span>
 #include "esp_log.h"
 #include "cxx_include/esp_modem_dte.hpp"
 #include "cxx_include/esp_modem_dce_module.hpp"
@@ -16,10 +17,29 @@ namespace esp_modem::dce_commands {
 
 static const char *TAG = "command_lib";
 
-static command_result generic_command(CommandableIf *t, const std::string &command,
-                                      const std::list<std::string_view> &pass_phrase,
-                                      const std::list<std::string_view> &fail_phrase,
-                                      uint32_t timeout_ms)
+/*
+ * Pass and fail phrases of the commands below, fixed at compile time so that matching a reply
+ * doesn't need to build any container
+ */
+namespace phrase {
+constexpr std::array<std::string_view, 1> ok = {"OK"};
+constexpr std::array<std::string_view, 1> error = {"ERROR"};
+constexpr std::array<std::string_view, 1> connect = {"CONNECT"};
+constexpr std::array<std::string_view, 2> command_mode = {"NO CARRIER", "OK"};
+constexpr std::array<std::string_view, 1> powered_down = {"POWERED DOWN"};
+constexpr std::array<std::string_view, 1> power_down = {"POWER DOWN"};
+constexpr std::array<std::string_view, 1> pb_done = {"PB DONE"};
+} // phrase
+
+/*
+ * Response lines parsed by the commands below are read into a stack buffer of this size
+ */
+constexpr size_t line_max = 80;
+
+command_result generic_command(CommandableIf *t, const std::string &command,
+                               std::span<const std::string_view> pass_phrase,
+                               std::span<const std::string_view> fail_phrase,
+                               uint32_t timeout_ms)
 {
     ESP_LOGD(TAG, "%s command %s\n", __func__, command.c_str());
     return t->command(command, [&](uint8_t *data, size_t len) {
@@ -42,49 +62,53 @@ static command_result generic_command(CommandableIf *t, const std::string &comma
 }
 
 command_result generic_command(CommandableIf *t, const std::string &command,
-                               const std::string &pass_phrase,
-                               const std::string &fail_phrase, uint32_t timeout_ms)
+                               std::string_view pass_phrase,
+                               std::string_view fail_phrase, uint32_t timeout_ms)
 {
     ESP_LOGV(TAG, "%s", __func__ );
-    const auto pass = std::list<std::string_view>({pass_phrase});
-    const auto fail = std::list<std::string_view>({fail_phrase});
+    const std::string_view pass[] = {pass_phrase};
+    const std::string_view fail[] = {fail_phrase};
     return generic_command(t, command, pass, fail, timeout_ms);
 }
 
 /*
  * Purpose of this namespace is to provide different means of assigning the result to a string-like parameter.
- * By default we assign strings, which comes with an allocation. Alternatively we could take `std::span`
- * with user's buffer and directly copy the result, thus avoiding allocations (this is not used as of now)
+ * By default we assign strings, which comes with an allocation. Alternatively we take `std::span`
+ * with user's buffer and directly copy the result, thus avoiding allocations
  */
 namespace str_copy {
 
-bool set(std::string &dest, std::string_view &src)
+bool set(std::string &dest, std::string_view src)
 {
     dest = src;
     return true;
 }
 
-/* This is an example of using std::span output in generic_get_string()
-bool set(std::span<char> &dest, std::string_view &src)
+bool set(std::span<char> &dest, std::string_view src)
 {
     if (dest.size() >= src.size()) {
         std::copy(src.begin(), src.end(), dest.data());
         dest = dest.subspan(0, src.size());
         return true;
     }
-    ESP_LOGE(TAG, "Cannot set result of size %d (to span of size %d)", dest.size(), src.size());
+    ESP_LOGE(TAG, "Cannot set result of size %d (to span of size %d)", static_cast<int>(src.size()), static_cast<int>(dest.size()));
+    dest = dest.first(0);
     return false;
 }
-*/
 
 } // str_copy
 
+/*
+ * The last line of the reply is copied to the output once the final OK or ERROR arrives:
+ * the callback may run several times over the growing reply, while a span output can only shrink
+ */
 template <typename T> command_result generic_get_string(CommandableIf *t, const std::string &command, T &output, uint32_t timeout_ms)
 {
     ESP_LOGV(TAG, "%s", __func__ );
     return t->command(command, [&](uint8_t *data, size_t len) {
         size_t pos = 0;
         std::string_view response((char *)data, len);
+        std::string_view result;
         while ((pos = response.find('\n')) != std::string::npos) {
             std::string_view token = response.substr(0, pos);
             for (auto it = token.end() - 1; it > token.begin(); it--) // strip trailing CR or LF
@@ -94,13 +118,12 @@ template <typename T> command_result generic_get_string(CommandableIf *t, const
             ESP_LOGV(TAG, "Token: {%.*s}\n", static_cast<int>(token.size()), token.data());
 
             if (token.find("OK") != std::string::npos) {
-                return command_result::OK;
+                return str_copy::set(output, result) ? command_result::OK : command_result::FAIL;
             } else if (token.find("ERROR") != std::string::npos) {
+                str_copy::set(output, result);
                 return command_result::FAIL;
             } else if (token.size() > 2) {
-                if (!str_copy::set(output, token)) {
-                    return command_result::FAIL;
-                }
+                result = token;
             }
             response = response.substr(pos + 1);
         }
@@ -111,7 +134,20 @@ template <typename T> command_result generic_get_string(CommandableIf *t, const
 command_result generic_command_common(CommandableIf *t, const std::string &command, uint32_t timeout_ms)
 {
     ESP_LOGV(TAG, "%s", __func__ );
-    return generic_command(t, command, "OK", "ERROR", timeout_ms);
+    return generic_command(t, command, phrase::ok, phrase::error, timeout_ms);
+}
+
+/*
+ * Reads the last line of the reply into `buffer`, `line` pointing to it if OK
+ */
+static command_result generic_get_line(CommandableIf *t, const std::string &command, std::span<char> buffer,
+                                       std::string_view &line, uint32_t timeout_ms = 500)
+{
+    auto ret = generic_get_string(t, command, buffer, timeout_ms);
+    if (ret == command_result::OK) {
+        line = std::string_view(buffer.data(), buffer.size());
+    }
+    return ret;
 }
 
 command_result sync(CommandableIf *t)
@@ -129,7 +165,7 @@ command_result store_profile(CommandableIf *t)
 command_result power_down(CommandableIf *t)
 {
     ESP_LOGV(TAG, "%s", __func__ );
-    return generic_command(t, "AT+QPOWD=1\r", "POWERED DOWN", "ERROR", 1000);
+    return generic_command(t, "AT+QPOWD=1\r", phrase::powered_down, phrase::error, 1000);
 }
 
 command_result power_down_sim76xx(CommandableIf *t)
@@ -141,19 +177,19 @@ command_result power_down_sim76xx(CommandableIf *t)
 command_result power_down_sim70xx(CommandableIf *t)
 {
     ESP_LOGV(TAG, "%s", __func__ );
-    return generic_command(t, "AT+CPOWD=1\r", "POWER DOWN", "ERROR", 1000);
+    return generic_command(t, "AT+CPOWD=1\r", phrase::power_down, phrase::error, 1000);
 }
 
 command_result power_down_sim8xx(CommandableIf *t)
 {
     ESP_LOGV(TAG, "%s", __func__ );
-    return generic_command(t, "AT+CPOWD=1\r", "POWER DOWN", "ERROR", 1000);
+    return generic_command(t, "AT+CPOWD=1\r", phrase::power_down, phrase::error, 1000);
 }
 
 command_result reset(CommandableIf *t)
 {
     ESP_LOGV(TAG, "%s", __func__ );
-    return generic_command(t,  "AT+CRESET\r", "PB DONE", "ERROR", 60000);
+    return generic_command(t,  "AT+CRESET\r", phrase::pb_done, phrase::error, 60000);
 }
 
 command_result set_baud(CommandableIf *t, int baud)
@@ -171,8 +207,9 @@ command_result hang_up(CommandableIf *t)
 command_result get_battery_status(CommandableIf *t, int &voltage, int &bcs, int &bcl)
 {
     ESP_LOGV(TAG, "%s", __func__ );
-    std::string out;
-    auto ret = generic_get_string(t, "AT+CBC\r", out);
+    char buffer[line_max];
+    std::string_view out;
+    auto ret = generic_get_line(t, "AT+CBC\r", buffer, out);
     if (ret != command_result::OK) {
         return ret;
     }
@@ -207,8 +244,9 @@ command_result get_battery_status(CommandableIf *t, int &voltage, int &bcs, int
 command_result get_battery_status_sim7xxx(CommandableIf *t, int &voltage, int &bcs, int &bcl)
 {
     ESP_LOGV(TAG, "%s", __func__ );
-    std::string out;
-    auto ret = generic_get_string(t, "AT+CBC\r", out);
+    char buffer[line_max];
+    std::string_view out;
+    auto ret = generic_get_line(t, "AT+CBC\r", buffer, out);
     if (ret != command_result::OK) {
         return ret;
     }
@@ -239,11 +277,11 @@ command_result set_flow_control(CommandableIf *t, int dce_flow, int dte_flow)
     return generic_command_common(t, "AT+IFC=" + std::to_string(dce_flow) + "," + std::to_string(dte_flow) + "\r");
 }
 
-command_result get_operator_name(CommandableIf *t, std::string &operator_name, int &act)
+template <typename T> static command_result get_operator_name_to(CommandableIf *t, T &operator_name, int &act)
 {
-    ESP_LOGV(TAG, "%s", __func__ );
-    std::string out;
-    auto ret = generic_get_string(t, "AT+COPS?\r", out, 75000);
+    char buffer[line_max];
+    std::string_view out;
+    auto ret = generic_get_line(t, "AT+COPS?\r", buffer, out, 75000);
     if (ret != command_result::OK) {
         return ret;
     }
@@ -252,24 +290,36 @@ command_result get_operator_name(CommandableIf *t, std::string &operator_name, i
     while (pos != std::string::npos) {
         // Looking for: +COPS: <mode>[, <format>[, <oper>[, <act>]]]
         if (property++ == 2) {  // operator name is after second comma (as a 3rd property of COPS string)
-            operator_name = out.substr(++pos);
-            auto additional_comma = operator_name.find(',');    // check for the optional ACT
-            if (additional_comma != std::string::npos && std::from_chars(operator_name.data() + additional_comma + 1, operator_name.data() + operator_name.length(), act).ec != std::errc::invalid_argument) {
-                operator_name = operator_name.substr(0, additional_comma);
+            auto name = out.substr(++pos);
+            auto additional_comma = name.find(',');    // check for the optional ACT
+            if (additional_comma != std::string::npos && std::from_chars(name.data() + additional_comma + 1, name.data() + name.length(), act).ec != std::errc::invalid_argument) {
+                name = name.substr(0, additional_comma);
             }
             // and strip quotes if present
-            auto quote1 = operator_name.find('"');
-            auto quote2 = operator_name.rfind('"');
+            auto quote1 = name.find('"');
+            auto quote2 = name.rfind('"');
             if (quote1 != std::string::npos && quote2 != std::string::npos) {
-                operator_name = operator_name.substr(quote1 + 1, quote2 - 1);
+                name = name.substr(quote1 + 1, quote2 - 1);
             }
-            return command_result::OK;
+            return str_copy::set(operator_name, name) ? command_result::OK : command_result::FAIL;
         }
         pos = out.find(',', ++pos);
     }
     return command_result::FAIL;
 }
 
+command_result get_operator_name(CommandableIf *t, std::string &operator_name, int &act)
+{
+    ESP_LOGV(TAG, "%s", __func__ );
+    return get_operator_name_to(t, operator_name, act);
+}
+
+command_result get_operator_name(CommandableIf *t, std::span<char> &operator_name, int &act)
+{
+    ESP_LOGV(TAG, "%s", __func__ );
+    return get_operator_name_to(t, operator_name, act);
+}
+
 command_result set_echo(CommandableIf *t, bool on)
 {
     ESP_LOGV(TAG, "%s", __func__ );
@@ -295,27 +345,25 @@ command_result set_pdp_context(CommandableIf *t, PdpContext &pdp)
 command_result set_data_mode(CommandableIf *t)
 {
     ESP_LOGV(TAG, "%s", __func__ );
-    return generic_command(t, "ATD*99#\r", "CONNECT", "ERROR", 5000);
+    return generic_command(t, "ATD*99#\r", phrase::connect, phrase::error, 5000);
 }
 
 command_result set_data_mode_alt(CommandableIf *t)
 {
     ESP_LOGV(TAG, "%s", __func__ );
-    return generic_command(t, "ATD*99##\r", "CONNECT", "ERROR", 5000);
+    return generic_command(t, "ATD*99##\r", phrase::connect, phrase::error, 5000);
 }
 
 command_result resume_data_mode(CommandableIf *t)
 {
     ESP_LOGV(TAG, "%s", __func__ );
-    return generic_command(t, "ATO\r", "CONNECT", "ERROR", 5000);
+    return generic_command(t, "ATO\r", phrase::connect, phrase::error, 5000);
 }
 
 command_result set_command_mode(CommandableIf *t)
 {
     ESP_LOGV(TAG, "%s", __func__ );
-    const auto pass = std::list<std::string_view>({"NO CARRIER", "OK"});
-    const auto fail = std::list<std::string_view>({"ERROR"});
-    return generic_command(t, "+++", pass, fail, 5000);
+    return generic_command(t, "+++", phrase::command_mode, phrase::error, 5000);
 }
 
 command_result get_imsi(CommandableIf *t, std::string &imsi_number)
@@ -324,18 +372,36 @@ command_result get_imsi(CommandableIf *t, std::string &imsi_number)
     return generic_get_string(t, "AT+CIMI\r", imsi_number, 5000);
 }
 
+command_result get_imsi(CommandableIf *t, std::span<char> &imsi_number)
+{
+    ESP_LOGV(TAG, "%s", __func__ );
+    return generic_get_string(t, "AT+CIMI\r", imsi_number, 5000);
+}
+
 command_result get_imei(CommandableIf *t, std::string &out)
 {
     ESP_LOGV(TAG, "%s", __func__ );
     return generic_get_string(t, "AT+CGSN\r", out, 5000);
 }
 
+command_result get_imei(CommandableIf *t, std::span<char> &out)
+{
+    ESP_LOGV(TAG, "%s", __func__ );
+    return generic_get_string(t, "AT+CGSN\r", out, 5000);
+}
+
 command_result get_module_name(CommandableIf *t, std::string &out)
 {
     ESP_LOGV(TAG, "%s", __func__ );
     return generic_get_string(t, "AT+CGMM\r", out, 5000);
 }
 
+command_result get_module_name(CommandableIf *t, std::span<char> &out)
+{
+    ESP_LOGV(TAG, "%s", __func__ );
+    return generic_get_string(t, "AT+CGMM\r", out, 5000);
+}
+
 command_result sms_txt_mode(CommandableIf *t, bool txt = true)
 {
     ESP_LOGV(TAG, "%s", __func__ );
@@ -379,8 +445,9 @@ command_result set_cmux(CommandableIf *t)
 command_result read_pin(CommandableIf *t, bool &pin_ok)
 {
     ESP_LOGV(TAG, "%s", __func__ );
-    std::string out;
-    auto ret = generic_get_string(t, "AT+CPIN?\r", out);
+    char buffer[line_max];
+    std::string_view out;
+    auto ret = generic_get_line(t, "AT+CPIN?\r", buffer, out);
     if (ret != command_result::OK) {
         return ret;
     }
@@ -412,6 +479,13 @@ command_result at(CommandableIf *t, const std::string &cmd, std::string &out, in
     return generic_get_string(t, at_command, out, timeout);
 }
 
+command_result at(CommandableIf *t, const std::string &cmd, std::span<char> &out, int timeout)
+{
+    ESP_LOGV(TAG, "%s", __func__ );
+    std::string at_command = cmd + "\r";
+    return generic_get_string(t, at_command, out, timeout);
+}
+
 command_result at_raw(CommandableIf *t, const std::string &cmd, std::string &out, const std::string &pass, const std::string &fail, int timeout = 500)
 {
     ESP_LOGV(TAG, "%s", __func__ );
@@ -431,8 +505,9 @@ command_result at_raw(CommandableIf *t, const std::string &cmd, std::string &out
 command_result get_signal_quality(CommandableIf *t, int &rssi, int &ber)
 {
     ESP_LOGV(TAG, "%s", __func__ );
-    std::string out;
-    auto ret = generic_get_string(t, "AT+CSQ\r", out);
+    char buffer[line_max];
+    std::string_view out;
+    auto ret = generic_get_line(t, "AT+CSQ\r", buffer, out);
     if (ret != command_result::OK) {
         return ret;
     }
@@ -469,8 +544,9 @@ command_result set_network_attachment_state(CommandableIf *t, int state)
 command_result get_network_attachment_state(CommandableIf *t, int &state)
 {
     ESP_LOGV(TAG, "%s", __func__ );
-    std::string out;
-    auto ret = generic_get_string(t, "AT+CGATT?\r", out);
+    char buffer[line_max];
+    std::string_view out;
+    auto ret = generic_get_line(t, "AT+CGATT?\r", buffer, out);
     if (ret != command_result::OK) {
         return ret;
     }
@@ -496,8 +572,9 @@ command_result set_radio_state(CommandableIf *t, int state)
 command_result get_radio_state(CommandableIf *t, int &state)
 {
     ESP_LOGV(TAG, "%s", __func__ );
-    std::string out;
-    auto ret = generic_get_string(t, "AT+CFUN?\r", out);
+    char buffer[line_max];
+    std::string_view out;
+    auto ret = generic_get_line(t, "AT+CFUN?\r", buffer, out);
     if (ret != command_result::OK) {
         return ret;
     }
@@ -561,8 +638,9 @@ command_result set_network_bands_sim76xx(CommandableIf *t, const std::string &mo
 command_result get_network_system_mode(CommandableIf *t, int &mode)
 {
     ESP_LOGV(TAG, "%s", __func__ );
-    std::string out;
-    auto ret = generic_get_string(t, "AT+CNSMOD?\r", out);
+    char buffer[line_max];
+    std::string_view out;
+    auto ret = generic_get_line(t, "AT+CNSMOD?\r", buffer, out);
     if (ret != command_result::OK) {
         return ret;
     }
@@ -589,8 +667,9 @@ command_result set_gnss_power_mode(CommandableIf *t, int mode)
 command_result get_gnss_power_mode(CommandableIf *t, int &mode)
 {
     ESP_LOGV(TAG, "%s", __func__ );
-    std::string out;
-    auto ret = generic_get_string(t, "AT+CGNSPWR?\r", out);
+    char buffer[line_max];
+    std::string_view out;
+    auto ret = generic_get_line(t, "AT+CGNSPWR?\r", buffer, out);
     if (ret != command_result::OK) {
         return ret;
     }
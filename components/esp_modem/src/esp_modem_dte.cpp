@@ -14,6 +14,10 @@ using namespace esp_modem;
 
 static const size_t dte_default_buffer_size = 1000;
 
+#if defined(CONFIG_ESP_MODEM_USE_INFLATABLE_BUFFER_IF_NEEDED) || defined(CONFIG_ESP_MODEM_USE_FIXED_EXTRA_BUFFER)
+#define DTE_EXTRA_BUFFER 1  // inflatable is either the heap or the fixed variant of the extra buffer
+#endif
+
 DTE::DTE(const esp_modem_dte_config *config, std::unique_ptr<Terminal> terminal):
     buffer(config->dte_buffer_size),
     cmux_term(nullptr), primary_term(std::move(terminal)), secondary_term(primary_term),
@@ -57,9 +61,13 @@ void DTE::set_command_callbacks()
             // For terminals which post data directly with the callback (CMUX)
             // we cannot defragment unless we allocate, but
             // we'll try to process the data on the actual buffer
-#ifdef CONFIG_ESP_MODEM_USE_INFLATABLE_BUFFER_IF_NEEDED
+#ifdef DTE_EXTRA_BUFFER
+            note_reply(inflatable.consumed + len);
             if (inflatable.consumed != 0) {
-                inflatable.grow(inflatable.consumed + len);
+                if (!inflatable.grow(inflatable.consumed + len)) {
+                    give_up_overflow();
+                    return true;
+                }
                 std::memcpy(inflatable.current(), data, len);
                 data = inflatable.begin();
             }
@@ -69,12 +77,16 @@ void DTE::set_command_callbacks()
             // at this point we're sure that the data processing hasn't finished,
             // and we have to grow the inflatable buffer (if enabled) or give up
             if (inflatable.consumed == 0) {
-                inflatable.grow(len);
+                if (!inflatable.grow(len)) {
+                    give_up_overflow();
+                    return true;
+                }
                 std::memcpy(inflatable.begin(), data, len);
             }
             inflatable.consumed += len;
             return false;
 #else
+            note_reply(len);
             if (command_cb.process_line(data, 0, len)) {
                 return true;
             }
@@ -88,6 +100,7 @@ void DTE::set_command_callbacks()
         if (buffer.size > buffer.consumed) {
             data = buffer.get();
             len = primary_term->read(data + buffer.consumed, buffer.size - buffer.consumed);
+            note_reply(buffer.consumed + len);
             if (command_cb.process_line(data, buffer.consumed, len)) {
                 return true;
             }
@@ -95,25 +108,24 @@ void DTE::set_command_callbacks()
             return false;
         }
         // we have used the entire DTE's buffer, need to use the inflatable buffer to continue
-#ifdef CONFIG_ESP_MODEM_USE_INFLATABLE_BUFFER_IF_NEEDED
-        if (inflatable.consumed == 0) {
-            inflatable.grow(buffer.size + len);
-            std::memcpy(inflatable.begin(), buffer.get(), buffer.size);
-            inflatable.consumed = buffer.size;
-        } else {
-            inflatable.grow(inflatable.consumed + len);
-        }
-        len = primary_term->read(inflatable.current(), len);
-        if (command_cb.process_line(inflatable.begin(), inflatable.consumed, len)) {
-            return true;
+#ifdef DTE_EXTRA_BUFFER
+        if (inflatable.grow((inflatable.consumed == 0 ? buffer.size : inflatable.consumed) + len)) {
+            if (inflatable.consumed == 0) {
+                std::memcpy(inflatable.begin(), buffer.get(), buffer.size);
+                inflatable.consumed = buffer.size;
+            }
+            len = primary_term->read(inflatable.current(), len);
+            note_reply(inflatable.consumed + len);
+            if (command_cb.process_line(inflatable.begin(), inflatable.consumed, len)) {
+                return true;
+            }
+            inflatable.consumed += len;
+            return false;
         }
-        inflatable.consumed += len;
-        return false;
-#else
-        // cannot inflate -> report a failure
-        command_cb.give_up();
-        return true;
 #endif
+        // cannot inflate (further) -> report a failure
+        give_up_overflow();
+        return true;
     });
     primary_term->set_error_cb([this](terminal_error err) {
         if (user_error_cb) {
@@ -138,7 +150,7 @@ command_result DTE::command(const std::string &command, got_line_cb got_line, ui
     command_cb.wait_for_line(time_ms);
     command_cb.set(nullptr);
     buffer.consumed = 0;
-#ifdef CONFIG_ESP_MODEM_USE_INFLATABLE_BUFFER_IF_NEEDED
+#ifdef DTE_EXTRA_BUFFER
     inflatable.deflate();
 #endif
     return command_cb.result;
@@ -368,6 +380,15 @@ bool DTE::recover()
     return false;
 }
 
+void DTE::give_up_overflow()
+{
+    // the rest of the reply may still come in, count it once
+    if (!command_cb.signal.is_any(command_cb::GOT_LINE)) {
+        stats.overflows++;
+    }
+    command_cb.give_up();
+}
+
 void DTE::handle_error(terminal_error err)
 {
     if (err == terminal_error::BUFFER_OVERFLOW ||
@@ -378,7 +399,7 @@ void DTE::handle_error(terminal_error err)
 }
 
 #ifdef CONFIG_ESP_MODEM_USE_INFLATABLE_BUFFER_IF_NEEDED
-void DTE::extra_buffer::grow(size_t need_size)
+bool DTE::extra_buffer::grow(size_t need_size)
 {
     if (need_size == 0) {
         delete buffer;
@@ -388,6 +409,7 @@ void DTE::extra_buffer::grow(size_t need_size)
     } else {
         buffer->resize(need_size);
     }
+    return true;
 }
 #endif
 
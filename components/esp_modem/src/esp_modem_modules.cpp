@@ -39,6 +39,31 @@ DECLARE_ALL_COMMAND_APIS(return_type name(...) )
 
 #undef ESP_MODEM_DECLARE_DCE_COMMAND
 
+command_result GenericModule::at(const std::string &cmd, std::span<char> &out, int timeout)
+{
+    return esp_modem::dce_commands::at(dte.get(), cmd, out, timeout);
+}
+
+command_result GenericModule::get_imsi(std::span<char> &imsi_number)
+{
+    return esp_modem::dce_commands::get_imsi(dte.get(), imsi_number);
+}
+
+command_result GenericModule::get_imei(std::span<char> &imei)
+{
+    return esp_modem::dce_commands::get_imei(dte.get(), imei);
+}
+
+command_result GenericModule::get_module_name(std::span<char> &name)
+{
+    return esp_modem::dce_commands::get_module_name(dte.get(), name);
+}
+
+command_result GenericModule::get_operator_name(std::span<char> &name, int &act)
+{
+    return esp_modem::dce_commands::get_operator_name(dte.get(), name, act);
+}
+
 //
 // Handle specific commands for specific supported modems
 //
@@ -6,12 +6,69 @@
 #define CATCH_CONFIG_MAIN // This tells the catch header to generate a main
 #include <memory>
 #include <future>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <span>
 #include "catch.hpp"
 #include "cxx_include/esp_modem_api.hpp"
+#include "cxx_include/esp_modem_command_library.hpp"
 #include "LoopbackTerm.h"
 
 using namespace esp_modem;
 
+// Counts heap allocations while enabled, for the allocation free command checks below.
+// All the variants are replaced, so that the sanitizer sees matching allocs and frees
+static bool count_allocs = false;
+static size_t alloc_count = 0;
+
+void *operator new (size_t size, const std::nothrow_t &) noexcept
+{
+    if (count_allocs) {
+        alloc_count++;
+    }
+    return malloc(size);
+}
+
+void *operator new (size_t size)
+{
+    void *p = operator new (size, std::nothrow);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new (size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+    return operator new (size, std::nothrow);
+}
+
+void operator delete (void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete (void *p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+    free(p);
+}
+
 TEST_CASE("DTE command races", "[esp_modem]")
 {
     auto term = std::make_unique<LoopbackTerm>(true);
@@ -106,6 +163,109 @@ TEST_CASE("DCE AT parser", "[esp_modem]")
     CHECK(dce->get_operator_name(operator_name, act) == command_result::OK);
     CHECK(operator_name == "OperatorName");
     CHECK(act == 5);
+
+    char buffer[32];
+    std::span<char> model_span(buffer);
+    CHECK(dce->get_module_name(model_span) == command_result::OK);
+    CHECK(std::string_view(model_span.data(), model_span.size()) == "0G Dummy Model");
+
+    std::span<char> operator_span(buffer);
+    CHECK(dce->get_operator_name(operator_span, act) == command_result::OK);
+    CHECK(std::string_view(operator_span.data(), operator_span.size()) == "OperatorName");
+
+    char small[4];
+    std::span<char> small_span(small);
+    CHECK(dce->get_module_name(small_span) == command_result::FAIL);
+    CHECK(small_span.empty());
+
+    auto stats = dte->get_buffer_stats();
+    CHECK(stats.peak > 0);
+    CHECK(stats.overflows == 0);
+}
+
+/**
+ * Replies to every command with a fixed response, without allocating
+ */
+class ReplayCommandable: public CommandableIf {
+public:
+    const char *reply = "";
+
+    command_result command(const std::string &cmd, got_line_cb got_line, uint32_t time_ms, const char separator) override
+    {
+        size_t len = strlen(reply);
+        memcpy(buffer, reply, len);
+        return got_line(buffer, len);
+    }
+
+    command_result command(const std::string &cmd, got_line_cb got_line, uint32_t time_ms) override
+    {
+        return command(cmd, got_line, time_ms, '\n');
+    }
+
+    int write(uint8_t *data, size_t len) override
+    {
+        return len;
+    }
+
+    void on_read(got_line_cb on_data) override {}
+
+private:
+    uint8_t buffer[128];
+};
+
+template <typename F> static size_t allocations(F &&cmd)
+{
+    alloc_count = 0;
+    count_allocs = true;
+    cmd();
+    count_allocs = false;
+    return alloc_count;
+}
+
+TEST_CASE("Command library doesn't allocate", "[esp_modem]")
+{
+    ReplayCommandable t;
+    command_result ret;
+
+    t.reply = "\r\nOK\r\n";
+    CHECK(allocations([&] { ret = dce_commands::sync(&t); }) == 0);
+    CHECK(ret == command_result::OK);
+    CHECK(allocations([&] { ret = dce_commands::set_command_mode(&t); }) == 0);
+    CHECK(ret == command_result::OK);
+    CHECK(allocations([&] { ret = dce_commands::set_network_mode(&t, 38); }) == 0);
+    CHECK(ret == command_result::OK);
+
+    t.reply = "\r\nCONNECT 115200\r\n";
+    CHECK(allocations([&] { ret = dce_commands::set_data_mode(&t); }) == 0);
+    CHECK(ret == command_result::OK);
+
+    int rssi = 0, ber = 0;
+    t.reply = "\r\n+CSQ: 18,99\r\n\r\nOK\r\n";
+    CHECK(allocations([&] { ret = dce_commands::get_signal_quality(&t, rssi, ber); }) == 0);
+    CHECK(ret == command_result::OK);
+    CHECK(rssi == 18);
+    CHECK(ber == 99);
+
+    bool pin_ok = false;
+    t.reply = "\r\n+CPIN: READY\r\n\r\nOK\r\n";
+    CHECK(allocations([&] { ret = dce_commands::read_pin(&t, pin_ok); }) == 0);
+    CHECK(ret == command_result::OK);
+    CHECK(pin_ok == true);
+
+    char buffer[64];
+    std::span<char> out(buffer);
+    t.reply = "\r\n+CGPSINFO: ,,,,,,,,\r\n\r\nOK\r\n";
+    CHECK(allocations([&] { ret = dce_commands::at(&t, "AT+CGPSINFO", out, 500); }) == 0);
+    CHECK(ret == command_result::OK);
+    CHECK(std::string_view(out.data(), out.size()) == "+CGPSINFO: ,,,,,,,,");
+
+    int act = 0;
+    std::span<char> name(buffer);
+    t.reply = "\r\n+COPS: 0,0,\"OperatorName\",7\r\n\r\nOK\r\n";
+    CHECK(allocations([&] { ret = dce_commands::get_operator_name(&t, name, act); }) == 0);
+    CHECK(ret == command_result::OK);
+    CHECK(std::string_view(name.data(), name.size()) == "OperatorName");
+    CHECK(act == 7);
 }
 
 
@@ -143,25 +143,21 @@ void ui_DataScreen_screen_init(void)
     lv_obj_set_style_text_opa(ui_PT1000Label, 255, LV_PART_MAIN | LV_STATE_DEFAULT);
     lv_obj_set_style_text_font(ui_PT1000Label, &lv_font_montserrat_14, LV_PART_MAIN | LV_STATE_DEFAULT);
 
-    ui_PT1000TextArea = lv_textarea_create(ui_DataScreen);
+    ui_PT1000TextArea = ui_readout_create(ui_DataScreen);
     lv_obj_set_width(ui_PT1000TextArea, 53);
     lv_obj_set_height(ui_PT1000TextArea, 36);
     lv_obj_set_x(ui_PT1000TextArea, -115);
     lv_obj_set_y(ui_PT1000TextArea, 101);
     lv_obj_set_align(ui_PT1000TextArea, LV_ALIGN_CENTER);
-    lv_textarea_set_text(ui_PT1000TextArea, "999");
-    lv_textarea_set_placeholder_text(ui_PT1000TextArea, "Placeholder...");
-    lv_obj_clear_flag(ui_PT1000TextArea,
-                      LV_OBJ_FLAG_CLICKABLE | LV_OBJ_FLAG_PRESS_LOCK | LV_OBJ_FLAG_CLICK_FOCUSABLE | LV_OBJ_FLAG_GESTURE_BUBBLE |
-                      LV_OBJ_FLAG_SNAPPABLE | LV_OBJ_FLAG_SCROLLABLE | LV_OBJ_FLAG_SCROLL_ELASTIC | LV_OBJ_FLAG_SCROLL_MOMENTUM |
-                      LV_OBJ_FLAG_SCROLL_CHAIN);     /// Flags
+    ui_readout_set_cells(ui_PT1000TextArea, 5);
     lv_obj_set_style_text_color(ui_PT1000TextArea, lv_color_hex(0xFFFFFF), LV_PART_MAIN | LV_STATE_DEFAULT);
-    lv_obj_set_style_text_opa(ui_PT1000TextArea, 255, LV_PART_MAIN | LV_STATE_DEFAULT);
     lv_obj_set_style_text_align(ui_PT1000TextArea, LV_TEXT_ALIGN_RIGHT, LV_PART_MAIN | LV_STATE_DEFAULT);
-    lv_obj_set_style_bg_color(ui_PT1000TextArea, lv_color_hex(0xFFFFFF), LV_PART_MAIN | LV_STATE_DEFAULT);
-    lv_obj_set_style_bg_opa(ui_PT1000TextArea, 0, LV_PART_MAIN | LV_STATE_DEFAULT);
-    lv_obj_set_style_border_color(ui_PT1000TextArea, lv_color_hex(0x000000), LV_PART_MAIN | LV_STATE_DEFAULT);
-    lv_obj_set_style_border_opa(ui_PT1000TextArea, 0, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_pad_left(ui_PT1000TextArea, 0, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_pad_right(ui_PT1000TextArea, 8, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_pad_top(ui_PT1000TextArea, 8, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_bg_color(ui_PT1000TextArea, lv_color_hex(0x002447), LV_PART_ITEMS | LV_STATE_DEFAULT);
+    lv_obj_set_style_bg_opa(ui_PT1000TextArea, 255, LV_PART_ITEMS | LV_STATE_DEFAULT);
+    ui_readout_set_text(ui_PT1000TextArea, "999");
 
     ui_Degrees1Label = lv_label_create(ui_DataScreen);
     lv_obj_set_width(ui_Degrees1Label, LV_SIZE_CONTENT);   /// 1
@@ -248,24 +244,21 @@ void ui_DataScreen_screen_init(void)
     lv_obj_set_style_text_opa(ui_BatteryVLabel, 255, LV_PART_MAIN | LV_STATE_DEFAULT);
     lv_obj_set_style_text_font(ui_BatteryVLabel, &lv_font_montserrat_14, LV_PART_MAIN | LV_STATE_DEFAULT);
 
-    ui_BattVTextArea = lv_textarea_create(ui_DataScreen);
+    ui_BattVTextArea = ui_readout_create(ui_DataScreen);
     lv_obj_set_width(ui_BattVTextArea, 65);
     lv_obj_set_height(ui_BattVTextArea, 40);
     lv_obj_set_x(ui_BattVTextArea, -9);
     lv_obj_set_y(ui_BattVTextArea, 92);
     lv_obj_set_align(ui_BattVTextArea, LV_ALIGN_CENTER);
-    lv_textarea_set_text(ui_BattVTextArea, "-  ");
-    lv_textarea_set_placeholder_text(ui_BattVTextArea, "Placeholder...");
-    lv_obj_clear_flag(ui_BattVTextArea, LV_OBJ_FLAG_CLICKABLE | LV_OBJ_FLAG_PRESS_LOCK | LV_OBJ_FLAG_CLICK_FOCUSABLE |
-                      LV_OBJ_FLAG_GESTURE_BUBBLE | LV_OBJ_FLAG_SNAPPABLE | LV_OBJ_FLAG_SCROLLABLE | LV_OBJ_FLAG_SCROLL_ELASTIC |
-                      LV_OBJ_FLAG_SCROLL_MOMENTUM | LV_OBJ_FLAG_SCROLL_CHAIN);     /// Flags
+    ui_readout_set_cells(ui_BattVTextArea, 5);
     lv_obj_set_style_text_color(ui_BattVTextArea, lv_color_hex(0xFFFFFF), LV_PART_MAIN | LV_STATE_DEFAULT);
-    lv_obj_set_style_text_opa(ui_BattVTextArea, 255, LV_PART_MAIN | LV_STATE_DEFAULT);
     lv_obj_set_style_text_align(ui_BattVTextArea, LV_TEXT_ALIGN_RIGHT, LV_PART_MAIN | LV_STATE_DEFAULT);
-    lv_obj_set_style_bg_color(ui_BattVTextArea, lv_color_hex(0xFFFFFF), LV_PART_MAIN | LV_STATE_DEFAULT);
-    lv_obj_set_style_bg_opa(ui_BattVTextArea, 0, LV_PART_MAIN | LV_STATE_DEFAULT);
-    lv_obj_set_style_border_color(ui_BattVTextArea, lv_color_hex(0xFFFFFF), LV_PART_MAIN | LV_STATE_DEFAULT);
-    lv_obj_set_style_border_opa(ui_BattVTextArea, 0, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_pad_left(ui_BattVTextArea, 8, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_pad_right(ui_BattVTextArea, 8, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_pad_top(ui_BattVTextArea, 8, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_bg_color(ui_BattVTextArea, lv_color_hex(0x002447), LV_PART_ITEMS | LV_STATE_DEFAULT);
+    lv_obj_set_style_bg_opa(ui_BattVTextArea, 255, LV_PART_ITEMS | LV_STATE_DEFAULT);
+    ui_readout_set_text(ui_BattVTextArea, "-  ");
 
     ui_BMEPanel = lv_obj_create(ui_DataScreen);
     lv_obj_set_width(ui_BMEPanel, 100);
@@ -281,25 +274,21 @@ void ui_DataScreen_screen_init(void)
     lv_obj_set_style_border_color(ui_BMEPanel, lv_color_hex(0x003F5A), LV_PART_MAIN | LV_STATE_DEFAULT);
     lv_obj_set_style_border_opa(ui_BMEPanel, 255, LV_PART_MAIN | LV_STATE_DEFAULT);
 
-    ui_BMETempTextArea = lv_textarea_create(ui_DataScreen);
+    ui_BMETempTextArea = ui_readout_create(ui_DataScreen);
     lv_obj_set_width(ui_BMETempTextArea, 53);
     lv_obj_set_height(ui_BMETempTextArea, 36);
     lv_obj_set_x(ui_BMETempTextArea, -120);
     lv_obj_set_y(ui_BMETempTextArea, 3);
     lv_obj_set_align(ui_BMETempTextArea, LV_ALIGN_CENTER);
-    lv_textarea_set_text(ui_BMETempTextArea, "999");
-    lv_textarea_set_placeholder_text(ui_BMETempTextArea, "Placeholder...");
-    lv_obj_clear_flag(ui_BMETempTextArea,
-                      LV_OBJ_FLAG_CLICKABLE | LV_OBJ_FLAG_PRESS_LOCK | LV_OBJ_FLAG_CLICK_FOCUSABLE | LV_OBJ_FLAG_GESTURE_BUBBLE |
-                      LV_OBJ_FLAG_SNAPPABLE | LV_OBJ_FLAG_SCROLLABLE | LV_OBJ_FLAG_SCROLL_ELASTIC | LV_OBJ_FLAG_SCROLL_MOMENTUM |
-                      LV_OBJ_FLAG_SCROLL_CHAIN);     /// Flags
+    ui_readout_set_cells(ui_BMETempTextArea, 5);
     lv_obj_set_style_text_color(ui_BMETempTextArea, lv_color_hex(0xFFFFFF), LV_PART_MAIN | LV_STATE_DEFAULT);
-    lv_obj_set_style_text_opa(ui_BMETempTextArea, 255, LV_PART_MAIN | LV_STATE_DEFAULT);
     lv_obj_set_style_text_align(ui_BMETempTextArea, LV_TEXT_ALIGN_RIGHT, LV_PART_MAIN | LV_STATE_DEFAULT);
-    lv_obj_set_style_bg_color(ui_BMETempTextArea, lv_color_hex(0xFFFFFF), LV_PART_MAIN | LV_STATE_DEFAULT);
-    lv_obj_set_style_bg_opa(ui_BMETempTextArea, 0, LV_PART_MAIN | LV_STATE_DEFAULT);
-    lv_obj_set_style_border_color(ui_BMETempTextArea, lv_color_hex(0x000000), LV_PART_MAIN | LV_STATE_DEFAULT);
-    lv_obj_set_style_border_opa(ui_BMETempTextArea, 0, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_pad_left(ui_BMETempTextArea, 0, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_pad_right(ui_BMETempTextArea, 8, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_pad_top(ui_BMETempTextArea, 8, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_bg_color(ui_BMETempTextArea, lv_color_hex(0x002447), LV_PART_ITEMS | LV_STATE_DEFAULT);
+    lv_obj_set_style_bg_opa(ui_BMETempTextArea, 255, LV_PART_ITEMS | LV_STATE_DEFAULT);
+    ui_readout_set_text(ui_BMETempTextArea, "999");
 
     ui_Degrees2Label = lv_label_create(ui_DataScreen);
     lv_obj_set_width(ui_Degrees2Label, LV_SIZE_CONTENT);   /// 1
@@ -313,25 +302,21 @@ void ui_DataScreen_screen_init(void)
     lv_obj_set_style_text_align(ui_Degrees2Label, LV_TEXT_ALIGN_LEFT, LV_PART_MAIN | LV_STATE_DEFAULT);
     lv_obj_set_style_text_font(ui_Degrees2Label, &lv_font_montserrat_14, LV_PART_MAIN | LV_STATE_DEFAULT);
 
-    ui_BMEPresTextArea = lv_textarea_create(ui_DataScreen);
+    ui_BMEPresTextArea = ui_readout_create(ui_DataScreen);
     lv_obj_set_width(ui_BMEPresTextArea, 65);
     lv_obj_set_height(ui_BMEPresTextArea, 36);
     lv_obj_set_x(ui_BMEPresTextArea, -127);
     lv_obj_set_y(ui_BMEPresTextArea, 23);
     lv_obj_set_align(ui_BMEPresTextArea, LV_ALIGN_CENTER);
-    lv_textarea_set_text(ui_BMEPresTextArea, "199.9");
-    lv_textarea_set_placeholder_text(ui_BMEPresTextArea, "Placeholder...");
-    lv_obj_clear_flag(ui_BMEPresTextArea,
-                      LV_OBJ_FLAG_CLICKABLE | LV_OBJ_FLAG_PRESS_LOCK | LV_OBJ_FLAG_CLICK_FOCUSABLE | LV_OBJ_FLAG_GESTURE_BUBBLE |
-                      LV_OBJ_FLAG_SNAPPABLE | LV_OBJ_FLAG_SCROLLABLE | LV_OBJ_FLAG_SCROLL_ELASTIC | LV_OBJ_FLAG_SCROLL_MOMENTUM |
-                      LV_OBJ_FLAG_SCROLL_CHAIN);     /// Flags
+    ui_readout_set_cells(ui_BMEPresTextArea, 6);
     lv_obj_set_style_text_color(ui_BMEPresTextArea, lv_color_hex(0xFFFFFF), LV_PART_MAIN | LV_STATE_DEFAULT);
-    lv_obj_set_style_text_opa(ui_BMEPresTextArea, 255, LV_PART_MAIN | LV_STATE_DEFAULT);
     lv_obj_set_style_text_align(ui_BMEPresTextArea, LV_TEXT_ALIGN_RIGHT, LV_PART_MAIN | LV_STATE_DEFAULT);
-    lv_obj_set_style_bg_color(ui_BMEPresTextArea, lv_color_hex(0xFFFFFF), LV_PART_MAIN | LV_STATE_DEFAULT);
-    lv_obj_set_style_bg_opa(ui_BMEPresTextArea, 0, LV_PART_MAIN | LV_STATE_DEFAULT);
-    lv_obj_set_style_border_color(ui_BMEPresTextArea, lv_color_hex(0x000000), LV_PART_MAIN | LV_STATE_DEFAULT);
-    lv_obj_set_style_border_opa(ui_BMEPresTextArea, 0, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_pad_left(ui_BMEPresTextArea, 0, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_pad_right(ui_BMEPresTextArea, 8, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_pad_top(ui_BMEPresTextArea, 8, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_bg_color(ui_BMEPresTextArea, lv_color_hex(0x002447), LV_PART_ITEMS | LV_STATE_DEFAULT);
+    lv_obj_set_style_bg_opa(ui_BMEPresTextArea, 255, LV_PART_ITEMS | LV_STATE_DEFAULT);
+    ui_readout_set_text(ui_BMEPresTextArea, "199.9");
 
     ui_PresLabel = lv_label_create(ui_DataScreen);
     lv_obj_set_width(ui_PresLabel, LV_SIZE_CONTENT);   /// 1
@@ -355,25 +340,21 @@ void ui_DataScreen_screen_init(void)
     lv_obj_set_style_text_opa(ui_HumLabel, 255, LV_PART_MAIN | LV_STATE_DEFAULT);
     lv_obj_set_style_text_font(ui_HumLabel, &lv_font_montserrat_14, LV_PART_MAIN | LV_STATE_DEFAULT);
 
-    ui_BMEHumTextArea = lv_textarea_create(ui_DataScreen);
+    ui_BMEHumTextArea = ui_readout_create(ui_DataScreen);
     lv_obj_set_width(ui_BMEHumTextArea, 53);
     lv_obj_set_height(ui_BMEHumTextArea, 36);
     lv_obj_set_x(ui_BMEHumTextArea, -120);
     lv_obj_set_y(ui_BMEHumTextArea, 47);
     lv_obj_set_align(ui_BMEHumTextArea, LV_ALIGN_CENTER);
-    lv_textarea_set_text(ui_BMEHumTextArea, "999");
-    lv_textarea_set_placeholder_text(ui_BMEHumTextArea, "Placeholder...");
-    lv_obj_clear_flag(ui_BMEHumTextArea,
-                      LV_OBJ_FLAG_CLICKABLE | LV_OBJ_FLAG_PRESS_LOCK | LV_OBJ_FLAG_CLICK_FOCUSABLE | LV_OBJ_FLAG_GESTURE_BUBBLE |
-                      LV_OBJ_FLAG_SNAPPABLE | LV_OBJ_FLAG_SCROLLABLE | LV_OBJ_FLAG_SCROLL_ELASTIC | LV_OBJ_FLAG_SCROLL_MOMENTUM |
-                      LV_OBJ_FLAG_SCROLL_CHAIN);     /// Flags
+    ui_readout_set_cells(ui_BMEHumTextArea, 5);
     lv_obj_set_style_text_color(ui_BMEHumTextArea, lv_color_hex(0xFFFFFF), LV_PART_MAIN | LV_STATE_DEFAULT);
-    lv_obj_set_style_text_opa(ui_BMEHumTextArea, 255, LV_PART_MAIN | LV_STATE_DEFAULT);
     lv_obj_set_style_text_align(ui_BMEHumTextArea, LV_TEXT_ALIGN_RIGHT, LV_PART_MAIN | LV_STATE_DEFAULT);
-    lv_obj_set_style_bg_color(ui_BMEHumTextArea, lv_color_hex(0xFFFFFF), LV_PART_MAIN | LV_STATE_DEFAULT);
-    lv_obj_set_style_bg_opa(ui_BMEHumTextArea, 0, LV_PART_MAIN | LV_STATE_DEFAULT);
-    lv_obj_set_style_border_color(ui_BMEHumTextArea, lv_color_hex(0x000000), LV_PART_MAIN | LV_STATE_DEFAULT);
-    lv_obj_set_style_border_opa(ui_BMEHumTextArea, 0, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_pad_left(ui_BMEHumTextArea, 0, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_pad_right(ui_BMEHumTextArea, 8, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_pad_top(ui_BMEHumTextArea, 8, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_bg_color(ui_BMEHumTextArea, lv_color_hex(0x002447), LV_PART_ITEMS | LV_STATE_DEFAULT);
+    lv_obj_set_style_bg_opa(ui_BMEHumTextArea, 255, LV_PART_ITEMS | LV_STATE_DEFAULT);
+    ui_readout_set_text(ui_BMEHumTextArea, "999");
 
     ui_PumpLabel = lv_label_create(ui_DataScreen);
     lv_obj_set_width(ui_PumpLabel, LV_SIZE_CONTENT);   /// 1
@@ -504,25 +485,21 @@ void ui_DataScreen_screen_init(void)
     lv_obj_clear_flag(ui_IntTankBar, LV_OBJ_FLAG_PRESS_LOCK | LV_OBJ_FLAG_CLICK_FOCUSABLE | LV_OBJ_FLAG_GESTURE_BUBBLE |
                       LV_OBJ_FLAG_SNAPPABLE);     /// Flags
 
-    ui_IntTankTextArea = lv_textarea_create(ui_DataScreen);
+    ui_IntTankTextArea = ui_readout_create(ui_DataScreen);
     lv_obj_set_width(ui_IntTankTextArea, 49);
     lv_obj_set_height(ui_IntTankTextArea, 37);
     lv_obj_set_x(ui_IntTankTextArea, 130);
     lv_obj_set_y(ui_IntTankTextArea, -26);
     lv_obj_set_align(ui_IntTankTextArea, LV_ALIGN_CENTER);
-    lv_textarea_set_text(ui_IntTankTextArea, "-");
-    lv_textarea_set_placeholder_text(ui_IntTankTextArea, "Placeholder...");
-    lv_obj_clear_flag(ui_IntTankTextArea,
-                      LV_OBJ_FLAG_CLICKABLE | LV_OBJ_FLAG_PRESS_LOCK | LV_OBJ_FLAG_CLICK_FOCUSABLE | LV_OBJ_FLAG_GESTURE_BUBBLE |
-                      LV_OBJ_FLAG_SNAPPABLE | LV_OBJ_FLAG_SCROLLABLE | LV_OBJ_FLAG_SCROLL_ELASTIC | LV_OBJ_FLAG_SCROLL_MOMENTUM |
-                      LV_OBJ_FLAG_SCROLL_CHAIN);     /// Flags
+    ui_readout_set_cells(ui_IntTankTextArea, 3);
     lv_obj_set_style_text_color(ui_IntTankTextArea, lv_color_hex(0xFFFFFF), LV_PART_MAIN | LV_STATE_DEFAULT);
-    lv_obj_set_style_text_opa(ui_IntTankTextArea, 255, LV_PART_MAIN | LV_STATE_DEFAULT);
     lv_obj_set_style_text_align(ui_IntTankTextArea, LV_TEXT_ALIGN_LEFT, LV_PART_MAIN | LV_STATE_DEFAULT);
-    lv_obj_set_style_bg_color(ui_IntTankTextArea, lv_color_hex(0xFFFFFF), LV_PART_MAIN | LV_STATE_DEFAULT);
-    lv_obj_set_style_bg_opa(ui_IntTankTextArea, 0, LV_PART_MAIN | LV_STATE_DEFAULT);
-    lv_obj_set_style_border_color(ui_IntTankTextArea, lv_color_hex(0xFFFFFF), LV_PART_MAIN | LV_STATE_DEFAULT);
-    lv_obj_set_style_border_opa(ui_IntTankTextArea, 0, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_pad_left(ui_IntTankTextArea, 8, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_pad_right(ui_IntTankTextArea, 8, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_pad_top(ui_IntTankTextArea, 8, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_bg_color(ui_IntTankTextArea, lv_color_hex(0x002447), LV_PART_ITEMS | LV_STATE_DEFAULT);
+    lv_obj_set_style_bg_opa(ui_IntTankTextArea, 255, LV_PART_ITEMS | LV_STATE_DEFAULT);
+    ui_readout_set_text(ui_IntTankTextArea, "-");
 
     ui_ExtTankBar = lv_bar_create(ui_DataScreen);
     lv_obj_set_width(ui_ExtTankBar, 37);
@@ -533,25 +510,21 @@ void ui_DataScreen_screen_init(void)
     lv_obj_clear_flag(ui_ExtTankBar, LV_OBJ_FLAG_PRESS_LOCK | LV_OBJ_FLAG_CLICK_FOCUSABLE | LV_OBJ_FLAG_GESTURE_BUBBLE |
                       LV_OBJ_FLAG_SNAPPABLE);     /// Flags
 
-    ui_ExtTankTextArea = lv_textarea_create(ui_DataScreen);
+    ui_ExtTankTextArea = ui_readout_create(ui_DataScreen);
     lv_obj_set_width(ui_ExtTankTextArea, 49);
     lv_obj_set_height(ui_ExtTankTextArea, 37);
     lv_obj_set_x(ui_ExtTankTextArea, 130);
     lv_obj_set_y(ui_ExtTankTextArea, 32);
     lv_obj_set_align(ui_ExtTankTextArea, LV_ALIGN_CENTER);
-    lv_textarea_set_text(ui_ExtTankTextArea, "-");
-    lv_textarea_set_placeholder_text(ui_ExtTankTextArea, "Placeholder...");
-    lv_obj_clear_flag(ui_ExtTankTextArea,
-                      LV_OBJ_FLAG_CLICKABLE | LV_OBJ_FLAG_PRESS_LOCK | LV_OBJ_FLAG_CLICK_FOCUSABLE | LV_OBJ_FLAG_GESTURE_BUBBLE |
-                      LV_OBJ_FLAG_SNAPPABLE | LV_OBJ_FLAG_SCROLLABLE | LV_OBJ_FLAG_SCROLL_ELASTIC | LV_OBJ_FLAG_SCROLL_MOMENTUM |
-                      LV_OBJ_FLAG_SCROLL_CHAIN);     /// Flags
+    ui_readout_set_cells(ui_ExtTankTextArea, 3);
     lv_obj_set_style_text_color(ui_ExtTankTextArea, lv_color_hex(0xFFFFFF), LV_PART_MAIN | LV_STATE_DEFAULT);
-    lv_obj_set_style_text_opa(ui_ExtTankTextArea, 255, LV_PART_MAIN | LV_STATE_DEFAULT);
     lv_obj_set_style_text_align(ui_ExtTankTextArea, LV_TEXT_ALIGN_LEFT, LV_PART_MAIN | LV_STATE_DEFAULT);
-    lv_obj_set_style_bg_color(ui_ExtTankTextArea, lv_color_hex(0xFFFFFF), LV_PART_MAIN | LV_STATE_DEFAULT);
-    lv_obj_set_style_bg_opa(ui_ExtTankTextArea, 0, LV_PART_MAIN | LV_STATE_DEFAULT);
-    lv_obj_set_style_border_color(ui_ExtTankTextArea, lv_color_hex(0xFFFFFF), LV_PART_MAIN | LV_STATE_DEFAULT);
-    lv_obj_set_style_border_opa(ui_ExtTankTextArea, 0, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_pad_left(ui_ExtTankTextArea, 8, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_pad_right(ui_ExtTankTextArea, 8, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_pad_top(ui_ExtTankTextArea, 8, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_bg_color(ui_ExtTankTextArea, lv_color_hex(0x002447), LV_PART_ITEMS | LV_STATE_DEFAULT);
+    lv_obj_set_style_bg_opa(ui_ExtTankTextArea, 255, LV_PART_ITEMS | LV_STATE_DEFAULT);
+    ui_readout_set_text(ui_ExtTankTextArea, "-");
 
     ui_AuxTankLabel1 = lv_label_create(ui_DataScreen);
     lv_obj_set_width(ui_AuxTankLabel1, LV_SIZE_CONTENT);   /// 1
@@ -576,25 +549,21 @@ void ui_DataScreen_screen_init(void)
     //lv_obj_set_style_bg_color(ui_ExtTankBar1, lv_color_hex(0xAFA504), LV_PART_INDICATOR | LV_STATE_DEFAULT);
     //lv_obj_set_style_bg_opa(ui_ExtTankBar1, 255, LV_PART_INDICATOR | LV_STATE_DEFAULT);
 
-    ui_AuxTankTextArea = lv_textarea_create(ui_DataScreen);
+    ui_AuxTankTextArea = ui_readout_create(ui_DataScreen);
     lv_obj_set_width(ui_AuxTankTextArea, 49);
     lv_obj_set_height(ui_AuxTankTextArea, 37);
     lv_obj_set_x(ui_AuxTankTextArea, 130);
     lv_obj_set_y(ui_AuxTankTextArea, 90);
     lv_obj_set_align(ui_AuxTankTextArea, LV_ALIGN_CENTER);
-    lv_textarea_set_text(ui_AuxTankTextArea, "-");
-    lv_textarea_set_placeholder_text(ui_AuxTankTextArea, "Placeholder...");
-    lv_obj_clear_flag(ui_AuxTankTextArea,
-                      LV_OBJ_FLAG_CLICKABLE | LV_OBJ_FLAG_PRESS_LOCK | LV_OBJ_FLAG_CLICK_FOCUSABLE | LV_OBJ_FLAG_GESTURE_BUBBLE |
-                      LV_OBJ_FLAG_SNAPPABLE | LV_OBJ_FLAG_SCROLLABLE | LV_OBJ_FLAG_SCROLL_ELASTIC | LV_OBJ_FLAG_SCROLL_MOMENTUM |
-                      LV_OBJ_FLAG_SCROLL_CHAIN);     /// Flags
+    ui_readout_set_cells(ui_AuxTankTextArea, 3);
     lv_obj_set_style_text_color(ui_AuxTankTextArea, lv_color_hex(0xFFFFFF), LV_PART_MAIN | LV_STATE_DEFAULT);
-    lv_obj_set_style_text_opa(ui_AuxTankTextArea, 255, LV_PART_MAIN | LV_STATE_DEFAULT);
     lv_obj_set_style_text_align(ui_AuxTankTextArea, LV_TEXT_ALIGN_LEFT, LV_PART_MAIN | LV_STATE_DEFAULT);
-    lv_obj_set_style_bg_color(ui_AuxTankTextArea, lv_color_hex(0xFFFFFF), LV_PART_MAIN | LV_STATE_DEFAULT);
-    lv_obj_set_style_bg_opa(ui_AuxTankTextArea, 0, LV_PART_MAIN | LV_STATE_DEFAULT);
-    lv_obj_set_style_border_color(ui_AuxTankTextArea, lv_color_hex(0xFFFFFF), LV_PART_MAIN | LV_STATE_DEFAULT);
-    lv_obj_set_style_border_opa(ui_AuxTankTextArea, 0, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_pad_left(ui_AuxTankTextArea, 8, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_pad_right(ui_AuxTankTextArea, 8, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_pad_top(ui_AuxTankTextArea, 8, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_bg_color(ui_AuxTankTextArea, lv_color_hex(0x002447), LV_PART_ITEMS | LV_STATE_DEFAULT);
+    lv_obj_set_style_bg_opa(ui_AuxTankTextArea, 255, LV_PART_ITEMS | LV_STATE_DEFAULT);
+    ui_readout_set_text(ui_AuxTankTextArea, "-");
 
     ui_BattVLabel = lv_label_create(ui_DataScreen);
     lv_obj_set_width(ui_BattVLabel, LV_SIZE_CONTENT);   /// 1
@@ -0,0 +1,286 @@
+#!/usr/bin/env python3
+"""Turn a SquareLine Studio screen source into const style tables.
+
+SquareLine emits one ``lv_obj_set_*`` / ``lv_obj_set_style_*`` call per
+property and object. Every one of them adds a property to the object's local
+style on the LVGL heap. This script rewrites ``<screen>_screen_init()`` into:
+
+  * one const geometry style per object (width, height, x, y, align),
+  * shared const styles for the remaining properties, one per distinct
+    (selector, property set) so objects that look the same share a style,
+  * a ``ui_widget_desc_t`` table that ``ui_build_widgets()`` walks in a loop.
+
+Everything outside the init function (object variables, destroy function) is
+copied unchanged. Calls the script does not understand are kept, in their
+original order, after the build loop.
+
+usage: ui_style_tables.py <screen.c> <output.c>
+"""
+
+import re
+import sys
+
+GEOMETRY = {
+    'lv_obj_set_width': 'WIDTH',
+    'lv_obj_set_height': 'HEIGHT',
+    'lv_obj_set_x': 'X',
+    'lv_obj_set_y': 'Y',
+    'lv_obj_set_align': 'ALIGN',
+}
+
+# Text setters and the variant the table should use
+TEXT_SETTERS = {
+    'lv_label_set_text': 'lv_label_set_text_static',    # literals stay in flash
+    'lv_textarea_set_text': 'lv_textarea_set_text',
+    'ui_readout_set_text': 'ui_readout_set_text',
+}
+
+MAX_STYLES = 3      # UI_WIDGET_MAX_STYLES in ui_builder.h
+
+STYLE_RE = re.compile(r'^lv_obj_set_style_(\w+)$')
+CALL_RE = re.compile(r'^(\w+)\s*\((.*)\)$', re.S)
+CREATE_RE = re.compile(r'^(\w+)\s*=\s*(\w+)\s*\((\w+)\)$')
+
+
+def split_args(s):
+    """Split a C argument list on top level commas."""
+    args, depth, cur, in_str = [], 0, '', False
+    for i, ch in enumerate(s):
+        if in_str:
+            cur += ch
+            if ch == '"' and s[i - 1] != '\\':
+                in_str = False
+            continue
+        if ch == '"':
+            in_str = True
+        elif ch == '(':
+            depth += 1
+        elif ch == ')':
+            depth -= 1
+        elif ch == ',' and depth == 0:
+            args.append(cur.strip())
+            cur = ''
+            continue
+        cur += ch
+    if cur.strip():
+        args.append(cur.strip())
+    return args
+
+
+def squeeze(st):
+    """Collapse whitespace outside string literals."""
+    parts = re.split(r'("(?:[^"\\]|\\.)*")', st)
+    for i in range(0, len(parts), 2):
+        parts[i] = re.sub(r'\s+', ' ', parts[i])
+    return ''.join(parts).strip()
+
+
+def split_statements(body):
+    """Split a function body into statements, dropping comments."""
+    body = re.sub(r'/\*.*?\*/', '', body, flags=re.S)
+    stmts, cur, in_str = [], '', False
+    i = 0
+    while i < len(body):
+        ch = body[i]
+        if in_str:
+            cur += ch
+            if ch == '"' and body[i - 1] != '\\':
+                in_str = False
+        elif ch == '"':
+            in_str = True
+            cur += ch
+        elif body.startswith('//', i):
+            i = body.find('\n', i)
+            if i < 0:
+                break
+            continue
+        elif ch == ';':
+            stmts.append(squeeze(cur))
+            cur = ''
+        else:
+            cur += ch
+        i += 1
+    return [s for s in stmts if s]
+
+
+def style_value(v):
+    m = re.fullmatch(r'lv_color_hex\((0x[0-9A-Fa-f]+)\)', v)
+    if m:
+        return 'UI_COLOR_HEX(%s)' % m.group(1).upper().replace('0X', '0x')
+    return v
+
+
+def selector_key(sel):
+    return ' | '.join(sorted(p.strip() for p in sel.split('|')))
+
+
+class Widget:
+    def __init__(self, var, create, parent):
+        self.var = var
+        self.create = create
+        self.parent = parent
+        self.geometry = {}
+        self.styles = {}        # selector -> {PROP: value}
+        self.flags_add = []
+        self.flags_clear = []
+        self.set_text = None
+        self.text = None
+        self.placeholder = None
+        self.extra = []
+
+
+def parse_init(stmts, fname):
+    widgets, order, extra = {}, [], []
+
+    for st in stmts:
+        m = CREATE_RE.match(st)
+        if m:
+            var, fn, parent = m.groups()
+            w = Widget(var, fn, None if parent == 'NULL' else parent)
+            widgets[var] = w
+            order.append(w)
+            continue
+
+        m = CALL_RE.match(st)
+        args = split_args(m.group(2)) if m else []
+        w = widgets.get(args[0]) if args else None
+        if w is None:
+            extra.append(st)
+            continue
+
+        fn = m.group(1)
+        sm = STYLE_RE.match(fn)
+        if fn in GEOMETRY and len(args) == 2:
+            w.geometry[GEOMETRY[fn]] = args[1]
+        elif sm and len(args) == 3:
+            props = w.styles.setdefault(selector_key(args[2]), {})
+            props[sm.group(1).upper()] = style_value(args[1])
+        elif fn == 'lv_obj_clear_flag' and len(args) == 2:
+            w.flags_clear.append(args[1])
+        elif fn == 'lv_obj_add_flag' and len(args) == 2:
+            w.flags_add.append(args[1])
+        elif fn in TEXT_SETTERS and len(args) == 2:
+            w.set_text, w.text = TEXT_SETTERS[fn], args[1]
+            w.text_stmt = st
+        elif fn == 'lv_textarea_set_placeholder_text' and len(args) == 2:
+            w.placeholder = args[1]
+        else:
+            w.extra.append(st)
+            extra.append(st)
+
+    # A widget with calls we keep verbatim (e.g. ui_readout_set_cells) gets its
+    # text set after them, as in the original code
+    for w in order:
+        if w.extra and w.text is not None:
+            extra.append(w.text_stmt)
+            w.set_text = w.text = None
+
+    if len(order) == 0:
+        sys.exit('%s: no objects found in the init function' % fname)
+    return order, extra
+
+
+def flag_expr(flags):
+    if not flags:
+        return '0'
+    parts = []
+    for f in flags:
+        parts.extend(p.strip() for p in f.split('|'))
+    return ' | '.join(parts)
+
+
+def emit(screen, order, extra, fname):
+    styles = {}         # (props tuple) -> style name
+    style_defs = []
+
+    def style_for(props):
+        key = tuple(sorted(props.items()))
+        if key not in styles:
+            name = '%s_style_%d' % (screen, len(styles))
+            styles[key] = name
+            style_defs.append((name, key))
+        return styles[key]
+
+    entries = []
+    for w in order:
+        refs = []
+        if w.geometry:
+            refs.append((style_for(w.geometry), 'LV_PART_MAIN | LV_STATE_DEFAULT'))
+        for sel, props in w.styles.items():
+            refs.append((style_for(props), sel))
+        if len(refs) > MAX_STYLES:
+            sys.exit('%s: %s needs %d styles, UI_WIDGET_MAX_STYLES is %d' %
+                     (fname, w.var, len(refs), MAX_STYLES))
+        entries.append((w, refs))
+
+    out = []
+    out.append('/*Const styles shared by the objects of %s*/' % screen)
+    for name, key in style_defs:
+        out.append('static const lv_style_const_prop_t %s_props[] = {' % name)
+        for prop, val in key:
+            out.append('    LV_STYLE_CONST_%s(%s),' % (prop, val))
+        out.append('};')
+        groups = ' | '.join('UI_STYLE_GROUP(LV_STYLE_%s)' % prop for prop, _ in key)
+        out.append('static UI_STYLE_CONST_INIT(%s, %s_props,' % (name, name))
+        out.append('                           %s);' % groups)
+        out.append('')
+
+    out.append('static const ui_widget_desc_t %s_widgets[] = {' % screen)
+    for w, refs in entries:
+        out.append('    {')
+        out.append('        .obj = &%s,' % w.var)
+        out.append('        .parent = %s,' % ('&' + w.parent if w.parent else 'NULL'))
+        out.append('        .create = %s,' % w.create)
+        if w.text is not None:
+            out.append('        .set_text = %s,' % w.set_text)
+            out.append('        .text = %s,' % w.text)
+        if w.placeholder is not None:
+            out.append('        .placeholder = %s,' % w.placeholder)
+        if w.flags_add:
+            out.append('        .flags_add = %s,' % flag_expr(w.flags_add))
+        if w.flags_clear:
+            out.append('        .flags_clear = %s,' % flag_expr(w.flags_clear))
+        out.append('        .styles = { %s },' % ', '.join('&' + r[0] for r in refs))
+        out.append('        .selectors = { %s },' % ', '.join(r[1] for r in refs))
+        out.append('    },')
+    out.append('};')
+    out.append('')
+    out.append('void %s_screen_init(void)' % screen)
+    out.append('{')
+    out.append('    ui_build_widgets(%s_widgets, sizeof(%s_widgets) / sizeof(%s_widgets[0]));' %
+               (screen, screen, screen))
+    if extra:
+        out.append('')
+    for st in extra:
+        out.append('    %s;' % st)
+    out.append('}')
+    return '\n'.join(out) + '\n'
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+    src_path, out_path = sys.argv[1], sys.argv[2]
+    with open(src_path, encoding='utf-8') as f:
+        src = f.read()
+
+    m = re.search(r'^void (\w+)_screen_init\(void\)\s*\n\{\n', src, re.M)
+    if not m:
+        sys.exit('%s: no <screen>_screen_init() found' % src_path)
+    end = src.index('\n}\n', m.end())
+    screen = m.group(1)
+
+    order, extra = parse_init(split_statements(src[m.end():end]), src_path)
+
+    head = src[:m.start()].replace('#include "../ui.h"',
+                                   '#include "ui.h"\n#include "ui_builder.h"')
+    text = ('// Generated by components/ui/tools/ui_style_tables.py from %s, do not edit\n'
+            % src_path.replace('\\', '/').split('components/ui/')[-1])
+    text += head + emit(screen, order, extra, src_path) + src[end + 2:]
+
+    with open(out_path, 'w', encoding='utf-8') as f:
+        f.write(text)
+
+
+if __name__ == '__main__':
+    main()
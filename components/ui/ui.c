@@ -27,19 +27,5 @@ lv_obj_t * ui____initial_actions0;
 
 ///////////////////// SCREENS ////////////////////
 
-void ui_init(void)
-{
-    lv_disp_t * dispp = lv_disp_get_default();
-    lv_theme_t * theme = lv_theme_default_init(dispp, lv_palette_main(LV_PALETTE_BLUE), lv_palette_main(LV_PALETTE_RED),
-                                               false, LV_FONT_DEFAULT);
-    lv_disp_set_theme(dispp, theme);
-    ui_DataScreen_screen_init();
-    ui_SplashScreen_screen_init();
-    lv_disp_load_scr(ui_SplashScreen);
-}
-
-void ui_destroy(void)
-{
-    ui_DataScreen_screen_destroy();
-    ui_SplashScreen_screen_destroy();
-}
+// No ui_init()/ui_destroy(): main/screens.c sets the theme and builds and
+// deletes each screen when it's needed
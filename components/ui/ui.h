@@ -14,6 +14,7 @@ extern "C" {
 
 #include "ui_helpers.h"
 #include "ui_events.h"
+#include "ui_readout.h"
 
 
 ///////////////////// SCREENS ////////////////////
@@ -31,10 +32,6 @@ extern lv_obj_t * ui____initial_actions0;
 // IMAGES AND IMAGE SETS
 LV_IMG_DECLARE(ui_img_dfs_logo_png_png);    // assets/DFS_LOGO_PNG.png
 
-// UI INIT
-void ui_init(void);
-void ui_destroy(void);
-
 #ifdef __cplusplus
 } /*extern "C"*/
 #endif
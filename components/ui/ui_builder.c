@@ -0,0 +1,44 @@
+/**
+ * @file ui_builder.c
+ *
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "ui_builder.h"
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+void ui_build_widgets(const ui_widget_desc_t * table, uint32_t cnt)
+{
+    /*Refresh the styles once for the whole tree instead of after every add_style*/
+    lv_obj_enable_style_refresh(false);
+
+    for(uint32_t i = 0; i < cnt; i++) {
+        const ui_widget_desc_t * d = &table[i];
+        lv_obj_t * obj = d->create(d->parent ? *d->parent : NULL);
+        *d->obj = obj;
+
+        if(d->flags_add) lv_obj_add_flag(obj, d->flags_add);
+        if(d->flags_clear) lv_obj_clear_flag(obj, d->flags_clear);
+
+        for(uint32_t s = 0; s < UI_WIDGET_MAX_STYLES && d->styles[s]; s++) {
+            /*The styles are const and live in flash, LVGL only reads them*/
+            lv_obj_add_style(obj, (lv_style_t *)d->styles[s], d->selectors[s]);
+        }
+
+        if(d->text) d->set_text(obj, d->text);
+#if LV_USE_TEXTAREA
+        if(d->placeholder) lv_textarea_set_placeholder_text(obj, d->placeholder);
+#endif
+    }
+
+    lv_obj_enable_style_refresh(true);
+
+    for(uint32_t i = 0; i < cnt; i++) {
+        if(table[i].parent == NULL) lv_obj_refresh_style(*table[i].obj, LV_PART_ANY, LV_STYLE_PROP_ANY);
+    }
+}
@@ -0,0 +1,87 @@
+/**
+ * @file ui_builder.h
+ * Table driven screen construction.
+ *
+ * `tools/ui_style_tables.py` converts the SquareLine screen sources into a
+ * `ui_widget_desc_t` table that references shared, `const` styles kept in
+ * flash. `ui_build_widgets()` then creates the whole screen in one loop
+ * instead of one `lv_obj_set_style_*` call (and LVGL heap allocation) per
+ * property.
+ */
+
+#ifndef UI_BUILDER_H
+#define UI_BUILDER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "lvgl.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+#define UI_WIDGET_MAX_STYLES    3
+
+/* Colour literal usable in a const style property. LV_COLOR_MAKE doesn't
+ * parenthesize its arguments, hence the extra parentheses. */
+#define UI_COLOR_HEX(c)         LV_COLOR_MAKE((((c) >> 16) & 0xFF), (((c) >> 8) & 0xFF), ((c) & 0xFF))
+
+/* Compile time version of `1 << _lv_style_get_prop_group(prop)` */
+#define UI_STYLE_GROUP(prop)    (1 << LV_MIN(((prop) & 0x1FF) >> 4, 7))
+
+/**
+ * Like LV_STYLE_CONST_INIT but with the real property groups instead of 0xFF,
+ * so style lookups skip the style for properties it can't contain.
+ */
+#if LV_USE_ASSERT_STYLE
+#define UI_STYLE_CONST_INIT(var_name, prop_array, groups)               \
+    const lv_style_t var_name = {                                       \
+        .sentinel = LV_STYLE_SENTINEL_VALUE,                            \
+        .v_p = { .const_props = prop_array },                           \
+        .has_group = (groups),                                          \
+        .prop1 = LV_STYLE_PROP_ANY,                                     \
+        .prop_cnt = (sizeof(prop_array) / sizeof((prop_array)[0])),     \
+    }
+#else
+#define UI_STYLE_CONST_INIT(var_name, prop_array, groups)               \
+    const lv_style_t var_name = {                                       \
+        .v_p = { .const_props = prop_array },                           \
+        .has_group = (groups),                                          \
+        .prop1 = LV_STYLE_PROP_ANY,                                     \
+        .prop_cnt = (sizeof(prop_array) / sizeof((prop_array)[0])),     \
+    }
+#endif
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef struct {
+    lv_obj_t ** obj;                                    /*Where to store the created object*/
+    lv_obj_t ** parent;                                 /*NULL to create a screen*/
+    lv_obj_t * (*create)(lv_obj_t * parent);
+    void (*set_text)(lv_obj_t * obj, const char * txt);
+    const char * text;
+    const char * placeholder;                           /*Text areas only*/
+    uint32_t flags_add;
+    uint32_t flags_clear;
+    const lv_style_t * styles[UI_WIDGET_MAX_STYLES];    /*Unused slots are NULL*/
+    lv_style_selector_t selectors[UI_WIDGET_MAX_STYLES];
+} ui_widget_desc_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Create the objects of a widget table in order
+ * @param table     the widget descriptors, parents must come before their children
+ * @param cnt       number of entries in `table`
+ */
+void ui_build_widgets(const ui_widget_desc_t * table, uint32_t cnt);
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*UI_BUILDER_H*/
@@ -0,0 +1,279 @@
+/**
+ * @file ui_glyph_cache.c
+ *
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "ui_glyph_cache.h"
+#include "src/misc/lv_lru.h"
+#include "src/draw/sw/lv_draw_sw.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+#define ATLAS_CHAR_CNT  (sizeof(UI_GLYPH_ATLAS_CHARS) - 1)
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef struct {
+    const lv_font_t * font;
+    uint32_t letter;
+} glyph_key_t;
+
+typedef struct {
+    lv_coord_t ofs_x;
+    lv_coord_t ofs_y;
+    uint16_t box_w;                 /*0: not in the atlas*/
+    uint16_t box_h;
+    uint32_t px_ofs;                /*Index of the first pixel in `px`*/
+} atlas_glyph_t;
+
+typedef struct {
+    const lv_font_t * font;         /*NULL: unused*/
+    lv_color_t fg;
+    lv_color_t bg;
+    atlas_glyph_t glyphs[ATLAS_CHAR_CNT];
+    lv_color_t px[UI_GLYPH_ATLAS_PX];   /*The glyph boxes one after the other*/
+} glyph_atlas_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static ui_glyph_t * glyph_render(const lv_font_t * font, uint32_t letter, size_t * size);
+static glyph_atlas_t * atlas_get(const lv_font_t * font, lv_color_t fg, lv_color_t bg);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static lv_lru_t * glyph_lru;
+static glyph_atlas_t atlases[UI_GLYPH_ATLAS_MAX];
+static uint8_t atlas_next;
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+const ui_glyph_t * ui_glyph_cache_get(const lv_font_t * font, uint32_t letter)
+{
+    if(glyph_lru == NULL) {
+        glyph_lru = lv_lru_create(UI_GLYPH_CACHE_SIZE, UI_GLYPH_CACHE_AVG, lv_mem_free, lv_mem_free);
+        if(glyph_lru == NULL) return NULL;
+    }
+
+    /*The key is compared as bytes: clear the padding*/
+    glyph_key_t key;
+    lv_memset_00(&key, sizeof(key));
+    key.font = font;
+    key.letter = letter;
+
+    ui_glyph_t * glyph = NULL;
+    lv_lru_get(glyph_lru, &key, sizeof(key), (void **)&glyph);
+    if(glyph) return glyph;
+
+    size_t size;
+    glyph = glyph_render(font, letter, &size);
+    if(glyph == NULL) return NULL;
+
+    lv_lru_set(glyph_lru, &key, sizeof(key), glyph, size);
+    return glyph;
+}
+
+void ui_glyph_cache_preload(const lv_font_t * font, const char * txt)
+{
+    while(*txt) {
+        ui_glyph_cache_get(font, (uint32_t)*txt);
+        txt++;
+    }
+}
+
+void ui_glyph_cache_clear(void)
+{
+    if(glyph_lru) {
+        lv_lru_del(glyph_lru);
+        glyph_lru = NULL;
+    }
+
+    for(uint32_t i = 0; i < UI_GLYPH_ATLAS_MAX; i++) {
+        atlases[i].font = NULL;
+    }
+}
+
+void ui_glyph_draw(lv_draw_ctx_t * draw_ctx, const lv_draw_label_dsc_t * dsc, const lv_point_t * pos,
+                   uint32_t letter)
+{
+    /*With opacity lv_draw_sw_letter scales the mask too: leave that case to it*/
+    if(dsc->opa < LV_OPA_MAX || dsc->blend_mode != LV_BLEND_MODE_NORMAL) {
+        lv_draw_letter(draw_ctx, dsc, pos, letter);
+        return;
+    }
+
+    const ui_glyph_t * glyph = ui_glyph_cache_get(dsc->font, letter);
+    if(glyph == NULL) {
+        lv_draw_letter(draw_ctx, dsc, pos, letter);
+        return;
+    }
+
+    lv_area_t box;
+    box.x1 = pos->x + glyph->ofs_x;
+    box.y1 = pos->y + glyph->ofs_y;
+    box.x2 = box.x1 + glyph->box_w - 1;
+    box.y2 = box.y1 + glyph->box_h - 1;
+    if(!_lv_area_is_on(&box, draw_ctx->clip_area)) return;
+
+#if LV_DRAW_COMPLEX
+    /*E.g. a rounded parent clipping the letter*/
+    if(lv_draw_mask_is_any(&box)) {
+        lv_draw_letter(draw_ctx, dsc, pos, letter);
+        return;
+    }
+#endif
+
+    lv_draw_sw_blend_dsc_t blend_dsc;
+    lv_memset_00(&blend_dsc, sizeof(blend_dsc));
+    blend_dsc.blend_area = &box;
+    blend_dsc.mask_area = &box;
+    blend_dsc.mask_buf = (lv_opa_t *)glyph->mask;
+    blend_dsc.mask_res = LV_DRAW_MASK_RES_CHANGED;
+    blend_dsc.color = dsc->color;
+    blend_dsc.opa = dsc->opa;
+    blend_dsc.blend_mode = dsc->blend_mode;
+    lv_draw_sw_blend(draw_ctx, &blend_dsc);
+}
+
+bool ui_glyph_atlas_draw(lv_draw_ctx_t * draw_ctx, const lv_draw_label_dsc_t * dsc, lv_color_t bg,
+                         const lv_area_t * bg_area, const lv_point_t * pos, uint32_t letter)
+{
+    if(dsc->opa < LV_OPA_MAX || dsc->blend_mode != LV_BLEND_MODE_NORMAL) return false;
+
+    uint32_t idx;
+    for(idx = 0; idx < ATLAS_CHAR_CNT; idx++) {
+        if((uint32_t)UI_GLYPH_ATLAS_CHARS[idx] == letter) break;
+    }
+    if(idx == ATLAS_CHAR_CNT) return false;
+
+    glyph_atlas_t * atlas = atlas_get(dsc->font, dsc->color, bg);
+    if(atlas == NULL) return false;
+
+    const atlas_glyph_t * ag = &atlas->glyphs[idx];
+    if(ag->box_w == 0) return false;
+
+    lv_area_t box;
+    box.x1 = pos->x + ag->ofs_x;
+    box.y1 = pos->y + ag->ofs_y;
+    box.x2 = box.x1 + ag->box_w - 1;
+    box.y2 = box.y1 + ag->box_h - 1;
+    /*Outside it the copy would overwrite e.g. the edge of the neighbouring letter*/
+    if(!_lv_area_is_in(&box, bg_area, 0)) return false;
+    if(!_lv_area_is_on(&box, draw_ctx->clip_area)) return true;
+
+#if LV_DRAW_COMPLEX
+    if(lv_draw_mask_is_any(&box)) return false;
+#endif
+
+    lv_draw_sw_blend_dsc_t blend_dsc;
+    lv_memset_00(&blend_dsc, sizeof(blend_dsc));
+    blend_dsc.blend_area = &box;
+    blend_dsc.src_buf = atlas->px + ag->px_ofs;
+    blend_dsc.mask_res = LV_DRAW_MASK_RES_FULL_COVER;
+    blend_dsc.opa = LV_OPA_COVER;
+    blend_dsc.blend_mode = LV_BLEND_MODE_NORMAL;
+    lv_draw_sw_blend(draw_ctx, &blend_dsc);
+    return true;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Unpack a glyph into one opacity byte per pixel, the way lv_draw_sw_letter does
+ */
+static ui_glyph_t * glyph_render(const lv_font_t * font, uint32_t letter, size_t * size)
+{
+    lv_font_glyph_dsc_t g;
+    if(!lv_font_get_glyph_dsc(font, &g, letter, '\0')) return NULL;
+    if(g.box_w == 0 || g.box_h == 0) return NULL;
+    if(g.resolved_font->subpx) return NULL;
+    if(g.bpp != 1 && g.bpp != 2 && g.bpp != 4 && g.bpp != 8) return NULL;
+
+    uint32_t px_cnt = (uint32_t)g.box_w * g.box_h;
+    *size = sizeof(ui_glyph_t) + px_cnt;
+    if(*size > UI_GLYPH_CACHE_SIZE) return NULL;
+
+    const uint8_t * map_p = lv_font_get_glyph_bitmap(g.resolved_font, letter);
+    if(map_p == NULL) return NULL;
+
+    ui_glyph_t * glyph = lv_mem_alloc(*size);
+    if(glyph == NULL) return NULL;
+
+    glyph->ofs_x = g.ofs_x;
+    glyph->ofs_y = (font->line_height - font->base_line) - g.box_h - g.ofs_y;
+    glyph->box_w = g.box_w;
+    glyph->box_h = g.box_h;
+
+    /*The rows are packed without padding. Scale like the _lv_bppN_opa_table's*/
+    uint32_t bpp = g.bpp;
+    uint32_t max = (1U << bpp) - 1;
+    uint32_t bit = 0;
+    for(uint32_t i = 0; i < px_cnt; i++) {
+        uint32_t v = (map_p[bit >> 3] >> (8 - bpp - (bit & 0x7))) & max;
+        glyph->mask[i] = (lv_opa_t)(v * 255 / max);
+        bit += bpp;
+    }
+
+    return glyph;
+}
+
+static glyph_atlas_t * atlas_get(const lv_font_t * font, lv_color_t fg, lv_color_t bg)
+{
+    for(uint32_t i = 0; i < UI_GLYPH_ATLAS_MAX; i++) {
+        glyph_atlas_t * atlas = &atlases[i];
+        if(atlas->font == font && atlas->fg.full == fg.full && atlas->bg.full == bg.full) {
+            return atlas;
+        }
+    }
+
+    /*Build a new one in place of the oldest*/
+    glyph_atlas_t * atlas = &atlases[atlas_next];
+    atlas_next = (atlas_next + 1) % UI_GLYPH_ATLAS_MAX;
+    atlas->font = NULL;
+
+    /*A glyph from the cache is only valid until the next lookup: measure first, then blend*/
+    uint32_t px_cnt = 0;
+    for(uint32_t i = 0; i < ATLAS_CHAR_CNT; i++) {
+        atlas_glyph_t * ag = &atlas->glyphs[i];
+        const ui_glyph_t * glyph = ui_glyph_cache_get(font, (uint32_t)UI_GLYPH_ATLAS_CHARS[i]);
+        ag->ofs_x = glyph ? glyph->ofs_x : 0;
+        ag->ofs_y = glyph ? glyph->ofs_y : 0;
+        ag->box_w = glyph ? glyph->box_w : 0;
+        ag->box_h = glyph ? glyph->box_h : 0;
+        ag->px_ofs = px_cnt;
+        px_cnt += (uint32_t)ag->box_w * ag->box_h;
+    }
+    if(px_cnt == 0 || px_cnt > UI_GLYPH_ATLAS_PX) return NULL;
+
+    for(uint32_t i = 0; i < ATLAS_CHAR_CNT; i++) {
+        atlas_glyph_t * ag = &atlas->glyphs[i];
+        if(ag->box_w == 0) continue;
+
+        const ui_glyph_t * glyph = ui_glyph_cache_get(font, (uint32_t)UI_GLYPH_ATLAS_CHARS[i]);
+        if(glyph == NULL) {
+            ag->box_w = 0;
+            continue;
+        }
+
+        /*What a masked fill gives on a `bg` pixel*/
+        lv_color_t * px = atlas->px + ag->px_ofs;
+        for(uint32_t j = 0; j < (uint32_t)ag->box_w * ag->box_h; j++) {
+            px[j] = glyph->mask[j] == LV_OPA_COVER ? fg : lv_color_mix(fg, bg, glyph->mask[j]);
+        }
+    }
+
+    atlas->font = font;
+    atlas->fg = fg;
+    atlas->bg = bg;
+    return atlas;
+}
@@ -0,0 +1,102 @@
+/**
+ * @file ui_glyph_cache.h
+ * Glyph raster cache and pre-blended digit atlas.
+ *
+ * `lv_draw_letter()` looks the glyph up in the font and unpacks its 4 bpp
+ * bitmap into an opacity mask every time the glyph is drawn. The cache keeps
+ * the unpacked masks in an LRU (`lv_lru`) keyed by font and letter, so a
+ * redraw is a single masked fill.
+ *
+ * The atlas goes one step further for the characters of numeric readouts: for
+ * a given font, text colour and background colour the glyphs are blended once
+ * into RGB565 and drawn as plain copies, so they can only be used where the
+ * caller knows the background is that colour.
+ */
+
+#ifndef UI_GLYPH_CACHE_H
+#define UI_GLYPH_CACHE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "lvgl.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+#define UI_GLYPH_CACHE_SIZE     2048        /*Bytes of glyph masks to keep*/
+#define UI_GLYPH_CACHE_AVG      96          /*Typical entry size, sizes the hash table*/
+
+#define UI_GLYPH_ATLAS_CHARS    "0123456789.-"
+#define UI_GLYPH_ATLAS_MAX      2           /*Font/colour combinations kept at once*/
+#define UI_GLYPH_ATLAS_PX       1024        /*Pixels per atlas, static (Montserrat 14 needs 834)*/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef struct {
+    lv_coord_t ofs_x;           /*Box position relative to the letter position*/
+    lv_coord_t ofs_y;
+    uint16_t box_w;
+    uint16_t box_h;
+    lv_opa_t mask[];            /*box_w * box_h opacities*/
+} ui_glyph_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Get the unpacked glyph of a letter, rendering it on a miss
+ * @param font      the font
+ * @param letter    UTF-8 code point
+ * @return          the glyph or NULL if the font doesn't have it, it is empty or
+ *                  its format isn't supported. Valid until the next call.
+ */
+const ui_glyph_t * ui_glyph_cache_get(const lv_font_t * font, uint32_t letter);
+
+/**
+ * Put the glyphs of a string in the cache, e.g. before the heap is partitioned
+ * @param font      the font
+ * @param txt       the characters to load
+ */
+void ui_glyph_cache_preload(const lv_font_t * font, const char * txt);
+
+/**
+ * Drop all cached glyphs and atlases
+ */
+void ui_glyph_cache_clear(void);
+
+/**
+ * Drop-in for `lv_draw_letter()` that draws from the cache. Falls back to
+ * `lv_draw_letter()` for what the cache doesn't handle (opacity, other blend
+ * modes, active draw masks, sub-pixel fonts).
+ * @param draw_ctx  the draw context
+ * @param dsc       the label draw descriptor
+ * @param pos       top left corner of the letter
+ * @param letter    UTF-8 code point
+ */
+void ui_glyph_draw(lv_draw_ctx_t * draw_ctx, const lv_draw_label_dsc_t * dsc, const lv_point_t * pos,
+                   uint32_t letter);
+
+/**
+ * Copy a pre-blended letter from the atlas of `dsc->font`, `dsc->color` and `bg`
+ * @param draw_ctx  the draw context
+ * @param dsc       the label draw descriptor
+ * @param bg        the background colour
+ * @param bg_area   an area known to be filled with `bg`, e.g. the letter's cell
+ * @param pos       top left corner of the letter
+ * @param letter    UTF-8 code point
+ * @return          true if drawn; false if the letter is not in UI_GLYPH_ATLAS_CHARS,
+ *                  doesn't fit in `bg_area` or the atlas couldn't be used:
+ *                  draw it with `ui_glyph_draw()` then
+ */
+bool ui_glyph_atlas_draw(lv_draw_ctx_t * draw_ctx, const lv_draw_label_dsc_t * dsc, lv_color_t bg,
+                         const lv_area_t * bg_area, const lv_point_t * pos, uint32_t letter);
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*UI_GLYPH_CACHE_H*/
@@ -0,0 +1,328 @@
+/**
+ * @file ui_readout.c
+ *
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "ui_readout.h"
+#include "ui_glyph_cache.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+#define MY_CLASS &ui_readout_class
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static void ui_readout_constructor(const lv_obj_class_t * class_p, lv_obj_t * obj);
+static void ui_readout_event(const lv_obj_class_t * class_p, lv_event_t * e);
+static void readout_apply(lv_obj_t * obj, const char * txt, uint8_t len);
+static void readout_relayout(lv_obj_t * obj);
+static lv_coord_t readout_cell_w(lv_obj_t * obj);
+static void readout_cell_area(lv_obj_t * obj, uint8_t idx, lv_area_t * area);
+static bool readout_cell_bg(lv_obj_t * obj, lv_color_t * bg);
+static void readout_glyph_pos(const lv_draw_label_dsc_t * dsc, char c, const lv_area_t * cell, lv_point_t * pos);
+static void draw_cells(lv_event_t * e);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+const lv_obj_class_t ui_readout_class = {
+    .base_class = &lv_obj_class,
+    .constructor_cb = ui_readout_constructor,
+    .event_cb = ui_readout_event,
+    .width_def = LV_SIZE_CONTENT,
+    .height_def = LV_SIZE_CONTENT,
+    .instance_size = sizeof(ui_readout_t),
+};
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+lv_obj_t * ui_readout_create(lv_obj_t * parent)
+{
+    lv_obj_t * obj = lv_obj_class_create_obj(MY_CLASS, parent);
+    lv_obj_class_init_obj(obj);
+    return obj;
+}
+
+void ui_readout_set_cells(lv_obj_t * obj, uint8_t cell_cnt)
+{
+    LV_ASSERT_OBJ(obj, MY_CLASS);
+
+    ui_readout_t * ro = (ui_readout_t *)obj;
+    if(cell_cnt == 0) cell_cnt = 1;
+    if(cell_cnt > UI_READOUT_MAX_CELLS) cell_cnt = UI_READOUT_MAX_CELLS;
+    if(cell_cnt == ro->cell_cnt) return;
+
+    ro->cell_cnt = cell_cnt;
+    readout_relayout(obj);
+    lv_obj_refresh_self_size(obj);
+    lv_obj_invalidate(obj);
+}
+
+void ui_readout_set_fixed(lv_obj_t * obj, int32_t value, uint8_t decimals)
+{
+    LV_ASSERT_OBJ(obj, MY_CLASS);
+
+    /*Build the digits right to left into the end of a scratch buffer*/
+    char buf[UI_READOUT_MAX_CELLS + 4];
+    uint8_t pos = sizeof(buf);
+    bool neg = value < 0;
+    uint32_t v = neg ? (uint32_t)(-(int64_t)value) : (uint32_t)value;
+    uint8_t digits = 0;
+
+    do {
+        buf[--pos] = (char)('0' + v % 10);
+        v /= 10;
+        digits++;
+        if(digits == decimals) buf[--pos] = '.';
+    } while((v != 0 || digits <= decimals) && pos > 1);
+
+    if(neg) buf[--pos] = '-';
+
+    readout_apply(obj, &buf[pos], (uint8_t)(sizeof(buf) - pos));
+}
+
+void ui_readout_set_text(lv_obj_t * obj, const char * txt)
+{
+    LV_ASSERT_OBJ(obj, MY_CLASS);
+
+    uint8_t len = 0;
+    while(txt[len] != '\0' && len < UI_READOUT_MAX_CELLS) len++;
+
+    readout_apply(obj, txt, len);
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static void ui_readout_constructor(const lv_obj_class_t * class_p, lv_obj_t * obj)
+{
+    LV_UNUSED(class_p);
+
+    ui_readout_t * ro = (ui_readout_t *)obj;
+    ro->font = NULL;
+    ro->cell_w = 0;
+    ro->cell_cnt = UI_READOUT_DEF_CELLS;
+    ro->txt_start = 0;
+    ro->txt_len = 0;
+    lv_memset(ro->cells, ' ', sizeof(ro->cells));
+
+    lv_obj_clear_flag(obj, LV_OBJ_FLAG_CLICKABLE | LV_OBJ_FLAG_SCROLLABLE | LV_OBJ_FLAG_CLICK_FOCUSABLE);
+}
+
+static void ui_readout_event(const lv_obj_class_t * class_p, lv_event_t * e)
+{
+    LV_UNUSED(class_p);
+
+    /*Call the ancestor's event handler*/
+    lv_res_t res = lv_obj_event_base(MY_CLASS, e);
+    if(res != LV_RES_OK) return;
+
+    lv_event_code_t code = lv_event_get_code(e);
+    lv_obj_t * obj = lv_event_get_target(e);
+
+    if(code == LV_EVENT_GET_SELF_SIZE) {
+        ui_readout_t * ro = (ui_readout_t *)obj;
+        lv_point_t * p = lv_event_get_param(e);
+        const lv_font_t * font = lv_obj_get_style_text_font(obj, LV_PART_MAIN);
+        p->x = LV_MAX(p->x, readout_cell_w(obj) * ro->cell_cnt);
+        p->y = LV_MAX(p->y, lv_font_get_line_height(font));
+    }
+    else if(code == LV_EVENT_STYLE_CHANGED) {
+        /*The font or the alignment might have changed: re-measure and re-place the text*/
+        ((ui_readout_t *)obj)->font = NULL;
+        readout_relayout(obj);
+        lv_obj_refresh_self_size(obj);
+        lv_obj_invalidate(obj);
+    }
+    else if(code == LV_EVENT_DRAW_MAIN) {
+        draw_cells(e);
+    }
+}
+
+/**
+ * Lay `txt` out over the cells according to the text align style and
+ * invalidate the cells whose character changed.
+ */
+static void readout_apply(lv_obj_t * obj, const char * txt, uint8_t len)
+{
+    ui_readout_t * ro = (ui_readout_t *)obj;
+    if(len > ro->cell_cnt) len = ro->cell_cnt;
+
+    uint8_t first = 0;
+    if(lv_obj_get_style_text_align(obj, LV_PART_MAIN) != LV_TEXT_ALIGN_LEFT) {
+        first = ro->cell_cnt - len;
+    }
+
+    ro->txt_start = first;
+    ro->txt_len = len;
+
+    for(uint8_t i = 0; i < ro->cell_cnt; i++) {
+        char c = (i >= first && i < first + len) ? txt[i - first] : ' ';
+        if(ro->cells[i] == c) continue;
+
+        ro->cells[i] = c;
+
+        lv_area_t a;
+        readout_cell_area(obj, i, &a);
+        lv_obj_invalidate_area(obj, &a);
+    }
+}
+
+/**
+ * Place the current text again, e.g. after the alignment or the cell count changed.
+ */
+static void readout_relayout(lv_obj_t * obj)
+{
+    ui_readout_t * ro = (ui_readout_t *)obj;
+    char txt[UI_READOUT_MAX_CELLS];
+    uint8_t len = 0;
+
+    for(uint8_t i = ro->txt_start; i < ro->txt_start + ro->txt_len && i < UI_READOUT_MAX_CELLS; i++) {
+        txt[len++] = ro->cells[i];
+    }
+
+    lv_memset(ro->cells, ' ', sizeof(ro->cells));
+    readout_apply(obj, txt, len);
+}
+
+/**
+ * Width of one cell: the widest digit of the current font, so the
+ * digits don't shift when the value changes.
+ */
+static lv_coord_t readout_cell_w(lv_obj_t * obj)
+{
+    ui_readout_t * ro = (ui_readout_t *)obj;
+    const lv_font_t * font = lv_obj_get_style_text_font(obj, LV_PART_MAIN);
+    if(ro->font == font) return ro->cell_w;
+
+    lv_coord_t w = 0;
+    for(uint32_t c = '0'; c <= '9'; c++) {
+        w = LV_MAX(w, (lv_coord_t)lv_font_get_glyph_width(font, c, 0));
+    }
+
+    ro->font = font;
+    ro->cell_w = w + lv_obj_get_style_text_letter_space(obj, LV_PART_MAIN);
+    return ro->cell_w;
+}
+
+static void readout_cell_area(lv_obj_t * obj, uint8_t idx, lv_area_t * area)
+{
+    ui_readout_t * ro = (ui_readout_t *)obj;
+    const lv_font_t * font = lv_obj_get_style_text_font(obj, LV_PART_MAIN);
+    lv_coord_t cell_w = readout_cell_w(obj);
+    lv_coord_t total_w = cell_w * ro->cell_cnt;
+
+    lv_area_t content;
+    lv_obj_get_content_coords(obj, &content);
+
+    lv_coord_t x;
+    switch(lv_obj_get_style_text_align(obj, LV_PART_MAIN)) {
+        case LV_TEXT_ALIGN_RIGHT:
+            x = content.x2 - total_w + 1;
+            break;
+        case LV_TEXT_ALIGN_CENTER:
+            x = content.x1 + (lv_area_get_width(&content) - total_w) / 2;
+            break;
+        default:
+            x = content.x1;
+            break;
+    }
+
+    area->x1 = x + idx * cell_w;
+    area->x2 = area->x1 + cell_w - 1;
+    area->y1 = content.y1;
+    area->y2 = content.y1 + lv_font_get_line_height(font) - 1;
+}
+
+/**
+ * Whether the cells have an opaque background of their own (LV_PART_ITEMS).
+ * Glyphs blended onto that colour can be copied from the atlas as they are.
+ */
+static bool readout_cell_bg(lv_obj_t * obj, lv_color_t * bg)
+{
+    if(lv_obj_get_style_bg_opa(obj, LV_PART_ITEMS) < LV_OPA_MAX) return false;
+    if(lv_obj_get_style_opa(obj, LV_PART_MAIN) < LV_OPA_MAX) return false;
+    if(lv_obj_get_style_bg_grad_dir(obj, LV_PART_ITEMS) != LV_GRAD_DIR_NONE) return false;
+
+    *bg = lv_obj_get_style_bg_color_filtered(obj, LV_PART_ITEMS);
+    return true;
+}
+
+/**
+ * Where to draw `c` in its cell: narrow glyphs ('.', '-') are centred
+ */
+static void readout_glyph_pos(const lv_draw_label_dsc_t * dsc, char c, const lv_area_t * cell, lv_point_t * pos)
+{
+    lv_coord_t glyph_w = lv_font_get_glyph_width(dsc->font, (uint32_t)c, 0);
+    pos->x = cell->x1 + (lv_area_get_width(cell) - glyph_w) / 2;
+    pos->y = cell->y1;
+}
+
+static void draw_cells(lv_event_t * e)
+{
+    lv_obj_t * obj = lv_event_get_target(e);
+    lv_draw_ctx_t * draw_ctx = lv_event_get_draw_ctx(e);
+    ui_readout_t * ro = (ui_readout_t *)obj;
+
+    lv_draw_label_dsc_t label_dsc;
+    lv_draw_label_dsc_init(&label_dsc);
+    lv_obj_init_draw_label_dsc(obj, LV_PART_MAIN, &label_dsc);
+    if(label_dsc.opa <= LV_OPA_MIN) return;
+
+    lv_color_t bg;
+    bool cell_bg = readout_cell_bg(obj, &bg);
+
+    /*Cell backgrounds first, then the glyphs copied from the atlas and last
+     *the rest blended on top, so no glyph reaching into the next cell is
+     *covered by that cell*/
+    if(cell_bg) {
+        lv_draw_rect_dsc_t cell_dsc;
+        lv_draw_rect_dsc_init(&cell_dsc);
+        cell_dsc.bg_color = bg;
+
+        for(uint8_t i = 0; i < ro->cell_cnt; i++) {
+            if(ro->cells[i] == ' ') continue;
+
+            lv_area_t cell;
+            readout_cell_area(obj, i, &cell);
+            if(_lv_area_is_on(&cell, draw_ctx->clip_area)) lv_draw_rect(draw_ctx, &cell_dsc, &cell);
+        }
+    }
+
+    uint8_t blend_cells = 0;        /*Bit per cell still to draw*/
+    for(uint8_t i = 0; i < ro->cell_cnt; i++) {
+        char c = ro->cells[i];
+        if(c == ' ') continue;
+
+        lv_area_t cell;
+        readout_cell_area(obj, i, &cell);
+        if(!_lv_area_is_on(&cell, draw_ctx->clip_area)) continue;
+
+#if UI_READOUT_USE_ATLAS
+        if(cell_bg) {
+            lv_point_t pos;
+            readout_glyph_pos(&label_dsc, c, &cell, &pos);
+            if(ui_glyph_atlas_draw(draw_ctx, &label_dsc, bg, &cell, &pos, (uint32_t)c)) continue;
+        }
+#endif
+        blend_cells |= 1 << i;
+    }
+
+    for(uint8_t i = 0; blend_cells; i++, blend_cells >>= 1) {
+        if((blend_cells & 1) == 0) continue;
+
+        lv_area_t cell;
+        lv_point_t pos;
+        readout_cell_area(obj, i, &cell);
+        readout_glyph_pos(&label_dsc, ro->cells[i], &cell, &pos);
+        ui_glyph_draw(draw_ctx, &label_dsc, &pos, (uint32_t)ro->cells[i]);
+    }
+}
@@ -0,0 +1,104 @@
+/**
+ * @file ui_readout.h
+ * Fixed-width, read-only numeric readout.
+ *
+ * A lightweight replacement for `lv_textarea` on the data screen. The value is
+ * kept in a small array of character cells; setting a new value formats it in
+ * place (no snprintf, no heap) and only the cells whose glyph changed are
+ * invalidated.
+ */
+
+#ifndef UI_READOUT_H
+#define UI_READOUT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "lvgl.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+#define UI_READOUT_MAX_CELLS    8
+#define UI_READOUT_DEF_CELLS    5
+
+/* Copy the glyphs of cells with an opaque LV_PART_ITEMS background from the
+ * pre-blended digit atlas (ui_glyph_cache.h) */
+#define UI_READOUT_USE_ATLAS    1
+
+/* Text shown while a channel has no valid reading */
+#define UI_READOUT_BLANK        "-  "
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef struct {
+    lv_obj_t obj;
+    const lv_font_t * font;                 /*Font the cell width was measured with*/
+    lv_coord_t cell_w;                      /*Width of one character cell [px]*/
+    uint8_t cell_cnt;                       /*Number of visible cells*/
+    uint8_t txt_start;                      /*First cell of the current text*/
+    uint8_t txt_len;                        /*Length of the current text in cells*/
+    char cells[UI_READOUT_MAX_CELLS];       /*One character per cell, ' ' is empty*/
+} ui_readout_t;
+
+extern const lv_obj_class_t ui_readout_class;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Create a readout object
+ * @param parent    pointer to an object, it will be the parent of the new readout
+ * @return          pointer to the created readout
+ */
+lv_obj_t * ui_readout_create(lv_obj_t * parent);
+
+/**
+ * Set how many character cells the readout shows
+ * @param obj       pointer to a readout
+ * @param cell_cnt  1 .. UI_READOUT_MAX_CELLS
+ */
+void ui_readout_set_cells(lv_obj_t * obj, uint8_t cell_cnt);
+
+/**
+ * Show a fixed-point value, e.g. `value = 234, decimals = 1` shows "23.4"
+ * @param obj       pointer to a readout
+ * @param value     the value scaled by 10^decimals
+ * @param decimals  number of digits after the decimal point
+ */
+void ui_readout_set_fixed(lv_obj_t * obj, int32_t value, uint8_t decimals);
+
+/**
+ * Show an integer value
+ * @param obj       pointer to a readout
+ * @param value     the value
+ */
+static inline void ui_readout_set_int(lv_obj_t * obj, int32_t value)
+{
+    ui_readout_set_fixed(obj, value, 0);
+}
+
+/**
+ * Show a short static string (e.g. UI_READOUT_BLANK). Longer strings are cut.
+ * @param obj       pointer to a readout
+ * @param txt       ASCII text
+ */
+void ui_readout_set_text(lv_obj_t * obj, const char * txt);
+
+/**
+ * Show the "no reading" sentinel
+ * @param obj       pointer to a readout
+ */
+static inline void ui_readout_set_blank(lv_obj_t * obj)
+{
+    ui_readout_set_text(obj, UI_READOUT_BLANK);
+}
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*UI_READOUT_H*/
@@ -9,6 +9,7 @@
 #include <stdio.h>
 #include "display.h"
 #include "at_handler.h"
+#include "power.h"
 
 
 static const char *TAG = "AT HANDLER";
@@ -20,20 +21,70 @@ void at_handler_set_response_queue(QueueHandle_t queue) {
 }
 
 
+// A URC line for mqtt_urc_task, cut to URC_CHUNK_SIZE
+static void urc_send_line(const char *line) {
+    urc_item_t item = { .kind = URC_LINE };
+    strlcpy(item.data, line, sizeof(item.data));
+    item.len = strlen(item.data);
+    xQueueSend(incoming_queue, &item, 0);
+}
+
+// Topic or payload bytes. mqtt_urc_task sees the gap if this gets dropped
+static void urc_send_data(urc_item_t *item) {
+    if (xQueueSend(incoming_queue, item, pdMS_TO_TICKS(URC_SEND_WAIT_MS)) != pdTRUE) {
+        ESP_LOGW(TAG, "⚠️ %u B of MQTT data dropped, URC queue full", item->len);
+    }
+    item->len = 0;
+}
+
+// "+CMQTTRXTOPIC: 0,<len>" and "+CMQTTRXPAYLOAD: 0,<len>": exactly <len> raw bytes follow
+static bool urc_data_header(const char *line, urc_item_t *item, size_t *len) {
+    unsigned int n;
+
+    if (sscanf(line, "+CMQTTRXTOPIC: %*d,%u", &n) == 1) {
+        item->kind = URC_TOPIC;
+    } else if (sscanf(line, "+CMQTTRXPAYLOAD: %*d,%u", &n) == 1) {
+        item->kind = URC_PAYLOAD;
+    } else {
+        return false;
+    }
+
+    item->len = 0;
+    *len = n;
+    return true;
+}
+
+
 // Task: reads UART events, dispatches attribute URCs and AT responses
 void rx_task(void *arg) {
     uint8_t data[256];
     char line[SIM7600_UART_BUF_SIZE];
     size_t line_idx = 0;
     bool in_rpc_block = false;
+    urc_item_t raw;             // Topic or payload bytes being collected
+    size_t raw_left = 0;        // of them still to come
 
     ESP_LOGI(TAG, "RX task started");
 
     while (1) {
         int len = uart_read_bytes(SIM7600_UART_PORT, data, sizeof(data), pdMS_TO_TICKS(20));
         if (len > 0) {
+            modem_stats_uart(0, len);
+            // A URC or +CMQTTRX block goes on for a while: don't sleep through the rest of it
+            power_hold(POWER_LOCK_MODEM, POWER_MODEM_HOLD_MS);
             for (int i = 0; i < len; i++) {
                 char c = (char)data[i];
+
+                // Counted bytes go through untouched: '\r', '\n' and '>' included
+                if (raw_left > 0) {
+                    raw.data[raw.len++] = c;
+                    raw_left--;
+                    if (raw.len == sizeof(raw.data) || raw_left == 0) {
+                        urc_send_data(&raw);
+                    }
+                    continue;
+                }
+
                 if (c == '\r') continue;
 
                 if (c == '>') {
@@ -69,15 +120,16 @@ void rx_task(void *arg) {
                     if (line_idx > 0) {
                         if (strstr(line, "+CMQTTRXSTART:")) {
                             in_rpc_block = true;
-                            xQueueSend(incoming_queue, line, 0);
+                            urc_send_line(line);
                         } else if (strstr(line, "+CMQTTRXEND:")) {
-                            xQueueSend(incoming_queue, line, 0);
+                            urc_send_line(line);
                             in_rpc_block = false;
                         } else if (in_rpc_block) {
-                            xQueueSend(incoming_queue, line, 0);
+                            urc_send_line(line);
+                            urc_data_header(line, &raw, &raw_left);
                         } else if (strstr(line, "+QMTRECV:") || strstr(line, "RDY") ||
                                    strstr(line, "SMS DONE") || strstr(line, "PB DONE")) {
-                            xQueueSend(incoming_queue, line, 0);
+                            urc_send_line(line);
                         } else {
                             if (active_response_queue) {
                                 xQueueSend(active_response_queue, line, 0);
@@ -96,15 +148,17 @@ void rx_task(void *arg) {
 
 
 void tx_task(void *arg) {
-    char command[SIM7600_UART_BUF_SIZE];
+    at_tx_item_t item;
 
     ESP_LOGI("TX", "tx_task started");
 
     while (1) {
-        if (xQueueReceive(at_send_queue, &command, portMAX_DELAY) == pdTRUE) {
-            // Flush UART input to avoid stale junk
-            
-            sim7600_send_command(command);
+        if (xQueueReceive(at_send_queue, &item, portMAX_DELAY) == pdTRUE) {
+            if (item.raw) {
+                sim7600_send_raw(item.data, item.len);
+            } else {
+                sim7600_send_command(item.data);
+            }
         }
     }
 }
@@ -0,0 +1,154 @@
+#include "blend.h"
+#include <string.h>
+
+#if BLEND_BACKEND == BLEND_BACKEND_FAST
+
+/*
+ * The kernels give exactly what lv_draw_sw_blend_basic gives for
+ * LV_BLEND_MODE_NORMAL. Backgrounds, panels and images without a mask are most
+ * of the pixels of a frame: they are filled 32 bits at a time and copied with
+ * memcpy, and semi-transparent fills work on the unpacked native colour instead
+ * of the bitfields LVGL reads through the byte swap.
+ */
+
+static inline uint16_t px_native(uint16_t px)
+{
+#if LV_COLOR_16_SWAP
+    return (uint16_t)((px << 8) | (px >> 8));
+#else
+    return px;
+#endif
+}
+
+// Fill `w` pixels starting at `dest`, two pixels per store where aligned
+static inline void fill_run(uint16_t *dest, uint16_t px, uint32_t px32, int32_t w)
+{
+    if (((uintptr_t)dest & 0x3) && w > 0) {
+        *dest++ = px;
+        w--;
+    }
+    uint32_t *d32 = (uint32_t *)dest;
+    for (; w >= 8; w -= 8) {
+        d32[0] = px32;
+        d32[1] = px32;
+        d32[2] = px32;
+        d32[3] = px32;
+        d32 += 4;
+    }
+    for (; w >= 2; w -= 2) {
+        *d32++ = px32;
+    }
+    if (w) {
+        *(uint16_t *)d32 = px;
+    }
+}
+
+
+///////////////////////////////// FILL /////////////////////////////////
+
+static void fill_opa(uint16_t *dest, int32_t w, int32_t h, int32_t stride, lv_color_t color, lv_opa_t opa)
+{
+    uint32_t opa_inv = 255 - opa;
+
+    // lv_color_premult() with the rounding lv_color_mix_premult() adds
+    uint16_t n = px_native(color.full);
+    uint32_t pr = (uint32_t)(n >> 11) * opa + LV_COLOR_MIX_ROUND_OFS;
+    uint32_t pg = (uint32_t)((n >> 5) & 0x3F) * opa + LV_COLOR_MIX_ROUND_OFS;
+    uint32_t pb = (uint32_t)(n & 0x1F) * opa + LV_COLOR_MIX_ROUND_OFS;
+
+    // Backgrounds are mostly flat: remember the last result. Over black
+    // lv_color_mix() is the premultiplied colour alone
+    uint16_t last_dest = 0;                     // lv_color_black()
+    uint16_t last_res = px_native((uint16_t)((LV_UDIV255(pr) << 11) | (LV_UDIV255(pg) << 5) | LV_UDIV255(pb)));
+
+    for (int32_t y = 0; y < h; y++) {
+        for (int32_t x = 0; x < w; x++) {
+            if (dest[x] != last_dest) {
+                last_dest = dest[x];
+                uint16_t bg = px_native(last_dest);
+                uint32_t r = LV_UDIV255(pr + (uint32_t)(bg >> 11) * opa_inv);
+                uint32_t g = LV_UDIV255(pg + (uint32_t)((bg >> 5) & 0x3F) * opa_inv);
+                uint32_t b = LV_UDIV255(pb + (uint32_t)(bg & 0x1F) * opa_inv);
+                last_res = px_native((uint16_t)((r << 11) | (g << 5) | b));
+            }
+            dest[x] = last_res;
+        }
+        dest += stride;
+    }
+}
+
+
+//////////////////////////////// ENTRY ////////////////////////////////
+
+void LV_ATTRIBUTE_FAST_MEM blend_fast(lv_draw_ctx_t *draw_ctx, const lv_draw_sw_blend_dsc_t *dsc)
+{
+    lv_disp_t *disp = _lv_refr_get_disp_refreshing();
+
+    /*
+     * Masked blends (anti-aliased edges, text) and image blends with opacity
+     * already go through lv_color_mix() with 4 byte mask reads in LVGL, so
+     * only the unmasked fill and copy get kernels of their own.
+     */
+    bool masked = dsc->mask_buf && dsc->mask_res != LV_DRAW_MASK_RES_FULL_COVER;
+    if (masked || disp->driver->set_px_cb || disp->driver->screen_transp ||
+        dsc->blend_mode != LV_BLEND_MODE_NORMAL || (dsc->src_buf && dsc->opa < LV_OPA_MAX)) {
+        lv_draw_sw_blend_basic(draw_ctx, dsc);
+        return;
+    }
+
+    lv_area_t area;
+    if (!_lv_area_intersect(&area, dsc->blend_area, draw_ctx->clip_area)) return;
+
+    int32_t stride = lv_area_get_width(draw_ctx->buf_area);
+    int32_t w = lv_area_get_width(&area);
+    int32_t h = lv_area_get_height(&area);
+    uint16_t *dest = (uint16_t *)draw_ctx->buf;
+    dest += stride * (area.y1 - draw_ctx->buf_area->y1) + (area.x1 - draw_ctx->buf_area->x1);
+
+    if (dsc->src_buf) {
+        int32_t src_stride = lv_area_get_width(dsc->blend_area);
+        const uint16_t *src = (const uint16_t *)dsc->src_buf;
+        src += src_stride * (area.y1 - dsc->blend_area->y1) + (area.x1 - dsc->blend_area->x1);
+
+        // lv_memcpy copies 4 bytes per iteration; the libc memcpy is much faster
+        for (int32_t y = 0; y < h; y++) {
+            memcpy(dest, src, w * sizeof(uint16_t));
+            dest += stride;
+            src += src_stride;
+        }
+    } else if (dsc->opa >= LV_OPA_MAX) {
+        uint16_t px = dsc->color.full;
+        uint32_t px32 = px | ((uint32_t)px << 16);
+        if (w == stride) {
+            // Full width rows are one run
+            fill_run(dest, px, px32, w * h);
+        } else {
+            for (int32_t y = 0; y < h; y++) {
+                fill_run(dest, px, px32, w);
+                dest += stride;
+            }
+        }
+    } else {
+        fill_opa(dest, w, h, stride, dsc->color, dsc->opa);
+    }
+}
+
+void blend_draw_ctx_init(lv_disp_drv_t *drv, lv_draw_ctx_t *draw_ctx)
+{
+    lv_draw_sw_init_ctx(drv, draw_ctx);
+    ((lv_draw_sw_ctx_t *)draw_ctx)->blend = blend_fast;
+}
+
+#else
+
+void blend_draw_ctx_init(lv_disp_drv_t *drv, lv_draw_ctx_t *draw_ctx)
+{
+    lv_draw_sw_init_ctx(drv, draw_ctx);
+}
+
+void blend_fast(lv_draw_ctx_t *draw_ctx, const lv_draw_sw_blend_dsc_t *dsc)
+{
+    lv_draw_sw_blend_basic(draw_ctx, dsc);
+}
+
+#endif
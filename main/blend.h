@@ -0,0 +1,34 @@
+#ifndef BLEND_H
+#define BLEND_H
+
+#include "lvgl.h"
+#include "src/draw/sw/lv_draw_sw.h"
+
+/*
+ * Blend backend for LVGL's software renderer.
+ *
+ * BLEND_BACKEND_LVGL  - LVGL's own lv_draw_sw_blend_basic (the reference)
+ * BLEND_BACKEND_FAST  - word-at-a-time RGB565-swapped kernels for the normal
+ *                       blend mode: fill, copy and alpha mix. Anything else
+ *                       (other blend modes, set_px_cb, transparent screen)
+ *                       still goes to lv_draw_sw_blend_basic.
+ *
+ * Both produce the same pixels.
+ */
+#define BLEND_BACKEND_LVGL      0
+#define BLEND_BACKEND_FAST      1
+
+#define BLEND_BACKEND           BLEND_BACKEND_FAST
+
+// LV_COLOR_MIX_ROUND_OFS 0 swaps lv_color_mix for a truncating 32 step mix
+#if BLEND_BACKEND == BLEND_BACKEND_FAST && (LV_COLOR_DEPTH != 16 || LV_COLOR_MIX_ROUND_OFS == 0)
+#error "BLEND_BACKEND_FAST only supports 16 bit colour with a rounding LV_COLOR_MIX_ROUND_OFS"
+#endif
+
+// Use as lv_disp_drv_t.draw_ctx_init: the software draw context with our blend
+void blend_draw_ctx_init(lv_disp_drv_t *drv, lv_draw_ctx_t *draw_ctx);
+
+// The blend callback blend_draw_ctx_init installs
+void blend_fast(lv_draw_ctx_t *draw_ctx, const lv_draw_sw_blend_dsc_t *dsc);
+
+#endif // BLEND_H
@@ -0,0 +1,109 @@
+#include <string.h>
+#include "cbor.h"
+
+
+// Major types
+#define CBOR_UINT       0
+#define CBOR_NEGINT     1
+#define CBOR_TEXT       3
+#define CBOR_ARRAY      4
+#define CBOR_MAP        5
+#define CBOR_SIMPLE     7
+
+#define CBOR_FALSE      20
+#define CBOR_TRUE       21
+#define CBOR_INDEFINITE 31
+
+
+void cbor_init(cbor_writer_t *w, uint8_t *buf, size_t size) {
+    w->buf = buf;
+    w->size = size;
+    w->len = 0;
+    w->overflow = false;
+}
+
+static bool reserve(cbor_writer_t *w, size_t n) {
+    if (w->overflow || w->size - w->len < n) {
+        w->overflow = true;
+        return false;
+    }
+    return true;
+}
+
+// Initial byte plus the shortest argument that holds `value`
+static void put_head(cbor_writer_t *w, uint8_t major, uint64_t value) {
+    int bytes;
+    uint8_t info;
+
+    if (value < 24) {
+        bytes = 0;
+        info = (uint8_t)value;
+    } else if (value <= UINT8_MAX) {
+        bytes = 1;
+        info = 24;
+    } else if (value <= UINT16_MAX) {
+        bytes = 2;
+        info = 25;
+    } else if (value <= UINT32_MAX) {
+        bytes = 4;
+        info = 26;
+    } else {
+        bytes = 8;
+        info = 27;
+    }
+
+    if (!reserve(w, 1 + bytes)) {
+        return;
+    }
+
+    w->buf[w->len++] = (major << 5) | info;
+    for (int i = bytes - 1; i >= 0; i--) {
+        w->buf[w->len++] = (uint8_t)(value >> (8 * i));     // big endian
+    }
+}
+
+void cbor_put_uint(cbor_writer_t *w, uint64_t value) {
+    put_head(w, CBOR_UINT, value);
+}
+
+void cbor_put_int(cbor_writer_t *w, int64_t value) {
+    if (value >= 0) {
+        put_head(w, CBOR_UINT, (uint64_t)value);
+    } else {
+        put_head(w, CBOR_NEGINT, (uint64_t)(-1 - value));
+    }
+}
+
+void cbor_put_bool(cbor_writer_t *w, bool value) {
+    put_head(w, CBOR_SIMPLE, value ? CBOR_TRUE : CBOR_FALSE);
+}
+
+void cbor_put_text(cbor_writer_t *w, const char *text) {
+    size_t n = strlen(text);
+
+    put_head(w, CBOR_TEXT, n);
+    if (!reserve(w, n)) {
+        return;
+    }
+    memcpy(w->buf + w->len, text, n);
+    w->len += n;
+}
+
+static void put_byte(cbor_writer_t *w, uint8_t byte) {
+    if (reserve(w, 1)) {
+        w->buf[w->len++] = byte;
+    }
+}
+
+void cbor_open_array(cbor_writer_t *w) {
+    put_byte(w, (CBOR_ARRAY << 5) | CBOR_INDEFINITE);
+}
+
+void cbor_open_map(cbor_writer_t *w) {
+    put_byte(w, (CBOR_MAP << 5) | CBOR_INDEFINITE);
+}
+
+// The "break" that ends an indefinite array or map
+void cbor_close(cbor_writer_t *w) {
+    put_byte(w, (CBOR_SIMPLE << 5) | CBOR_INDEFINITE);
+}
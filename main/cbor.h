@@ -0,0 +1,33 @@
+#ifndef CBOR_H
+#define CBOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Just enough of a CBOR (RFC 8949) encoder for the telemetry payload.
+ *
+ * Arrays and maps are indefinite length: open them, write the items and
+ * close with cbor_close(). A write that doesn't fit sets `overflow` and
+ * everything after it is dropped, so check it once at the end.
+ */
+typedef struct {
+    uint8_t *buf;
+    size_t size;
+    size_t len;
+    bool overflow;
+} cbor_writer_t;
+
+void cbor_init(cbor_writer_t *w, uint8_t *buf, size_t size);
+
+void cbor_put_uint(cbor_writer_t *w, uint64_t value);
+void cbor_put_int(cbor_writer_t *w, int64_t value);
+void cbor_put_bool(cbor_writer_t *w, bool value);
+void cbor_put_text(cbor_writer_t *w, const char *text);
+
+void cbor_open_array(cbor_writer_t *w);
+void cbor_open_map(cbor_writer_t *w);
+void cbor_close(cbor_writer_t *w);
+
+#endif // CBOR_H
@@ -11,6 +11,10 @@
 #include "mqtt.h"
 #include "publish.h"
 #include "message_ids.h"
+#include "deep_sleep.h"
+#include "history.h"
+#include "filter.h"
+#include "protocol.h"
 
 static const char *TAG = "Data";
 
@@ -18,6 +22,25 @@ static const char *TAG = "Data";
 QueueHandle_t message_queue;
 SemaphoreHandle_t message_semaphore;
 
+// The latest frame per id, for deep_sleep_enter() to keep in RTC memory
+static DecodedMessage last_frames[DATA_FRAME_IDS];
+static uint32_t last_frames_seen = 0;
+static portMUX_TYPE frames_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// data_replay() running: the frames went out before the sleep, only redraw them
+static bool replaying = false;
+
+static void data_publish(bool alarm) {
+    if (replaying) {
+        return;
+    }
+    if (alarm) {
+        publish_alarm();
+    } else {
+        publish_data();
+    }
+}
+
 
 
 // Task function to monitor the queue and handle messages
@@ -37,123 +60,161 @@ void data_task(void *param) {
     }
 }
 
-// Function to decode a UART message
-void decode_uart_message(const char *input_message, DecodedMessage *decoded_msg) {
-    decoded_msg->message_type = input_message[0] - '0';
-    sscanf(input_message + 1, "%4X", &decoded_msg->message_id);
-    sscanf(input_message + 6, "%4hX%4hX%4hX%4hX",
-           &decoded_msg->data0, &decoded_msg->data1,
-           &decoded_msg->data2, &decoded_msg->data3);
+uint32_t data_last_frames(DecodedMessage frames[DATA_FRAME_IDS]) {
+    taskENTER_CRITICAL(&frames_lock);
+    memcpy(frames, last_frames, sizeof(last_frames));
+    uint32_t seen = last_frames_seen;
+    taskEXIT_CRITICAL(&frames_lock);
+    return seen;
+}
 
+void data_replay(const DecodedMessage frames[DATA_FRAME_IDS], uint32_t seen) {
+    replaying = true;
+    for (int id = 0; id < DATA_FRAME_IDS; id++) {
+        if (seen & BIT(id)) {
+            handle_message(&frames[id]);
+        }
+    }
+    replaying = false;
 }
 
-// Function to handle messages based on their ID
+typedef void (*message_handler_t)(const DecodedMessage *decoded_msg);
+
+// Indexed by id, from MSG_IDS; ids past the last take the handle_none at the end
+static const message_handler_t handlers[MSG_ID_COUNT + 1] = {
+#define X(name, id, handler, channels) [id] = handler,
+    MSG_IDS(X)
+#undef X
+    [MSG_ID_COUNT] = handle_none,
+};
+
 void handle_message(const DecodedMessage *decoded_msg) {
-    switch (decoded_msg->message_id) {
-        case MSG_ID_BME280:
-            handle_bme280_message(decoded_msg);
-            //ESP_LOGI(TAG, "recieved BME280       message ID: %d", decoded_msg->message_id);
-            break;
-        
-        case MSG_ID_TANK_LEVEL:
-            handle_tank_message(decoded_msg);
-            //ESP_LOGI(TAG, "recieved TANK LEVEL   message ID: %d", decoded_msg->message_id);
-            break;
-
-        case MSG_ID_MODE:
-            handle_mode_message(decoded_msg);
-            //ESP_LOGI(TAG, "recieved PUMP         message ID: %d", decoded_msg->message_id);
-            break;
-
-        case MSG_ID_COMMS:
-            handle_comms_message(decoded_msg);
-            //ESP_LOGI(TAG, "recieved COMM         message ID: %d", decoded_msg->message_id);
-            break;
-
-        case MSG_ID_SPARE:
-            //handle_outputs_message(decoded_msg);
-            //ESP_LOGI(TAG, "recieved 24V_OUT      message ID: %d", decoded_msg->message_id);
-            break;
-
-        case MSG_ID_BATT:
-            handle_batt_message(decoded_msg);
-            //ESP_LOGI(TAG, "recieved NPN_OUT      message ID: %d", decoded_msg->message_id);
-            break;
-        
-        case MSG_ID_OUTPUTS:
-            handle_outputs_message(decoded_msg);
-            publish_data();
-
-            //ESP_LOGI(TAG, "recieved OUTPUTS      message ID: %d", decoded_msg->message_id);
-            break;
-                
-        case MSG_ID_PT1000:
-            handle_pt1000_message(decoded_msg);
-            //ESP_LOGI(TAG, "recieved PT1000       message ID: %d", decoded_msg->message_id);
-            break;
-
-        case MSG_ID_STATUS:
-            handle_status_message(decoded_msg);
-            //ESP_LOGI(TAG, "recieved ERROR        message ID: %d", decoded_msg->message_id);
-            break;
-
-        case MSG_ID_SYSTEM:
-            handle_system_message(decoded_msg);
-            break;
-
-
-        default:
-            //ESP_LOGW(TAG, "Unknown message ID: %d", decoded_msg->message_id);
-            break;
+    unsigned id = (unsigned)decoded_msg->message_id;
+    if (id < DATA_FRAME_IDS && id != MSG_ID_HEARTBEAT) {
+        taskENTER_CRITICAL(&frames_lock);
+        last_frames[id] = *decoded_msg;
+        last_frames_seen |= BIT(id);
+        taskEXIT_CRITICAL(&frames_lock);
     }
+
+    handlers[id < MSG_ID_COUNT ? id : MSG_ID_COUNT](decoded_msg);
 }
 
 ////////HANDLING FUNCTIONS///////////
 
-void handle_bme280_message(const DecodedMessage *decoded_msg) {
+void handle_none(const DecodedMessage *decoded_msg) {
+}
+
+// What each channel's readout shows, SENSOR_NO_DATA until its first reading
+static int32_t channel_shown[PROTOCOL_CHANNEL_COUNT];
+static sensor_state_t channel_state[PROTOCOL_CHANNEL_COUNT];
+
+// Rounded half away from zero: -15 tenths show as -2, not -1
+static int32_t round_div(int32_t value, int32_t div) {
+    return (value >= 0 ? value + div / 2 : value - div / 2) / div;
+}
 
-    // ESP_LOGI(TAG, "Handling BME280 Message:");
-    // ESP_LOGI(TAG, "Message Type: %d", decoded_msg->message_type);
-    // ESP_LOGI(TAG, "Data0: %04X", decoded_msg->data0);
-    // ESP_LOGI(TAG, "Data1: %04X", decoded_msg->data1);
-    // ESP_LOGI(TAG, "Data2: %04X", decoded_msg->data2);
-    // ESP_LOGI(TAG, "Data3: %04X", decoded_msg->data3);
+void handle_channels(const DecodedMessage *decoded_msg) {
+    protocol_span_t span = protocol_spans[decoded_msg->message_id];
+    int32_t value[PROTOCOL_CHANNEL_COUNT];
+    sensor_state_t state[PROTOCOL_CHANNEL_COUNT];
+    bool redraw[PROTOCOL_CHANNEL_COUNT];
+    bool any_redraw = false;
+
+    for (int i = span.first; i < span.first + span.count; i++) {
+        const protocol_channel_t *ch = &protocol_channels[i];
+        state[i] = protocol_channel_value(ch, decoded_msg, &value[i]);
+        if (ch->filter != PROTOCOL_NO_FILTER) {
+            if (state[i] == SENSOR_OK) {
+                filter_run(ch->filter, value[i], &value[i]);
+            } else {
+                filter_reset(ch->filter);
+            }
+        }
 
-    float temp_float = (float)decoded_msg->data0 / 100.0f;
-    float pres_float = (float)decoded_msg->data1 / 100.0f;
-    float hum_float = (float)decoded_msg->data2 / 100.0f;
+        // Readouts only move when what they show does
+        int32_t shown = state[i] == SENSOR_OK ? round_div(value[i], ch->shown_div) : 0;
+        redraw[i] = state[i] != channel_state[i] || shown != channel_shown[i];
+        any_redraw |= redraw[i];
+        channel_state[i] = state[i];
+        channel_shown[i] = shown;
+    }
 
-    //Update the shared data structure - using mutex
+    // Without a reading the last good value stays
     xSemaphoreTake(data_mutex, portMAX_DELAY);
-    shared_sensor_data.temp = temp_float;
-    shared_sensor_data.pres = pres_float;
-    shared_sensor_data.rh = hum_float;
+    for (int i = span.first; i < span.first + span.count; i++) {
+        const protocol_channel_t *ch = &protocol_channels[i];
+        if (state[i] == SENSOR_OK) {
+            *protocol_channel_field(ch, &shared_sensor_data) = (float)value[i] / ch->unit_div;
+        }
+        if (ch->state >= 0) {
+            ((uint8_t *)&shared_sensor_data)[ch->state] = state[i];
+        }
+    }
     xSemaphoreGive(data_mutex);
 
-    
-    char temp_buf[32];
-    char pres_buf[32];
-    char hum_buf[32];
-
-    
-    snprintf(temp_buf, 32, "%.1f", temp_float);
-    snprintf(pres_buf, 32, "%.1f", pres_float);
-    snprintf(hum_buf,  32, "%.1f", hum_float);
-    
-    if (lvgl_lock(LVGL_LOCK_WAIT_TIME))
+    if (any_redraw && lvgl_lock(LVGL_LOCK_WAIT_TIME))
     {
-        lv_textarea_set_text(ui_BMETempTextArea, temp_buf);
-        lv_textarea_set_text(ui_BMEPresTextArea, pres_buf);
-        lv_textarea_set_text(ui_BMEHumTextArea, hum_buf);
+        for (int i = span.first; i < span.first + span.count; i++) {
+            const protocol_channel_t *ch = &protocol_channels[i];
+            if (!redraw[i]) {
+                continue;
+            }
+            if (state[i] == SENSOR_OK) {
+                ui_readout_set_fixed(*ch->readout, channel_shown[i], ch->shown);
+            } else {
+                ui_readout_set_blank(*ch->readout);
+            }
+        }
         lvgl_unlock();
     }
 }
 
 
+// Level in 0.1 % from a 4-20 mA loop in 0.01 mA: `range` of the sensor over the tank's `max`.
+// One float division per frame for the gain, the rest in integers
+static int32_t loop_level(uint16_t centi_ma, float range, float max) {
+    if (max <= 0.0f) {
+        max = 1.0f;
+    }
+    int32_t gain_q16 = (int32_t)(range / max * 1000.0f / 1600.0f * 65536.0f);
+    return (int32_t)(((int64_t)((int32_t)centi_ma - 400) * gain_q16) >> 16);
+}
+
+// In history.h order: internal, external, aux
+static const struct {
+    lv_obj_t **readout;
+    lv_obj_t **bar;
+} tank_widgets[HISTORY_TANKS] = {
+    { &ui_IntTankTextArea, &ui_IntTankBar },
+    { &ui_ExtTankTextArea, &ui_ExtTankBar },
+    { &ui_AuxTankTextArea, &ui_ExtTankBar1 },
+};
+
+static void draw_tank(int t, sensor_state_t state, int32_t level) {
+    lv_obj_t *readout = *tank_widgets[t].readout;
+    lv_obj_t *bar = *tank_widgets[t].bar;
+
+    if (state != SENSOR_OK) {
+        if (state == SENSOR_NO_DATA) {
+            ui_readout_set_blank(readout);
+        } else {
+            ui_readout_set_text(readout, sensor_state_short(state));
+        }
+        lv_bar_set_value(bar, 0, LV_ANIM_OFF);
+        return;
+    }
+
+    int32_t percent = round_div(level, 10);
+    ui_readout_set_int(readout, percent);
+    lv_bar_set_value(bar, percent, LV_ANIM_OFF);
+    lv_obj_set_style_bg_color(bar, lv_color_hex(percent <= 20 ? 0xFF0000 : 0x03A9F4), LV_PART_INDICATOR | LV_STATE_DEFAULT);
+}
+
 void handle_tank_message(const DecodedMessage *decoded_msg) {
 
-    int16_t int_tank_percent  = decoded_msg->data0;
-    uint16_t ext_tank_ma = decoded_msg->data2;
+    int16_t int_tank_percent  = decoded_msg->data0;     // The master's own level, -1 without one
+    uint16_t ext_tank_ma = decoded_msg->data2;          // 0.01 mA
     uint16_t aux_tank_ma  = decoded_msg->data1;
     //ESP_LOGW(TAG, "int: %d, ext: %d, aux: %d", int_tank_percent, ext_tank_ma, aux_tank_ma);
 
@@ -186,111 +247,74 @@ void handle_tank_message(const DecodedMessage *decoded_msg) {
         //ESP_LOGE(TAG, "Failed to get ext max from NVS: %s", esp_err_to_name(err));
         extMax = 1.0f; // Default value if read fails
     }
-    
-    char int_buf[32];
-    char ext_buf[32];
-    char aux_buf[32];
-
-    //ESP_LOGI(TAG, "ext_tank_ma: %d, aux_tank_ma: %d", ext_tank_ma, aux_tank_ma);
-
-    
-    int16_t ext_tank_percent = ((float)((float)((ext_tank_ma - 400.0) * 1000 * extRange) / 1600)  /  (1000 * extMax)) * 100.0;
-    int16_t aux_tank_percent = ((float)((float)((aux_tank_ma - 400.0) * 1000 * auxRange) / 1600)  /  (1000 * auxMax)) * 100.0;
-
-    //ESP_LOGI(TAG, "ext_tank_ma: %d, extRange: %f, extMax: %f, ext_tank_percent: %d", ext_tank_ma, extRange, extMax,ext_tank_percent);
-    //ESP_LOGI(TAG, "aux_tank_ma: %d, auxRange: %f, auxMax: %f, aux_tank_percent: %d", aux_tank_ma, auxRange, auxMax, aux_tank_percent);
 
+    // Raw levels in 0.1 %, and what they're worth
+    sensor_state_t state[HISTORY_TANKS] = {
+        int_tank_percent < 0 ? SENSOR_NO_DATA : SENSOR_OK,
+        filter_loop_state(ext_tank_ma),
+        filter_loop_state(aux_tank_ma),
+    };
+    int32_t level[HISTORY_TANKS] = {
+        int_tank_percent * 10,
+        loop_level(ext_tank_ma, extRange, extMax),
+        loop_level(aux_tank_ma, auxRange, auxMax),
+    };
+
+    // Sloshing: the dashboard and the telemetry only see the filtered level move
+    bool redraw[HISTORY_TANKS];
+    bool any_redraw = false;
+    for (int t = 0; t < HISTORY_TANKS; t++) {
+        if (state[t] == SENSOR_OK && level[t] > 1000) {
+            state[t] = SENSOR_OVER_RANGE;
+        }
+        if (level[t] < 0) {
+            level[t] = 0;       // 3.8-4 mA: still a working loop, just below empty
+        }
 
-    if (ext_tank_percent > 100){
-        ext_tank_percent = -1;
-    }
-
-    if (aux_tank_percent > 100){
-        aux_tank_percent = -1;
+        if (state[t] == SENSOR_OK) {
+            redraw[t] = filter_run(FILTER_INT_TANK + t, level[t], &level[t]);
+        } else {
+            filter_reset(FILTER_INT_TANK + t);
+            redraw[t] = false;
+        }
     }
 
-    
-
-
     //update the global data structure
     xSemaphoreTake(data_mutex, portMAX_DELAY);
-    shared_sensor_data.int_tank = int_tank_percent;
-    shared_sensor_data.ext_tank = ext_tank_percent;
-    shared_sensor_data.aux_tank = aux_tank_percent;
+    float *shared_level[HISTORY_TANKS] = {
+        &shared_sensor_data.int_tank, &shared_sensor_data.ext_tank, &shared_sensor_data.aux_tank,
+    };
+    uint8_t *shared_state[HISTORY_TANKS] = {
+        &shared_sensor_data.int_tank_state, &shared_sensor_data.ext_tank_state, &shared_sensor_data.aux_tank_state,
+    };
+    for (int t = 0; t < HISTORY_TANKS; t++) {
+        redraw[t] |= *shared_state[t] != state[t];
+        any_redraw |= redraw[t];
+        *shared_state[t] = state[t];
+        if (state[t] == SENSOR_OK) {
+            *shared_level[t] = level[t] / 10.0f;
+        }
+    }
     xSemaphoreGive(data_mutex);
 
-    //ESP_LOGI(TAG, "ext_tank_percent: %d, aux_tank_percent: %d", ext_tank_percent, aux_tank_percent);
-
-    snprintf(int_buf, 32, "%d", int_tank_percent);
-    snprintf(ext_buf, 32, "%d", ext_tank_percent);
-    snprintf(aux_buf, 32, "%d", aux_tank_percent);
-
-    if (ext_tank_percent < -1){
-        ext_tank_percent = -1;
-    }
-    if (aux_tank_percent < -1){
-        aux_tank_percent = -1;
+    // Already in the history before the sleep
+    if (!replaying) {
+        int16_t percent[HISTORY_TANKS];
+        for (int t = 0; t < HISTORY_TANKS; t++) {
+            percent[t] = state[t] == SENSOR_OK ? round_div(level[t], 10) : -1;
+        }
+        history_add(percent[HISTORY_INT_TANK], percent[HISTORY_EXT_TANK], percent[HISTORY_AUX_TANK]);
     }
 
-
-    if (lvgl_lock(LVGL_LOCK_WAIT_TIME))
+    if (any_redraw && lvgl_lock(LVGL_LOCK_WAIT_TIME))
     {
-
-        if (ext_tank_percent == -1){
-            lv_textarea_set_text(ui_ExtTankTextArea, "-  ");
-            lv_bar_set_value(ui_ExtTankBar, 0, LV_ANIM_OFF);
-
-        }
-
-        else if (ext_tank_percent < 101){
-            lv_textarea_set_text(ui_ExtTankTextArea, ext_buf);
-            lv_bar_set_value(ui_ExtTankBar, ext_tank_percent, LV_ANIM_OFF);
-            lv_obj_set_style_bg_color(ui_ExtTankBar, lv_color_hex(0x03A9F4), LV_PART_INDICATOR | LV_STATE_DEFAULT);
-
-            if (ext_tank_percent <= 20){
-                lv_obj_set_style_bg_color(ui_ExtTankBar, lv_color_hex(0xFF0000), LV_PART_INDICATOR | LV_STATE_DEFAULT);
-            }
-            
-        }
-        
-        if (int_tank_percent == -1){
-            lv_textarea_set_text(ui_IntTankTextArea, "-  ");
-            lv_bar_set_value(ui_IntTankBar, 0, LV_ANIM_OFF);
-
-        }
-
-        else if (int_tank_percent < 101){
-            lv_textarea_set_text(ui_IntTankTextArea, int_buf);
-            lv_bar_set_value(ui_IntTankBar, int_tank_percent, LV_ANIM_OFF);
-            lv_obj_set_style_bg_color(ui_IntTankBar, lv_color_hex(0x03A9F4), LV_PART_INDICATOR | LV_STATE_DEFAULT);
-
-            if (int_tank_percent <= 20){
-                lv_obj_set_style_bg_color(ui_IntTankBar, lv_color_hex(0xFF0000), LV_PART_INDICATOR | LV_STATE_DEFAULT);
-            }
-        }
-        
-        if (aux_tank_percent == -1){
-            lv_textarea_set_text(ui_AuxTankTextArea, "-  ");
-            lv_bar_set_value(ui_ExtTankBar1, 0, LV_ANIM_OFF);
-
-        }
-
-        else if (aux_tank_percent < 101){
-            lv_textarea_set_text(ui_AuxTankTextArea, aux_buf);
-            lv_bar_set_value(ui_ExtTankBar1, aux_tank_percent, LV_ANIM_OFF);
-            lv_obj_set_style_bg_color(ui_ExtTankBar1, lv_color_hex(0x03A9F4), LV_PART_INDICATOR | LV_STATE_DEFAULT);
-
-            if (aux_tank_percent <= 20){
-                lv_obj_set_style_bg_color(ui_ExtTankBar1, lv_color_hex(0xFF0000), LV_PART_INDICATOR | LV_STATE_DEFAULT);
+        for (int t = 0; t < HISTORY_TANKS; t++) {
+            if (redraw[t]) {
+                draw_tank(t, state[t], level[t]);
             }
         }
-        
-        
-        
         lvgl_unlock();
     }
-
-
 }
 
 
@@ -332,7 +356,7 @@ void handle_comms_message(const DecodedMessage *decoded_msg){
             xSemaphoreGive(data_mutex);
             
             lv_obj_set_style_text_color(ui_CANTextArea, lv_color_hex(0x40E0D0), LV_PART_MAIN | LV_STATE_DEFAULT);
-            publish_data();
+            data_publish(false);
         }
         else if (decoded_msg->data0==CAN_DATA){
 
@@ -341,7 +365,7 @@ void handle_comms_message(const DecodedMessage *decoded_msg){
             xSemaphoreGive(data_mutex);
             
             lv_obj_set_style_text_color(ui_CANTextArea, lv_color_hex(0x00FF00), LV_PART_MAIN | LV_STATE_DEFAULT);
-            publish_data();
+            data_publish(false);
         }
         else if (decoded_msg->data0==CAN_ERROR){
             lv_obj_set_style_text_color(ui_CANTextArea, lv_color_hex(0xFF0000), LV_PART_MAIN | LV_STATE_DEFAULT);
@@ -352,336 +376,107 @@ void handle_comms_message(const DecodedMessage *decoded_msg){
     
 
 
+// The outputs of MSG_ID_OUTPUTS by index, PROTOCOL_OUTPUTS
+static const struct {
+    size_t field;                       // bool in sensor_data_t
+    lv_obj_t **readout;
+} outputs[] = {
+#define O(index, field, readout) [index] = { offsetof(sensor_data_t, field), &readout },
+    PROTOCOL_OUTPUTS(O)
+#undef O
+};
+
 void handle_outputs_message(const DecodedMessage *decoded_msg){
-    int output_id = decoded_msg->data0;
+    unsigned output_id = decoded_msg->data0;
     bool output_state = decoded_msg->data1;
     //ESP_LOGI(TAG, "Output ID: %d, State: %d", output_id, output_state);
 
-    if (output_id == 0) {
+    if (output_id < sizeof(outputs) / sizeof(outputs[0])) {
         xSemaphoreTake(data_mutex, portMAX_DELAY);
-        shared_sensor_data.out1 = output_state;
+        *((bool *)((uint8_t *)&shared_sensor_data + outputs[output_id].field)) = output_state;
         xSemaphoreGive(data_mutex);
-        if (output_state == true) {
-            if (lvgl_lock(LVGL_LOCK_WAIT_TIME)) {
-                lv_obj_set_style_text_color(ui_Out124VTextArea, output_state ? lv_color_hex(0x00FF00) : lv_color_hex(0xFF0000), LV_PART_MAIN | LV_STATE_DEFAULT);
-                lvgl_unlock();
-            }
-        } 
-        else {
-            if (lvgl_lock(LVGL_LOCK_WAIT_TIME)) {
-                lv_obj_set_style_text_color(ui_Out124VTextArea, output_state ? lv_color_hex(0xFF0000) : lv_color_hex(0xFF0000), LV_PART_MAIN | LV_STATE_DEFAULT);
-                lvgl_unlock();
-            }
-        }
-    }
 
-    else if (output_id == 1) {
-        xSemaphoreTake(data_mutex, portMAX_DELAY);
-        shared_sensor_data.out2 = output_state;
-        xSemaphoreGive(data_mutex);
-        if (output_state == true) {
-            if (lvgl_lock(LVGL_LOCK_WAIT_TIME)) {
-                lv_obj_set_style_text_color(ui_Out224VTextArea, output_state ? lv_color_hex(0x00FF00) : lv_color_hex(0xFF0000), LV_PART_MAIN | LV_STATE_DEFAULT);
-                lvgl_unlock();
-            }
-        }
-        else {
-            if (lvgl_lock(LVGL_LOCK_WAIT_TIME)) {
-                lv_obj_set_style_text_color(ui_Out224VTextArea, output_state ? lv_color_hex(0xFF0000) : lv_color_hex(0xFF0000), LV_PART_MAIN | LV_STATE_DEFAULT);
-                lvgl_unlock();
-            }
-        }
-    }
-
-    else if (output_id == 2) {
-        xSemaphoreTake(data_mutex, portMAX_DELAY);
-        shared_sensor_data.npn1 = output_state;
-        xSemaphoreGive(data_mutex);
-        if (output_state == true) {
-            if (lvgl_lock(LVGL_LOCK_WAIT_TIME)) {
-                lv_obj_set_style_text_color(ui_Out1NPNTextArea1, output_state ? lv_color_hex(0x00FF00) : lv_color_hex(0xFF0000), LV_PART_MAIN | LV_STATE_DEFAULT);
-                lvgl_unlock();
-            }
-        }
-        else {
-            if (lvgl_lock(LVGL_LOCK_WAIT_TIME)) {
-                lv_obj_set_style_text_color(ui_Out1NPNTextArea1, output_state ? lv_color_hex(0xFF0000) : lv_color_hex(0xFF0000), LV_PART_MAIN | LV_STATE_DEFAULT);
-                lvgl_unlock();
-            }
-        }
-    }
-    
-    
-    
-    else if (output_id == 3) {
-        xSemaphoreTake(data_mutex, portMAX_DELAY);
-        shared_sensor_data.npn2 = output_state;
-        xSemaphoreGive(data_mutex);
-        if (output_state == true) {
-            if (lvgl_lock(LVGL_LOCK_WAIT_TIME)) {
-                lv_obj_set_style_text_color(ui_Out2NPNTextArea2, output_state ? lv_color_hex(0x00FF00) : lv_color_hex(0xFF0000), LV_PART_MAIN | LV_STATE_DEFAULT);
-                lvgl_unlock();
-            }
-        }
-        else {
-            if (lvgl_lock(LVGL_LOCK_WAIT_TIME)) {
-                lv_obj_set_style_text_color(ui_Out2NPNTextArea2, output_state ? lv_color_hex(0xFF0000) : lv_color_hex(0xFF0000), LV_PART_MAIN | LV_STATE_DEFAULT);
-                lvgl_unlock();
-            }
+        if (lvgl_lock(LVGL_LOCK_WAIT_TIME)) {
+            lv_obj_set_style_text_color(*outputs[output_id].readout, lv_color_hex(output_state ? 0x00FF00 : 0xFF0000),
+                                        LV_PART_MAIN | LV_STATE_DEFAULT);
+            lvgl_unlock();
         }
     }
-
-
+    data_publish(false);
 }
 
-void handle_batt_message(const DecodedMessage *decoded_msg){
+// What the dashboard and Status say for each status_messages_t in data0
+static const struct {
+    const char *shown;
+    const char *status;
+} pump_statuses[] = {
+    [PUMP_RUNNING]           = { "Running",   "Pump Running" },
+    [PUMP_PURGING]           = { "Purging..", "Pump Purging" },
+    [PUMP_STOPPED]           = { "Stopped",   "Pump Stopped" },
+    [PUMP_WAITING_TO_START]  = { "Waiting",   "Pump Waiting" },
+    [AUTO_ROUTINE_CHECKING]  = { "Auto Run",  "Auto: Running" },
+    [AUTO_ROUTINE_FILLING]   = { "Filling",   "Auto: Filling" },
+    [AUTO_ROUTINE_PURGING]   = { "Purging",   "Auto: Purging" },
+    [AUTO_ROUTINE_VERIFYING] = { "Verifying", "Auto: Verifying" },
+};
+
+// And for each error_messages_t in data1, both ways: these raise an alarm
+static const char *pump_errors[] = {
+    [FILL_ERROR] = "Fill Error",
+    [COMM_ERROR] = "Comm Error",
+};
 
-        if (decoded_msg->data0 == 65535){
+void handle_status_message(const DecodedMessage *decoded_msg){
+    unsigned status = decoded_msg->data0;
+    unsigned error = decoded_msg->data1;
+
+    if (status == PUMP_ERROR) {
         if (lvgl_lock(LVGL_LOCK_WAIT_TIME))
         {
-            lv_textarea_set_text(ui_BattVTextArea, "-  ");
+            lv_obj_set_style_border_color(ui_ErrorPanel, lv_color_hex(0xFF0000), LV_PART_MAIN | LV_STATE_DEFAULT);
             lvgl_unlock();
         }
-    }
-
-    else {
-
-        float batt_float = (float)decoded_msg->data0/1000.0;
-
-        //Update the shared data structure - using mutex
-        xSemaphoreTake(data_mutex, portMAX_DELAY);
-        shared_sensor_data.batt_volt = batt_float;
-        xSemaphoreGive(data_mutex);
-
-        //ESP_LOGW(TAG, "msg %d", decoded_msg->data0);
-            
-        char volts_buf[32];
-
-        snprintf(volts_buf, 32, "%.1f", batt_float);
-        
+        vTaskDelay(20/ portTICK_PERIOD_MS);
+        data_publish(true);
+    } else if (status < sizeof(pump_statuses) / sizeof(pump_statuses[0]) && pump_statuses[status].shown) {
         if (lvgl_lock(LVGL_LOCK_WAIT_TIME))
         {
-            lv_textarea_set_text(ui_BattVTextArea, volts_buf);
+            lv_obj_set_style_text_color(ui_ErrorTextArea, lv_color_hex(0xFFFFFF), LV_PART_MAIN | LV_STATE_DEFAULT);
+            lv_obj_set_style_border_color(ui_ErrorPanel, lv_color_hex(0x003F5A), LV_PART_MAIN | LV_STATE_DEFAULT);
+            lv_textarea_set_text(ui_ErrorTextArea, pump_statuses[status].shown);
             lvgl_unlock();
         }
+        xSemaphoreTake(data_mutex, portMAX_DELAY);
+        strcpy(shared_sensor_data.status, pump_statuses[status].status);
+        xSemaphoreGive(data_mutex);
+        data_publish(false);
+    } else {
+        ESP_LOGW(TAG, "Unknown Status Message: %d", decoded_msg->data0);
     }
 
-}
-
-void handle_pt1000_message(const DecodedMessage *decoded_msg){
-    
-    int16_t pt1000  = decoded_msg->data0;
-
-    
-
-    if (pt1000 == -1){
-        if (lvgl_lock(LVGL_LOCK_WAIT_TIME))
-    {
-            lv_textarea_set_text(ui_PT1000TextArea, "-  ");
-            lvgl_unlock();
-    }
-
-    xSemaphoreTake(data_mutex, portMAX_DELAY);
-    shared_sensor_data.pt1000 = pt1000;
-    xSemaphoreGive(data_mutex);
-    }
-
-    else{
-        float temp_float = (float)pt1000/10.0 - 50;
-        
-        char temp_buf[32];
-
-        snprintf(temp_buf, 32, "%.1f", temp_float);
-        
+    if (error < sizeof(pump_errors) / sizeof(pump_errors[0]) && pump_errors[error]) {
         if (lvgl_lock(LVGL_LOCK_WAIT_TIME))
         {
-            lv_textarea_set_text(ui_PT1000TextArea, temp_buf);
+            lv_obj_set_style_text_color(ui_ErrorTextArea, lv_color_hex(0xFF0000), LV_PART_MAIN | LV_STATE_DEFAULT);
+            lv_textarea_set_text(ui_ErrorTextArea, pump_errors[error]);
             lvgl_unlock();
         }
-
         xSemaphoreTake(data_mutex, portMAX_DELAY);
-        shared_sensor_data.pt1000 = temp_float;
+        strcpy(shared_sensor_data.status, pump_errors[error]);
         xSemaphoreGive(data_mutex);
+        data_publish(true);
     }
-    
-    
 }
 
-void handle_status_message(const DecodedMessage *decoded_msg){
-    switch (decoded_msg->data0) {
-        case PUMP_RUNNING:
-            if (lvgl_lock(LVGL_LOCK_WAIT_TIME))
-            {
-                lv_obj_set_style_text_color(ui_ErrorTextArea, lv_color_hex(0xFFFFFF), LV_PART_MAIN | LV_STATE_DEFAULT);
-                lv_obj_set_style_border_color(ui_ErrorPanel, lv_color_hex(0x003F5A), LV_PART_MAIN | LV_STATE_DEFAULT);
-
-                lv_textarea_set_text(ui_ErrorTextArea, "Running");
-                lvgl_unlock();
-            }
-            ESP_LOGW(TAG, "Pump Running");
-            xSemaphoreTake(data_mutex, portMAX_DELAY);
-            strcpy(shared_sensor_data.status, "Pump Running");
-            //ESP_LOGW(TAG, "string: %s", shared_sensor_data.status);
-            xSemaphoreGive(data_mutex);
-            publish_data();
-
-            break;
-        case PUMP_PURGING:
-            if (lvgl_lock(LVGL_LOCK_WAIT_TIME))
-            {
-                lv_obj_set_style_text_color(ui_ErrorTextArea, lv_color_hex(0xFFFFFF), LV_PART_MAIN | LV_STATE_DEFAULT);
-                lv_obj_set_style_border_color(ui_ErrorPanel, lv_color_hex(0x003F5A), LV_PART_MAIN | LV_STATE_DEFAULT);
-
-                lv_textarea_set_text(ui_ErrorTextArea, "Purging..");
-                lvgl_unlock();
-            }
-            xSemaphoreTake(data_mutex, portMAX_DELAY);
-            strcpy(shared_sensor_data.status, "Pump Purging");
-            xSemaphoreGive(data_mutex);
-            publish_data();
-            break;
-        case PUMP_STOPPED:
-            if (lvgl_lock(LVGL_LOCK_WAIT_TIME))
-            {
-                lv_obj_set_style_text_color(ui_ErrorTextArea, lv_color_hex(0xFFFFFF), LV_PART_MAIN | LV_STATE_DEFAULT);
-                lv_obj_set_style_border_color(ui_ErrorPanel, lv_color_hex(0x003F5A), LV_PART_MAIN | LV_STATE_DEFAULT);
-
-                lv_textarea_set_text(ui_ErrorTextArea, "Stopped");
-                lvgl_unlock();
-            }
-            xSemaphoreTake(data_mutex, portMAX_DELAY);
-            strcpy(shared_sensor_data.status, "Pump Stopped");
-            xSemaphoreGive(data_mutex);
-            publish_data();
-            break;
-        case PUMP_WAITING_TO_START:
-            if (lvgl_lock(LVGL_LOCK_WAIT_TIME))
-            {
-                lv_obj_set_style_text_color(ui_ErrorTextArea, lv_color_hex(0xFFFFFF), LV_PART_MAIN | LV_STATE_DEFAULT);
-                lv_obj_set_style_border_color(ui_ErrorPanel, lv_color_hex(0x003F5A), LV_PART_MAIN | LV_STATE_DEFAULT);
-
-                lv_textarea_set_text(ui_ErrorTextArea, "Waiting");
-                lvgl_unlock();
-            }
-            xSemaphoreTake(data_mutex, portMAX_DELAY);
-            strcpy(shared_sensor_data.status, "Pump Waiting");
-            xSemaphoreGive(data_mutex);
-            publish_data();
-            break;
-        case AUTO_ROUTINE_CHECKING:
-            if (lvgl_lock(LVGL_LOCK_WAIT_TIME))
-            {
-                lv_obj_set_style_text_color(ui_ErrorTextArea, lv_color_hex(0xFFFFFF), LV_PART_MAIN | LV_STATE_DEFAULT);
-                lv_obj_set_style_border_color(ui_ErrorPanel, lv_color_hex(0x003F5A), LV_PART_MAIN | LV_STATE_DEFAULT);
-
-                lv_textarea_set_text(ui_ErrorTextArea, "Auto Run");
-                lvgl_unlock();
-            }
-            xSemaphoreTake(data_mutex, portMAX_DELAY);
-            strcpy(shared_sensor_data.status, "Auto: Running");
-            xSemaphoreGive(data_mutex);
-            publish_data();
-            break;
-        case AUTO_ROUTINE_FILLING:
-            if (lvgl_lock(LVGL_LOCK_WAIT_TIME))
-            {
-                lv_obj_set_style_text_color(ui_ErrorTextArea, lv_color_hex(0xFFFFFF), LV_PART_MAIN | LV_STATE_DEFAULT);
-                lv_obj_set_style_border_color(ui_ErrorPanel, lv_color_hex(0x003F5A), LV_PART_MAIN | LV_STATE_DEFAULT);
-
-                lv_textarea_set_text(ui_ErrorTextArea, "Filling");
-                lvgl_unlock();
-            }
-            xSemaphoreTake(data_mutex, portMAX_DELAY);
-            strcpy(shared_sensor_data.status, "Auto: Filling");
-            xSemaphoreGive(data_mutex);
-            publish_data();
-            break;
-        case AUTO_ROUTINE_PURGING:
-            if (lvgl_lock(LVGL_LOCK_WAIT_TIME))
-            {
-                lv_obj_set_style_text_color(ui_ErrorTextArea, lv_color_hex(0xFFFFFF), LV_PART_MAIN | LV_STATE_DEFAULT);
-                lv_obj_set_style_border_color(ui_ErrorPanel, lv_color_hex(0x003F5A), LV_PART_MAIN | LV_STATE_DEFAULT);
-
-                lv_textarea_set_text(ui_ErrorTextArea, "Purging");
-                lvgl_unlock();
-            }
-            xSemaphoreTake(data_mutex, portMAX_DELAY);
-            strcpy(shared_sensor_data.status, "Auto: Purging");
-            xSemaphoreGive(data_mutex);
-            publish_data();
-
-            break;
-
-        case AUTO_ROUTINE_VERIFYING:
-            if (lvgl_lock(LVGL_LOCK_WAIT_TIME))
-            {
-                lv_obj_set_style_text_color(ui_ErrorTextArea, lv_color_hex(0xFFFFFF), LV_PART_MAIN | LV_STATE_DEFAULT);
-                lv_obj_set_style_border_color(ui_ErrorPanel, lv_color_hex(0x003F5A), LV_PART_MAIN | LV_STATE_DEFAULT);
-
-                lv_textarea_set_text(ui_ErrorTextArea, "Verifying");
-                lvgl_unlock();
-            }
-            xSemaphoreTake(data_mutex, portMAX_DELAY);
-            strcpy(shared_sensor_data.status, "Auto: Verifying");
-            xSemaphoreGive(data_mutex);
-            publish_data();
-            break;
-
-        case PUMP_ERROR:
-            if (lvgl_lock(LVGL_LOCK_WAIT_TIME))
-            {
-                lv_obj_set_style_border_color(ui_ErrorPanel, lv_color_hex(0xFF0000), LV_PART_MAIN | LV_STATE_DEFAULT);
-                lvgl_unlock();
-            }
-            vTaskDelay(20/ portTICK_PERIOD_MS);
-            publish_data();
-            break;
-        
-        
-        default:
-            ESP_LOGW(TAG, "Unknown Status Message: %d", decoded_msg->data0);
-            break;
-    }
-
-    switch (decoded_msg->data1) {
-        case FILL_ERROR:
-            if (lvgl_lock(LVGL_LOCK_WAIT_TIME))
-            {
-                lv_obj_set_style_text_color(ui_ErrorTextArea, lv_color_hex(0xFF0000), LV_PART_MAIN | LV_STATE_DEFAULT);
-                lv_textarea_set_text(ui_ErrorTextArea, "Fill Error");
-                lvgl_unlock();
-            }
-            xSemaphoreTake(data_mutex, portMAX_DELAY);
-            strcpy(shared_sensor_data.status, "Fill Error");
-            xSemaphoreGive(data_mutex);
-            break;
-
-        case COMM_ERROR:
-            if (lvgl_lock(LVGL_LOCK_WAIT_TIME))
-            {
-                lv_obj_set_style_text_color(ui_ErrorTextArea, lv_color_hex(0xFF0000), LV_PART_MAIN | LV_STATE_DEFAULT);
-                lv_textarea_set_text(ui_ErrorTextArea, "Comm Error");
-                lvgl_unlock();
-            }
+void handle_system_message(const DecodedMessage *decoded_msg){
 
-            xSemaphoreTake(data_mutex, portMAX_DELAY);
-            strcpy(shared_sensor_data.status, "Comm Error");
-            xSemaphoreGive(data_mutex);
-            break;
+    if (decoded_msg->data0 == WAKE_UP) {
+        return;
     }
 
-}
-
-void handle_system_message(const DecodedMessage *decoded_msg){
-
-    esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_ALL);
-    ESP_ERROR_CHECK(esp_sleep_enable_ext0_wakeup(UART1_RXD, 1));
-    gpio_pulldown_en(UART1_RXD);
-    
+    // Publishes what's queued, saves the state and powers the modem down first
     ESP_LOGE(TAG, "Sleep message recieved, goodnight...");
-    vTaskDelay( 3000 / portTICK_PERIOD_MS);
-    //maybe send a 'am sleeping message to cloud'
-    esp_deep_sleep_start();
+    deep_sleep_request();
 
 }
 
@@ -36,7 +36,11 @@ typedef struct {
     bool out2;
     bool npn1;
     bool npn2;
-
+    // sensor_state_t (filter.h); while not SENSOR_OK the value above is the last good one
+    uint8_t int_tank_state;
+    uint8_t ext_tank_state;
+    uint8_t aux_tank_state;
+    uint8_t pt1000_state;
 
 } sensor_data_t;
 
@@ -57,27 +61,30 @@ typedef struct {
 
 
 
+#define DATA_FRAME_IDS  MSG_ID_SYSTEM   // Master frames kept for a redraw after deep sleep: ids below this
+
+
+
 // Queue and Semaphore Handles
 extern QueueHandle_t message_queue;
 extern SemaphoreHandle_t message_semaphore;
 
-// Function to decode a UART message
-void decode_uart_message(const char *input_message, DecodedMessage *decoded_msg);
-
-// Function to handle messages based on their ID
+// A decoded frame (protocol_decode) to its handler in MSG_IDS
 void handle_message(const DecodedMessage *decoded_msg);
 
-// Handle Functions
-void handle_bme280_message(const DecodedMessage *decoded_msg);
+// The latest frame of each id below DATA_FRAME_IDS; BIT(id) is set in the result for the ones seen
+uint32_t data_last_frames(DecodedMessage frames[DATA_FRAME_IDS]);
+
+// Redraw the dashboard from data_last_frames() kept over deep sleep, without publishing them
+void data_replay(const DecodedMessage frames[DATA_FRAME_IDS], uint32_t seen);
+
+// Handlers, by MSG_IDS (message_ids.h)
+void handle_none(const DecodedMessage *decoded_msg);
+void handle_channels(const DecodedMessage *decoded_msg);       // The PROTOCOL_ channels of the message
 void handle_tank_message(const DecodedMessage *decoded_msg);
 void handle_mode_message(const DecodedMessage *decoded_msg);
 void handle_comms_message(const DecodedMessage *decoded_msg);
 void handle_outputs_message(const DecodedMessage *decoded_msg);
-void handle_batt_message(const DecodedMessage *decoded_msg);
-void handle_analog_out_message(const DecodedMessage *decoded_msg);
-void handle_420_inputs_message(const DecodedMessage *decoded_msg);
-void handle_analog_inputs_message(const DecodedMessage *decoded_msg);
-void handle_pt1000_message(const DecodedMessage *decoded_msg);
 void handle_status_message(const DecodedMessage *decoded_msg);
 void handle_system_message(const DecodedMessage *decoded_msg);
 
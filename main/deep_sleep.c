@@ -0,0 +1,164 @@
+#include <stddef.h>
+#include "deep_sleep.h"
+#include "main.h"
+#include "pin_map.h"
+#include "data.h"
+#include "gnss.h"
+#include "history.h"
+#include "mqtt.h"
+#include "modem.h"
+#include "pppos.h"
+#include "publish.h"
+#include "esp_attr.h"
+#include "esp_rom_crc.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "driver/rtc_io.h"
+
+
+static const char *TAG = "SLEEP";
+
+#define DEEP_SLEEP_MAGIC    0x534c5031  // "SLP1"
+
+// What the dashboard and the first publish after waking need
+typedef struct {
+    uint32_t magic;                     // DEEP_SLEEP_MAGIC until deep_sleep_resume() took it
+    uint16_t version;                   // DEEP_SLEEP_STATE_VERSION
+    uint16_t size;                      // sizeof(deep_sleep_state_t)
+    uint32_t frames_seen;               // BIT(message id) of the valid frames[]
+    DecodedMessage frames[DATA_FRAME_IDS];
+    sensor_data_t sensors;
+    GNSSLocation gnss;
+    shared_settings_t settings;
+    uint32_t crc;                       // esp_rom_crc32_le() of everything above
+} deep_sleep_state_t;
+
+// RTC slow memory: zeroed on power on, kept over deep sleep
+RTC_DATA_ATTR static deep_sleep_state_t rtc_state;
+RTC_DATA_ATTR static uint32_t rtc_sleeps;
+
+static bool requested = false;
+static bool resumed = false;
+static portMUX_TYPE request_lock = portMUX_INITIALIZER_UNLOCKED;
+
+
+static uint32_t state_crc(const deep_sleep_state_t *s) {
+    return esp_rom_crc32_le(0, (const uint8_t *)s, offsetof(deep_sleep_state_t, crc));
+}
+
+static void save_state(void) {
+    deep_sleep_state_t *s = &rtc_state;
+
+    s->magic = DEEP_SLEEP_MAGIC;
+    s->version = DEEP_SLEEP_STATE_VERSION;
+    s->size = sizeof(deep_sleep_state_t);
+    s->frames_seen = data_last_frames(s->frames);
+
+    xSemaphoreTake(data_mutex, portMAX_DELAY);
+    s->sensors = shared_sensor_data;
+    xSemaphoreGive(data_mutex);
+
+    xSemaphoreTake(gnss_mutex, portMAX_DELAY);
+    s->gnss = shared_gnss_data;
+    xSemaphoreGive(gnss_mutex);
+
+    mqtt_settings_get(&s->settings);
+    s->crc = state_crc(s);
+}
+
+bool deep_sleep_resume(void) {
+    deep_sleep_state_t *s = &rtc_state;
+
+    // A reset or power on, not a wake: RTC memory has nothing for us
+    if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_UNDEFINED) {
+        return false;
+    }
+    if (s->magic != DEEP_SLEEP_MAGIC || s->version != DEEP_SLEEP_STATE_VERSION ||
+        s->size != sizeof(deep_sleep_state_t) || s->crc != state_crc(s)) {
+        ESP_LOGW(TAG, "⚠️ Woke without a saved state, starting fresh");
+        return false;
+    }
+
+    xSemaphoreTake(data_mutex, portMAX_DELAY);
+    shared_sensor_data = s->sensors;
+    xSemaphoreGive(data_mutex);
+
+    xSemaphoreTake(gnss_mutex, portMAX_DELAY);
+    shared_gnss_data = s->gnss;
+    xSemaphoreGive(gnss_mutex);
+
+    mqtt_settings_restore(&s->settings);
+
+    // Used once: a later wake must come with a state saved for it
+    s->magic = 0;
+    resumed = true;
+
+    ESP_LOGI(TAG, "☀️ Woke from deep sleep #%lu, %d frames to redraw", (unsigned long)rtc_sleeps,
+             __builtin_popcount(s->frames_seen));
+    return true;
+}
+
+bool deep_sleep_resumed(void) {
+    return resumed;
+}
+
+void deep_sleep_replay(void) {
+    if (resumed) {
+        data_replay(rtc_state.frames, rtc_state.frames_seen);
+    }
+}
+
+
+// ===== Going to sleep =====
+
+// The AT transport publishes synchronously; esp-mqtt only queues
+static void wait_pubacks(void) {
+    int64_t until = esp_timer_get_time() + (int64_t)DEEP_SLEEP_PUBACK_MS * 1000;
+
+    while (pppos_mqtt_inflight() > 0 && esp_timer_get_time() < until) {
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+    if (pppos_mqtt_inflight() > 0) {
+        ESP_LOGW(TAG, "⚠️ %d publishes still without a PUBACK", pppos_mqtt_inflight());
+    }
+}
+
+static void sleep_task(void *param) {
+    int64_t start = esp_timer_get_time();
+    ESP_LOGW(TAG, "💤 Preparing for deep sleep");
+
+    bool published = publish_drain("sleep", DEEP_SLEEP_DRAIN_MS);
+    if (published) {
+        wait_pubacks();
+    } else {
+        ESP_LOGW(TAG, "⚠️ Sleeping with samples unpublished");
+    }
+
+    // After the drain: the last readings are in the "sleep" sample too
+    save_state();
+    history_save();
+    modem_shutdown();
+    gpio_set_level(LCD_LED, 0);
+
+    // The master's TX idles high again when it wakes
+    esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_ALL);
+    rtc_gpio_pullup_dis(UART1_RXD);
+    rtc_gpio_pulldown_en(UART1_RXD);
+    ESP_ERROR_CHECK(esp_sleep_enable_ext0_wakeup(UART1_RXD, 1));
+
+    rtc_sleeps++;
+    ESP_LOGW(TAG, "💤 Deep sleep #%lu after %lld ms of shutdown, goodnight...", (unsigned long)rtc_sleeps,
+             (long long)((esp_timer_get_time() - start) / 1000));
+    esp_deep_sleep_start();
+}
+
+void deep_sleep_request(void) {
+    taskENTER_CRITICAL(&request_lock);
+    bool first = !requested;
+    requested = true;
+    taskEXIT_CRITICAL(&request_lock);
+
+    if (first) {
+        xTaskCreate(sleep_task, "deep_sleep", 2048*4, NULL, 5, NULL);
+    }
+}
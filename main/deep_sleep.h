@@ -0,0 +1,41 @@
+#ifndef DEEP_SLEEP_H
+#define DEEP_SLEEP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// ===== Configuration =====
+
+#define DEEP_SLEEP_DRAIN_MS     20000   // Queued samples and the "sleep" event going out
+#define DEEP_SLEEP_PUBACK_MS    5000    // Then their PUBACKs (PPPoS)
+#define DEEP_SLEEP_STATE_VERSION 2      // Bump when deep_sleep_state_t changes
+
+
+// Asks the master's GO_SLEEP to be carried out, from a task of its own: publishes
+// what's queued with a last "sleep" event, keeps the readings and settings in
+// RTC memory, powers the modem off and sleeps until UART1_RXD goes high.
+// Further calls do nothing
+void deep_sleep_request(void);
+
+// Early in app_main, after nvs_flash_init(): true if we woke from deep sleep
+// with the state saved before it. The sensor, GNSS and settings caches are
+// back then; mqtt_settings_load() isn't needed
+bool deep_sleep_resume(void);
+
+// deep_sleep_resume() returned true: the display task skips the splash
+bool deep_sleep_resumed(void);
+
+// Redraw the dashboard from before the sleep. Takes the LVGL lock itself
+void deep_sleep_replay(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DEEP_SLEEP_H
@@ -0,0 +1,357 @@
+#include <string.h>
+#include "diag.h"
+#include "main.h"
+#include "modem.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "cJSON.h"
+#include "trace.h"
+#if DIAG_CONSOLE
+#include "esp_console.h"
+#endif
+
+
+static const char *TAG = "DIAG";
+
+static diag_snapshot_t snapshot;        // The latest sample, under snapshot_mutex
+static SemaphoreHandle_t snapshot_mutex = NULL;
+
+static diag_queue_t queues[DIAG_QUEUES_MAX];
+static uint8_t queue_count = 0;
+static portMUX_TYPE queues_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Only diag_task touches these: run time counters as of the previous sample
+static TaskStatus_t status[DIAG_TASKS_MAX];
+static struct {
+    TaskHandle_t handle;
+    uint32_t run_time;
+} prev_run[DIAG_TASKS_MAX];
+static int prev_count = 0;
+static uint32_t prev_total = 0;
+
+static char payload[DIAG_PAYLOAD_MAX];    // diag_task's MQTT_TOPIC_DIAG payload
+
+
+void diag_queue_register(const char *name, QueueHandle_t queue) {
+    if (queue == NULL) {
+        return;
+    }
+
+    taskENTER_CRITICAL(&queues_lock);
+    bool added = queue_count < DIAG_QUEUES_MAX;
+    if (added) {
+        queues[queue_count++] = (diag_queue_t){
+            .name = name,
+            .queue = queue,
+            .length = uxQueueMessagesWaiting(queue) + uxQueueSpacesAvailable(queue),
+        };
+    }
+    taskEXIT_CRITICAL(&queues_lock);
+
+    if (!added) {
+        ESP_LOGW(TAG, "⚠️ No room for queue %s, raise DIAG_QUEUES_MAX", name);
+    }
+}
+
+
+// ===== Sampling =====
+
+static uint32_t prev_run_time(TaskHandle_t handle) {
+    for (int i = 0; i < prev_count; i++) {
+        if (prev_run[i].handle == handle) {
+            return prev_run[i].run_time;
+        }
+    }
+    return 0;       // Started since the last sample
+}
+
+static void sample_tasks(diag_snapshot_t *snap) {
+    uint32_t total = 0;
+    UBaseType_t count = uxTaskGetSystemState(status, DIAG_TASKS_MAX, &total);
+    if (count == 0) {
+        ESP_LOGW(TAG, "⚠️ %u tasks, more than DIAG_TASKS_MAX", (unsigned)uxTaskGetNumberOfTasks());
+        return;
+    }
+
+    // The total is wall time: a task busy on one core gets 1000
+    uint32_t span = total - prev_total;
+    prev_total = total;
+
+    snap->task_count = 0;
+    for (UBaseType_t i = 0; i < count; i++) {
+        const TaskStatus_t *t = &status[i];
+        uint32_t ran = t->ulRunTimeCounter - prev_run_time(t->xHandle);
+
+        diag_task_t *d = &snap->tasks[snap->task_count++];
+        strlcpy(d->name, t->pcTaskName, sizeof(d->name));
+        d->priority = t->uxCurrentPriority;
+#if CONFIG_FREERTOS_VTASKLIST_INCLUDE_COREID
+        d->core = t->xCoreID == tskNO_AFFINITY ? -1 : (int8_t)t->xCoreID;
+#else
+        d->core = -1;
+#endif
+        d->cpu_permille = span ? (uint16_t)((uint64_t)ran * 1000 / span) : 0;
+        d->stack_free_min = t->usStackHighWaterMark * sizeof(StackType_t);
+    }
+
+    for (UBaseType_t i = 0; i < count; i++) {
+        prev_run[i].handle = status[i].xHandle;
+        prev_run[i].run_time = status[i].ulRunTimeCounter;
+    }
+    prev_count = count;
+
+    // Busiest first
+    for (int i = 1; i < snap->task_count; i++) {
+        diag_task_t t = snap->tasks[i];
+        int j = i;
+        while (j > 0 && snap->tasks[j - 1].cpu_permille < t.cpu_permille) {
+            snap->tasks[j] = snap->tasks[j - 1];
+            j--;
+        }
+        snap->tasks[j] = t;
+    }
+}
+
+static void sample_heap(diag_heap_t *heap, uint32_t caps) {
+    heap->free = heap_caps_get_free_size(caps);
+    heap->min_free = heap_caps_get_minimum_free_size(caps);
+    heap->largest = heap_caps_get_largest_free_block(caps);
+}
+
+static void sample_queues(diag_snapshot_t *snap) {
+    taskENTER_CRITICAL(&queues_lock);
+    for (int i = 0; i < queue_count; i++) {
+        diag_queue_t *q = &queues[i];
+        q->waiting = uxQueueMessagesWaiting(q->queue);
+        if (q->waiting > q->peak) {
+            q->peak = q->waiting;
+        }
+    }
+    snap->queue_count = queue_count;
+    memcpy(snap->queues, queues, sizeof(queues[0]) * queue_count);
+    taskEXIT_CRITICAL(&queues_lock);
+}
+
+static void sample(void) {
+    xSemaphoreTake(snapshot_mutex, portMAX_DELAY);
+    snapshot.uptime_us = esp_timer_get_time();
+    snapshot.samples++;
+    sample_tasks(&snapshot);
+    sample_heap(&snapshot.internal, MALLOC_CAP_INTERNAL);
+    sample_heap(&snapshot.dma, MALLOC_CAP_DMA);
+    sample_queues(&snapshot);
+    xSemaphoreGive(snapshot_mutex);
+}
+
+bool diag_get(diag_snapshot_t *out) {
+    if (snapshot_mutex == NULL) {
+        return false;
+    }
+    xSemaphoreTake(snapshot_mutex, portMAX_DELAY);
+    *out = snapshot;
+    xSemaphoreGive(snapshot_mutex);
+    return out->samples > 0;
+}
+
+
+// ===== Output =====
+
+static cJSON *heap_json(const diag_heap_t *heap) {
+    cJSON *obj = cJSON_CreateObject();
+    cJSON_AddNumberToObject(obj, "free", heap->free);
+    cJSON_AddNumberToObject(obj, "min", heap->min_free);
+    cJSON_AddNumberToObject(obj, "largest", heap->largest);
+    return obj;
+}
+
+int diag_json(const diag_snapshot_t *snap, char *buf, size_t size) {
+    cJSON *root = cJSON_CreateObject();
+    if (root == NULL) {
+        return -1;
+    }
+
+    cJSON_AddNumberToObject(root, "uptime_s", (double)(snap->uptime_us / 1000000));
+    cJSON_AddNumberToObject(root, "sample_ms", DIAG_SAMPLE_MS);
+
+    // Rows, not objects: a name per field per task would double the payload
+    cJSON_AddStringToObject(root, "task_fields", "name,cpu_permille,stack_free_min,prio,core");
+    cJSON *tasks = cJSON_AddArrayToObject(root, "tasks");
+    for (int i = 0; i < snap->task_count; i++) {
+        const diag_task_t *t = &snap->tasks[i];
+        cJSON *row = cJSON_CreateArray();
+        cJSON_AddItemToArray(row, cJSON_CreateString(t->name));
+        cJSON_AddItemToArray(row, cJSON_CreateNumber(t->cpu_permille));
+        cJSON_AddItemToArray(row, cJSON_CreateNumber(t->stack_free_min));
+        cJSON_AddItemToArray(row, cJSON_CreateNumber(t->priority));
+        cJSON_AddItemToArray(row, cJSON_CreateNumber(t->core));
+        cJSON_AddItemToArray(tasks, row);
+    }
+
+    cJSON *heap = cJSON_AddObjectToObject(root, "heap");
+    cJSON_AddItemToObject(heap, "internal", heap_json(&snap->internal));
+    cJSON_AddItemToObject(heap, "dma", heap_json(&snap->dma));
+
+    cJSON *queue_obj = cJSON_AddObjectToObject(root, "queues");
+    for (int i = 0; i < snap->queue_count; i++) {
+        const diag_queue_t *q = &snap->queues[i];
+        cJSON *obj = cJSON_CreateObject();
+        cJSON_AddNumberToObject(obj, "len", q->length);
+        cJSON_AddNumberToObject(obj, "waiting", q->waiting);
+        cJSON_AddNumberToObject(obj, "peak", q->peak);
+        cJSON_AddItemToObject(queue_obj, q->name, obj);
+    }
+
+    bool ok = cJSON_PrintPreallocated(root, buf, size, false);
+    cJSON_Delete(root);
+    return ok ? (int)strlen(buf) : -1;
+}
+
+static void print_tasks(const diag_snapshot_t *snap) {
+    printf("%-16s %6s %8s %4s %4s\n", "task", "cpu%", "stack", "prio", "core");
+    for (int i = 0; i < snap->task_count; i++) {
+        const diag_task_t *t = &snap->tasks[i];
+        printf("%-16s %4u.%u %8lu %4u %4d%s\n", t->name, t->cpu_permille / 10, t->cpu_permille % 10,
+               (unsigned long)t->stack_free_min, t->priority, t->core,
+               t->stack_free_min < DIAG_STACK_WARN_BYTES ? "  <- low" : "");
+    }
+}
+
+static void print_heap(const diag_snapshot_t *snap) {
+    printf("%-8s %8s %8s %8s\n", "heap", "free", "min", "largest");
+    printf("%-8s %8lu %8lu %8lu\n", "internal", (unsigned long)snap->internal.free,
+           (unsigned long)snap->internal.min_free, (unsigned long)snap->internal.largest);
+    printf("%-8s %8lu %8lu %8lu\n", "dma", (unsigned long)snap->dma.free,
+           (unsigned long)snap->dma.min_free, (unsigned long)snap->dma.largest);
+}
+
+static void print_queues(const diag_snapshot_t *snap) {
+    printf("%-16s %4s %7s %4s\n", "queue", "len", "waiting", "peak");
+    for (int i = 0; i < snap->queue_count; i++) {
+        const diag_queue_t *q = &snap->queues[i];
+        printf("%-16s %4u %7u %4u\n", q->name, q->length, q->waiting, q->peak);
+    }
+}
+
+// Warnings only, the rest is on the console and MQTT_TOPIC_DIAG
+static void diag_log(const diag_snapshot_t *snap) {
+    ESP_LOGI(TAG, "🩺 internal heap %lu B free, %lu B at worst, largest block %lu B",
+             (unsigned long)snap->internal.free, (unsigned long)snap->internal.min_free,
+             (unsigned long)snap->internal.largest);
+    for (int i = 0; i < snap->task_count; i++) {
+        const diag_task_t *t = &snap->tasks[i];
+        if (t->stack_free_min < DIAG_STACK_WARN_BYTES) {
+            ESP_LOGW(TAG, "⚠️ %s: only %lu B of stack never used", t->name, (unsigned long)t->stack_free_min);
+        }
+    }
+}
+
+
+// ===== Console =====
+
+#if DIAG_CONSOLE
+static int diag_cmd(int argc, char **argv) {
+    // Too big for the console task's stack, and not diag_task's
+    static diag_snapshot_t snap;
+    static char json[DIAG_PAYLOAD_MAX];
+    if (!diag_get(&snap)) {
+        printf("No sample yet, one every %d ms\n", DIAG_SAMPLE_MS);
+        return 1;
+    }
+
+    const char *what = argc > 1 ? argv[1] : "all";
+    bool all = strcmp(what, "all") == 0;
+
+    if (strcmp(what, "json") == 0) {
+        if (diag_json(&snap, json, sizeof(json)) < 0) {
+            printf("Doesn't fit in DIAG_PAYLOAD_MAX\n");
+            return 1;
+        }
+        printf("%s\n", json);
+        return 0;
+    }
+    if (!all && strcmp(what, "tasks") && strcmp(what, "heap") && strcmp(what, "queues")) {
+        printf("Unknown: %s\n", what);
+        return 1;
+    }
+
+    printf("Sample %lu at %lld s\n", (unsigned long)snap.samples, (long long)(snap.uptime_us / 1000000));
+    if (all || strcmp(what, "tasks") == 0) {
+        print_tasks(&snap);
+    }
+    if (all || strcmp(what, "heap") == 0) {
+        print_heap(&snap);
+    }
+    if (all || strcmp(what, "queues") == 0) {
+        print_queues(&snap);
+    }
+    return 0;
+}
+
+static void console_start(void) {
+    esp_console_repl_t *repl = NULL;
+    esp_console_repl_config_t repl_config = ESP_CONSOLE_REPL_CONFIG_DEFAULT();
+    repl_config.prompt = "tank>";
+    esp_console_dev_uart_config_t uart_config = ESP_CONSOLE_DEV_UART_CONFIG_DEFAULT();
+
+    esp_err_t err = esp_console_new_repl_uart(&uart_config, &repl_config, &repl);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "❌ Console failed: %s", esp_err_to_name(err));
+        return;
+    }
+    esp_console_register_help_command();
+
+    const esp_console_cmd_t cmd = {
+        .command = "diag",
+        .help = "Task CPU and stack, heap and queue use, from the latest sample",
+        .hint = "[all|tasks|heap|queues|json]",
+        .func = diag_cmd,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+#if TRACE_CONSOLE
+    trace_console_register();
+#endif
+    ESP_ERROR_CHECK(esp_console_start_repl(repl));
+}
+#endif
+
+
+// ===== Task =====
+
+void diag_task(void *param) {
+    snapshot_mutex = xSemaphoreCreateMutex();
+#if DIAG_CONSOLE
+    console_start();
+#endif
+
+    TickType_t last_publish = xTaskGetTickCount();
+    static diag_snapshot_t snap;
+
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(DIAG_SAMPLE_MS));
+        sample();
+        if (xEventGroupGetBits(systemEvents) & MQTT_INIT) {
+            trace_publish_crash();
+        }
+
+        if (DIAG_PUBLISH_MS == 0 || xTaskGetTickCount() - last_publish < pdMS_TO_TICKS(DIAG_PUBLISH_MS)) {
+            continue;
+        }
+        last_publish = xTaskGetTickCount();
+
+        diag_get(&snap);
+        diag_log(&snap);
+        if (!(xEventGroupGetBits(systemEvents) & MQTT_INIT)) {
+            continue;
+        }
+
+        int len = diag_json(&snap, payload, sizeof(payload));
+        if (len < 0) {
+            ESP_LOGW(TAG, "⚠️ Diagnostics don't fit in DIAG_PAYLOAD_MAX");
+        } else if (!sim7600_mqtt_publish_bytes(MQTT_TOPIC_DIAG, payload, len)) {
+            ESP_LOGW(TAG, "⚠️ Diagnostics not published");
+        }
+    }
+}
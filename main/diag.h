@@ -0,0 +1,76 @@
+#ifndef DIAG_H
+#define DIAG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// ===== Configuration =====
+
+#define DIAG_SAMPLE_MS          10000           // CPU % is over this long
+#define DIAG_PUBLISH_MS         (15 * 60 * 1000)    // On MQTT_TOPIC_DIAG, 0: never
+#define DIAG_TASKS_MAX          32
+#define DIAG_QUEUES_MAX         8
+#define DIAG_PAYLOAD_MAX        2048
+#define DIAG_STACK_WARN_BYTES   512             // Log tasks with less than this never touched
+#define DIAG_CONSOLE            1               // `diag` command on the UART0 console
+
+
+typedef struct {
+    char name[configMAX_TASK_NAME_LEN];
+    uint8_t priority;
+    int8_t core;                        // -1: not pinned
+    uint16_t cpu_permille;              // Of one core, over the last DIAG_SAMPLE_MS
+    uint32_t stack_free_min;            // Bytes of stack never used since the task started
+} diag_task_t;
+
+typedef struct {
+    uint32_t free;
+    uint32_t min_free;                  // Since boot
+    uint32_t largest;                   // Biggest block malloc could hand out now
+} diag_heap_t;
+
+typedef struct {
+    const char *name;
+    QueueHandle_t queue;
+    uint16_t length;
+    uint16_t waiting;
+    uint16_t peak;                      // Most seen waiting at a sample
+} diag_queue_t;
+
+typedef struct {
+    int64_t uptime_us;
+    uint32_t samples;
+    uint8_t task_count;
+    diag_task_t tasks[DIAG_TASKS_MAX];
+    diag_heap_t internal;
+    diag_heap_t dma;
+    uint8_t queue_count;
+    diag_queue_t queues[DIAG_QUEUES_MAX];
+} diag_snapshot_t;
+
+
+// Where a queue is created: its occupancy goes into every sample
+void diag_queue_register(const char *name, QueueHandle_t queue);
+
+// Samples every DIAG_SAMPLE_MS, publishes every DIAG_PUBLISH_MS while MQTT is up
+void diag_task(void *param);
+
+// The latest sample, false before the first one
+bool diag_get(diag_snapshot_t *out);
+
+// As a compact JSON object, the MQTT_TOPIC_DIAG payload. Length, or -1 if it didn't fit
+int diag_json(const diag_snapshot_t *snap, char *buf, size_t size);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DIAG_H
@@ -14,6 +14,12 @@
 #include "driver/ledc.h"
 
 #include "ui.h"
+#include "ui_mem.h"
+#include "ui_glyph_cache.h"
+#include "screens.h"
+#include "blend.h"
+#include "power.h"
+#include "deep_sleep.h"
 
 
 #include "../managed_components\lvgl__lvgl\src\hal\lv_hal_disp.h"
@@ -32,20 +38,19 @@ spi_device_handle_t spi;
 
 
 
-#define LV_TICK_PERIOD_MS 1
-
 void lvgl_unlock(void);
 bool lvgl_lock(TickType_t timeout);
 
 
 
 void run_display_task(void *pvParameter);
-static void lv_tick_task(void *arg);
 
 
 // LVGL is single threaded only - we must maintain a semaphore for access control
 SemaphoreHandle_t xLVGLSemaphore;
 
+static TaskHandle_t display_task = NULL;
+
 
 // reqeust a lock on the lvgl instance. If successful in given timeout, return true
 bool lvgl_lock(TickType_t timeout)
@@ -68,7 +73,40 @@ void lvgl_unlock(void)
 {
     if (xLVGLSemaphore != NULL)
     {
+        // Another task changed the screen or started an animation: the display
+        // task may be waiting out DISPLAY_IDLE_WAIT_MS
+        lv_disp_t *disp = lv_disp_get_default();
+        bool notify = display_task && xTaskGetCurrentTaskHandle() != display_task &&
+                      disp && (disp->inv_p != 0 || lv_anim_count_running() != 0);
+
         xSemaphoreGive(xLVGLSemaphore);
+        if (notify) {
+            xTaskNotifyGive(display_task);
+        }
+    }
+}
+
+
+///////////////////////FLUSH/////////////////////////////
+
+static bool flushing = false;      // POWER_LOCK_DISPLAY held for a flush on the SPI DMA
+
+// The transfer finishes on the SPI interrupt, after this returns
+static void display_flush(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_map)
+{
+    if (!flushing) {
+        power_lock(POWER_LOCK_DISPLAY);
+        flushing = true;
+    }
+    ili9341_flush(drv, area, color_map);
+}
+
+// Called with the LVGL lock held, from the display task
+static void display_flush_done(lv_disp_drv_t *drv)
+{
+    if (flushing && !drv->draw_buf->flushing) {
+        flushing = false;
+        power_unlock(POWER_LOCK_DISPLAY);
     }
 }
 
@@ -97,89 +135,92 @@ void run_display_task(void *pvParameter)
     static lv_disp_drv_t disp_drv;
     lv_disp_drv_init(&disp_drv); /*Basic initialization*/
     disp_drv.draw_buf = &disp_buf1;
-    disp_drv.flush_cb = ili9341_flush;
+    disp_drv.flush_cb = display_flush;
     disp_drv.hor_res = 320;
     disp_drv.ver_res = 240;
     disp_drv.antialiasing = 1;
+    disp_drv.draw_ctx_init = blend_draw_ctx_init;   /*BLEND_BACKEND in blend.h*/
     //disp_drv.full_refresh = 1;
     //disp_drv.rotated = 0;
     
 
-    lv_disp_t *disp = lv_disp_drv_register(&disp_drv);
-
+    lv_disp_drv_register(&disp_drv);
+    display_task = xTaskGetCurrentTaskHandle();
 
 
-    /* Create and start a periodic timer interrupt to call lv_tick_inc */
-    const esp_timer_create_args_t periodic_timer_args = {
-        .callback = &lv_tick_task,
-        .name = "periodic_gui"};
-    esp_timer_handle_t periodic_timer;
-    ESP_ERROR_CHECK(esp_timer_create(&periodic_timer_args, &periodic_timer));
-    ESP_ERROR_CHECK(esp_timer_start_periodic(periodic_timer, LV_TICK_PERIOD_MS * 1000));
 
-
-    
+    // No lv_tick_inc() timer: LV_TICK_CUSTOM reads esp_timer, so nothing wakes
+    // us every millisecond just to count
     
 
-    // call our squareline init func
+    // Back from deep sleep: straight to the dashboard as it was, no splash
+    bool resumed = deep_sleep_resumed();
+
+    // The dashboard now, the splash only when it's shown
     if (lvgl_lock(LVGL_LOCK_WAIT_TIME))
     {
-        ui_init();
+        screens_init();
+        // Readout glyphs stay cached for good: keep them on lv_mem, out of the pools
+        ui_glyph_cache_preload(&lv_font_montserrat_14, UI_GLYPH_ATLAS_CHARS);
+        ui_mem_init();
         ESP_LOGW(TAG, "UI initialized.");
-        //signal that the display is ready
-        xEventGroupSetBits(systemEvents, DISPLAY_INIT);
+        if (resumed) {
+            screens_show(SCREEN_DATA, LV_SCR_LOAD_ANIM_NONE, 0);
+        } else {
+            screens_show(SCREEN_SPLASH, LV_SCR_LOAD_ANIM_NONE, 0);
+            //signal that the display is ready
+            xEventGroupSetBits(systemEvents, DISPLAY_INIT);
+        }
         lvgl_unlock();
     }
-    
-    vTaskDelay(pdMS_TO_TICKS(1000));
 
-   
-    // Call this immediately after unlocking from ui_init()
-    vTaskDelay(pdMS_TO_TICKS(10));  // Give LVGL 1 frame
-    if (lvgl_lock(LVGL_LOCK_WAIT_TIME))
-    {
-        lv_timer_handler();  // Force first render
-        lvgl_unlock();
-    }
-    
-    // Wait 5 secs for splash
-    vTaskDelay(pdMS_TO_TICKS(5000));
+    if (resumed) {
+        // Before master_rx_task starts on DISPLAY_INIT: the saved frames go first
+        deep_sleep_replay();
+        xEventGroupSetBits(systemEvents, DISPLAY_INIT);
+    } else {
+        vTaskDelay(pdMS_TO_TICKS(1000));
 
-    if (lvgl_lock(LVGL_LOCK_WAIT_TIME))
-    {
-        lv_scr_load_anim(ui_DataScreen,               // Target screen
-                        LV_SCR_LOAD_ANIM_MOVE_LEFT,    // Animation type
-                        1000,                         // Duration (ms)
-                        0,                           // Delay
-                        false);                      // Don't delete old screen (optional)
-        lvgl_unlock();
-    }
+        // Call this immediately after unlocking from screens_init()
+        vTaskDelay(pdMS_TO_TICKS(10));  // Give LVGL 1 frame
+        if (lvgl_lock(LVGL_LOCK_WAIT_TIME))
+        {
+            lv_timer_handler();  // Force first render
+            lvgl_unlock();
+        }
 
+        vTaskDelay(pdMS_TO_TICKS(DISPLAY_SPLASH_MS));
 
+        if (lvgl_lock(LVGL_LOCK_WAIT_TIME))
+        {
+            // The splash is deleted once it has slid off
+            screens_show(SCREEN_DATA, LV_SCR_LOAD_ANIM_MOVE_LEFT, DISPLAY_SPLASH_ANIM_MS);
+            lvgl_unlock();
+        }
+    }
 
     while (1)
     {
+        uint32_t wait_ms = DISPLAY_MIN_WAIT_MS;
 
-        /* Delay 1 tick (assumes FreeRTOS tick is 10ms */
-        vTaskDelay(pdMS_TO_TICKS(10));
         // we must lock our lvgl instance before we try and use it
         if (lvgl_lock(LVGL_LOCK_WAIT_TIME))
         {
-            lv_timer_handler();
+            // The refresh timer pauses with nothing invalidated, so this is the next timer due
+            wait_ms = lv_timer_handler();
+            display_flush_done(&disp_drv);
             lvgl_unlock();
-         }
+        }
+
+        if (flushing) {
+            wait_ms = DISPLAY_MIN_WAIT_MS;
+        } else if (wait_ms < DISPLAY_MIN_WAIT_MS) {
+            wait_ms = DISPLAY_MIN_WAIT_MS;
+        } else if (wait_ms > DISPLAY_IDLE_WAIT_MS) {
+            wait_ms = DISPLAY_IDLE_WAIT_MS;
+        }
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait_ms));
     }
 
     vTaskDelete(NULL);
-}
-
-// this task is set to run at an interval, and defines the LVGL tick rate. 
-static void lv_tick_task(void *arg)
-{
-    (void)arg;
-    if (lvgl_lock(LVGL_LOCK_WAIT_TIME))
-    {
-        lv_tick_inc(LV_TICK_PERIOD_MS);
-        lvgl_unlock();
-    }
 }
\ No newline at end of file
@@ -10,6 +10,14 @@
 
 #define LVGL_LOCK_WAIT_TIME (3000 / portTICK_PERIOD_MS)
 
+// Display task pacing: lv_timer_handler() says when it's next needed, within these
+#define DISPLAY_MIN_WAIT_MS     10      // One FreeRTOS tick
+#define DISPLAY_IDLE_WAIT_MS    1000    // No LVGL timer due: other tasks' changes notify the task
+
+// Cold boot: the splash stays this long after its first frame, then the dashboard slides over it
+#define DISPLAY_SPLASH_MS       5000
+#define DISPLAY_SPLASH_ANIM_MS  1000
+
 extern SemaphoreHandle_t xLVGLSemaphore;
 
 void lvgl_unlock(void);
@@ -0,0 +1,146 @@
+#include <string.h>
+#include "filter.h"
+#include "mqtt.h"
+
+
+// Only data_task runs the filters
+typedef struct {
+    int32_t window[FILTER_MEDIAN_MAX];  // Latest raw samples, a ring
+    uint8_t next;
+    uint8_t filled;
+    bool primed;                        // ema_q8 and out hold a sample
+    int32_t ema_q8;                     // 24.8 fixed point
+    int32_t out;
+} filter_state_t;
+
+typedef struct {
+    int32_t median;
+    int32_t ema;
+    int32_t step;
+} filter_config_t;
+
+static filter_state_t states[FILTER_CHANNELS];
+
+static const char *state_names[SENSOR_STATE_COUNT] = {
+    [SENSOR_NO_DATA]    = "no_data",
+    [SENSOR_OK]         = "ok",
+    [SENSOR_OPEN_LOOP]  = "open_loop",
+    [SENSOR_SATURATED]  = "saturated",
+    [SENSOR_OVER_RANGE] = "over_range",
+};
+
+static const char *state_short[SENSOR_STATE_COUNT] = {
+    [SENSOR_NO_DATA]    = "-",
+    [SENSOR_OK]         = "",
+    [SENSOR_OPEN_LOOP]  = "OL",
+    [SENSOR_SATURATED]  = "SAT",
+    [SENSOR_OVER_RANGE] = "OVR",
+};
+
+
+static int32_t clamp(int32_t v, int32_t lo, int32_t hi) {
+    return v < lo ? lo : v > hi ? hi : v;
+}
+
+// The shared attribute if the server set it, else the default
+static int32_t setting_or(const shared_settings_t *s, setting_id_t id, int32_t value, int32_t fallback) {
+    return (s->present & BIT(id)) ? value : fallback;
+}
+
+static void channel_config(filter_channel_t ch, filter_config_t *cfg) {
+    shared_settings_t s;
+    mqtt_settings_get(&s);
+
+    if (ch <= FILTER_AUX_TANK) {
+        cfg->median = setting_or(&s, SETTING_TANK_MEDIAN, s.tank_median, FILTER_TANK_MEDIAN);
+        cfg->ema = setting_or(&s, SETTING_TANK_EMA, s.tank_ema, FILTER_TANK_EMA);
+        cfg->step = setting_or(&s, SETTING_TANK_STEP, s.tank_step, FILTER_TANK_STEP);
+    } else {
+        cfg->median = setting_or(&s, SETTING_TEMP_MEDIAN, s.temp_median, FILTER_TEMP_MEDIAN);
+        cfg->ema = setting_or(&s, SETTING_TEMP_EMA, s.temp_ema, FILTER_TEMP_EMA);
+        cfg->step = setting_or(&s, SETTING_TEMP_STEP, s.temp_step, FILTER_TEMP_STEP);
+    }
+    cfg->median = clamp(cfg->median, 1, FILTER_MEDIAN_MAX);
+    cfg->ema = clamp(cfg->ema, 1, 100);
+    cfg->step = clamp(cfg->step, 1, 1000);
+}
+
+// Of the latest `n` samples; a sort is cheapest at these sizes
+static int32_t median(const filter_state_t *f, int n) {
+    int32_t sorted[FILTER_MEDIAN_MAX];
+
+    if (n > f->filled) {
+        n = f->filled;
+    }
+    for (int i = 0; i < n; i++) {
+        int32_t v = f->window[(f->next + FILTER_MEDIAN_MAX - 1 - i) % FILTER_MEDIAN_MAX];
+        int j = i;
+        while (j > 0 && sorted[j - 1] > v) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = v;
+    }
+    return n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+}
+
+// To the nearest multiple of `step`, halves away from zero
+static int32_t quantise(int32_t v, int32_t step) {
+    return v >= 0 ? (v + step / 2) / step * step : -((-v + step / 2) / step * step);
+}
+
+bool filter_run(filter_channel_t ch, int32_t raw, int32_t *out) {
+    filter_state_t *f = &states[ch];
+    filter_config_t cfg;
+    channel_config(ch, &cfg);
+
+    f->window[f->next] = raw;
+    f->next = (f->next + 1) % FILTER_MEDIAN_MAX;
+    if (f->filled < FILTER_MEDIAN_MAX) {
+        f->filled++;
+    }
+    int32_t m = median(f, cfg.median);
+
+    // Alpha in 1/256: the EMA sits at the first sample rather than ramping up from 0
+    int32_t alpha_q8 = cfg.ema * 256 / 100;
+    if (!f->primed) {
+        f->ema_q8 = m * 256;
+    } else {
+        f->ema_q8 += (int32_t)(((int64_t)m * 256 - f->ema_q8) * alpha_q8 / 256);
+    }
+    int32_t y = (f->ema_q8 + 128) >> 8;
+
+    // Moves only once the EMA is a whole step away: noise around a step edge stays put
+    bool changed = !f->primed;
+    if (!f->primed || (y > f->out ? y - f->out : f->out - y) >= cfg.step) {
+        int32_t q = quantise(y, cfg.step);
+        changed |= q != f->out;
+        f->out = q;
+    }
+    f->primed = true;
+
+    *out = f->out;
+    return changed;
+}
+
+void filter_reset(filter_channel_t ch) {
+    memset(&states[ch], 0, sizeof(states[ch]));
+}
+
+sensor_state_t filter_loop_state(uint16_t centi_ma) {
+    if (centi_ma < FILTER_LOOP_OPEN_CMA) {
+        return SENSOR_OPEN_LOOP;
+    }
+    if (centi_ma > FILTER_LOOP_SAT_CMA) {
+        return SENSOR_SATURATED;
+    }
+    return SENSOR_OK;
+}
+
+const char *sensor_state_str(sensor_state_t state) {
+    return state < SENSOR_STATE_COUNT ? state_names[state] : "?";
+}
+
+const char *sensor_state_short(sensor_state_t state) {
+    return state < SENSOR_STATE_COUNT ? state_short[state] : "?";
+}
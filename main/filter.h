@@ -0,0 +1,70 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// ===== Configuration =====
+
+// Defaults until the server sets the TankMedian/TankEma/TankStep and
+// TempMedian/TempEma/TempStep shared attributes
+#define FILTER_MEDIAN_MAX       9               // Longest median window, samples
+#define FILTER_TANK_MEDIAN      5               // 1: off
+#define FILTER_TANK_EMA         25              // % of each new sample, 100: off
+#define FILTER_TANK_STEP        10              // 0.1 %: the output moves in whole percent
+#define FILTER_TEMP_MEDIAN      3
+#define FILTER_TEMP_EMA         50
+#define FILTER_TEMP_STEP        10              // 0.01 degC
+
+// 4-20 mA loops, in the master's 0.01 mA
+#define FILTER_LOOP_OPEN_CMA    380             // Below 3.8 mA: wire broken or sensor unpowered
+#define FILTER_LOOP_SAT_CMA     2050            // Above 20.5 mA: sensor saturated or shorted
+
+
+typedef enum {
+    FILTER_INT_TANK = 0,                // 0.1 %
+    FILTER_EXT_TANK,
+    FILTER_AUX_TANK,
+    FILTER_PT1000,                      // 0.01 degC
+    FILTER_TEMP,                        // BME280, 0.01 degC
+    FILTER_CHANNELS,
+} filter_channel_t;
+
+// What a reading is worth, published instead of a -1 level
+typedef enum {
+    SENSOR_NO_DATA = 0,                 // Nothing from the master yet, or it has no reading
+    SENSOR_OK,
+    SENSOR_OPEN_LOOP,                   // Loop current below FILTER_LOOP_OPEN_CMA
+    SENSOR_SATURATED,                   // Loop current above FILTER_LOOP_SAT_CMA
+    SENSOR_OVER_RANGE,                  // Current fine, level past 100 %: range or max set wrong
+    SENSOR_STATE_COUNT
+} sensor_state_t;
+
+
+// A raw sample through median, EMA and hysteresis quantisation, all integer.
+// `*out` is the channel's output; true if that changed
+bool filter_run(filter_channel_t ch, int32_t raw, int32_t *out);
+
+// The sensor is faulty: start over once it's back, rather than averaging across
+void filter_reset(filter_channel_t ch);
+
+// State of a 4-20 mA loop from its current
+sensor_state_t filter_loop_state(uint16_t centi_ma);
+
+// "ok", "open_loop", ...
+const char *sensor_state_str(sensor_state_t state);
+
+// A few characters for a readout: "OL", "SAT", ...
+const char *sensor_state_short(sensor_state_t state);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FILTER_H
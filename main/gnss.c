@@ -8,6 +8,8 @@
 #include "data.h"
 #include "mqtt.h"
 #include "publish.h"
+#include "link_health.h"
+#include <sys/time.h>
 
 #define GNSS_TASK_DELAY 2
 static const char *TAG = "GNSS";
@@ -53,6 +55,10 @@ static bool parse_gpsinfo_line(const char *line, GNSSLocation *shared_gnss_data)
 
     time_t timestamp = mktime(&gps_time); // Convert to Unix timestamp (local time)
 
+    // Published samples are stamped with the system clock, which only GNSS sets
+    struct timeval now = { .tv_sec = timestamp };
+    settimeofday(&now, NULL);
+
     
 
     xSemaphoreTake(gnss_mutex, portMAX_DELAY);
@@ -123,13 +129,15 @@ void gnss_task(void *param) {
 
     ESP_LOGW(TAG, "GNSS task started");
 
-    if (!xSemaphoreTake(publish_mutex, pdMS_TO_TICKS(10000))) {
+    // The modem may be in a link recovery, which holds the mutex: wait it out
+    while (!xSemaphoreTake(publish_mutex, pdMS_TO_TICKS(10000))) {
         ESP_LOGW(TAG, "Timeout waiting for publish mutex");
-        esp_restart(); // Restart if mutex not available
+        link_failed("publish mutex");
     }
 
     if (!gnss_power_on()) {
         ESP_LOGE(TAG, "GPS failed to power on");
+        xSemaphoreGive(publish_mutex);
         vTaskDelete(NULL);
     }
     
@@ -147,7 +155,9 @@ void gnss_task(void *param) {
 
          if (!xSemaphoreTake(publish_mutex, pdMS_TO_TICKS(10000))) { //using the publish mutex as a general at send mutex
             ESP_LOGW(TAG, "Timeout waiting for publish mutex");
-            esp_restart(); // Restart if mutex not available
+            link_failed("publish mutex");
+            vTaskDelay(GNSS_TASK_DELAY *60000/ portTICK_PERIOD_MS);
+            continue;
             }
 
         if (gnss_get_location(&shared_gnss_data)) {
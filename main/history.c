@@ -0,0 +1,406 @@
+#include <string.h>
+#include "history.h"
+#include "main.h"
+#include "display.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "lvgl.h"
+#include "screens.h"
+
+
+static const char *TAG = "HISTORY";
+
+typedef int16_t history_row_t[HISTORY_TANKS];
+
+typedef struct {
+    const char *span;                   // Of the whole ring, for the chart title and the summary
+    history_row_t *rows;
+    uint16_t len;
+    uint16_t ratio;                     // Buckets of the tier before per bucket, 0 for the first
+    uint32_t bucket_s;
+    uint16_t head;                      // Next row written
+    uint32_t total;                     // Rows ever written
+    // The bucket being filled
+    int32_t sum[HISTORY_TANKS];
+    uint16_t count[HISTORY_TANKS];
+    uint16_t parts;                     // Buckets of the tier before closed into it
+} history_ring_t;
+
+// The 15 min and 1 h tiers as kept in NVS
+typedef struct {
+    uint16_t version;                   // HISTORY_VERSION
+    uint16_t size;                      // sizeof(history_record_t)
+    struct {
+        uint16_t head;
+        uint32_t total;
+    } ring[2];
+    history_row_t rows1[HISTORY_TIER1_LEN];
+    history_row_t rows2[HISTORY_TIER2_LEN];
+} history_record_t;
+
+static history_row_t rows0[HISTORY_TIER0_LEN];
+static history_row_t rows1[HISTORY_TIER1_LEN];
+static history_row_t rows2[HISTORY_TIER2_LEN];
+
+static history_ring_t tiers[HISTORY_TIERS] = {
+    [HISTORY_1MIN]  = { .span = "2h",  .rows = rows0, .len = HISTORY_TIER0_LEN,
+                        .bucket_s = HISTORY_TIER0_S },
+    [HISTORY_15MIN] = { .span = "24h", .rows = rows1, .len = HISTORY_TIER1_LEN, .ratio = HISTORY_TIER1_RATIO,
+                        .bucket_s = HISTORY_TIER0_S * HISTORY_TIER1_RATIO },
+    [HISTORY_1H]    = { .span = "7d",  .rows = rows2, .len = HISTORY_TIER2_LEN, .ratio = HISTORY_TIER2_RATIO,
+                        .bucket_s = HISTORY_TIER0_S * HISTORY_TIER1_RATIO * HISTORY_TIER2_RATIO },
+};
+
+// Names as in the telemetry, and the bar colours of the dashboard
+static const char *tank_names[HISTORY_TANKS] = { "Internal_Tank", "External_Tank", "Aux_Tank" };
+static const char *tank_short[HISTORY_TANKS] = { "Int", "Ext", "Aux" };
+static const uint32_t tank_colors[HISTORY_TANKS] = { 0x03A9F4, 0x4CAF50, 0xFFC107 };
+
+static SemaphoreHandle_t history_mutex = NULL;
+static int64_t minute = -1;             // HISTORY_TIER0_S bucket being filled, since boot
+static int16_t latest[HISTORY_TANKS] = { HISTORY_NONE, HISTORY_NONE, HISTORY_NONE };
+
+// Only with the LVGL lock
+lv_obj_t *history_screen = NULL;
+static lv_obj_t *title = NULL;
+static lv_obj_t *chart = NULL;
+static lv_chart_series_t *series[HISTORY_TANKS];
+static lv_timer_t *back_timer = NULL;
+static history_tier_t shown = HISTORY_TIERS;
+static uint32_t shown_total = 0;        // Rows of the shown tier on the chart
+
+
+// ===== Rings =====
+
+static void close_bucket(history_tier_t t);
+
+static void push(history_tier_t t, const int16_t row[HISTORY_TANKS]) {
+    history_ring_t *r = &tiers[t];
+    memcpy(r->rows[r->head], row, sizeof(history_row_t));
+    r->head = (r->head + 1) % r->len;
+    r->total++;
+
+    if (t + 1 >= HISTORY_TIERS) {
+        return;
+    }
+    history_ring_t *next = &tiers[t + 1];
+    for (int k = 0; k < HISTORY_TANKS; k++) {
+        if (row[k] != HISTORY_NONE) {
+            next->sum[k] += row[k];
+            next->count[k]++;
+        }
+    }
+    if (++next->parts == next->ratio) {
+        close_bucket(t + 1);
+    }
+}
+
+static void close_bucket(history_tier_t t) {
+    history_ring_t *r = &tiers[t];
+    int16_t row[HISTORY_TANKS];
+
+    for (int k = 0; k < HISTORY_TANKS; k++) {
+        row[k] = r->count[k] ? (int16_t)((r->sum[k] + r->count[k] / 2) / r->count[k]) : HISTORY_NONE;
+        r->sum[k] = 0;
+        r->count[k] = 0;
+    }
+    r->parts = 0;
+    push(t, row);
+}
+
+// Oldest first: the i-th of the rows still in the ring
+static const int16_t *row_at(const history_ring_t *r, uint32_t i) {
+    uint32_t kept = r->total < r->len ? r->total : r->len;
+    return r->rows[(r->head + r->len - kept + i) % r->len];
+}
+
+
+// ===== Chart =====
+
+// With the LVGL lock: the rows the shown tier got since the chart last moved
+static void view_catch_up(void) {
+    if (shown == HISTORY_TIERS) {
+        return;
+    }
+    const history_ring_t *r = &tiers[shown];
+
+    xSemaphoreTake(history_mutex, portMAX_DELAY);
+    uint32_t missing = r->total - shown_total;
+    if (missing > r->len) {
+        missing = r->len;
+    }
+    uint32_t kept = r->total < r->len ? r->total : r->len;
+    for (uint32_t i = kept - missing; i < kept; i++) {
+        const int16_t *row = row_at(r, i);
+        for (int k = 0; k < HISTORY_TANKS; k++) {
+            lv_chart_set_next_value(chart, series[k], row[k] == HISTORY_NONE ? LV_CHART_POINT_NONE : row[k]);
+        }
+    }
+    shown_total = r->total;
+    xSemaphoreGive(history_mutex);
+}
+
+static void view_timeout(lv_timer_t *timer) {
+    (void)timer;
+    back_timer = NULL;          // One shot, LVGL deletes it
+    shown = HISTORY_TIERS;
+    screens_show(SCREEN_DATA, LV_SCR_LOAD_ANIM_NONE, 0);
+}
+
+void history_screen_build(void) {
+    history_screen = lv_obj_create(NULL);
+    lv_obj_clear_flag(history_screen, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_set_style_bg_color(history_screen, lv_color_hex(0x002447), LV_PART_MAIN | LV_STATE_DEFAULT);
+
+    title = lv_label_create(history_screen);
+    lv_label_set_recolor(title, true);
+    lv_obj_set_style_text_color(title, lv_color_hex(0xFFFFFF), LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_text_font(title, &lv_font_montserrat_14, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_align(title, LV_ALIGN_TOP_MID, 0, 6);
+
+    chart = lv_chart_create(history_screen);
+    lv_obj_set_size(chart, 300, 200);
+    lv_obj_align(chart, LV_ALIGN_BOTTOM_MID, 0, -8);
+    lv_obj_set_style_bg_color(chart, lv_color_hex(0x002447), LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_border_color(chart, lv_color_hex(0x003F5A), LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_line_color(chart, lv_color_hex(0x003F5A), LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_size(chart, 0, LV_PART_INDICATOR);     // Lines, no point markers
+    lv_chart_set_type(chart, LV_CHART_TYPE_LINE);
+    lv_chart_set_update_mode(chart, LV_CHART_UPDATE_MODE_SHIFT);
+    lv_chart_set_range(chart, LV_CHART_AXIS_PRIMARY_Y, 0, 1000);
+    lv_chart_set_div_line_count(chart, 5, 0);               // Every 25 %
+
+    for (int k = 0; k < HISTORY_TANKS; k++) {
+        series[k] = lv_chart_add_series(chart, lv_color_hex(tank_colors[k]), LV_CHART_AXIS_PRIMARY_Y);
+    }
+}
+
+// Off the display: the chart and its points go back to the LVGL heap
+void history_screen_destroy(void) {
+    if (back_timer) {
+        lv_timer_del(back_timer);
+        back_timer = NULL;
+    }
+    shown = HISTORY_TIERS;
+    lv_obj_del(history_screen);
+    history_screen = NULL;
+    title = NULL;
+    chart = NULL;
+    for (int k = 0; k < HISTORY_TANKS; k++) {
+        series[k] = NULL;
+    }
+}
+
+// With the LVGL lock: the whole tier once, history_add() moves it on a row at a time
+static void view_load(history_tier_t tier) {
+    const history_ring_t *r = &tiers[tier];
+
+    lv_label_set_text_fmt(title, "Last %s   #%06lx %s#  #%06lx %s#  #%06lx %s#", r->span,
+                          (unsigned long)tank_colors[0], tank_short[0],
+                          (unsigned long)tank_colors[1], tank_short[1],
+                          (unsigned long)tank_colors[2], tank_short[2]);
+    lv_chart_set_point_count(chart, r->len);
+    for (int k = 0; k < HISTORY_TANKS; k++) {
+        lv_chart_set_all_value(chart, series[k], LV_CHART_POINT_NONE);
+    }
+    shown = tier;
+    shown_total = 0;
+    view_catch_up();
+}
+
+void history_show(history_tier_t tier) {
+    if (!(xEventGroupGetBits(systemEvents) & DISPLAY_INIT)) {
+        return;
+    }
+    if (!lvgl_lock(LVGL_LOCK_WAIT_TIME)) {
+        return;
+    }
+
+    if (tier >= HISTORY_TIERS) {
+        if (back_timer) {
+            lv_timer_del(back_timer);
+        }
+        view_timeout(NULL);
+    } else {
+        screens_show(SCREEN_HISTORY, LV_SCR_LOAD_ANIM_NONE, 0);
+        view_load(tier);
+        if (HISTORY_VIEW_MS && back_timer) {
+            lv_timer_reset(back_timer);
+        } else if (HISTORY_VIEW_MS) {
+            back_timer = lv_timer_create(view_timeout, HISTORY_VIEW_MS, NULL);
+            lv_timer_set_repeat_count(back_timer, 1);
+        }
+    }
+    lvgl_unlock();
+}
+
+
+// ===== Readings =====
+
+void history_add(int16_t int_tank, int16_t ext_tank, int16_t aux_tank) {
+    const int16_t levels[HISTORY_TANKS] = { int_tank, ext_tank, aux_tank };
+    int64_t now = esp_timer_get_time() / 1000000 / HISTORY_TIER0_S;
+
+    // A silence longer than all three tiers leaves nothing of them anyway
+    const int64_t gap_max = (int64_t)HISTORY_TIER2_LEN * HISTORY_TIER2_RATIO * HISTORY_TIER1_RATIO;
+
+    xSemaphoreTake(history_mutex, portMAX_DELAY);
+    uint32_t hours = tiers[HISTORY_1H].total;
+
+    // Minutes without a reading go in as gaps
+    int64_t closes = minute < 0 ? 0 : now - minute;
+    if (closes > gap_max) {
+        closes = gap_max;
+    }
+    while (closes-- > 0) {
+        close_bucket(HISTORY_1MIN);
+    }
+    minute = now;
+
+    history_ring_t *r = &tiers[HISTORY_1MIN];
+    for (int k = 0; k < HISTORY_TANKS; k++) {
+        bool valid = levels[k] >= 0 && levels[k] <= 100;
+        latest[k] = valid ? levels[k] * 10 : HISTORY_NONE;
+        if (valid) {
+            r->sum[k] += latest[k];
+            r->count[k]++;
+        }
+    }
+    bool hour_closed = tiers[HISTORY_1H].total != hours;
+    xSemaphoreGive(history_mutex);
+
+    if (hour_closed) {
+        history_save();
+    }
+
+    // Nothing to move while the chart isn't up
+    if (shown != HISTORY_TIERS && lvgl_lock(LVGL_LOCK_WAIT_TIME)) {
+        view_catch_up();
+        lvgl_unlock();
+    }
+}
+
+
+// ===== Summary =====
+
+static void tier_summary(const history_ring_t *r, int k, cJSON *obj) {
+    uint32_t kept = r->total < r->len ? r->total : r->len;
+    int16_t min = INT16_MAX, max = INT16_MIN;
+    int32_t sum = 0;
+    uint32_t n = 0, first = 0, last = 0;
+
+    for (uint32_t i = 0; i < kept; i++) {
+        int16_t v = row_at(r, i)[k];
+        if (v == HISTORY_NONE) {
+            continue;
+        }
+        if (n == 0) {
+            first = i;
+        }
+        last = i;
+        min = v < min ? v : min;
+        max = v > max ? v : max;
+        sum += v;
+        n++;
+    }
+    if (n == 0) {
+        return;
+    }
+
+    cJSON *t = cJSON_AddObjectToObject(obj, r->span);
+    cJSON_AddNumberToObject(t, "min", min / 10.0);
+    cJSON_AddNumberToObject(t, "max", max / 10.0);
+    cJSON_AddNumberToObject(t, "avg", (double)sum / n / 10.0);
+    if (last > first) {
+        // From the first reading to the last: negative while the tank drains
+        double hours = (double)(last - first) * r->bucket_s / 3600.0;
+        cJSON_AddNumberToObject(t, "per_h", (row_at(r, last)[k] - row_at(r, first)[k]) / 10.0 / hours);
+    }
+}
+
+void history_summary(cJSON *obj) {
+    xSemaphoreTake(history_mutex, portMAX_DELAY);
+    for (int k = 0; k < HISTORY_TANKS; k++) {
+        cJSON *tank = cJSON_AddObjectToObject(obj, tank_names[k]);
+        if (latest[k] != HISTORY_NONE) {
+            cJSON_AddNumberToObject(tank, "now", latest[k] / 10.0);
+        }
+        for (int t = 0; t < HISTORY_TIERS; t++) {
+            tier_summary(&tiers[t], k, tank);
+        }
+    }
+    xSemaphoreGive(history_mutex);
+}
+
+
+// ===== NVS =====
+
+static history_record_t record;         // Too big for the callers' stacks, under history_mutex
+
+void history_save(void) {
+    xSemaphoreTake(history_mutex, portMAX_DELAY);
+    record.version = HISTORY_VERSION;
+    record.size = sizeof(record);
+    for (int i = 0; i < 2; i++) {
+        record.ring[i].head = tiers[HISTORY_15MIN + i].head;
+        record.ring[i].total = tiers[HISTORY_15MIN + i].total;
+    }
+    memcpy(record.rows1, rows1, sizeof(rows1));
+    memcpy(record.rows2, rows2, sizeof(rows2));
+
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(HISTORY_NVS_NAMESPACE, NVS_READWRITE, &h);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(h, HISTORY_NVS_KEY, &record, sizeof(record));
+        if (err == ESP_OK) {
+            err = nvs_commit(h);
+        }
+        nvs_close(h);
+    }
+    xSemaphoreGive(history_mutex);
+
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "⚠️ History not saved: %s", esp_err_to_name(err));
+    }
+}
+
+void history_init(void) {
+    history_mutex = xSemaphoreCreateMutex();
+
+    for (int t = 0; t < HISTORY_TIERS; t++) {
+        for (int i = 0; i < tiers[t].len; i++) {
+            for (int k = 0; k < HISTORY_TANKS; k++) {
+                tiers[t].rows[i][k] = HISTORY_NONE;
+            }
+        }
+    }
+
+    nvs_handle_t h;
+    if (nvs_open(HISTORY_NVS_NAMESPACE, NVS_READONLY, &h) != ESP_OK) {
+        ESP_LOGI(TAG, "No history saved yet");
+        return;
+    }
+    size_t size = sizeof(record);
+    esp_err_t err = nvs_get_blob(h, HISTORY_NVS_KEY, &record, &size);
+    nvs_close(h);
+
+    if (err != ESP_OK || size != sizeof(record) || record.version != HISTORY_VERSION ||
+        record.size != sizeof(record) || record.ring[0].head >= HISTORY_TIER1_LEN ||
+        record.ring[1].head >= HISTORY_TIER2_LEN) {
+        ESP_LOGW(TAG, "⚠️ Saved history v%u (%u B) not readable, starting over", record.version, (unsigned)size);
+        return;
+    }
+
+    // No wall clock: the time the device was off isn't known, the rows carry on from where they were
+    memcpy(rows1, record.rows1, sizeof(rows1));
+    memcpy(rows2, record.rows2, sizeof(rows2));
+    for (int i = 0; i < 2; i++) {
+        tiers[HISTORY_15MIN + i].head = record.ring[i].head;
+        tiers[HISTORY_15MIN + i].total = record.ring[i].total;
+    }
+    ESP_LOGI(TAG, "📈 History restored: %lu x 15 min, %lu x 1 h",
+             (unsigned long)tiers[HISTORY_15MIN].total, (unsigned long)tiers[HISTORY_1H].total);
+}
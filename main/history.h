@@ -0,0 +1,75 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "cJSON.h"
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// ===== Configuration =====
+
+// Each tier averages HISTORY_TIERn_RATIO buckets of the one before it
+#define HISTORY_TIER0_S         60              // 1 min buckets, RAM only
+#define HISTORY_TIER0_LEN       120             // 2 h
+#define HISTORY_TIER1_RATIO     15              // 15 min buckets
+#define HISTORY_TIER1_LEN       96              // 24 h
+#define HISTORY_TIER2_RATIO     4               // 1 h buckets
+#define HISTORY_TIER2_LEN       168             // 7 days
+
+#define HISTORY_NVS_NAMESPACE   "history"
+#define HISTORY_NVS_KEY         "tiers"
+#define HISTORY_VERSION         1               // Bump when history_record_t changes
+#define HISTORY_VIEW_MS         60000           // Chart back to the dashboard after, 0: stays
+
+
+typedef enum {
+    HISTORY_INT_TANK = 0,
+    HISTORY_EXT_TANK,
+    HISTORY_AUX_TANK,
+    HISTORY_TANKS,
+} history_tank_t;
+
+typedef enum {
+    HISTORY_1MIN = 0,
+    HISTORY_15MIN,
+    HISTORY_1H,
+    HISTORY_TIERS,
+} history_tier_t;
+
+// Levels are kept in tenths of a percent, this for a bucket without readings
+#define HISTORY_NONE            INT16_MIN
+
+
+// Reads the 15 min and 1 h tiers from NVS, call once after nvs_flash_init()
+void history_init(void);
+
+// A tank reading from the master, in percent; below 0 is no reading.
+// Closes the buckets that are over and moves the chart on
+void history_add(int16_t int_tank, int16_t ext_tank, int16_t aux_tank);
+
+// Writes the 15 min and 1 h tiers to NVS; done on every 1 h bucket by itself
+void history_save(void);
+
+// Shows a tier on the chart screen until HISTORY_VIEW_MS, or the dashboard
+// again for HISTORY_TIERS. Takes the LVGL lock itself
+void history_show(history_tier_t tier);
+
+// Current level, min, max, mean and rate per tank over each tier, added to `obj`
+void history_summary(cJSON *obj);
+
+// The chart screen for screens.c, built while it's shown. With the LVGL lock
+extern lv_obj_t *history_screen;
+void history_screen_build(void);
+void history_screen_destroy(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HISTORY_H
@@ -0,0 +1,271 @@
+#include <string.h>
+#include "json_stream.h"
+
+
+typedef enum {
+    ST_VALUE = 0,           // A value must come
+    ST_VALUE_OR_END,        // Just after '['
+    ST_KEY_OR_END,          // Just after '{'
+    ST_KEY,                 // After ',' in an object
+    ST_KEY_STRING,
+    ST_COLON,
+    ST_STRING,
+    ST_NUMBER,
+    ST_LITERAL,             // true, false, null
+    ST_AFTER_VALUE,         // ',' or the end of the container
+    ST_DONE,                // Only whitespace may follow
+} json_stream_state_t;
+
+
+void json_stream_init(json_stream_t *js, json_stream_value_cb_t on_value, void *ctx) {
+    memset(js, 0, sizeof(*js));
+    js->on_value = on_value;
+    js->ctx = ctx;
+    js->state = ST_VALUE;
+}
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static void token_add(json_stream_t *js, char c) {
+    if (js->token_len < sizeof(js->token) - 1) {
+        js->token[js->token_len++] = c;
+    }
+}
+
+static void key_add(json_stream_t *js, char c) {
+    char *key = js->keys[js->depth - 1];
+    if (js->token_len < JSON_STREAM_KEY_MAX - 1) {
+        key[js->token_len++] = c;
+        key[js->token_len] = '\0';
+    }
+}
+
+static void after_value(json_stream_t *js) {
+    js->state = js->depth == 0 ? ST_DONE : ST_AFTER_VALUE;
+}
+
+static void emit(json_stream_t *js, json_stream_type_t type) {
+    js->token[js->token_len] = '\0';
+
+    int depth = js->depth;
+    const char *key = depth >= 1 && js->is_object[depth - 1] ? js->keys[depth - 1] : NULL;
+    const char *parent = depth >= 2 && js->is_object[depth - 2] ? js->keys[depth - 2] : NULL;
+
+    if (js->on_value) {
+        js->on_value(js->ctx, depth, parent, key, type, js->token);
+    }
+    js->token_len = 0;
+    after_value(js);
+}
+
+static void emit_literal(json_stream_t *js) {
+    js->token[js->token_len] = '\0';
+
+    if (strcmp(js->token, "true") == 0 || strcmp(js->token, "false") == 0) {
+        emit(js, JSON_STREAM_BOOL);
+    } else if (strcmp(js->token, "null") == 0) {
+        emit(js, JSON_STREAM_NULL);
+    } else {
+        js->error = true;
+    }
+}
+
+static void push(json_stream_t *js, bool object) {
+    if (js->depth == JSON_STREAM_DEPTH_MAX) {
+        js->error = true;
+        return;
+    }
+    js->is_object[js->depth] = object;
+    js->keys[js->depth][0] = '\0';
+    js->depth++;
+    js->state = object ? ST_KEY_OR_END : ST_VALUE_OR_END;
+}
+
+static void pop(json_stream_t *js, bool object) {
+    if (js->is_object[js->depth - 1] != object) {
+        js->error = true;
+        return;
+    }
+    js->depth--;
+    after_value(js);
+}
+
+static void value_start(json_stream_t *js, char c) {
+    js->token_len = 0;
+
+    if (c == '{') {
+        push(js, true);
+    } else if (c == '[') {
+        push(js, false);
+    } else if (c == '"') {
+        js->state = ST_STRING;
+    } else if (c == '-' || (c >= '0' && c <= '9')) {
+        token_add(js, c);
+        js->state = ST_NUMBER;
+    } else if (c == 't' || c == 'f' || c == 'n') {
+        token_add(js, c);
+        js->state = ST_LITERAL;
+    } else if (!is_space(c)) {
+        js->error = true;
+    }
+}
+
+// A string character after the opening quote. Returns true at the closing one
+static bool string_char(json_stream_t *js, char c, void (*add)(json_stream_t *, char)) {
+    if (js->escape == 1) {
+        js->escape = 0;
+        switch (c) {
+            case 'b': add(js, '\b'); break;
+            case 'f': add(js, '\f'); break;
+            case 'n': add(js, '\n'); break;
+            case 'r': add(js, '\r'); break;
+            case 't': add(js, '\t'); break;
+            case 'u':
+                js->escape = 5;     // Four hex digits to go
+                js->unicode = 0;
+                break;
+            default:  add(js, c); break;    // '"', '\\', '/'
+        }
+        return false;
+    }
+
+    if (js->escape > 1) {
+        int digit;
+        if (c >= '0' && c <= '9') digit = c - '0';
+        else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+        else {
+            js->error = true;
+            return false;
+        }
+        js->unicode = (js->unicode << 4) | digit;
+        if (--js->escape == 1) {
+            js->escape = 0;
+            // None of our keys or values need more than ASCII
+            add(js, js->unicode < 0x80 ? (char)js->unicode : '?');
+        }
+        return false;
+    }
+
+    if (c == '\\') {
+        js->escape = 1;
+        return false;
+    }
+    if (c == '"') {
+        return true;
+    }
+    add(js, c);
+    return false;
+}
+
+static void feed_char(json_stream_t *js, char c) {
+    switch (js->state) {
+        case ST_VALUE:
+            value_start(js, c);
+            break;
+
+        case ST_VALUE_OR_END:
+            if (c == ']') {
+                pop(js, false);
+            } else {
+                value_start(js, c);
+            }
+            break;
+
+        case ST_KEY_OR_END:
+            if (c == '}') {
+                pop(js, true);
+                break;
+            }
+            // fall through
+        case ST_KEY:
+            if (c == '"') {
+                js->token_len = 0;
+                js->keys[js->depth - 1][0] = '\0';
+                js->state = ST_KEY_STRING;
+            } else if (!is_space(c)) {
+                js->error = true;
+            }
+            break;
+
+        case ST_KEY_STRING:
+            if (string_char(js, c, key_add)) {
+                js->token_len = 0;
+                js->state = ST_COLON;
+            }
+            break;
+
+        case ST_COLON:
+            if (c == ':') {
+                js->state = ST_VALUE;
+            } else if (!is_space(c)) {
+                js->error = true;
+            }
+            break;
+
+        case ST_STRING:
+            if (string_char(js, c, token_add)) {
+                emit(js, JSON_STREAM_STRING);
+            }
+            break;
+
+        case ST_NUMBER:
+            if ((c >= '0' && c <= '9') || c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-') {
+                token_add(js, c);
+            } else {
+                emit(js, JSON_STREAM_NUMBER);
+                feed_char(js, c);
+            }
+            break;
+
+        case ST_LITERAL:
+            if (c >= 'a' && c <= 'z') {
+                token_add(js, c);
+            } else {
+                emit_literal(js);
+                if (!js->error) {
+                    feed_char(js, c);
+                }
+            }
+            break;
+
+        case ST_AFTER_VALUE:
+            if (c == ',') {
+                js->state = js->is_object[js->depth - 1] ? ST_KEY : ST_VALUE;
+            } else if (c == '}') {
+                pop(js, true);
+            } else if (c == ']') {
+                pop(js, false);
+            } else if (!is_space(c)) {
+                js->error = true;
+            }
+            break;
+
+        case ST_DONE:
+            if (!is_space(c)) {
+                js->error = true;
+            }
+            break;
+    }
+}
+
+bool json_stream_feed(json_stream_t *js, const char *data, size_t len) {
+    for (size_t i = 0; i < len && !js->error; i++) {
+        feed_char(js, data[i]);
+    }
+    return !js->error;
+}
+
+bool json_stream_finish(json_stream_t *js) {
+    // A number at the top level only ends with the input
+    if (!js->error && js->depth == 0) {
+        if (js->state == ST_NUMBER) {
+            emit(js, JSON_STREAM_NUMBER);
+        } else if (js->state == ST_LITERAL) {
+            emit_literal(js);
+        }
+    }
+    return !js->error && js->state == ST_DONE;
+}
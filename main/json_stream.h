@@ -0,0 +1,59 @@
+#ifndef JSON_STREAM_H
+#define JSON_STREAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Incremental JSON parser for MQTT payloads that arrive in chunks.
+ *
+ * Feed it the bytes as they come; every scalar (string, number, true,
+ * false, null) is reported once complete with the member name it was
+ * found under and the name of the object around that. Nothing is kept
+ * but the current token, so the payload can be any size.
+ *
+ * Longer names or strings than the limits below are cut short, nesting
+ * deeper than JSON_STREAM_DEPTH_MAX is an error.
+ */
+
+#define JSON_STREAM_DEPTH_MAX   8       // Objects and arrays inside each other
+#define JSON_STREAM_KEY_MAX     32      // Member name, with terminator
+#define JSON_STREAM_VALUE_MAX   72      // Scalar as text, with terminator: a SHA-256 in hex fits
+
+typedef enum {
+    JSON_STREAM_STRING = 0,
+    JSON_STREAM_NUMBER,
+    JSON_STREAM_BOOL,                   // value is "true" or "false"
+    JSON_STREAM_NULL,
+} json_stream_type_t;
+
+// `depth` is 1 for members of the outermost object. `key` is NULL for array
+// elements, `parent` is NULL at depth 1
+typedef void (*json_stream_value_cb_t)(void *ctx, int depth, const char *parent, const char *key,
+                                       json_stream_type_t type, const char *value);
+
+typedef struct {
+    json_stream_value_cb_t on_value;
+    void *ctx;
+
+    unsigned char state;
+    unsigned char escape;               // Inside a string: after '\', or the \u digits left
+    unsigned short unicode;             // The \u code point so far
+    bool error;
+    int depth;
+    unsigned char is_object[JSON_STREAM_DEPTH_MAX];     // Per level: object or array
+    char keys[JSON_STREAM_DEPTH_MAX][JSON_STREAM_KEY_MAX];
+
+    char token[JSON_STREAM_VALUE_MAX];
+    size_t token_len;
+} json_stream_t;
+
+void json_stream_init(json_stream_t *js, json_stream_value_cb_t on_value, void *ctx);
+
+// False once the input isn't JSON, the rest is ignored then
+bool json_stream_feed(json_stream_t *js, const char *data, size_t len);
+
+// True if exactly one complete value was parsed
+bool json_stream_finish(json_stream_t *js);
+
+#endif // JSON_STREAM_H
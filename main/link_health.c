@@ -0,0 +1,245 @@
+#include "link_health.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_attr.h"
+#include "esp_bit_defs.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+
+static const char *TAG = "LINK";
+
+#define LINK_RTC_MAGIC  0x4c4e4b31      // "LNK1": rtc_reboots survived a reset
+
+static link_health_t health;
+static uint32_t skip_levels = 0;
+static bool recovery_pending = false;
+static int64_t next_attempt_us = 0;     // Backoff: no recovery before this
+static portMUX_TYPE health_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static StaticSemaphore_t wake_buf;
+static SemaphoreHandle_t wake = NULL;   // Given when a recovery becomes due
+
+// Reboots by the supervisor without the link coming up in between
+RTC_NOINIT_ATTR static uint32_t rtc_magic;
+RTC_NOINIT_ATTR static uint32_t rtc_reboots;
+
+static const char *level_names[LINK_LEVEL_COUNT] = {
+    [LINK_LEVEL_RETRY]  = "retry",
+    [LINK_LEVEL_MQTT]   = "MQTT reconnect",
+    [LINK_LEVEL_PDP]    = "PDP reactivation",
+    [LINK_LEVEL_RADIO]  = "radio reset",
+    [LINK_LEVEL_POWER]  = "modem power cycle",
+    [LINK_LEVEL_REBOOT] = "ESP reboot",
+};
+
+
+const char *link_level_str(link_level_t level) {
+    return level < LINK_LEVEL_COUNT ? level_names[level] : "?";
+}
+
+// The first level from `level` up the transport can do. Rebooting stops once
+// it didn't help LINK_REBOOT_MAX times: power cycles, LINK_BACKOFF_MAX_MS apart, from then on
+static uint8_t level_from(int level) {
+    while (level < LINK_LEVEL_REBOOT && (skip_levels & BIT(level))) {
+        level++;
+    }
+    if (level >= LINK_LEVEL_REBOOT) {
+        level = rtc_reboots < LINK_REBOOT_MAX ? LINK_LEVEL_REBOOT : LINK_LEVEL_POWER;
+    }
+    return level;
+}
+
+static void wake_supervisor(void) {
+    if (wake) {
+        xSemaphoreGive(wake);
+    }
+}
+
+void link_init(uint32_t skip) {
+    if (wake == NULL) {
+        wake = xSemaphoreCreateBinaryStatic(&wake_buf);
+    }
+    if (rtc_magic != LINK_RTC_MAGIC) {
+        rtc_magic = LINK_RTC_MAGIC;
+        rtc_reboots = 0;
+    }
+
+    taskENTER_CRITICAL(&health_lock);
+    skip_levels = skip & ~BIT(LINK_LEVEL_RETRY) & ~BIT(LINK_LEVEL_REBOOT);
+    health.level = level_from(LINK_LEVEL_MQTT);
+    health.level_tries = 0;
+    health.backoff_ms = LINK_BACKOFF_MIN_MS;
+    health.reboots = rtc_reboots;
+    bool pending = recovery_pending;
+    taskEXIT_CRITICAL(&health_lock);
+
+    if (pending) {
+        wake_supervisor();
+    }
+    if (rtc_reboots) {
+        ESP_LOGW(TAG, "⚠️ %lu reboot(s) in a row for the link", (unsigned long)rtc_reboots);
+    }
+}
+
+void link_ok(void) {
+    int64_t now = esp_timer_get_time();
+    int64_t down_since;
+
+    taskENTER_CRITICAL(&health_lock);
+    down_since = health.up ? 0 : health.down_since_us;
+    health.up = true;
+    health.fail_streak = 0;
+    health.level = level_from(LINK_LEVEL_MQTT);
+    health.level_tries = 0;
+    health.backoff_ms = LINK_BACKOFF_MIN_MS;
+    health.reboots = 0;
+    health.last_ok_us = now;
+    health.down_since_us = 0;
+    recovery_pending = false;
+    next_attempt_us = 0;
+    rtc_reboots = 0;
+    taskEXIT_CRITICAL(&health_lock);
+
+    if (down_since) {
+        ESP_LOGI(TAG, "✅ Link back after %lld s", (long long)((now - down_since) / 1000000));
+    }
+}
+
+static void link_lost(link_health_t *h, int64_t now) {
+    if (h->up || h->down_since_us == 0) {
+        h->down_since_us = now;
+    }
+    h->up = false;
+    h->failures++;
+    h->fail_streak++;
+}
+
+void link_failed(const char *what) {
+    bool wake_now = false;
+    uint32_t streak;
+
+    taskENTER_CRITICAL(&health_lock);
+    link_lost(&health, esp_timer_get_time());
+    streak = health.fail_streak;
+    if (streak >= LINK_FAIL_THRESHOLD && !recovery_pending) {
+        recovery_pending = true;
+        wake_now = true;
+    }
+    taskEXIT_CRITICAL(&health_lock);
+
+    ESP_LOGW(TAG, "⚠️ %s failed, %lu in a row", what, (unsigned long)streak);
+    if (wake_now) {
+        wake_supervisor();
+    }
+}
+
+void link_down(const char *what, link_level_t level) {
+    taskENTER_CRITICAL(&health_lock);
+    link_lost(&health, esp_timer_get_time());
+    if (health.fail_streak < LINK_FAIL_THRESHOLD) {
+        health.fail_streak = LINK_FAIL_THRESHOLD;
+    }
+    if (level > health.level) {
+        health.level = level_from(level);
+        health.level_tries = 0;
+    }
+    recovery_pending = true;
+    taskEXIT_CRITICAL(&health_lock);
+
+    ESP_LOGE(TAG, "❌ %s failed, recovering from %s up", what, link_level_str(level));
+    wake_supervisor();
+}
+
+link_level_t link_wait_recovery(uint32_t timeout_ms) {
+    TickType_t start = xTaskGetTickCount();
+    TickType_t limit = pdMS_TO_TICKS(timeout_ms);
+
+    while (1) {
+        int64_t now = esp_timer_get_time();
+
+        taskENTER_CRITICAL(&health_lock);
+        bool pending = recovery_pending;
+        int64_t wait_us = next_attempt_us - now;
+        uint8_t level = health.level;
+        if (pending && wait_us <= 0 && level == LINK_LEVEL_REBOOT) {
+            rtc_reboots++;
+            health.reboots = rtc_reboots;
+        }
+        taskEXIT_CRITICAL(&health_lock);
+
+        if (pending && wait_us <= 0) {
+            return level;
+        }
+
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= limit) {
+            return LINK_LEVEL_RETRY;
+        }
+
+        TickType_t wait = limit - elapsed;
+        if (pending) {
+            TickType_t backoff = pdMS_TO_TICKS(wait_us / 1000) + 1;
+            if (backoff < wait) {
+                wait = backoff;
+            }
+        }
+        xSemaphoreTake(wake, wait);
+    }
+}
+
+void link_recovered(link_level_t level, bool ok) {
+    int64_t now = esp_timer_get_time();
+
+    taskENTER_CRITICAL(&health_lock);
+    health.recoveries[level]++;
+
+    // Only link_ok() proves a recovery worked: until then the tries count,
+    // so a session that connects but can't publish still escalates
+    if (ok) {
+        recovery_pending = false;
+        health.fail_streak = 0;
+    }
+    if (++health.level_tries >= LINK_TRIES_PER_LEVEL) {
+        health.level = level_from(level + 1);
+        health.level_tries = 0;
+    }
+
+    uint32_t backoff = health.backoff_ms;
+    next_attempt_us = now + (int64_t)backoff * 1000;
+    health.backoff_ms = backoff * 2 < LINK_BACKOFF_MAX_MS ? backoff * 2 : LINK_BACKOFF_MAX_MS;
+    uint8_t next = health.level;
+    taskEXIT_CRITICAL(&health_lock);
+
+    if (ok) {
+        ESP_LOGI(TAG, "%s done", link_level_str(level));
+    } else {
+        ESP_LOGE(TAG, "❌ %s failed, next: %s in %lu s", link_level_str(level), link_level_str(next),
+                 (unsigned long)(backoff / 1000));
+    }
+}
+
+void link_health_get(link_health_t *out) {
+    taskENTER_CRITICAL(&health_lock);
+    *out = health;
+    taskEXIT_CRITICAL(&health_lock);
+}
+
+void link_health_log(void) {
+    link_health_t h;
+    link_health_get(&h);
+    int64_t now = esp_timer_get_time();
+
+    if (h.up) {
+        ESP_LOGI(TAG, "🩺 link up, last OK %lld s ago", (long long)((now - h.last_ok_us) / 1000000));
+    } else {
+        ESP_LOGW(TAG, "🩺 link down for %lld s, %lu failures in a row, next: %s",
+                 h.down_since_us ? (long long)((now - h.down_since_us) / 1000000) : 0LL,
+                 (unsigned long)h.fail_streak, link_level_str(h.level));
+    }
+    ESP_LOGI(TAG, "🩺 %lu failures, recoveries: %lu MQTT, %lu PDP, %lu radio, %lu power, %lu reboots in a row",
+             (unsigned long)h.failures,
+             (unsigned long)h.recoveries[LINK_LEVEL_MQTT], (unsigned long)h.recoveries[LINK_LEVEL_PDP],
+             (unsigned long)h.recoveries[LINK_LEVEL_RADIO], (unsigned long)h.recoveries[LINK_LEVEL_POWER],
+             (unsigned long)h.reboots);
+}
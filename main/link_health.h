@@ -0,0 +1,75 @@
+#ifndef LINK_HEALTH_H
+#define LINK_HEALTH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// ===== Configuration =====
+
+#define LINK_FAIL_THRESHOLD     3       // Failures in a row before modem_task recovers
+#define LINK_TRIES_PER_LEVEL    2       // Failed recoveries before the next level
+#define LINK_BACKOFF_MIN_MS     10000   // Between failed recoveries, doubling each time
+#define LINK_BACKOFF_MAX_MS     600000
+#define LINK_REBOOT_MAX         2       // ESP reboots in a row without the link coming up;
+                                        // after that only the modem is power cycled
+
+
+// Recovery levels, each one more disruptive than the last
+typedef enum {
+    LINK_LEVEL_RETRY = 0,       // Nothing: the caller sends the failed step again
+    LINK_LEVEL_MQTT,            // Disconnect and connect the MQTT session
+    LINK_LEVEL_PDP,             // Deactivate and reactivate the PDP context
+    LINK_LEVEL_RADIO,           // AT+CFUN=0 then AT+CFUN=1
+    LINK_LEVEL_POWER,           // Power cycle the modem and bring everything up
+    LINK_LEVEL_REBOOT,          // esp_restart()
+    LINK_LEVEL_COUNT
+} link_level_t;
+
+typedef struct {
+    bool up;                            // Last operation got through
+    uint8_t level;                      // link_level_t the next recovery runs
+    uint8_t level_tries;                // Failed recoveries at that level
+    uint32_t fail_streak;               // Failures since the last success
+    uint32_t failures;                  // Since boot
+    uint32_t recoveries[LINK_LEVEL_COUNT];  // Recoveries run per level, since boot
+    uint32_t backoff_ms;                // Wait before the next recovery
+    uint32_t reboots;                   // ESP reboots in a row by the supervisor
+    int64_t last_ok_us;                 // esp_timer time of the last success, 0: never
+    int64_t down_since_us;              // When the current outage started, 0 while up
+} link_health_t;
+
+
+// `skip` is a BIT(link_level_t) mask of levels the transport can't do
+void link_init(uint32_t skip);
+
+// A publish got through to the broker (OK from AT+CMQTTPUB, or the PUBACK)
+void link_ok(void);
+
+// An operation failed. The LINK_FAIL_THRESHOLD-th in a row wakes modem_task
+void link_failed(const char *what);
+
+// Lost for sure (bring-up failed, session gone): recover now, from `level` up
+void link_down(const char *what, link_level_t level);
+
+// For modem_task: waits up to `timeout_ms` for a recovery to be due and returns
+// its level, or LINK_LEVEL_RETRY if there's nothing to do
+link_level_t link_wait_recovery(uint32_t timeout_ms);
+
+// What the recovery link_wait_recovery() asked for achieved
+void link_recovered(link_level_t level, bool ok);
+
+void link_health_get(link_health_t *out);
+void link_health_log(void);
+const char *link_level_str(link_level_t level);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LINK_HEALTH_H
@@ -11,6 +11,13 @@
 
 #include "heartbeat.h"
 #include "publish.h"
+#include "ui_mem.h"
+#include "power.h"
+#include "deep_sleep.h"
+#include "diag.h"
+#include "history.h"
+#include "ota.h"
+#include "trace.h"
 #include "message_ids.h"
 
 
@@ -44,6 +51,10 @@ void GPIOInit(void)
 
     gpio_set_level(MODEM_PWR_KEY, 0);
     gpio_set_level(RAIL_4V_EN, 0);
+
+    gpio_reset_pin(MODEM_RI);
+    gpio_set_direction(MODEM_RI, GPIO_MODE_INPUT);
+    gpio_set_pull_mode(MODEM_RI, GPIO_PULLUP_ONLY);
 }
 
 void mqtt_nvs_init(void) {
@@ -53,10 +64,16 @@ void mqtt_nvs_init(void) {
         err = nvs_flash_init();
     }
     ESP_ERROR_CHECK(err);
+
+    // Back from deep sleep the settings come from RTC memory, with the last readings
+    if (!deep_sleep_resume()) {
+        mqtt_settings_load();
+    }
 }
 
 void app_main(void)
 {
+    trace_init();
 
     xLVGLSemaphore = xSemaphoreCreateMutex();
     data_mutex = xSemaphoreCreateMutex();
@@ -65,6 +82,12 @@ void app_main(void)
     systemEvents = xEventGroupCreate();
 
     mqtt_nvs_init();
+    mqtt_rpc_init();
+    history_init();
+    ota_init();
+
+    // DFS and light sleep from here; each driver below holds its lock while it needs the clock
+    power_init();
 
 
     GPIOInit();
@@ -82,10 +105,14 @@ void app_main(void)
 
     // Start Tasks
     xTaskCreatePinnedToCore(run_display_task, "display", 2048*12, NULL, 3, &displayTaskHandle, 0);
+    xTaskCreatePinnedToCore(ui_mem_monitor_task, "ui_mem_monitor", 2048*2, NULL, 1, NULL, 0);
+    xTaskCreatePinnedToCore(diag_task, "diag_task", 2048*3, NULL, 1, NULL, 0);
     xTaskCreatePinnedToCore(master_rx_task, "master_rx_task", 2048*8, NULL, 1, &uartTaskHandle, 1);
     xTaskCreatePinnedToCore(master_tx_task, "master_tx_task", 2048*8, NULL, 2, &uartTaskHandle, 1);
 
     xTaskCreatePinnedToCore(data_task, "data_task", 2048*8, NULL, 4, &dataTaskHandle, 0);
+    xTaskCreatePinnedToCore(rpc_response_task, "rpc_response_task", 2048*4, NULL, 4, NULL, 1);
+    xTaskCreatePinnedToCore(ota_task, "ota_task", 2048*3, NULL, 2, NULL, 1);
     xTaskCreatePinnedToCore(modem_task, "modem_task", 2048*12, NULL, 5, NULL, 1);
 
     vTaskDelay(3000 / portTICK_PERIOD_MS);
@@ -1,20 +1,38 @@
 #ifndef MESSAGE_IDS_H
 #define MESSAGE_IDS_H
 
-#define MSG_ID_HEARTBEAT        0
-#define MSG_ID_BME280           1  
-#define MSG_ID_TANK_LEVEL       2
-#define MSG_ID_MODE             3
-#define MSG_ID_COMMS            4 
-#define MSG_ID_SPARE            5
-#define MSG_ID_BATT             6
-#define MSG_ID_OUTPUTS          7
-#define MSG_ID_420_INPUTS       8
-#define MSG_ID_ANALOG_INPUTS    9
-#define MSG_ID_PT1000           10
-#define MSG_ID_STATUS           11
-#define MSG_ID_SYSTEM           12
-#define MSG_ID_SETTINGS         13
+// Every message id on the master link, with its handler in data.c and its
+// numeric channels in protocol.h. The handlers are a dense table indexed by
+// id, so ids stay 0..MSG_ID_COUNT-1 in order; one the slave only sends takes
+// handle_none. X(NAME, id, handler, channels)
+#define MSG_IDS(X)                                                              \
+    X(HEARTBEAT,      0,  handle_none,            PROTOCOL_NONE)                \
+    X(BME280,         1,  handle_channels,        PROTOCOL_BME280)              \
+    X(TANK_LEVEL,     2,  handle_tank_message,    PROTOCOL_NONE)                \
+    X(MODE,           3,  handle_mode_message,    PROTOCOL_NONE)                \
+    X(COMMS,          4,  handle_comms_message,   PROTOCOL_NONE)                \
+    X(SPARE,          5,  handle_none,            PROTOCOL_NONE)                \
+    X(BATT,           6,  handle_channels,        PROTOCOL_BATT)                \
+    X(OUTPUTS,        7,  handle_outputs_message, PROTOCOL_NONE)                \
+    X(420_INPUTS,     8,  handle_none,            PROTOCOL_NONE)                \
+    X(ANALOG_INPUTS,  9,  handle_none,            PROTOCOL_NONE)                \
+    X(PT1000,         10, handle_channels,        PROTOCOL_PT1000)              \
+    X(STATUS,         11, handle_status_message,  PROTOCOL_NONE)                \
+    X(SYSTEM,         12, handle_system_message,  PROTOCOL_NONE)                \
+    X(SETTINGS,       13, handle_none,            PROTOCOL_NONE)                \
+    X(ACK,            14, handle_none,            PROTOCOL_NONE)    /* master -> slave, see below; uart.c takes it */
+
+enum {
+#define X(name, id, handler, channels) MSG_ID_##name = id,
+    MSG_IDS(X)
+#undef X
+};
+
+enum {
+#define X(name, id, handler, channels) + 1
+    MSG_ID_COUNT = 0 MSG_IDS(X)
+#undef X
+};
 
 
 //Message types
@@ -80,4 +98,40 @@ typedef enum {
 } button_messages_t;
 
 
+//Acknowledged commands (slave -> master), with MASTER_CMD_SEQ in uart.h
+//
+// SYSTEM and SETTINGS commands from the slave carry a sequence number 1..255
+// in the high byte of the message id field: "0" "05" "0C" "#..." is sequence
+// 5 of MSG_ID_SYSTEM. Sequence 0 (the heartbeat) is never acknowledged.
+//
+// The master answers every sequenced frame with MSG_ID_ACK:
+//   data0 - the message id it acknowledges (low byte only)
+//   data1 - the sequence number
+//   data2 - ack_results_t
+//
+// A frame with no ACK within MASTER_CMD_TIMEOUT_MS is sent again with the
+// same sequence number. The master must ACK a repeat of the sequence number
+// it executed last without executing it a second time.
+#define MSG_SEQ_SHIFT           8
+#define MSG_ID_MASK             0xFF
+
+typedef enum {                  //goes in ack data2
+    ACK_OK = 0,
+    ACK_REJECTED,               //understood but not carried out (e.g. wrong mode)
+    ACK_UNKNOWN,                //message id or value it doesn't know
+} ack_results_t;
+
+
+//Waking the slave (master -> slave)
+//
+// Between bursts the slave may be in light sleep, woken by edges on its RX
+// line (POWER_UART_WAKE_EDGES in power.h). The bytes that wake it are lost,
+// so the master starts every burst with MSG_WAKE_PREAMBLE, then keeps the
+// line idle for MSG_WAKE_GAP_MS before the first frame. The gap is longer
+// than master_rx_task's read timeout: what's left of the preamble is read
+// and dropped as a short frame, and the frame after it comes in whole.
+#define MSG_WAKE_PREAMBLE       "UU"    //0x55: five rising edges a byte
+#define MSG_WAKE_GAP_MS         20
+
+
 #endif // MESSAGE_IDS_H
@@ -12,6 +12,13 @@
 #include "display.h"
 #include "freertos/semphr.h"
 #include "at_handler.h"
+#include "pppos.h"
+#include "esp_timer.h"
+#include "link_health.h"
+#include "power.h"
+#include "diag.h"
+#include "trace.h"
+#include "ota.h"
 
 
 
@@ -21,20 +28,21 @@ static const char *TAG = "MODEM";
 //mutex to proect UART
 SemaphoreHandle_t at_mutex = NULL;  
 SemaphoreHandle_t publish_mutex = NULL;           // Mutex to protect AT command access
-SemaphoreHandle_t publish_trigger = NULL;      //semaphore to trigger publish task
 
 QueueHandle_t incoming_queue;
 QueueHandle_t at_send_queue;
 QueueHandle_t at_resp_queue;
 
+static mqtt_transport_stats_t transport_stats;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
 // ===== Configuration =====
 
 
 
 // ===== UART & GPIO Setup =====
 
-void sim7600_init(void) {
-
+static void modem_locks_init(void) {
     if (at_mutex == NULL) {
         at_mutex = xSemaphoreCreateMutex();
     }
@@ -42,6 +50,21 @@ void sim7600_init(void) {
     if (publish_mutex == NULL) {
         publish_mutex = xSemaphoreCreateMutex();
     }
+}
+
+static void sim7600_power_cycle(void) {
+    gpio_set_direction(MODEM_PWR_KEY, GPIO_MODE_OUTPUT);
+    gpio_set_direction(RAIL_4V_EN, GPIO_MODE_OUTPUT);
+
+    sim7600_power_off();
+    vTaskDelay(pdMS_TO_TICKS(1000));
+    sim7600_power_on();
+    vTaskDelay(pdMS_TO_TICKS(8000));
+}
+
+void sim7600_init(void) {
+
+    modem_locks_init();
 
     uart_config_t uart_config = {
         .baud_rate = SIM7600_BAUD_RATE,
@@ -49,7 +72,7 @@ void sim7600_init(void) {
         .parity = UART_PARITY_DISABLE,
         .stop_bits = UART_STOP_BITS_1,
         .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
-        .source_clk = UART_SCLK_DEFAULT,
+        .source_clk = UART_SCLK_XTAL,       // APB changes with DFS, see power.h
     };
 
     uart_driver_install(SIM7600_UART_PORT, UART_BUF_SIZE, 0, EVENT_QUEUE_LEN, NULL, 0);
@@ -62,29 +85,24 @@ void sim7600_init(void) {
     }
 
     
-    at_send_queue = xQueueCreate(EVENT_QUEUE_LEN, sizeof(char[SIM7600_UART_BUF_SIZE]));
+    at_send_queue = xQueueCreate(EVENT_QUEUE_LEN, sizeof(at_tx_item_t));
     if (at_send_queue == NULL) {            
         ESP_LOGE(TAG, "Failed to create at_send_queue");
     }
+    diag_queue_register("at_send", at_send_queue);
 
-    incoming_queue = xQueueCreate(EVENT_QUEUE_LEN, sizeof(char[SIM7600_UART_BUF_SIZE]));
+    incoming_queue = xQueueCreate(URC_QUEUE_LEN, sizeof(urc_item_t));
     if (incoming_queue == NULL) {
         ESP_LOGE(TAG, "Failed to create incoming_queue");
     }
+    diag_queue_register("incoming", incoming_queue);
 
     xTaskCreatePinnedToCore(rx_task, "rx_task", 2048*4, NULL, 1, NULL, 1);
     xTaskCreatePinnedToCore(tx_task, "tx_task", 2048*4, NULL, 2, NULL, 1);
     xTaskCreatePinnedToCore(mqtt_urc_task, "mqtt_urc_task", 2048*4, NULL, 3, NULL, 1);
 
 
-
-    gpio_set_direction(MODEM_PWR_KEY, GPIO_MODE_OUTPUT);
-    gpio_set_direction(RAIL_4V_EN, GPIO_MODE_OUTPUT);
-
-    sim7600_power_off();
-    vTaskDelay(pdMS_TO_TICKS(1000));
-    sim7600_power_on();
-    vTaskDelay(pdMS_TO_TICKS(8000));
+    sim7600_power_cycle();
 }
 
 void sim7600_power_on(void) {
@@ -96,10 +114,16 @@ void sim7600_power_on(void) {
     vTaskDelay(pdMS_TO_TICKS(200));
     gpio_set_level(MODEM_PWR_KEY, 1);
     vTaskDelay(pdMS_TO_TICKS(5000));
+
+    power_rx_wake(MODEM_RX, true);
+    power_rx_wake(MODEM_RI, true);
 }
 
 void sim7600_power_off(void) {
     ESP_LOGI(TAG, "Powering off SIM7600E");
+    // Unpowered, the modem pulls its TX and RI low: that would wake us straight away
+    power_rx_wake(MODEM_RX, false);
+    power_rx_wake(MODEM_RI, false);
     gpio_set_level(RAIL_4V_EN, 0);
     vTaskDelay(pdMS_TO_TICKS(1000));
 }
@@ -107,8 +131,15 @@ void sim7600_power_off(void) {
 // ===== AT Communication =====
 
 void sim7600_send_command(const char* command) {
-    uart_write_bytes(SIM7600_UART_PORT, command, strlen(command));
+    size_t len = strlen(command);
+    uart_write_bytes(SIM7600_UART_PORT, command, len);
     uart_write_bytes(SIM7600_UART_PORT, "\r\n", 2);
+    modem_stats_uart(len + 2, 0);
+}
+
+void sim7600_send_raw(const char *data, size_t len) {
+    uart_write_bytes(SIM7600_UART_PORT, data, len);
+    modem_stats_uart(len, 0);
 }
 
 
@@ -116,13 +147,21 @@ const char *send_at_command(const char *command, int timeout_ms) {
     static char response[SIM7600_UART_BUF_SIZE];
     response[0] = '\0';
 
+    if (pppos_is_active()) {
+        return pppos_at_command(command, timeout_ms);
+    }
+
     if (xSemaphoreTake(at_mutex, pdMS_TO_TICKS(1000)) != pdTRUE) return NULL;
 
-    
+    // Awake until the final result code is in
+    power_lock(POWER_LOCK_MODEM);
+
     // Create a temporary queue for this AT command
     QueueHandle_t temp_resp_queue = xQueueCreate(10, sizeof(char[SIM7600_UART_BUF_SIZE]));
     if (!temp_resp_queue) {
         ESP_LOGE("AT", "Failed to create response queue");
+        power_unlock(POWER_LOCK_MODEM);
+        xSemaphoreGive(at_mutex);
         return NULL;
     }
 
@@ -133,15 +172,16 @@ const char *send_at_command(const char *command, int timeout_ms) {
     char drain[SIM7600_UART_BUF_SIZE];
     while (xQueueReceive(temp_resp_queue, drain, 0) == pdTRUE);
 
-    ESP_LOGI("MODEM", ">> %s", command);
+    TRACE_STR(ESP_LOG_INFO, TEV_AT_CMD, command);
 
-    char copy[SIM7600_UART_BUF_SIZE];
-    snprintf(copy, sizeof(copy), "%s", command);
+    at_tx_item_t item = { .raw = false };
+    item.len = snprintf(item.data, sizeof(item.data), "%s", command);
 
-    if (xQueueSend(at_send_queue, &copy, pdMS_TO_TICKS(100)) != pdTRUE) {
+    if (xQueueSend(at_send_queue, &item, pdMS_TO_TICKS(100)) != pdTRUE) {
         ESP_LOGW("AT", "❌ Failed to enqueue command: %s", command);
         vQueueDelete(temp_resp_queue);
         at_handler_set_response_queue(NULL);
+        power_unlock(POWER_LOCK_MODEM);
         xSemaphoreGive(at_mutex);
         return NULL;
     }
@@ -160,14 +200,17 @@ const char *send_at_command(const char *command, int timeout_ms) {
             strncat(response, "\n", SIM7600_UART_BUF_SIZE - strlen(response) - 1);
 
             if (strcmp(line, "OK") == 0 || strcmp(line, "ERROR") == 0 || strcmp(line, ">") == 0) {
-                ESP_LOGI("MODEM", "<< [Complete Response]\n%s", response);
+                TRACE_STR(ESP_LOG_INFO, TEV_AT_DONE, line, (xTaskGetTickCount() - start) * portTICK_PERIOD_MS,
+                          strlen(response));
                 break;
             }
         }
     }
+    power_unlock(POWER_LOCK_MODEM);
     xSemaphoreGive(at_mutex);
     if (!got_any_line) {
         ESP_LOGW("AT", "❌ No response (timeout %d ms): %s", timeout_ms, command);
+        TRACE_STR(ESP_LOG_WARN, TEV_AT_TIMEOUT, command, timeout_ms);
     }
 
     vQueueDelete(temp_resp_queue);
@@ -178,21 +221,27 @@ const char *send_at_command(const char *command, int timeout_ms) {
 
 
 
-bool send_raw_uart_data(const char *data) {
+// Data after a ">" prompt: exactly `len` bytes, split over as many tx_task writes as it takes
+bool send_raw_uart_data(const char *data, size_t len) {
     if (!at_send_queue || data == NULL) {
         ESP_LOGW("TX", "❌ Cannot send raw data: null input or uninitialized queue");
         return false;
     }
 
-    char copy[SIM7600_UART_BUF_SIZE];
-    snprintf(copy, sizeof(copy), "%s", data);
+    at_tx_item_t item = { .raw = true };
+    while (len > 0) {
+        item.len = len < sizeof(item.data) ? len : sizeof(item.data);
+        memcpy(item.data, data, item.len);
 
-    if (xQueueSend(at_send_queue, &copy, pdMS_TO_TICKS(100)) != pdTRUE) {
-        ESP_LOGW("TX", "❌ Failed to enqueue raw data: %s", data);
-        return false;
+        if (xQueueSend(at_send_queue, &item, pdMS_TO_TICKS(100)) != pdTRUE) {
+            ESP_LOGW("TX", "❌ Failed to enqueue %u B of raw data", (unsigned)len);
+            return false;
+        }
+        data += item.len;
+        len -= item.len;
     }
 
-    //ESP_LOGI("TX", "📤 Raw data enqueued: %s", data);
+    //ESP_LOGI("TX", "📤 Raw data enqueued");
     return true;
 }
 
@@ -291,12 +340,9 @@ bool sim7600_wait_for_ip(int timeout_ms) {
 
 
 
-bool sim7600_network_init(void) {
+bool sim7600_wait_for_registration(int creg_attempts) {
     const char *resp;
 
-    //Check network registration
-    int creg_attempts = 80;
-
     ESP_LOGI(TAG, "Checking network registration status...");
 
     for (int i = 0; i < creg_attempts; i++) {
@@ -318,13 +364,18 @@ bool sim7600_network_init(void) {
         }
 
         if (i == creg_attempts - 1) {
-            ESP_LOGE(TAG, "❌ Network registration failed after %d attempts. Rebooting...", creg_attempts);
+            ESP_LOGE(TAG, "❌ Network registration failed after %d attempts", creg_attempts);
             return false;
         }
 
         vTaskDelay(pdMS_TO_TICKS(2000));
     }
-    
+    return true;
+}
+
+
+// Radio preferences, APN and its credentials; activating the context is up to the transport
+void sim7600_pdp_setup(void) {
     send_at_command("AT+CNMP=38", 2000);  // 38 = LTE only, int timeout_ms)
     send_at_command("AT+CMNB=3", 2000);    // Set LTE-only preference
     
@@ -338,11 +389,25 @@ bool sim7600_network_init(void) {
     char cmd[128];
 
     snprintf(cmd, sizeof(cmd), "AT+CGDCONT=1,\"IP\",\"%s\"", APN);
-    resp = send_at_command(cmd, 5000);
+    send_at_command(cmd, 5000);
 
     snprintf(cmd, sizeof(cmd), "AT+CGAUTH=1,1,\"%s\",\"%s\"", APN_USER, APN_PASS);
-    resp = send_at_command(cmd, 5000);
-    
+    send_at_command(cmd, 5000);
+}
+
+
+bool sim7600_network_init(void) {
+
+    //Check network registration
+    if (!sim7600_wait_for_registration(80)) {
+        return false;
+    }
+
+    sim7600_pdp_setup();
+
+    // RI pulses low on every URC: a +CMQTTRXSTART wakes us from light sleep
+    send_at_command("AT+CFGRI=1", 1000);
+
     send_at_command("AT+CGACT=1,1", 30000);
 
     send_at_command("AT+CGPADDR=1", 20000);
@@ -375,7 +440,9 @@ bool sim7600_network_init(void) {
         }
 
         cJSON_AddStringToObject(root, "sharedKeys",
-            "AuxTankMax,AuxTankRange,ExtTankMax,ExtTankRange,FillTime,PurgeTime,SleepTimeout,MinDEFLevel");
+            "AuxTankMax,AuxTankRange,ExtTankMax,ExtTankRange,FillTime,PurgeTime,SleepTimeout,MinDEFLevel,"
+            "TankMedian,TankEma,TankStep,TempMedian,TempEma,TempStep,"
+            "fw_title,fw_version,fw_checksum,fw_checksum_algorithm,fw_size");
 
         char *json_str = cJSON_PrintUnformatted(root);
         if (json_str) {
@@ -455,6 +522,12 @@ bool sim7600_network_init(void) {
         }
         vTaskDelay(1000 / portTICK_PERIOD_MS);
 
+        if (!sim7600_mqtt_subscribe(OTA_TOPIC_RESPONSE, 1)) {
+            ESP_LOGE("MQTT", "Failed to subscribe to OTA_TOPIC_RESPONSE");
+            success = false;
+        }
+        vTaskDelay(1000 / portTICK_PERIOD_MS);
+
         if (!request_all_shared_attributes()) {
             ESP_LOGE("MQTT", "Failed to request shared attributes");
             success = false;
@@ -462,9 +535,8 @@ bool sim7600_network_init(void) {
         vTaskDelay(1000 / portTICK_PERIOD_MS);
 
         if (!success) {
-            ESP_LOGE("MQTT", "One or more MQTT setup steps failed — restarting ESP");
-            vTaskDelay(2000 / portTICK_PERIOD_MS); // small delay before reset (optional)
-            esp_restart();
+            ESP_LOGE("MQTT", "One or more MQTT setup steps failed");
+            return false;
         }
         
         xEventGroupSetBits(systemEvents, MQTT_INIT);
@@ -512,7 +584,7 @@ bool sim7600_network_init(void) {
 
     // Send topic if '>' prompt expected
     if (strstr(resp, ">")) {
-        send_raw_uart_data(topic);
+        send_raw_uart_data(topic, strlen(topic));
         vTaskDelay(pdMS_TO_TICKS(500));
     }
 
@@ -529,12 +601,24 @@ bool sim7600_network_init(void) {
 
     //Publish Function
     bool sim7600_mqtt_publish(const char *topic, const char *payload) {
+        return sim7600_mqtt_publish_bytes(topic, payload, strlen(payload));
+    }
+
+    bool sim7600_mqtt_publish_bytes(const char *topic, const void *payload, size_t len) {
+        if (pppos_is_active()) {
+            bool ok = pppos_mqtt_publish(topic, payload, len);
+            modem_stats_publish(ok);
+            return ok;
+        }
+
         if (!xSemaphoreTake(publish_mutex, pdMS_TO_TICKS(10000))) {
         ESP_LOGW(TAG, "Timeout waiting for publish mutex");
+        link_failed("publish mutex");
         return false;
     }
         char cmd[128];
         const char *resp;
+        int64_t start = esp_timer_get_time();
 
         // Flush UART input to avoid stale junk
         uart_flush_input(SIM7600_UART_PORT);
@@ -545,122 +629,305 @@ bool sim7600_network_init(void) {
         resp = send_at_command(cmd, 10000);
         if (!resp || !strstr(resp, ">")) {
             ESP_LOGE(TAG, "❌ Failed to set topic");
-            //esp_restart(); // Restart if failed to set topic
             xSemaphoreGive(publish_mutex);
+            modem_stats_publish(false);
+            link_failed("AT+CMQTTTOPIC");
             return false;
         }
 
         
-        send_raw_uart_data(topic);
+        send_raw_uart_data(topic, strlen(topic));
         vTaskDelay(pdMS_TO_TICKS(100));
 
         // Step 2: Set payload
-        snprintf(cmd, sizeof(cmd), "AT+CMQTTPAYLOAD=0,%d", strlen(payload));
+        snprintf(cmd, sizeof(cmd), "AT+CMQTTPAYLOAD=0,%u", (unsigned)len);
         resp = send_at_command(cmd, 5000);
         if (!resp || !strstr(resp, ">")) {
             ESP_LOGE(TAG, "❌ Failed to set payload");
             xSemaphoreGive(publish_mutex);
+            modem_stats_publish(false);
+            link_failed("AT+CMQTTPAYLOAD");
             return false;
         }
 
         
-        send_raw_uart_data(payload);
+        send_raw_uart_data(payload, len);
         vTaskDelay(pdMS_TO_TICKS(100));
 
         // Step 3: Publish
         resp = send_at_command("AT+CMQTTPUB=0,1,60", 10000);
         if (resp && strstr(resp, "OK")) {
-            ESP_LOGI(TAG, "✅ Published %s to topic: %s", payload, topic);
+            TRACE_STR(ESP_LOG_INFO, TEV_MQTT_PUB, topic, len);
             vTaskDelay(200 / portTICK_PERIOD_MS); // Allow time for publish to complete
             xSemaphoreGive(publish_mutex);
+            modem_stats_publish(true);
+            modem_stats_acked((uint32_t)((esp_timer_get_time() - start) / 1000));
+            link_ok();
             return true;
         } else {
             ESP_LOGE(TAG, "❌ Publish failed");
             xSemaphoreGive(publish_mutex);
+            modem_stats_publish(false);
+            link_failed("AT+CMQTTPUB");
             return false;
         }
         
     }
 
+
+// ===== Transport Stats =====
+
+void modem_stats_publish(bool ok) {
+    taskENTER_CRITICAL(&stats_lock);
+    if (ok) {
+        transport_stats.publish_cnt++;
+    } else {
+        transport_stats.publish_fail++;
+    }
+    taskEXIT_CRITICAL(&stats_lock);
+}
+
+void modem_stats_acked(uint32_t latency_ms) {
+    taskENTER_CRITICAL(&stats_lock);
+    transport_stats.acked_cnt++;
+    transport_stats.latency_last_ms = latency_ms;
+    transport_stats.latency_sum_ms += latency_ms;
+    if (latency_ms > transport_stats.latency_max_ms) {
+        transport_stats.latency_max_ms = latency_ms;
+    }
+    taskEXIT_CRITICAL(&stats_lock);
+}
+
+void modem_stats_uart(uint32_t tx_bytes, uint32_t rx_bytes) {
+    taskENTER_CRITICAL(&stats_lock);
+    transport_stats.uart_tx_bytes += tx_bytes;
+    transport_stats.uart_rx_bytes += rx_bytes;
+    taskEXIT_CRITICAL(&stats_lock);
+}
+
+void modem_stats_get(mqtt_transport_stats_t *stats) {
+    taskENTER_CRITICAL(&stats_lock);
+    *stats = transport_stats;
+    taskEXIT_CRITICAL(&stats_lock);
+}
+
+static void modem_stats_log(void) {
+    mqtt_transport_stats_t st;
+    modem_stats_get(&st);
+
+    ESP_LOGI(TAG, "📊 MQTT over %s: %lu published, %lu failed, latency avg %lu ms / max %lu ms",
+             pppos_is_active() ? "PPPoS" : "AT",
+             (unsigned long)st.publish_cnt, (unsigned long)st.publish_fail,
+             (unsigned long)(st.acked_cnt ? st.latency_sum_ms / st.acked_cnt : 0),
+             (unsigned long)st.latency_max_ms);
+    if (!pppos_is_active() && st.publish_cnt) {
+        // Includes the AT traffic of GNSS and CSQ polling
+        ESP_LOGI(TAG, "📊 modem UART %lu B out, %lu B in, %lu B per publish",
+                 (unsigned long)st.uart_tx_bytes, (unsigned long)st.uart_rx_bytes,
+                 (unsigned long)((st.uart_tx_bytes + st.uart_rx_bytes) / st.publish_cnt));
+    }
+    if (pppos_is_active()) {
+        pppos_stats_log();
+    }
+}
+
 // ===== Modem Functions =====
 
 
     void modem_update_signal_quality(void) {
         
         if (!xSemaphoreTake(publish_mutex, pdMS_TO_TICKS(10000))) {
-        ESP_LOGW(TAG, "Timeout waiting for publish mutex");
-        esp_restart(); // Restart if mutex not available
+            ESP_LOGW(TAG, "Timeout waiting for publish mutex");
+            link_failed("publish mutex");
+            return;
         }
 
-        uart_flush(UART_NUM_2);
+        // Over PPPoS the UART belongs to esp_modem
+        if (!pppos_is_active()) {
+            uart_flush(SIM7600_UART_PORT);
+        }
 
         const char *resp = send_at_command("AT+CSQ", 5000);
         vTaskDelay(10 / portTICK_PERIOD_MS); // Allow time for response to be processed
         
+        int rssi = 0, ber = 0;
+        const char *csq = resp ? strstr(resp, "+CSQ:") : NULL;
 
         if (!resp) {
             ESP_LOGW(TAG, "⚠️ No response to AT+CSQ");
-            return;
-        }
-
-        const char *csq = strstr(resp, "+CSQ:");
-        if (!csq) {
+        } else if (!csq) {
             ESP_LOGW(TAG, "⚠️ +CSQ not found in response");
-            return;
-        }
-
-        int rssi = 0, ber = 0;
-        if (sscanf(csq, "+CSQ: %d,%d", &rssi, &ber) != 2) {
+        } else if (sscanf(csq, "+CSQ: %d,%d", &rssi, &ber) != 2) {
             ESP_LOGW(TAG, "⚠️ Failed to parse CSQ response");
-            return;
+        } else {
+            // Update your global or shared telemetry structure
+            shared_sensor_data.csq = rssi;
+            ESP_LOGI(TAG, "📶 Signal updated: RSSI = %d, BER = %d", rssi, ber);
         }
 
-        // Update your global or shared telemetry structure
-        shared_sensor_data.csq = rssi;
-
-        ESP_LOGI(TAG, "📶 Signal updated: RSSI = %d, BER = %d", rssi, ber);
         xSemaphoreGive(publish_mutex);
-
     }
 
 
 
 
 
-// ===== Main Task =====
+// ===== Link Recovery =====
 
-void modem_task(void *param) {
-    sim7600_init();
+static bool use_pppos = false;      // Transport that came up at boot, kept until the next one
+static volatile bool shut_down = false;     // modem_shutdown(): the link stays down
 
-    if (!sim7080_wait_for_sim_and_signal(500, 3000)) {
-        ESP_LOGE(TAG, "Network discovery failed");
-        esp_restart(); // Restart if SIM or signal not ready
+// Drop the AT+CMQTT client so sim7600_mqtt_cmqtt_setup() can start from scratch
+static void at_mqtt_release(void) {
+    send_at_command("AT+CMQTTDISC=0,60", 10000);
+    send_at_command("AT+CMQTTREL=0", 5000);
+    send_at_command("AT+CMQTTSTOP", 10000);
+}
+
+// Redo the bring-up from the step `level` resets: everything after it follows
+static bool at_recover(link_level_t level) {
+    if (level < LINK_LEVEL_POWER) {
+        at_mqtt_release();
     }
 
-    if (!sim7600_network_init()) {
-        ESP_LOGE(TAG, "Network init failed");
-        esp_restart(); // Restart if network init failed
+    switch (level) {
+    case LINK_LEVEL_POWER:
+        sim7600_power_cycle();
+        break;
+    case LINK_LEVEL_RADIO:
+        send_at_command("AT+CFUN=0", 10000);
+        vTaskDelay(pdMS_TO_TICKS(2000));
+        send_at_command("AT+CFUN=1", 10000);
+        break;
+    case LINK_LEVEL_PDP:
+        send_at_command("AT+CGACT=0,1", 20000);
+        break;
+    default:
+        break;
     }
 
+    if (level >= LINK_LEVEL_RADIO && !sim7080_wait_for_sim_and_signal(MODEM_RECOVER_SIM_ATTEMPTS, 3000)) {
+        return false;
+    }
+    if (level >= LINK_LEVEL_PDP && !sim7600_network_init()) {
+        return false;
+    }
+    return sim7600_mqtt_cmqtt_setup(MQTT_BROKER, MQTT_PORT, MQTT_CLIENT_ID, MQTT_USERNAME, MQTT_PASSWORD);
+}
 
-    
-    if (!sim7600_mqtt_cmqtt_setup(MQTT_BROKER, MQTT_PORT, MQTT_CLIENT_ID, MQTT_USERNAME, MQTT_PASSWORD)) {
-        ESP_LOGE(TAG, "MQTT connection failed");
-        esp_restart(); // Restart if MQTT connection failed
+// link_init() skips PDP and radio here: the PDP context is the PPP session, and
+// AT+CFUN would take CMUX down with it. The power cycle redoes both
+static bool pppos_recover(link_level_t level) {
+    if (level == LINK_LEVEL_MQTT) {
+        return pppos_mqtt_reconnect();
     }
 
+    pppos_stop();
+    sim7600_power_cycle();
+    return pppos_start();
+}
 
-    while (1) {
+static void modem_recover(link_level_t level) {
+    if (shut_down) {
+        return;
+    }
+    if (level == LINK_LEVEL_REBOOT) {
+        ESP_LOGE(TAG, "❌ Link not recovering, restarting ESP");
+        link_health_log();
+        vTaskDelay(pdMS_TO_TICKS(2000));
+        esp_restart();
+    }
 
-         
+    ESP_LOGW(TAG, "🔧 Link recovery: %s", link_level_str(level));
 
-        vTaskDelay(pdMS_TO_TICKS(180000));
-        
+    // Publishers wait for MQTT_INIT again; GNSS and CSQ polling for the mutex
+    xEventGroupClearBits(systemEvents, MQTT_INIT);
+    bool locked = xSemaphoreTake(publish_mutex, pdMS_TO_TICKS(MODEM_RECOVER_LOCK_MS)) == pdTRUE;
 
-        modem_update_signal_quality(); 
+    // Dialling and CMUX setup go through esp_modem, not send_at_command()
+    power_lock(POWER_LOCK_MODEM);
+    bool ok = use_pppos ? pppos_recover(level) : at_recover(level);
+    power_unlock(POWER_LOCK_MODEM);
 
-        
+    if (locked) {
+        xSemaphoreGive(publish_mutex);
     }
+    link_recovered(level, ok);
 }
 
 
+// ===== Shutdown =====
+
+void modem_shutdown(void) {
+    shut_down = true;
+    ESP_LOGW(TAG, "🔌 Shutting the modem down");
+
+    xEventGroupClearBits(systemEvents, MQTT_INIT);
+    bool locked = xSemaphoreTake(publish_mutex, pdMS_TO_TICKS(MODEM_RECOVER_LOCK_MS)) == pdTRUE;
+    power_lock(POWER_LOCK_MODEM);
+
+    if (pppos_is_active()) {
+        pppos_shutdown();
+    } else if (!use_pppos && at_send_queue != NULL) {
+        at_mqtt_release();
+        send_at_command("AT+CPOF", 5000);
+    }
+    sim7600_power_off();
+
+    power_unlock(POWER_LOCK_MODEM);
+    if (locked) {
+        xSemaphoreGive(publish_mutex);
+    }
+}
+
+
+// ===== Main Task =====
+
+void modem_task(void *param) {
+#if MQTT_TRANSPORT == MQTT_TRANSPORT_PPPOS
+    modem_locks_init();
+    sim7600_power_cycle();
+
+    power_lock(POWER_LOCK_MODEM);
+    use_pppos = pppos_start();
+    power_unlock(POWER_LOCK_MODEM);
+    if (!use_pppos) {
+        // The AT+CMQTT path power cycles the modem, so it starts from a clean state
+        ESP_LOGW(TAG, "⚠️ PPPoS bring-up failed, falling back to AT+CMQTT");
+        pppos_stop();
+    }
+#endif
+
+    link_init(use_pppos ? BIT(LINK_LEVEL_PDP) | BIT(LINK_LEVEL_RADIO) : 0);
+
+    // A failed step is left to the supervisor below, from the level that redoes it
+    if (!use_pppos) {
+        // POWER_LOCK_MODEM only for each AT exchange: between them MODEM_RI
+        // wakes us for a URC, and rx_task holds on for the rest of it
+        sim7600_init();
+
+        if (!sim7080_wait_for_sim_and_signal(500, 3000)) {
+            link_down("Network discovery", LINK_LEVEL_POWER);
+        } else if (!sim7600_network_init()) {
+            link_down("Network init", LINK_LEVEL_PDP);
+        } else if (!sim7600_mqtt_cmqtt_setup(MQTT_BROKER, MQTT_PORT, MQTT_CLIENT_ID, MQTT_USERNAME, MQTT_PASSWORD)) {
+            link_down("MQTT connection", LINK_LEVEL_MQTT);
+        }
+    }
+
+
+    while (1) {
+        // Signal and stats every MODEM_POLL_MS, recoveries as soon as they're due
+        link_level_t level = link_wait_recovery(MODEM_POLL_MS);
+        if (level != LINK_LEVEL_RETRY) {
+            modem_recover(level);
+            continue;
+        }
+
+        modem_update_signal_quality(); 
+
+        modem_stats_log();
+        link_health_log();
+        power_log();
+    }
+}
@@ -2,6 +2,7 @@
 #define SIM7600_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -21,6 +22,9 @@ extern "C" {
 #define MQTT_PASSWORD    "dev"
 
 #define MQTT_TOPIC_PUB   "v1/devices/me/telemetry"       //topic for publishing telemetry data
+#define MQTT_TOPIC_PUB_CBOR "tlm/" MQTT_CLIENT_ID "/cbor" //CBOR telemetry, for the ThingsBoard MQTT integration in tools/
+#define MQTT_TOPIC_DIAG  "diag/" MQTT_CLIENT_ID           //diag.h task, heap and queue samples, JSON
+#define MQTT_TOPIC_TRACE "trace/" MQTT_CLIENT_ID          //trace.h events before a crash, binary
 #define MQTT_ATRR_SUBSCRIBE "v1/devices/me/attributes"   //subscribe to attributes
 #define MQTT_RPC_REQUEST "v1/devices/me/rpc/request/+"   //subscribe to RPC requests
 
@@ -35,9 +39,62 @@ extern "C" {
 #define EVENT_QUEUE_LEN    10
 #define AT_RESP_QUEUE_LEN  20
 
+#define MODEM_POLL_MS               180000  // Signal quality and stats
+#define MODEM_RECOVER_SIM_ATTEMPTS  40      // 3 s apart, after a radio reset or power cycle
+#define MODEM_RECOVER_LOCK_MS       30000   // Wait for a publish in progress before recovering
+
+// What rx_task passes to mqtt_urc_task: URC lines, and the topic and payload
+// bytes of a +CMQTTRX block as counted by their +CMQTTRXTOPIC/+CMQTTRXPAYLOAD
+#define URC_QUEUE_LEN      16
+#define URC_CHUNK_SIZE     256
+#define URC_SEND_WAIT_MS   100     // rx_task waits this long for mqtt_urc_task, then drops
+
+typedef enum {
+    URC_LINE = 0,                   // data is NUL terminated
+    URC_TOPIC,
+    URC_PAYLOAD,
+} urc_kind_t;
+
+typedef struct {
+    uint8_t kind;
+    uint16_t len;
+    char data[URC_CHUNK_SIZE];
+} urc_item_t;
+
+// One write for tx_task: commands get "\r\n" appended, raw data goes out as is
+typedef struct {
+    uint16_t len;
+    bool raw;
+    char data[SIM7600_UART_BUF_SIZE];
+} at_tx_item_t;
+
+
+// ===== MQTT transport =====
+
+// AT:    the SIM7600's own MQTT stack, driven with AT+CMQTT* over the AT UART
+// PPPOS: the modem carries PPP on a CMUX channel and esp-mqtt keeps the ThingsBoard
+//        session; AT commands (GNSS, CSQ) go over the second channel. Falls back to
+//        AT at runtime if the PPP link doesn't come up
+// AT stays the default until the per-transport stats modem_task logs have been
+// measured on devices in the field
+#define MQTT_TRANSPORT_AT       0
+#define MQTT_TRANSPORT_PPPOS    1
+
+#define MQTT_TRANSPORT          MQTT_TRANSPORT_AT
+
+typedef struct {
+    uint32_t publish_cnt;       // Publishes accepted by the transport
+    uint32_t publish_fail;
+    uint32_t acked_cnt;         // Publishes with a measured latency
+    uint32_t latency_last_ms;   // AT: the whole AT+CMQTT sequence, PPPoS: until PUBACK
+    uint32_t latency_max_ms;
+    uint64_t latency_sum_ms;
+    uint32_t uart_tx_bytes;     // Modem UART traffic, AT transport only
+    uint32_t uart_rx_bytes;
+} mqtt_transport_stats_t;
+
 extern SemaphoreHandle_t at_mutex;
 extern SemaphoreHandle_t publish_mutex;           // Mutex to protect AT command access
-extern SemaphoreHandle_t publish_trigger; // Semaphore to trigger
 
 
 
@@ -56,16 +113,31 @@ void sim7600_power_on(void);
 void sim7600_power_off(void);
 
 void sim7600_send_command(const char* command);
+void sim7600_send_raw(const char *data, size_t len);
+bool send_raw_uart_data(const char *data, size_t len);
 int  sim7600_read_response(char *buffer, uint32_t buffer_size, int timeout_ms);
 const char* send_at_command(const char *command, int timeout_ms);
 
 bool sim7600_wait_for_network(int attempts, int delay_ms);
+bool sim7080_wait_for_sim_and_signal(int max_attempts, int delay_ms);
+bool sim7600_wait_for_registration(int creg_attempts);
+void sim7600_pdp_setup(void);
 bool sim7600_network_init(void);
 bool sim7600_mqtt_connect(void);
 bool sim7600_mqtt_publish(const char *topic, const char *message);
+bool sim7600_mqtt_publish_bytes(const char *topic, const void *payload, size_t len);
 bool sim7600_mqtt_subscribe(const char *topic, int qos);
 bool request_all_shared_attributes(void);
 
+void modem_stats_publish(bool ok);
+void modem_stats_acked(uint32_t latency_ms);
+void modem_stats_uart(uint32_t tx_bytes, uint32_t rx_bytes);
+void modem_stats_get(mqtt_transport_stats_t *stats);
+
+
+// For deep sleep: leaves the broker and the network, powers the modem off and
+// keeps modem_task from recovering it. Waits up to MODEM_RECOVER_LOCK_MS for a publish
+void modem_shutdown(void);
 
 void modem_task(void *param);
 void monitor_task(void *param);
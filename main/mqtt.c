@@ -11,19 +11,26 @@
 #include "main.h"
 #include "message_ids.h"
 #include "publish.h"
+#include "json_stream.h"
 
 #include <string.h>
 #include <stdio.h>
+#include <stddef.h>
 #include <stdbool.h>
 #include "esp_system.h"
 #include "nvs.h"
 #include "nvs_flash.h"
 #include "cJSON.h"
+#include "diag.h"
+#include "history.h"
+#include "ota.h"
+#include "trace.h"
 
 #define MQTT_CLIENT_IDX         0
 
 #define TOPIC_ATTR_UPDATES      "v1/devices/me/attributes"
 #define TOPIC_RPC_REQUEST_BASE  "v1/devices/me/rpc/request/"
+#define TOPIC_RPC_RESPONSE_BASE "v1/devices/me/rpc/response/"
 #define TOPIC_ATTR_REQUEST_BASE "v1/devices/me/attributes/response/1"
 
 
@@ -31,362 +38,735 @@
 static const char *TAG = "MQTT";
 
 
-// Entry point: called from URC handler when +QMTRECV lines arrive
-void mqtt_handle_urc(const char *urc) {
-    static bool in_mqtt_block = false;
-    static char current_topic[128] = {0};
-    static char current_payload[512] = {0};
+///////////////shared attributes//////////////
+
+// A setting the server can push: its attribute name and where it lives in shared_settings_t
+typedef struct {
+    const char *key;
+    bool is_float;                      // Else int32_t
+    size_t offset;
+} attr_key_t;
+
+static const attr_key_t attr_keys[SETTING_COUNT] = {
+    [SETTING_AUX_RANGE]     = { KEY_AUX_RANGE,     true,  offsetof(shared_settings_t, aux_range) },
+    [SETTING_AUX_MAX]       = { KEY_AUX_MAX,       true,  offsetof(shared_settings_t, aux_max) },
+    [SETTING_EXT_RANGE]     = { KEY_EXT_RANGE,     true,  offsetof(shared_settings_t, ext_range) },
+    [SETTING_EXT_MAX]       = { KEY_EXT_MAX,       true,  offsetof(shared_settings_t, ext_max) },
+    [SETTING_FILL_TIME]     = { KEY_FILL_TIME,     false, offsetof(shared_settings_t, fill_time) },
+    [SETTING_PURGE_TIME]    = { KEY_PURGE_TIME,    false, offsetof(shared_settings_t, purge_time) },
+    [SETTING_SLEEP_TIMEOUT] = { KEY_SLEEP_TIMEOUT, false, offsetof(shared_settings_t, sleep_timeout) },
+    [SETTING_MIN_DEF_LEVEL] = { KEY_MIN_DEF_LEVEL, false, offsetof(shared_settings_t, min_def_level) },
+    [SETTING_TANK_MEDIAN]   = { KEY_TANK_MEDIAN,   false, offsetof(shared_settings_t, tank_median) },
+    [SETTING_TANK_EMA]      = { KEY_TANK_EMA,      false, offsetof(shared_settings_t, tank_ema) },
+    [SETTING_TANK_STEP]     = { KEY_TANK_STEP,     false, offsetof(shared_settings_t, tank_step) },
+    [SETTING_TEMP_MEDIAN]   = { KEY_TEMP_MEDIAN,   false, offsetof(shared_settings_t, temp_median) },
+    [SETTING_TEMP_EMA]      = { KEY_TEMP_EMA,      false, offsetof(shared_settings_t, temp_ema) },
+    [SETTING_TEMP_STEP]     = { KEY_TEMP_STEP,     false, offsetof(shared_settings_t, temp_step) },
+};
+
+// What the master keeps: a change to these has to be sent to it
+#define SETTINGS_MASTER_MASK    (BIT(SETTING_FILL_TIME) | BIT(SETTING_PURGE_TIME) | \
+                                 BIT(SETTING_SLEEP_TIMEOUT) | BIT(SETTING_MIN_DEF_LEVEL))
+
+// Copy of the KEY_SETTINGS record, so readers and unchanged updates don't touch flash
+static shared_settings_t settings = { .version = SETTINGS_VERSION };
+static portMUX_TYPE settings_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static json_stream_t attr_parser;
+static bool attr_found[SETTING_COUNT];
+static double attr_value[SETTING_COUNT];
+
+
+static float *setting_float(shared_settings_t *s, int id) {
+    return (float *)((uint8_t *)s + attr_keys[id].offset);
+}
 
-    ESP_LOGI(TAG, "Received URC: %s", urc);
+static int32_t *setting_int(shared_settings_t *s, int id) {
+    return (int32_t *)((uint8_t *)s + attr_keys[id].offset);
+}
 
-    // Start of MQTT RX block
-    if (strstr(urc, "+CMQTTRXSTART:")) {
-        in_mqtt_block = true;
-        current_topic[0] = '\0';
-        current_payload[0] = '\0';
-        return;
+static esp_err_t settings_write(const shared_settings_t *s) {
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(NS_ATTR, NVS_READWRITE, &h);
+    if (err != ESP_OK) return err;
+
+    err = nvs_set_blob(h, KEY_SETTINGS, s, sizeof(*s));
+    if (err == ESP_OK) {
+        err = nvs_commit(h);
     }
+    nvs_close(h);
+    return err;
+}
 
-    // Topic line (actual topic follows +CMQTTRXTOPIC)
-    if (in_mqtt_block && strstr(urc, "+CMQTTRXTOPIC:")) {
-        // Next line will contain the topic
-        return;
+// Older firmware kept one NVS entry per attribute: read those into `s`, then drop them
+static void settings_migrate(nvs_handle_t h, shared_settings_t *s) {
+    for (int i = 0; i < SETTING_COUNT; i++) {
+        esp_err_t err;
+        if (attr_keys[i].is_float) {
+            size_t size = sizeof(float);
+            err = nvs_get_blob(h, attr_keys[i].key, setting_float(s, i), &size);
+        } else {
+            err = nvs_get_i32(h, attr_keys[i].key, setting_int(s, i));
+        }
+        if (err == ESP_OK) {
+            s->present |= BIT(i);
+            nvs_erase_key(h, attr_keys[i].key);
+        }
     }
+}
+
+void mqtt_settings_load(void) {
+    shared_settings_t loaded = { .version = SETTINGS_VERSION };
 
-    // Payload line (after +CMQTTRXPAYLOAD)
-    if (in_mqtt_block && strstr(urc, "+CMQTTRXPAYLOAD:")) {
-        // Next line will contain JSON payload
+    nvs_handle_t h;
+    if (nvs_open(NS_ATTR, NVS_READWRITE, &h) != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to open NVS namespace: %s", NS_ATTR);
         return;
     }
 
-    // End of MQTT RX block
-    if (strstr(urc, "+CMQTTRXEND:")) {
-        in_mqtt_block = false;
-
-        // Classify and dispatch
-        if (strlen(current_topic) > 0 && strlen(current_payload) > 0) {
-            if (strcmp(current_topic, TOPIC_ATTR_UPDATES) == 0) {
-                handle_shared_attributes(current_payload);
-            } 
-            else if (strncmp(current_topic, TOPIC_RPC_REQUEST_BASE,
-                               strlen(TOPIC_RPC_REQUEST_BASE)) == 0) {
-                handle_rpc_request(current_topic, current_payload);
-            } 
-            else if (strncmp(current_topic, TOPIC_ATTR_REQUEST_BASE,
-                                strlen(TOPIC_ATTR_REQUEST_BASE)) == 0) {
-                handle_shared_attributes(current_payload);
-            }
-            
-            else {
-                ESP_LOGW(TAG, "Unhandled topic: %s with payload: %s",
-                         current_topic, current_payload);
-            }
+    size_t size = sizeof(loaded);
+    esp_err_t err = nvs_get_blob(h, KEY_SETTINGS, &loaded, &size);
+    if (err == ESP_OK && size == SETTINGS_V1_SIZE && loaded.version == 1) {
+        // Without the filter settings, which keep their defaults: written as v2 on the next change
+        ESP_LOGI(TAG, "Settings record v1 read as v%d", SETTINGS_VERSION);
+        loaded.version = SETTINGS_VERSION;
+        size = sizeof(loaded);
+    }
+    if (err == ESP_OK && size == sizeof(loaded) && loaded.version == SETTINGS_VERSION) {
+        nvs_close(h);
+        ESP_LOGI(TAG, "Settings record loaded, written %lu times", (unsigned long)loaded.writes);
+    } else {
+        if (err == ESP_OK) {
+            ESP_LOGW(TAG, "Settings record v%u (%u B) not readable, starting over", loaded.version, (unsigned)size);
         }
+        memset(&loaded, 0, sizeof(loaded));
+        loaded.version = SETTINGS_VERSION;
+        settings_migrate(h, &loaded);
+        nvs_close(h);
+
+        if (loaded.present) {
+            loaded.writes = 1;
+            err = settings_write(&loaded);
+            ESP_LOGI(TAG, "Settings 0x%02x moved to one record: %s", loaded.present, esp_err_to_name(err));
+        }
+    }
+
+    taskENTER_CRITICAL(&settings_lock);
+    settings = loaded;
+    taskEXIT_CRITICAL(&settings_lock);
+}
+
+void mqtt_settings_get(shared_settings_t *out) {
+    taskENTER_CRITICAL(&settings_lock);
+    *out = settings;
+    taskEXIT_CRITICAL(&settings_lock);
+}
+
+void mqtt_settings_restore(const shared_settings_t *saved) {
+    if (saved->version != SETTINGS_VERSION) {
+        mqtt_settings_load();
+        return;
+    }
+    taskENTER_CRITICAL(&settings_lock);
+    settings = *saved;
+    taskEXIT_CRITICAL(&settings_lock);
+}
+
+
+// Settings sit at the top of an update, under "shared" in the response to our request
+static void attributes_value(void *ctx, int depth, const char *parent, const char *key,
+                             json_stream_type_t type, const char *value) {
+    if (key == NULL) return;
+    if (depth != 1 && !(depth == 2 && parent && strcmp(parent, "shared") == 0)) return;
+
+    // fw_title, fw_version, ...: a firmware package assigned to the device
+    if (strncmp(key, "fw_", 3) == 0) {
+        ota_attribute(key, value);
         return;
     }
+    if (type != JSON_STREAM_NUMBER) return;
 
-    // If we're inside a message block but this line is not a header, it's data
-    if (in_mqtt_block) {
-        if (current_topic[0] == '\0') {
-            // First data line after +CMQTTRXTOPIC is the topic
-            strncpy(current_topic, urc, sizeof(current_topic) - 1);
-        } else if (current_payload[0] == '\0' && strchr(urc, '{')) {
-            // First line containing '{' after +CMQTTRXPAYLOAD is payload
-            strncpy(current_payload, urc, sizeof(current_payload) - 1);
+    for (int i = 0; i < SETTING_COUNT; i++) {
+        if (strcmp(key, attr_keys[i].key) == 0) {
+            attr_value[i] = strtod(value, NULL);
+            attr_found[i] = true;
+            return;
         }
     }
 }
 
+static void attributes_begin(const char *topic) {
+    memset(attr_found, 0, sizeof(attr_found));
+    json_stream_init(&attr_parser, attributes_value, NULL);
+}
+
+static void attributes_data(const char *data, size_t len) {
+    json_stream_feed(&attr_parser, data, len);
+}
 
-// Parse shared attributes JSON and store floats (2dp) in NVS
-void handle_shared_attributes(const char *json) {
-    ESP_LOGI(TAG, "Handling shared attributes: %s", json);
+// From master_tx_task: the outcome of a settings update, nothing waits for it
+static void settings_sent(command_result_t result, void *arg) {
+    if (result != CMD_DELIVERED && result != CMD_SENT) {
+        ESP_LOGE(TAG, "❌ Settings not delivered to the master: %s", command_result_str(result));
+    }
+}
 
-    cJSON *root = cJSON_Parse(json);
-    if (!root) {
+// Every reconnect requests all attributes again, so most of these change nothing.
+// Only real changes are written (as one record), sent to the master and published.
+// On the MQTT receive path: the master's ACK is left to settings_sent()
+static void attributes_end(bool complete) {
+    if (!complete || !json_stream_finish(&attr_parser)) {
         ESP_LOGW(TAG, "Failed to parse shared attributes JSON");
+        ota_attributes_done(false);
         return;
     }
+    ota_attributes_done(true);
+
+    shared_settings_t updated;
+    mqtt_settings_get(&updated);
+    uint16_t changed = 0;
+
+    for (int i = 0; i < SETTING_COUNT; i++) {
+        if (!attr_found[i]) continue;
+
+        bool present = updated.present & BIT(i);
+        if (attr_keys[i].is_float) {
+            float *val = setting_float(&updated, i);
+            float float_val = (float)attr_value[i];
+            if (present && *val == float_val) continue;
+            ESP_LOGI(TAG, "%s = %.2f", attr_keys[i].key, float_val);
+            *val = float_val;
+        } else {
+            int32_t *val = setting_int(&updated, i);
+            int32_t int_val = (int32_t)attr_value[i];
+            if (present && *val == int_val) continue;
+            ESP_LOGI(TAG, "%s = %ld", attr_keys[i].key, (long)int_val);
+            *val = int_val;
+        }
+        updated.present |= BIT(i);
+        changed |= BIT(i);
+    }
 
-   
+    if (!changed) {
+        ESP_LOGI(TAG, "Shared attributes unchanged, nothing to store");
+        return;
+    }
 
-    cJSON *container = cJSON_GetObjectItem(root, "shared");
-    if (!cJSON_IsObject(container)) {
-        container = root;  // fallback to root if not wrapped
+    updated.writes++;
+    esp_err_t err = settings_write(&updated);
+    if (err != ESP_OK) {
+        // Still used until the next boot, which gets them from the server again
+        ESP_LOGE(TAG, "❌ Settings not stored: %s", esp_err_to_name(err));
     }
 
+    taskENTER_CRITICAL(&settings_lock);
+    settings = updated;
+    taskEXIT_CRITICAL(&settings_lock);
 
-    nvs_handle_t h;
-    if (nvs_open(NS_ATTR, NVS_READWRITE, &h) == ESP_OK) {
-        cJSON *item;
-        float float_val;
-        int int_val;
-
-        // AUX_RANGE
-        item = cJSON_GetObjectItem(container, KEY_AUX_RANGE);
-        if (cJSON_IsNumber(item)) {
-            float_val = (float)item->valuedouble;
-            ESP_LOGI(TAG, "KEY_AUX_RANGE = %.2f", float_val);
-            nvs_set_blob(h, KEY_AUX_RANGE, &float_val, sizeof(float_val));
-        } else {
-            ESP_LOGI(TAG, "KEY_AUX_RANGE not found in JSON");
-        }
+    if (changed & SETTINGS_MASTER_MASK) {
+        // Send the values in data0–data3
+        ESP_LOGI(TAG, "Sending updated system message with fillTime: %ld, purgeTime: %ld, sleepTimeout: %ld, minDEFLevel: %ld",
+                 (long)updated.fill_time, (long)updated.purge_time, (long)updated.sleep_timeout, (long)updated.min_def_level);
+        master_link_send(MSG_ID_SETTINGS, MSG_TYPE_DATA, (uint16_t)updated.fill_time, (uint16_t)updated.purge_time,
+                         (uint16_t)updated.sleep_timeout, (uint16_t)updated.min_def_level, settings_sent, NULL);
+    }
+    publish_data();
+}
 
-        // AUX_MAX
-        item = cJSON_GetObjectItem(container, KEY_AUX_MAX);
-        if (cJSON_IsNumber(item)) {
-            float_val = (float)item->valuedouble;
-            ESP_LOGI(TAG, "KEY_AUX_MAX = %.2f", float_val);
-            nvs_set_blob(h, KEY_AUX_MAX, &float_val, sizeof(float_val));
-        } else {
-            ESP_LOGI(TAG, "KEY_AUX_MAX not found in JSON");
-        }
 
-        // EXT_RANGE
-        item = cJSON_GetObjectItem(container, KEY_EXT_RANGE);
-        if (cJSON_IsNumber(item)) {
-            float_val = (float)item->valuedouble;
-            ESP_LOGI(TAG, "KEY_EXT_RANGE = %.2f", float_val);
-            nvs_set_blob(h, KEY_EXT_RANGE, &float_val, sizeof(float_val));
-        } else {
-            ESP_LOGI(TAG, "KEY_EXT_RANGE not found in JSON");
+///////////////RPC//////////////
+
+// A request waiting for the master's ACK before it can be answered
+typedef struct {
+    bool used;
+    bool reboot;                        // Restart once answered
+    char req_id[RPC_ID_MAX];
+    command_result_t result;
+} rpc_ctx_t;
+
+typedef enum {
+    RPC_FREE = 0,
+    RPC_PENDING,                        // Sent to the master, no response yet
+    RPC_DONE,                           // Answered with `result`
+    RPC_UNKNOWN,                        // Answered with an error, nothing was run
+} rpc_state_t;
+
+// Recently seen request ids, so a retried RPC gets the first answer again
+typedef struct {
+    char req_id[RPC_ID_MAX];
+    uint8_t state;
+    command_result_t result;
+} rpc_seen_t;
+
+static rpc_ctx_t rpc_pool[RPC_POOL_SIZE];
+static rpc_seen_t rpc_seen[RPC_DEDUP_SIZE];
+static int rpc_seen_next = 0;
+static portMUX_TYPE rpc_lock = portMUX_INITIALIZER_UNLOCKED;
+static QueueHandle_t rpc_done_queue = NULL;     // rpc_ctx_t * answered by the master
+
+
+static rpc_seen_t *rpc_seen_find(const char *req_id) {
+    for (int i = 0; i < RPC_DEDUP_SIZE; i++) {
+        if (rpc_seen[i].state != RPC_FREE && strcmp(rpc_seen[i].req_id, req_id) == 0) {
+            return &rpc_seen[i];
         }
+    }
+    return NULL;
+}
 
-        // EXT_MAX
-        item = cJSON_GetObjectItem(container, KEY_EXT_MAX);
-        if (cJSON_IsNumber(item)) {
-            float_val = (float)item->valuedouble;
-            ESP_LOGI(TAG, "KEY_EXT_MAX = %.2f", float_val);
-            nvs_set_blob(h, KEY_EXT_MAX, &float_val, sizeof(float_val));
-        } else {
-            ESP_LOGI(TAG, "KEY_EXT_MAX not found in JSON");
-        }
+static void rpc_seen_set(const char *req_id, rpc_state_t state, command_result_t result) {
+    taskENTER_CRITICAL(&rpc_lock);
+    rpc_seen_t *seen = rpc_seen_find(req_id);
+    if (seen == NULL) {
+        // Over the oldest
+        seen = &rpc_seen[rpc_seen_next];
+        rpc_seen_next = (rpc_seen_next + 1) % RPC_DEDUP_SIZE;
+        strlcpy(seen->req_id, req_id, sizeof(seen->req_id));
+    }
+    seen->state = state;
+    seen->result = result;
+    taskEXIT_CRITICAL(&rpc_lock);
+}
 
-        // Fill time (int)
-        item = cJSON_GetObjectItem(container, KEY_FILL_TIME);
-        if (cJSON_IsNumber(item)) {
-            int_val = (int)item->valuedouble;
-            ESP_LOGI(TAG, "KEY_FILL_TIME = %d", int_val);
-            nvs_set_i32(h, KEY_FILL_TIME, int_val);
-        }
+static void rpc_respond(const char *req_id, rpc_state_t state, command_result_t result) {
+    cJSON *response = cJSON_CreateObject();
+    if (response == NULL) {
+        ESP_LOGE("RPC", "Failed to create cJSON object");
+        return;
+    }
 
-        // Purge time (int)
-        item = cJSON_GetObjectItem(container, KEY_PURGE_TIME);
-        if (cJSON_IsNumber(item)) {
-            int_val = (int)item->valuedouble;
-            ESP_LOGI(TAG, "KEY_PURGE_TIME = %d", int_val);
-            nvs_set_i32(h, KEY_PURGE_TIME, int_val);
-        }
+    if (state == RPC_UNKNOWN) {
+        cJSON_AddStringToObject(response, "error", "unknown method");
+        cJSON_AddBoolToObject(response, "success", false);
+    } else {
+        // What the master made of it, not just that we got the request
+        cJSON_AddStringToObject(response, "delivery", command_result_str(result));
+        cJSON_AddBoolToObject(response, "success", result == CMD_DELIVERED || result == CMD_SENT);
+    }
 
-        // Sleep timeout (int)
-        item = cJSON_GetObjectItem(container, KEY_SLEEP_TIMEOUT);
-        if (cJSON_IsNumber(item)) {
-            int_val = (int)item->valuedouble;
-            ESP_LOGI(TAG, "KEY_SLEEP_TIMEOUT = %d", int_val);
-            nvs_set_i32(h, KEY_SLEEP_TIMEOUT, int_val);
-        }
+    send_rpc_response(req_id, response);
+    cJSON_Delete(response);
+}
+
+// From master_tx_task: hand over to rpc_response_task, which may publish
+static void rpc_command_done(command_result_t result, void *arg) {
+    rpc_ctx_t *ctx = arg;
+    ctx->result = result;
+    xQueueSend(rpc_done_queue, &ctx, 0);    // One slot per context: never full
+}
 
-        // Min DEF Level (int)
-        item = cJSON_GetObjectItem(container, KEY_MIN_DEF_LEVEL);
-        if (cJSON_IsNumber(item)) {
-            int_val = (int)item->valuedouble;
-            ESP_LOGI(TAG, "KEY_MIN_DEF_LEVEL = %d", int_val);
-            nvs_set_i32(h, KEY_MIN_DEF_LEVEL, int_val);
+// The history chart and summary: answered here, nothing goes to the master.
+// Not remembered either, a server retry just runs them again
+static const struct {
+    const char *method;
+    history_tier_t tier;                // HISTORY_TIERS: back to the dashboard
+} history_methods[] = {
+    { "History1m",  HISTORY_1MIN },
+    { "History15m", HISTORY_15MIN },
+    { "History1h",  HISTORY_1H },
+    { "Dashboard",  HISTORY_TIERS },
+};
+
+static bool rpc_local(const char *req_id, const char *method_str) {
+    cJSON *result = NULL;
+
+    if (strcmp(method_str, "HistorySummary") == 0) {
+        result = cJSON_CreateObject();
+        history_summary(cJSON_AddObjectToObject(result, "history"));
+    }
+    for (int i = 0; result == NULL && i < (int)(sizeof(history_methods) / sizeof(history_methods[0])); i++) {
+        if (strcmp(method_str, history_methods[i].method) == 0) {
+            history_show(history_methods[i].tier);
+            result = cJSON_CreateObject();
         }
+    }
+    if (result == NULL) {
+        return false;
+    }
 
-        // Commit changes to NVS
-        nvs_commit(h);
-        nvs_close(h);
+    cJSON_AddBoolToObject(result, "success", true);
+    send_rpc_response(req_id, result);
+    cJSON_Delete(result);
+    return true;
+}
 
-        // Retrieve integer values after saving
-        int fillTime = 0, purgeTime = 0, sleepTimeout = 0, minDEFLevel = 0;
-        if (nvs_open(NS_ATTR, NVS_READONLY, &h) == ESP_OK) {
-            nvs_get_i32(h, KEY_FILL_TIME, &fillTime);
-            nvs_get_i32(h, KEY_PURGE_TIME, &purgeTime);
-            nvs_get_i32(h, KEY_SLEEP_TIMEOUT, &sleepTimeout);
-            nvs_get_i32(h, KEY_MIN_DEF_LEVEL, &minDEFLevel);
-        } else {
-            ESP_LOGW(TAG, "Failed to open NVS for reading");
-        }
-        
+// Handle RPC calls (button controls) without NVS persistence.
+// Answered from rpc_response_task once the master acknowledged the command
+static void rpc_request(const char *req_id, const char *method_str) {
+    // A retry from the server: don't run it again
+    taskENTER_CRITICAL(&rpc_lock);
+    rpc_seen_t *seen = rpc_seen_find(req_id);
+    rpc_seen_t previous = seen ? *seen : (rpc_seen_t){ 0 };
+    taskEXIT_CRITICAL(&rpc_lock);
+
+    if (previous.state == RPC_PENDING) {
+        ESP_LOGW("RPC", "Request %s still waiting for the master", req_id);
+        return;
+    }
+    if (previous.state != RPC_FREE) {
+        ESP_LOGW("RPC", "Request %s repeated, answering again", req_id);
+        rpc_respond(req_id, previous.state, previous.result);
+        return;
+    }
 
-        // Send the values in data0–data3
-        ESP_LOGI(TAG, "Sending updated system message with fillTime: %d, purgeTime: %d, sleepTimeout: %d, minDEFLevel: %d",
-                 fillTime, purgeTime, sleepTimeout, minDEFLevel);
-        send_message(MSG_ID_SETTINGS, MSG_TYPE_DATA, (uint16_t)fillTime, (uint16_t)purgeTime, (uint16_t)sleepTimeout, (uint16_t)minDEFLevel);
-        publish_data();
+    if (method_str == NULL) {
+        cJSON *result = cJSON_CreateObject();
+        cJSON_AddStringToObject(result, "error", "invalid or missing method");
+        cJSON_AddBoolToObject(result, "success", false);
+        send_rpc_response(req_id, result);
+        cJSON_Delete(result);
+        return;
+    }
+
+    ESP_LOGI("RPC", "Received method: %s", method_str);
 
-        
+    if (rpc_local(req_id, method_str)) {
+        return;
+    }
+
+    int command;
+    if (strcmp(method_str, "Run") == 0) {
+        command = RUN;
+    } else if (strcmp(method_str, "Stop") == 0) {
+        command = STOP;
+    } else if (strcmp(method_str, "Reboot") == 0) {
+        command = RESET;
     } else {
-        ESP_LOGW(TAG, "Failed to open NVS namespace: %s", NS_ATTR);
+        ESP_LOGW("RPC", "Unknown RPC method: %s", method_str);
+        rpc_seen_set(req_id, RPC_UNKNOWN, CMD_BUSY);
+        rpc_respond(req_id, RPC_UNKNOWN, CMD_BUSY);
+        return;
+    }
+
+    rpc_ctx_t *ctx = NULL;
+    taskENTER_CRITICAL(&rpc_lock);
+    for (int i = 0; i < RPC_POOL_SIZE; i++) {
+        if (!rpc_pool[i].used) {
+            ctx = &rpc_pool[i];
+            ctx->used = true;
+            break;
+        }
     }
-    cJSON_Delete(root);
+    taskEXIT_CRITICAL(&rpc_lock);
+
+    // Not remembered: the server's retry may find room
+    if (ctx == NULL) {
+        ESP_LOGW("RPC", "%d requests pending, %s refused", RPC_POOL_SIZE, req_id);
+        rpc_respond(req_id, RPC_DONE, CMD_BUSY);
+        return;
+    }
+
+    strlcpy(ctx->req_id, req_id, sizeof(ctx->req_id));
+    ctx->reboot = command == RESET;
+    rpc_seen_set(req_id, RPC_PENDING, CMD_BUSY);
+
+    ESP_LOGI("RPC", "Handling %s command", method_str);
+    master_link_send(MSG_ID_SYSTEM, MSG_TYPE_COMMAND, command, 0, 0, 0, rpc_command_done, ctx);
 }
 
+// The request being received: the id is in the topic, the method in the JSON
+static json_stream_t rpc_parser;
+static char rpc_req_id[RPC_ID_MAX];
+static char rpc_method[JSON_STREAM_VALUE_MAX];
+static bool rpc_method_found;
+
+static void rpc_value(void *ctx, int depth, const char *parent, const char *key,
+                      json_stream_type_t type, const char *value) {
+    if (depth == 1 && type == JSON_STREAM_STRING && key && strcmp(key, "method") == 0) {
+        strlcpy(rpc_method, value, sizeof(rpc_method));
+        rpc_method_found = true;
+    }
+}
 
-// Handle RPC calls (button controls) without NVS persistence
-void handle_rpc_request(const char *topic, const char *json) {
-    const char *req_id = strrchr(topic, '/');
-    if (!req_id) return;
-    req_id++;
+static void rpc_begin(const char *topic) {
+    const char *req_id = topic + strlen(TOPIC_RPC_REQUEST_BASE);
 
-    cJSON *root = cJSON_Parse(json);
-    if (!root) return;
-    cJSON *method = cJSON_GetObjectItem(root, "method");
-    cJSON *params = cJSON_GetObjectItem(root, "params");
+    rpc_req_id[0] = '\0';
+    rpc_method_found = false;
+    if (strlen(req_id) >= RPC_ID_MAX) {
+        ESP_LOGW("RPC", "Request id %s too long", req_id);
+        return;
+    }
+    strlcpy(rpc_req_id, req_id, sizeof(rpc_req_id));
+    json_stream_init(&rpc_parser, rpc_value, NULL);
+}
 
-    cJSON *result = cJSON_CreateObject();
-    bool success = false;
+static void rpc_data(const char *data, size_t len) {
+    if (rpc_req_id[0]) {
+        json_stream_feed(&rpc_parser, data, len);
+    }
+}
 
-    if (cJSON_IsString(method)) {
-        const char *method_str = method->valuestring;
-        ESP_LOGI("RPC", "Received method: %s", method_str);
+static void rpc_end(bool complete) {
+    if (!rpc_req_id[0]) return;
 
-        if (strcmp(method_str, "Run") == 0) {
-            // Handle "run"
-            ESP_LOGI("RPC", "Handling RUN command");
-            handle_run();
-            success = true;
+    if (!complete || !json_stream_finish(&rpc_parser)) {
+        ESP_LOGW("RPC", "Request %s is not valid JSON", rpc_req_id);
+        return;
+    }
+    rpc_request(rpc_req_id, rpc_method_found ? rpc_method : NULL);
+}
 
-        } else if (strcmp(method_str, "Stop") == 0) {
-            // Handle "stop"
-            ESP_LOGI("RPC", "Handling STOP command");
-            handle_stop();
-            success = true;
+void send_rpc_response(const char *req_id, cJSON *result) {
+    char topic[MQTT_TOPIC_MAX];
+    snprintf(topic, sizeof(topic), TOPIC_RPC_RESPONSE_BASE "%s", req_id);
 
-        } else if (strcmp(method_str, "Reboot") == 0) {
-            // Handle "stop"
-            ESP_LOGI("RPC", "Handling STOP command");
-            handle_reboot();
-            success = true;
+    char *json = cJSON_PrintUnformatted(result);
+    if (json == NULL) {
+        ESP_LOGE("RPC", "Failed to print RPC response");
+        return;
+    }
 
-        } else {
-            ESP_LOGW("RPC", "Unknown RPC method: %s", method_str);
-            cJSON_AddStringToObject(result, "error", "unknown method");
-        }
-    } else {
-        cJSON_AddStringToObject(result, "error", "invalid or missing method");
+    if (!sim7600_mqtt_publish(topic, json)) {
+        ESP_LOGE("RPC", "❌ RPC response %s not published", req_id);
     }
+    free(json);
+}
 
-    cJSON_AddBoolToObject(result, "success", success);
-    //send_rpc_response(req_id, result);
+void mqtt_rpc_init(void) {
+    rpc_done_queue = xQueueCreate(RPC_POOL_SIZE, sizeof(rpc_ctx_t *));
+    diag_queue_register("rpc_done", rpc_done_queue);
+}
 
-    
-    cJSON_Delete(result);
-    cJSON_Delete(root);
+void rpc_response_task(void *param) {
+    rpc_ctx_t *ctx;
+
+    while (1) {
+        if (xQueueReceive(rpc_done_queue, &ctx, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+
+        ESP_LOGI("RPC", "Request %s: %s", ctx->req_id, command_result_str(ctx->result));
+        rpc_seen_set(ctx->req_id, RPC_DONE, ctx->result);
+        rpc_respond(ctx->req_id, RPC_DONE, ctx->result);
+
+        bool reboot = ctx->reboot;
+        taskENTER_CRITICAL(&rpc_lock);
+        ctx->used = false;
+        taskEXIT_CRITICAL(&rpc_lock);
+
+        if (reboot) {
+            ESP_LOGW(TAG, "Reboot command received");
+            vTaskDelay(1000 / portTICK_PERIOD_MS);  // Delay to ensure the response is sent
+            esp_restart();  // Restart the ESP32
+        }
+    }
 }
 
 
+///////////////receiving//////////////
 
+// A kind of message, fed as it arrives and told at the end whether all of it came
+typedef struct {
+    const char *topic;
+    bool prefix;                        // Matches any topic starting with `topic`
+    void (*begin)(const char *topic);
+    void (*data)(const char *data, size_t len);
+    void (*end)(bool complete);
+} rx_handler_t;
 
+static const rx_handler_t rx_handlers[] = {
+    { TOPIC_ATTR_UPDATES,      false, attributes_begin, attributes_data, attributes_end },
+    { TOPIC_RPC_REQUEST_BASE,  true,  rpc_begin,        rpc_data,        rpc_end        },
+    { TOPIC_ATTR_REQUEST_BASE, true,  attributes_begin, attributes_data, attributes_end },
+    { OTA_TOPIC_RESPONSE_BASE, true,  ota_chunk_begin,  ota_chunk_data,  ota_chunk_end  },
+};
+#define RX_HANDLER_COUNT    (sizeof(rx_handlers) / sizeof(rx_handlers[0]))
 
+// The message being received. One transport is active at a time, so one message
+static const rx_handler_t *rx_handler = NULL;
+static size_t rx_expected = 0;
+static size_t rx_received = 0;
 
 
+void mqtt_rx_begin(const char *topic, size_t payload_len) {
+    if (rx_handler) {
+        ESP_LOGW(TAG, "Message cut short by one on %s", topic);
+        rx_handler->end(false);
+    }
 
-//Function to retrieve values from flash
-esp_err_t mqtt_get_aux_range(float *out_val) {
-    nvs_handle_t h;
-    esp_err_t err = nvs_open(NS_ATTR, NVS_READONLY, &h);
-    if (err != ESP_OK) return err;
-    size_t required_size = sizeof(float);
-    err = nvs_get_blob(h, KEY_AUX_RANGE, out_val, &required_size);
-    nvs_close(h);
-    return err;
+    rx_handler = NULL;
+    rx_expected = payload_len;
+    rx_received = 0;
+
+    for (int i = 0; i < RX_HANDLER_COUNT; i++) {
+        const rx_handler_t *h = &rx_handlers[i];
+        bool match = h->prefix ? strncmp(topic, h->topic, strlen(h->topic)) == 0
+                               : strcmp(topic, h->topic) == 0;
+        if (match) {
+            rx_handler = h;
+            break;
+        }
+    }
+
+    if (rx_handler == NULL) {
+        ESP_LOGW(TAG, "Unhandled topic: %s (%u B)", topic, (unsigned)payload_len);
+        return;
+    }
+
+    TRACE_STR(ESP_LOG_INFO, TEV_MQTT_RX, topic, payload_len);
+    rx_handler->begin(topic);
 }
 
-esp_err_t mqtt_get_aux_max(float *out_val) {
-    nvs_handle_t h;
-    esp_err_t err = nvs_open(NS_ATTR, NVS_READONLY, &h);
-    if (err != ESP_OK) return err;
-    size_t required_size = sizeof(float);
-    err = nvs_get_blob(h, KEY_AUX_MAX, out_val, &required_size);
-    nvs_close(h);
-    return err;
+void mqtt_rx_data(const char *data, size_t len) {
+    rx_received += len;
+    if (rx_handler) {
+        rx_handler->data(data, len);
+    }
 }
 
-esp_err_t mqtt_get_ext_range(float *out_val) {
-    nvs_handle_t h;
-    esp_err_t err = nvs_open(NS_ATTR, NVS_READONLY, &h);
-    if (err != ESP_OK) return err;
-    size_t required_size = sizeof(float);
-    err = nvs_get_blob(h, KEY_EXT_RANGE, out_val, &required_size);
-    nvs_close(h);
-    return err;
+void mqtt_rx_end(void) {
+    if (rx_handler == NULL) return;
+
+    bool complete = rx_received == rx_expected;
+    if (!complete) {
+        ESP_LOGW(TAG, "Got %u of %u B, message dropped", (unsigned)rx_received, (unsigned)rx_expected);
+    }
+
+    const rx_handler_t *handler = rx_handler;
+    rx_handler = NULL;
+    handler->end(complete);
 }
 
-esp_err_t mqtt_get_ext_max(float *out_val) {
-    nvs_handle_t h;
-    esp_err_t err = nvs_open(NS_ATTR, NVS_READONLY, &h);
-    if (err != ESP_OK) return err;
-    size_t required_size = sizeof(float);
-    err = nvs_get_blob(h, KEY_EXT_MAX, out_val, &required_size);
-    nvs_close(h);
-    return err;
+// A whole message at once
+void mqtt_dispatch_message(const char *topic, const char *payload) {
+    size_t len = strlen(payload);
+
+    mqtt_rx_begin(topic, len);
+    mqtt_rx_data(payload, len);
+    mqtt_rx_end();
 }
 
-///////////////message sending//////////////
-void int_to_hex_str(unsigned int num, char *str, int str_size) {
-    snprintf(str, str_size, "%04X", num);
+
+// AT transport: +CMQTTRXSTART: <client>,<topic len>,<payload len>, then for each
+// part a +CMQTTRXTOPIC/+CMQTTRXPAYLOAD line followed by the bytes it counts
+// (rx_task queues those as URC_TOPIC/URC_PAYLOAD), then +CMQTTRXEND
+static bool at_rx_block = false;
+static bool at_rx_started = false;      // mqtt_rx_begin() called for this block
+static size_t at_rx_payload_len = 0;
+static char at_rx_topic[MQTT_TOPIC_MAX];
+static size_t at_rx_topic_len = 0;
+
+static void at_rx_start(void) {
+    if (!at_rx_started) {
+        at_rx_topic[at_rx_topic_len] = '\0';
+        mqtt_rx_begin(at_rx_topic, at_rx_payload_len);
+        at_rx_started = true;
+    }
 }
 
-void send_message(int message_id, int message_type, uint16_t data0, uint16_t data1, uint16_t data2, uint16_t data3) {
-    // Temporary buffers
-    char output_buffer[23];  // 1 byte for type + 4 bytes for each data field + null terminator
-    char message_id_str[5];  // 4 characters for 2 bytes in hex + null terminator
-    char data_type = message_type ? '1' : '0';
+void mqtt_handle_urc(const char *urc) {
+    unsigned int topic_len, payload_len;
 
-    // Convert the message ID to a hex string
-    int_to_hex_str(message_id, message_id_str, sizeof(message_id_str));
+    TRACE_STR(ESP_LOG_INFO, TEV_AT_URC, urc);
 
-    // Format the message
-    snprintf(output_buffer, 23, "%c%s#%04X%04X%04X%04X",
-             data_type, message_id_str,
-             data0, data1, data2, data3);
+    if (sscanf(urc, "+CMQTTRXSTART: %*d,%u,%u", &topic_len, &payload_len) == 2) {
+        at_rx_block = true;
+        at_rx_started = false;
+        at_rx_topic_len = 0;
+        at_rx_payload_len = payload_len;
+        return;
+    }
 
-    if (xQueueSend(master_cmd_queue, output_buffer, portMAX_DELAY) != pdTRUE) {
-        ESP_LOGE("UART_SEND", "Failed to send message to queue");
+    if (strstr(urc, "+CMQTTRXEND:")) {
+        if (at_rx_block) {
+            at_rx_start();      // An empty payload has no +CMQTTRXPAYLOAD
+            mqtt_rx_end();
+            at_rx_block = false;
+        } else {
+            // Its +CMQTTRXSTART went while MODEM_RI woke us. An RPC is left to
+            // time out at the server, an attribute update can be asked for again
+            ESP_LOGW(TAG, "⚠️ Message lost its start, requesting the shared attributes again");
+            request_all_shared_attributes();
+        }
     }
 }
 
+static void mqtt_handle_urc_data(const urc_item_t *item) {
+    if (!at_rx_block) return;
 
+    if (item->kind == URC_TOPIC) {
+        size_t room = sizeof(at_rx_topic) - 1 - at_rx_topic_len;
+        size_t n = item->len < room ? item->len : room;
+        memcpy(at_rx_topic + at_rx_topic_len, item->data, n);
+        at_rx_topic_len += n;
+    } else {
+        at_rx_start();
+        mqtt_rx_data(item->data, item->len);
+    }
+}
 
+//Functions to retrieve the settings, ESP_ERR_NVS_NOT_FOUND until the server set them
+static esp_err_t settings_get_float(int id, float *out_val) {
+    shared_settings_t s;
+    mqtt_settings_get(&s);
+    if (!(s.present & BIT(id))) return ESP_ERR_NVS_NOT_FOUND;
+    *out_val = *setting_float(&s, id);
+    return ESP_OK;
+}
 
+esp_err_t mqtt_get_aux_range(float *out_val) {
+    return settings_get_float(SETTING_AUX_RANGE, out_val);
+}
 
+esp_err_t mqtt_get_aux_max(float *out_val) {
+    return settings_get_float(SETTING_AUX_MAX, out_val);
+}
 
+esp_err_t mqtt_get_ext_range(float *out_val) {
+    return settings_get_float(SETTING_EXT_RANGE, out_val);
+}
 
+esp_err_t mqtt_get_ext_max(float *out_val) {
+    return settings_get_float(SETTING_EXT_MAX, out_val);
+}
 
-void handle_run(void) {
-    ESP_LOGW(TAG, "Run command received");
-    send_message(MSG_ID_SYSTEM, MSG_TYPE_COMMAND, RUN , 0, 0, 0);
-    ESP_LOGI(TAG, "Run command sent to master");
+///////////////message sending//////////////
+void int_to_hex_str(unsigned int num, char *str, int str_size) {
+    snprintf(str, str_size, "%04X", num);
 }
 
-void handle_stop(void) {
-    ESP_LOGW(TAG, "Stop command received");
-    send_message(MSG_ID_SYSTEM, MSG_TYPE_COMMAND, STOP , 0, 0, 0);
-    ESP_LOGI(TAG, "Stop command sent to master");
+void send_message(int message_id, int message_type, uint16_t data0, uint16_t data1, uint16_t data2, uint16_t data3) {
+    master_link_send(message_id, message_type, data0, data1, data2, data3, NULL, NULL);
 }
 
+typedef struct {
+    SemaphoreHandle_t done;
+    command_result_t result;
+} command_wait_t;
 
-void handle_reboot(void) {
-    ESP_LOGW(TAG, "Reboot command received");
-    send_message(MSG_ID_SYSTEM, MSG_TYPE_COMMAND, RESET , 0, 0, 0);
-    vTaskDelay(1000 / portTICK_PERIOD_MS);  // Delay to ensure message is sent
-    esp_restart();  // Restart the ESP32
-    ESP_LOGI(TAG, "Reboot command sent to master");
+static void command_wait_done(command_result_t result, void *arg) {
+    command_wait_t *wait = arg;
+    wait->result = result;
+    xSemaphoreGive(wait->done);
 }
 
-
+command_result_t send_command(int message_id, int message_type, uint16_t data0, uint16_t data1, uint16_t data2, uint16_t data3) {
+    StaticSemaphore_t done_buf;
+    command_wait_t wait = {
+        .done = xSemaphoreCreateBinaryStatic(&done_buf),
+        .result = CMD_BUSY,
+    };
+
+    // Always completes: ACK, sent without MASTER_CMD_SEQ, MASTER_CMD_TRIES timeouts or no room to send at all
+    master_link_send(message_id, message_type, data0, data1, data2, data3, command_wait_done, &wait);
+    xSemaphoreTake(wait.done, portMAX_DELAY);
+    return wait.result;
+}
 
 void mqtt_urc_task(void *param) {
-    char line[SIM7600_UART_BUF_SIZE];
+    urc_item_t item;
 
     ESP_LOGI("MQTT_URC", "MQTT URC task started");
 
     while (1) {
-        // Block until a line is received from the queue
-        if (xQueueReceive(incoming_queue, &line, portMAX_DELAY) == pdTRUE) {
-            mqtt_handle_urc(line);
+        // Block until a line or a chunk of a received message comes from rx_task
+        if (xQueueReceive(incoming_queue, &item, portMAX_DELAY) == pdTRUE) {
+            if (item.kind == URC_LINE) {
+                mqtt_handle_urc(item.data);
+            } else {
+                mqtt_handle_urc_data(&item);
+            }
         }
     }
 }
\ No newline at end of file
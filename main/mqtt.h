@@ -3,6 +3,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include "driver/gpio.h"
 #include "driver/i2c.h"
 #include "freertos/FreeRTOS.h"
@@ -19,6 +20,8 @@
 #include "nvs.h"
 #include "nvs_flash.h"
 #include "cJSON.h"
+#include "esp_bit_defs.h"
+#include "uart.h"
 
 extern QueueHandle_t incoming_queue;
 extern QueueHandle_t master_cmd_queue; 
@@ -35,25 +38,113 @@ extern QueueHandle_t master_cmd_queue;
 #define KEY_SLEEP_TIMEOUT       "SleepTimeout"
 #define KEY_MIN_DEF_LEVEL       "MinDEFLevel"
 
+// Signal conditioning (filter.h)
+#define KEY_TANK_MEDIAN         "TankMedian"
+#define KEY_TANK_EMA            "TankEma"
+#define KEY_TANK_STEP           "TankStep"
+#define KEY_TEMP_MEDIAN         "TempMedian"
+#define KEY_TEMP_EMA            "TempEma"
+#define KEY_TEMP_STEP           "TempStep"
+
+// All of them in one record, written only when something changed. Older
+// firmware stored each key on its own; mqtt_settings_load() moves those over
+#define KEY_SETTINGS            "settings"
+#define SETTINGS_VERSION        2       // Bump when shared_settings_t changes
+
+typedef enum {
+    SETTING_AUX_RANGE = 0,
+    SETTING_AUX_MAX,
+    SETTING_EXT_RANGE,
+    SETTING_EXT_MAX,
+    SETTING_FILL_TIME,
+    SETTING_PURGE_TIME,
+    SETTING_SLEEP_TIMEOUT,
+    SETTING_MIN_DEF_LEVEL,
+    SETTING_TANK_MEDIAN,
+    SETTING_TANK_EMA,
+    SETTING_TANK_STEP,
+    SETTING_TEMP_MEDIAN,
+    SETTING_TEMP_EMA,
+    SETTING_TEMP_STEP,
+    SETTING_COUNT
+} setting_id_t;
+
+typedef struct {
+    uint16_t version;
+    uint16_t present;                   // BIT(setting_id_t) for each one the server has set
+    uint32_t writes;                    // Times this record went to flash
+    float aux_range;
+    float aux_max;
+    float ext_range;
+    float ext_max;
+    int32_t fill_time;
+    int32_t purge_time;
+    int32_t sleep_timeout;
+    int32_t min_def_level;
+    // Added in version 2
+    int32_t tank_median;
+    int32_t tank_ema;
+    int32_t tank_step;
+    int32_t temp_median;
+    int32_t temp_ema;
+    int32_t temp_step;
+} shared_settings_t;
+
+// Version 1 of the record: the same fields up to min_def_level
+#define SETTINGS_V1_SIZE        offsetof(shared_settings_t, tank_median)
+
+// Longest received topic, both transports. Payloads are parsed as they
+// arrive and have no limit
+#define MQTT_TOPIC_MAX          128
+
+// RPCs
+#define RPC_ID_MAX              12      // Request id from the topic, with terminator
+#define RPC_POOL_SIZE           4       // Requests waiting for the master at once
+#define RPC_DEDUP_SIZE          16      // Request ids remembered to catch server retries
+
 
 // Handle incoming MQTT URC (to be called from your URC handler)
 void mqtt_handle_urc(const char *urc);
+
+// A received message in pieces: begin with the topic and the payload size,
+// the payload bytes in any number of calls, then end. Both transports use it
+void mqtt_rx_begin(const char *topic, size_t payload_len);
+void mqtt_rx_data(const char *data, size_t len);
+void mqtt_rx_end(void);
+
+// The same with the whole payload at once
+void mqtt_dispatch_message(const char *topic, const char *payload);
+
 void publish_stored_attributes(void);
 void send_rpc_response(const char *req_id, cJSON *result);
-void handle_shared_attributes(const char *json);
-void handle_rpc_request(const char *topic, const char *json);
 
-void handle_run(void);
-void handle_stop(void);
-void handle_reboot(void);
+// The queue rpc_response_task answers from, before any MQTT transport is up
+void mqtt_rpc_init(void);
+
+// Answers the RPCs passed to the master once it acknowledged them
+void rpc_response_task(void *param);
 
 void int_to_hex_str(unsigned int num, char *str, int str_size);
+
+// Fire and forget (the heartbeat): nothing waits for the master
 void send_message(int message_id, int message_type, uint16_t data0, uint16_t data1, uint16_t data2, uint16_t data3);
 
+// Sent until the master acknowledges it; blocks for at most
+// MASTER_CMD_SLOT_WAIT_MS + MASTER_CMD_TRIES * MASTER_CMD_TIMEOUT_MS, so not
+// from the MQTT receive path: that uses master_link_send() with a callback
+command_result_t send_command(int message_id, int message_type, uint16_t data0, uint16_t data1, uint16_t data2, uint16_t data3);
+
 void mqtt_urc_task(void *param);
 
 
-// Getter functions to retrieve stored values from NVS
+// Reads the settings record into RAM, call once after nvs_flash_init()
+void mqtt_settings_load(void);
+// Copy of the settings in RAM
+void mqtt_settings_get(shared_settings_t *out);
+// Instead of mqtt_settings_load(): the copy kept over deep sleep, the same as the record
+void mqtt_settings_restore(const shared_settings_t *saved);
+
+// Getter functions to retrieve the stored settings
 esp_err_t mqtt_get_aux_range(float *out_val);
 esp_err_t mqtt_get_aux_max(float *out_val);
 esp_err_t mqtt_get_ext_range(float *out_val);
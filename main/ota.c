@@ -0,0 +1,543 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "ota.h"
+#include "main.h"
+#include "modem.h"
+#include "mqtt.h"
+#include "pppos.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_app_desc.h"
+#include "esp_app_format.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_system.h"
+#include "mbedtls/sha256.h"
+#include "cJSON.h"
+
+
+static const char *TAG = "OTA";
+
+#define OTA_TITLE_MAX       32
+#define OTA_VERSION_MAX     32
+
+// What the fw_* shared attributes ask for
+typedef struct {
+    char title[OTA_TITLE_MAX];
+    char version[OTA_VERSION_MAX];
+    char checksum[65];                  // Hex
+    char algorithm[16];
+    uint32_t size;
+} ota_target_t;
+
+typedef enum {
+    IMAGE_UNKNOWN = 0,                  // Until the first byte
+    IMAGE_FULL,
+    IMAGE_DELTA,
+} image_kind_t;
+
+typedef enum {
+    DELTA_HEADER = 0,
+    DELTA_OP,
+    DELTA_ARGS,
+    DELTA_INSERT,
+    DELTA_DONE,
+} delta_state_t;
+
+// One download, only ota_task touches it
+typedef struct {
+    esp_ota_handle_t handle;
+    const esp_partition_t *dst;
+    const esp_partition_t *src;         // The running image, for COPY
+    mbedtls_sha256_context sha;         // Of the package as received
+    image_kind_t kind;
+    uint32_t written;                   // Image bytes through esp_ota_write()
+    const char *error;                  // Why it stopped, for fw_error
+
+    // Delta parser, across chunk boundaries
+    delta_state_t state;
+    ota_delta_header_t header;
+    uint32_t header_len;
+    uint8_t op;
+    uint8_t args[8];
+    uint8_t args_len;
+    uint32_t insert_left;
+} ota_session_t;
+
+static ota_target_t parsing;            // From the attribute message being parsed
+static ota_target_t target;             // The latest complete one
+static bool target_set = false;
+static portMUX_TYPE target_lock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t ota_task_handle = NULL;
+
+static bool pending_verify = false;     // First boot of an image, see ota_init()
+static char failed_version[OTA_VERSION_MAX];    // Not tried again until the server names another
+static uint32_t request_id = 0;
+static ota_session_t session;
+static uint8_t copy_buf[OTA_COPY_BUF];
+
+// The chunk being waited for, filled by the MQTT receive path
+static uint8_t chunk_buf[OTA_CHUNK_SIZE];
+static struct {
+    bool waiting;                       // ota_task asked for `index` and hasn't got it
+    bool accept;                        // The message coming in is that chunk
+    bool overflow;
+    uint32_t request_id;
+    uint32_t index;
+    size_t len;
+} rx;
+static portMUX_TYPE rx_lock = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t chunk_ready = NULL;
+
+
+// ===== Attributes =====
+
+void ota_attribute(const char *key, const char *value) {
+    if (strcmp(key, "fw_title") == 0) {
+        strlcpy(parsing.title, value, sizeof(parsing.title));
+    } else if (strcmp(key, "fw_version") == 0) {
+        strlcpy(parsing.version, value, sizeof(parsing.version));
+    } else if (strcmp(key, "fw_checksum") == 0) {
+        strlcpy(parsing.checksum, value, sizeof(parsing.checksum));
+    } else if (strcmp(key, "fw_checksum_algorithm") == 0) {
+        strlcpy(parsing.algorithm, value, sizeof(parsing.algorithm));
+    } else if (strcmp(key, "fw_size") == 0) {
+        parsing.size = strtoul(value, NULL, 10);
+    }
+}
+
+void ota_attributes_done(bool complete) {
+    // ThingsBoard sends all of them when a package is assigned
+    if (complete && parsing.version[0] && parsing.size) {
+        taskENTER_CRITICAL(&target_lock);
+        target = parsing;
+        target_set = true;
+        taskEXIT_CRITICAL(&target_lock);
+
+        if (ota_task_handle) {
+            xTaskNotifyGive(ota_task_handle);
+        }
+    }
+    memset(&parsing, 0, sizeof(parsing));
+}
+
+
+// ===== Receiving chunks =====
+
+void ota_chunk_begin(const char *topic) {
+    unsigned long req, index;
+    bool parsed = sscanf(topic + strlen(OTA_TOPIC_RESPONSE_BASE), "%lu/chunk/%lu", &req, &index) == 2;
+
+    taskENTER_CRITICAL(&rx_lock);
+    rx.accept = parsed && rx.waiting && req == rx.request_id && index == rx.index;
+    rx.overflow = false;
+    rx.len = 0;
+    taskEXIT_CRITICAL(&rx_lock);
+}
+
+void ota_chunk_data(const char *data, size_t len) {
+    if (!rx.accept) {
+        return;
+    }
+    if (rx.len + len > sizeof(chunk_buf)) {
+        rx.overflow = true;
+        return;
+    }
+    memcpy(chunk_buf + rx.len, data, len);
+    rx.len += len;
+}
+
+void ota_chunk_end(bool complete) {
+    taskENTER_CRITICAL(&rx_lock);
+    bool ready = rx.accept && complete && !rx.overflow;
+    if (ready) {
+        rx.waiting = false;
+    }
+    rx.accept = false;
+    taskEXIT_CRITICAL(&rx_lock);
+
+    if (ready) {
+        xSemaphoreGive(chunk_ready);
+    }
+}
+
+// Asks for a chunk and waits for it to be in chunk_buf; a late answer is ignored
+static bool fetch(uint32_t index, uint32_t chunk_size, size_t *len) {
+    taskENTER_CRITICAL(&rx_lock);
+    rx.waiting = true;
+    rx.request_id = request_id;
+    rx.index = index;
+    taskEXIT_CRITICAL(&rx_lock);
+    xSemaphoreTake(chunk_ready, 0);
+
+    char topic[MQTT_TOPIC_MAX];
+    char size[12];
+    snprintf(topic, sizeof(topic), OTA_TOPIC_REQUEST, (unsigned long)request_id, (unsigned long)index);
+    snprintf(size, sizeof(size), "%lu", (unsigned long)chunk_size);
+
+    bool ok = sim7600_mqtt_publish(topic, size) &&
+              xSemaphoreTake(chunk_ready, pdMS_TO_TICKS(OTA_CHUNK_TIMEOUT_MS)) == pdTRUE;
+
+    taskENTER_CRITICAL(&rx_lock);
+    rx.waiting = false;
+    *len = rx.len;
+    taskEXIT_CRITICAL(&rx_lock);
+    return ok;
+}
+
+
+// ===== Writing the image =====
+
+static bool write_out(const void *data, size_t len) {
+    esp_err_t err = esp_ota_write(session.handle, data, len);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "❌ esp_ota_write: %s", esp_err_to_name(err));
+        session.error = "flash write failed";
+        return false;
+    }
+    session.written += len;
+    return true;
+}
+
+static bool delta_copy(uint32_t offset, uint32_t len) {
+    if (offset > session.src->size || len > session.src->size - offset) {
+        session.error = "delta copies past the running image";
+        return false;
+    }
+    while (len) {
+        uint32_t n = len < sizeof(copy_buf) ? len : sizeof(copy_buf);
+        if (esp_partition_read(session.src, offset, copy_buf, n) != ESP_OK) {
+            session.error = "running image not readable";
+            return false;
+        }
+        if (!write_out(copy_buf, n)) {
+            return false;
+        }
+        offset += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool delta_header_ok(void) {
+    const ota_delta_header_t *h = &session.header;
+    const esp_app_desc_t *app = esp_app_get_description();
+
+    if (memcmp(h->magic, OTA_DELTA_MAGIC, sizeof(h->magic)) != 0 || h->version != OTA_DELTA_VERSION) {
+        session.error = "not a delta this firmware reads";
+        return false;
+    }
+    if (memcmp(h->base_sha256, app->app_elf_sha256, sizeof(h->base_sha256)) != 0) {
+        session.error = "delta made for another image";
+        return false;
+    }
+    if (h->image_size > session.dst->size) {
+        session.error = "image bigger than the OTA partition";
+        return false;
+    }
+    return true;
+}
+
+static uint32_t le32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static bool delta_feed(const uint8_t *p, size_t len) {
+    while (len) {
+        switch (session.state) {
+        case DELTA_HEADER: {
+            size_t n = sizeof(session.header) - session.header_len;
+            n = len < n ? len : n;
+            memcpy((uint8_t *)&session.header + session.header_len, p, n);
+            session.header_len += n;
+            p += n;
+            len -= n;
+            if (session.header_len == sizeof(session.header)) {
+                if (!delta_header_ok()) {
+                    return false;
+                }
+                session.state = DELTA_OP;
+            }
+            break;
+        }
+
+        case DELTA_OP:
+            session.op = *p++;
+            len--;
+            session.args_len = 0;
+            if (session.op == OTA_DELTA_END) {
+                session.state = DELTA_DONE;
+            } else if (session.op == OTA_DELTA_COPY || session.op == OTA_DELTA_INSERT) {
+                session.state = DELTA_ARGS;
+            } else {
+                session.error = "unknown delta op";
+                return false;
+            }
+            break;
+
+        case DELTA_ARGS: {
+            uint8_t need = session.op == OTA_DELTA_COPY ? 8 : 4;
+            size_t n = need - session.args_len;
+            n = len < n ? len : n;
+            memcpy(session.args + session.args_len, p, n);
+            session.args_len += n;
+            p += n;
+            len -= n;
+            if (session.args_len < need) {
+                break;
+            }
+            if (session.op == OTA_DELTA_COPY) {
+                if (!delta_copy(le32(session.args), le32(session.args + 4))) {
+                    return false;
+                }
+                session.state = DELTA_OP;
+            } else {
+                session.insert_left = le32(session.args);
+                session.state = session.insert_left ? DELTA_INSERT : DELTA_OP;
+            }
+            break;
+        }
+
+        case DELTA_INSERT: {
+            size_t n = len < session.insert_left ? len : session.insert_left;
+            if (!write_out(p, n)) {
+                return false;
+            }
+            session.insert_left -= n;
+            p += n;
+            len -= n;
+            if (session.insert_left == 0) {
+                session.state = DELTA_OP;
+            }
+            break;
+        }
+
+        case DELTA_DONE:
+            session.error = "data after the delta's end";
+            return false;
+        }
+    }
+    return true;
+}
+
+// A chunk of the package, in order
+static bool apply(const uint8_t *data, size_t len) {
+    if (session.kind == IMAGE_UNKNOWN && len) {
+        if (data[0] == ESP_IMAGE_HEADER_MAGIC) {
+            session.kind = IMAGE_FULL;
+        } else if (data[0] == OTA_DELTA_MAGIC[0]) {
+            session.kind = IMAGE_DELTA;
+            ESP_LOGI(TAG, "📦 Delta against the running image");
+        } else {
+            session.error = "neither an app image nor a delta";
+            return false;
+        }
+    }
+    return session.kind == IMAGE_FULL ? write_out(data, len) : delta_feed(data, len);
+}
+
+
+// ===== Download =====
+
+// fw_state telemetry, as ThingsBoard's firmware dashboard reads it
+static void report(const char *state, const char *error) {
+    const esp_app_desc_t *app = esp_app_get_description();
+
+    ESP_LOGI(TAG, "📦 %s%s%s", state, error ? ": " : "", error ? error : "");
+    if (!(xEventGroupGetBits(systemEvents) & MQTT_INIT)) {
+        return;
+    }
+
+    cJSON *root = cJSON_CreateObject();
+    if (root == NULL) {
+        return;
+    }
+    cJSON_AddStringToObject(root, "current_fw_title", app->project_name);
+    cJSON_AddStringToObject(root, "current_fw_version", app->version);
+    cJSON_AddStringToObject(root, "fw_state", state);
+    if (error) {
+        cJSON_AddStringToObject(root, "fw_error", error);
+    }
+    char *json = cJSON_PrintUnformatted(root);
+    if (json && !sim7600_mqtt_publish(MQTT_TOPIC_PUB, json)) {
+        ESP_LOGW(TAG, "⚠️ fw_state %s not published", state);
+    }
+    free(json);
+    cJSON_Delete(root);
+}
+
+static bool checksum_ok(const ota_target_t *t) {
+    uint8_t sum[32];
+    char hex[65];
+
+    mbedtls_sha256_finish(&session.sha, sum);
+    for (size_t i = 0; i < sizeof(sum); i++) {
+        snprintf(hex + i * 2, 3, "%02x", sum[i]);
+    }
+    return strcasecmp(hex, t->checksum) == 0;
+}
+
+static bool session_start(void) {
+    memset(&session, 0, sizeof(session));
+    session.src = esp_ota_get_running_partition();
+    session.dst = esp_ota_get_next_update_partition(NULL);
+    if (session.dst == NULL) {
+        session.error = "no OTA partition to write";
+        return false;
+    }
+
+    esp_err_t err = esp_ota_begin(session.dst, OTA_WITH_SEQUENTIAL_WRITES, &session.handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "❌ esp_ota_begin: %s", esp_err_to_name(err));
+        session.error = "OTA partition not writable";
+        return false;
+    }
+    mbedtls_sha256_init(&session.sha);
+    mbedtls_sha256_starts(&session.sha, 0);
+    return true;
+}
+
+static bool download(const ota_target_t *t) {
+    if (strcasecmp(t->algorithm, "SHA256") != 0) {
+        report("FAILED", "only SHA256 checksums are supported");
+        return false;
+    }
+    if (!session_start()) {
+        report("FAILED", session.error);
+        return false;
+    }
+
+    // AT+CMQTT has to take a chunk in one +CMQTTRX block: smaller ones there
+    uint32_t chunk_size = pppos_is_active() ? OTA_CHUNK_SIZE : OTA_CHUNK_SIZE_AT;
+    uint32_t chunks = (t->size + chunk_size - 1) / chunk_size;
+    uint32_t tries = 0;
+    request_id++;
+
+    ESP_LOGI(TAG, "📦 %s %s: %lu B in %lu chunks to %s", t->title, t->version, (unsigned long)t->size,
+             (unsigned long)chunks, session.dst->label);
+    report("DOWNLOADING", NULL);
+
+    for (uint32_t i = 0; i < chunks && session.error == NULL; ) {
+        // A dropped link: carry on at the same chunk once it's back
+        xEventGroupWaitBits(systemEvents, MQTT_INIT, pdFALSE, pdFALSE, portMAX_DELAY);
+
+        size_t len;
+        if (!fetch(i, chunk_size, &len)) {
+            if ((xEventGroupGetBits(systemEvents) & MQTT_INIT) && ++tries >= OTA_CHUNK_TRIES) {
+                session.error = "chunk requests unanswered";
+            }
+            ESP_LOGW(TAG, "⚠️ Chunk %lu not received, try %lu", (unsigned long)i, (unsigned long)tries);
+            continue;
+        }
+
+        uint32_t expected = i + 1 < chunks ? chunk_size : t->size - i * chunk_size;
+        if (len != expected) {
+            session.error = "chunk of the wrong size";
+            break;
+        }
+        mbedtls_sha256_update(&session.sha, chunk_buf, len);
+        if (!apply(chunk_buf, len)) {
+            break;
+        }
+
+        tries = 0;
+        i++;
+        if (i % (chunks / 10 + 1) == 0) {
+            ESP_LOGI(TAG, "📦 %lu%%", (unsigned long)(i * 100 / chunks));
+        }
+    }
+
+    if (session.error == NULL && !checksum_ok(t)) {
+        session.error = "checksum mismatch";
+    }
+    if (session.error == NULL && session.kind == IMAGE_DELTA &&
+        (session.state != DELTA_DONE || session.written != session.header.image_size)) {
+        session.error = "delta incomplete";
+    }
+    mbedtls_sha256_free(&session.sha);
+
+    if (session.error) {
+        esp_ota_abort(session.handle);
+        report("FAILED", session.error);
+        return false;
+    }
+    report("DOWNLOADED", NULL);
+
+    // esp_ota_end() checks the image itself, its own SHA-256 included
+    esp_err_t err = esp_ota_end(session.handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "❌ esp_ota_end: %s", esp_err_to_name(err));
+        report("FAILED", "image not valid");
+        return false;
+    }
+    report("VERIFIED", NULL);
+
+    err = esp_ota_set_boot_partition(session.dst);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "❌ esp_ota_set_boot_partition: %s", esp_err_to_name(err));
+        report("FAILED", "boot partition not set");
+        return false;
+    }
+    report("UPDATING", NULL);
+    vTaskDelay(pdMS_TO_TICKS(2000));    // Let the state go out
+    esp_restart();
+    return true;
+}
+
+static bool wanted(const ota_target_t *t) {
+    const esp_app_desc_t *app = esp_app_get_description();
+    return strcmp(t->version, app->version) != 0 && strcmp(t->version, failed_version) != 0;
+}
+
+
+// ===== Rollback =====
+
+void ota_init(void) {
+    chunk_ready = xSemaphoreCreateBinary();
+
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    esp_ota_img_states_t state;
+
+    if (esp_ota_get_state_partition(running, &state) == ESP_OK && state == ESP_OTA_IMG_PENDING_VERIFY) {
+        pending_verify = true;
+        ESP_LOGW(TAG, "📦 First boot from %s: rolled back unless MQTT comes up", running->label);
+    }
+}
+
+// The new image has to reach the server before it is kept
+static void confirm(void) {
+    EventBits_t bits = xEventGroupWaitBits(systemEvents, MQTT_INIT, pdFALSE, pdFALSE,
+                                           pdMS_TO_TICKS(OTA_CONFIRM_MS));
+    if (!(bits & MQTT_INIT)) {
+        ESP_LOGE(TAG, "❌ No MQTT in %d s, rolling back", OTA_CONFIRM_MS / 1000);
+        esp_ota_mark_app_invalid_rollback_and_reboot();
+        return;
+    }
+    esp_ota_mark_app_valid_cancel_rollback();
+    report("UPDATED", NULL);
+}
+
+void ota_task(void *param) {
+    ota_task_handle = xTaskGetCurrentTaskHandle();
+
+    if (pending_verify) {
+        confirm();
+    }
+
+    // A target may have come in before this task was up: look before waiting
+    while (1) {
+        taskENTER_CRITICAL(&target_lock);
+        ota_target_t t = target;
+        bool set = target_set;
+        taskEXIT_CRITICAL(&target_lock);
+
+        if (set && wanted(&t) && !download(&t)) {
+            strlcpy(failed_version, t.version, sizeof(failed_version));
+        }
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef OTA_H
+#define OTA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// ===== Configuration =====
+
+#define OTA_CHUNK_SIZE          4096    // Requested per chunk over PPPoS, and the receive buffer
+#define OTA_CHUNK_SIZE_AT       1024    // Over AT+CMQTT, which has to fit it in one +CMQTTRX block
+#define OTA_CHUNK_TIMEOUT_MS    30000
+#define OTA_CHUNK_TRIES         5       // Unanswered requests for one chunk while MQTT is up
+#define OTA_CONFIRM_MS          300000  // A new image rolls back unless MQTT is up within this
+#define OTA_COPY_BUF            1024    // Delta COPY reads the running image this much at a time
+
+// ThingsBoard's firmware chunk topics: the request payload is the chunk size
+#define OTA_TOPIC_REQUEST       "v2/fw/request/%lu/chunk/%lu"
+#define OTA_TOPIC_RESPONSE_BASE "v2/fw/response/"
+#define OTA_TOPIC_RESPONSE      OTA_TOPIC_RESPONSE_BASE "+/chunk/+"
+
+
+// ===== Delta images =====
+//
+// The package is either a plain app image or a delta made by tools/ota_delta.py:
+// an ota_delta_header_t then ops, each an op byte and little endian arguments:
+//   OTA_DELTA_COPY    u32 offset, u32 length: bytes of the running image
+//   OTA_DELTA_INSERT  u32 length, then that many bytes
+//   OTA_DELTA_END
+// The ops are applied as the chunks arrive, nothing is buffered beyond one chunk.
+
+#define OTA_DELTA_MAGIC         "ESPD"
+#define OTA_DELTA_VERSION       1
+
+typedef enum {
+    OTA_DELTA_END = 0,
+    OTA_DELTA_COPY,
+    OTA_DELTA_INSERT,
+} ota_delta_op_t;
+
+typedef struct __attribute__((packed)) {
+    char magic[4];                      // OTA_DELTA_MAGIC
+    uint8_t version;                    // OTA_DELTA_VERSION
+    uint8_t reserved[3];
+    uint8_t base_sha256[32];            // app_elf_sha256 of the image it applies to
+    uint32_t image_size;                // Of the image it makes
+} ota_delta_header_t;
+
+
+// Early in app_main: notes whether this is the first boot of a new image
+void ota_init(void);
+
+// Confirms a new image once MQTT is up (or rolls it back), then downloads
+// whatever the fw_* shared attributes name if that isn't what's running
+void ota_task(void *param);
+
+// From the shared attributes parser: fw_title, fw_version, fw_checksum,
+// fw_checksum_algorithm, fw_size. Done with the message: `complete` if it parsed
+void ota_attribute(const char *key, const char *value);
+void ota_attributes_done(bool complete);
+
+// mqtt_rx_* handler for OTA_TOPIC_RESPONSE
+void ota_chunk_begin(const char *topic);
+void ota_chunk_data(const char *data, size_t len);
+void ota_chunk_end(bool complete);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // OTA_H
@@ -8,6 +8,7 @@
 #define MODEM_RX        GPIO_NUM_34
 #define MODEM_TX        GPIO_NUM_35
 #define MODEM_PWR_KEY   GPIO_NUM_36
+#define MODEM_RI        GPIO_NUM_37     // Ring indicator: pulses low on a URC, see AT+CFGRI
 #define RAIL_4V_EN      GPIO_NUM_21
 
 
@@ -0,0 +1,345 @@
+#include "power.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_attr.h"
+#include "esp_freertos_hooks.h"
+#include "esp_log.h"
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+
+
+static const char *TAG = "POWER";
+
+typedef struct {
+    uint32_t count;                     // power_lock() calls not yet unlocked
+    int64_t since_us;                   // When count last left 0
+    int64_t held_us;                    // Since boot, up to since_us while held
+    int64_t hold_until_us;              // power_hold() deadline
+    bool holding;                       // power_hold() has a count on it
+} power_lock_state_t;
+
+static const char *lock_names[POWER_LOCK_COUNT] = {
+    [POWER_LOCK_DISPLAY] = "display",
+    [POWER_LOCK_MASTER]  = "master",
+    [POWER_LOCK_MODEM]   = "modem",
+    [POWER_LOCK_WAKE]    = "wake",
+};
+
+static esp_pm_lock_handle_t pm_locks[POWER_LOCK_COUNT];     // NULL without CONFIG_PM_ENABLE
+static esp_timer_handle_t hold_timers[POWER_LOCK_COUNT];
+static power_lock_state_t locks[POWER_LOCK_COUNT];
+static int64_t sleep_us = 0;            // Light sleep since boot
+static volatile bool woke = false;      // on_sleep_exit() to wake_hook()
+static portMUX_TYPE power_spin = portMUX_INITIALIZER_UNLOCKED;
+
+// power_sample() window
+static int64_t window_start_us = 0;
+static int64_t window_sleep_us = 0;
+static int64_t window_held_us[POWER_LOCK_COUNT];
+
+// Only master_rx_task writes these
+static esp_timer_handle_t master_timer = NULL;
+static int64_t master_burst_us = 0;     // First frame of the latest burst
+static int64_t master_last_us = 0;
+static uint32_t master_period_ms = 0;
+
+
+void IRAM_ATTR power_lock(power_lock_id_t id) {
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL_SAFE(&power_spin);
+    if (locks[id].count++ == 0) {
+        locks[id].since_us = now;
+    }
+    portEXIT_CRITICAL_SAFE(&power_spin);
+
+    if (pm_locks[id]) {
+        esp_pm_lock_acquire(pm_locks[id]);
+    }
+}
+
+void IRAM_ATTR power_unlock(power_lock_id_t id) {
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL_SAFE(&power_spin);
+    if (locks[id].count && --locks[id].count == 0) {
+        locks[id].held_us += now - locks[id].since_us;
+    }
+    portEXIT_CRITICAL_SAFE(&power_spin);
+
+    if (pm_locks[id]) {
+        esp_pm_lock_release(pm_locks[id]);
+    }
+}
+
+void power_hold(power_lock_id_t id, uint32_t ms) {
+    if (hold_timers[id] == NULL) {
+        return;
+    }
+    int64_t until = esp_timer_get_time() + (int64_t)ms * 1000;
+
+    portENTER_CRITICAL_SAFE(&power_spin);
+    if (until > locks[id].hold_until_us) {
+        locks[id].hold_until_us = until;
+    }
+    bool start = !locks[id].holding;
+    locks[id].holding = true;
+    portEXIT_CRITICAL_SAFE(&power_spin);
+
+    // Already holding: hold_expired() sees the later deadline and waits on
+    if (start) {
+        power_lock(id);
+        esp_timer_start_once(hold_timers[id], (uint64_t)ms * 1000);
+    }
+}
+
+static void hold_expired(void *arg) {
+    power_lock_id_t id = (power_lock_id_t)(intptr_t)arg;
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&power_spin);
+    int64_t left_us = locks[id].hold_until_us - now;
+    if (left_us <= 0) {
+        locks[id].holding = false;
+    }
+    portEXIT_CRITICAL(&power_spin);
+
+    if (left_us > 0) {
+        esp_timer_start_once(hold_timers[id], left_us);
+    } else {
+        power_unlock(id);
+    }
+}
+
+
+// ===== Master frames =====
+
+// The bytes that wake us from UART1 are lost: a master that doesn't send
+// MSG_WAKE_PREAMBLE first would lose its frame. So be awake before each one is due
+static void master_due(void *arg) {
+    (void)arg;
+    power_hold(POWER_LOCK_MASTER, 2 * POWER_MASTER_GUARD_MS + POWER_MASTER_HOLD_MS);
+}
+
+void power_master_frame(void) {
+    int64_t now = esp_timer_get_time();
+    int64_t quiet_ms = (now - master_last_us) / 1000;
+    master_last_us = now;
+
+    power_hold(POWER_LOCK_MASTER, POWER_MASTER_HOLD_MS);
+
+    // Frames closer together than that are one burst
+    if (master_burst_us != 0 && quiet_ms < POWER_MASTER_HOLD_MS) {
+        return;
+    }
+
+    int64_t period_ms = (now - master_burst_us) / 1000;
+    if (master_burst_us != 0 && period_ms < POWER_MASTER_IDLE_MS) {
+        // Average over about four periods, the master's timing jitters
+        master_period_ms = master_period_ms ? (master_period_ms * 3 + (uint32_t)period_ms) / 4
+                                            : (uint32_t)period_ms;
+    }
+    master_burst_us = now;
+
+    if (master_timer && master_period_ms > POWER_MASTER_HOLD_MS + POWER_MASTER_GUARD_MS) {
+        esp_timer_stop(master_timer);
+        esp_timer_start_once(master_timer, (uint64_t)(master_period_ms - POWER_MASTER_GUARD_MS) * 1000);
+    }
+}
+
+
+// ===== Light sleep =====
+
+void power_uart_wake(uart_port_t port) {
+#if POWER_MGMT_ENABLE && POWER_LIGHT_SLEEP
+    // Edges, not a level: a master held in reset with the line low doesn't keep waking us
+    ESP_ERROR_CHECK(uart_set_wakeup_threshold(port, POWER_UART_WAKE_EDGES));
+    ESP_ERROR_CHECK(esp_sleep_enable_uart_wakeup(port));
+#else
+    (void)port;
+#endif
+}
+
+void power_rx_wake(gpio_num_t pin, bool enable) {
+#if POWER_MGMT_ENABLE && POWER_LIGHT_SLEEP
+    // RX idles high and RI rests high: the first start bit or RI pulse wakes us
+    if (enable) {
+        gpio_wakeup_enable(pin, GPIO_INTR_LOW_LEVEL);
+    } else {
+        gpio_wakeup_disable(pin);
+    }
+#else
+    (void)pin;
+    (void)enable;
+#endif
+}
+
+#if CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+static esp_err_t IRAM_ATTR on_sleep_exit(int64_t slept_us, void *arg) {
+    (void)arg;
+
+    portENTER_CRITICAL_SAFE(&power_spin);
+    sleep_us += slept_us;
+    portEXIT_CRITICAL_SAFE(&power_spin);
+
+    // No timers or PM locks this deep in the sleep code: wake_hook() holds
+    woke = true;
+    return ESP_OK;
+}
+
+// The idle task runs its hooks before it can go back to sleep, so the rest
+// of what woke us still finds us awake
+static bool wake_hook(void) {
+    if (!woke) {
+        return true;
+    }
+    woke = false;
+
+    switch (esp_sleep_get_wakeup_cause()) {
+    case ESP_SLEEP_WAKEUP_UART:
+        power_hold(POWER_LOCK_WAKE, POWER_UART_WAKE_HOLD_MS);
+        break;
+    case ESP_SLEEP_WAKEUP_GPIO:
+        power_hold(POWER_LOCK_WAKE, POWER_WAKE_HOLD_MS);
+        break;
+    default:
+        break;
+    }
+    return true;
+}
+#endif
+
+void power_init(void) {
+    for (int i = 0; i < POWER_LOCK_COUNT; i++) {
+        const esp_timer_create_args_t args = {
+            .callback = hold_expired,
+            .arg = (void *)(intptr_t)i,
+            .name = "power_hold",
+        };
+        ESP_ERROR_CHECK(esp_timer_create(&args, &hold_timers[i]));
+    }
+    const esp_timer_create_args_t master_args = {
+        .callback = master_due,
+        .name = "power_master",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&master_args, &master_timer));
+    window_start_us = esp_timer_get_time();
+
+#if POWER_MGMT_ENABLE && CONFIG_PM_ENABLE
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = POWER_CPU_MAX_MHZ,
+        .min_freq_mhz = POWER_CPU_MIN_MHZ,
+        .light_sleep_enable = POWER_LIGHT_SLEEP,
+    };
+    esp_err_t err = esp_pm_configure(&pm_config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "❌ esp_pm_configure failed: %s", esp_err_to_name(err));
+        return;
+    }
+
+    for (int i = 0; i < POWER_LOCK_COUNT; i++) {
+        ESP_ERROR_CHECK(esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, lock_names[i], &pm_locks[i]));
+    }
+
+#if POWER_LIGHT_SLEEP
+    // UART1 is added by uart_init(), MODEM_RX and MODEM_RI while the modem is powered
+    ESP_ERROR_CHECK(esp_sleep_enable_gpio_wakeup());
+#endif
+
+#if CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+    esp_pm_sleep_cbs_register_config_t cbs = {
+        .exit_cb = on_sleep_exit,
+    };
+    ESP_ERROR_CHECK(esp_pm_light_sleep_register_cbs(&cbs));
+    for (int cpu = 0; cpu < portNUM_PROCESSORS; cpu++) {
+        ESP_ERROR_CHECK(esp_register_freertos_idle_hook_for_cpu(wake_hook, cpu));
+    }
+#else
+    ESP_LOGW(TAG, "⚠️ No CONFIG_PM_LIGHT_SLEEP_CALLBACKS: sleep time and RX wakeups not seen");
+#endif
+
+    ESP_LOGI(TAG, "🔋 DFS %d-%d MHz, light sleep %s", POWER_CPU_MIN_MHZ, POWER_CPU_MAX_MHZ,
+             POWER_LIGHT_SLEEP ? "on" : "off");
+#else
+    ESP_LOGW(TAG, "⚠️ Power management off, CPU at %d MHz", CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+#endif
+}
+
+
+// ===== Stats =====
+
+// Held time of every lock up to `now`, the ones held now included
+static void held_until(int64_t now, int64_t held[POWER_LOCK_COUNT]) {
+    for (int i = 0; i < POWER_LOCK_COUNT; i++) {
+        held[i] = locks[i].held_us;
+        if (locks[i].count) {
+            held[i] += now - locks[i].since_us;
+        }
+    }
+}
+
+static uint16_t permille(int64_t part, int64_t whole) {
+    if (whole <= 0 || part <= 0) {
+        return 0;
+    }
+    return part >= whole ? 1000 : (uint16_t)(part * 1000 / whole);
+}
+
+void power_sample(power_sample_t *out) {
+    int64_t now = esp_timer_get_time();
+    int64_t held[POWER_LOCK_COUNT];
+
+    portENTER_CRITICAL(&power_spin);
+    held_until(now, held);
+    int64_t span = now - window_start_us;
+    int64_t slept = sleep_us - window_sleep_us;
+    window_start_us = now;
+    window_sleep_us = sleep_us;
+    for (int i = 0; i < POWER_LOCK_COUNT; i++) {
+        int64_t total = held[i];
+        held[i] -= window_held_us[i];
+        window_held_us[i] = total;
+    }
+    portEXIT_CRITICAL(&power_spin);
+
+    out->sleep_permille = permille(slept, span);
+    for (int i = 0; i < POWER_LOCK_COUNT; i++) {
+        out->held_permille[i] = permille(held[i], span);
+    }
+    out->master_period_ms = master_period_ms > UINT16_MAX ? UINT16_MAX : master_period_ms;
+
+    // Flushing and modem traffic at full clock, the rest of the awake time idle at the minimum
+    uint16_t awake = 1000 - out->sleep_permille;
+    uint16_t active = out->held_permille[POWER_LOCK_DISPLAY];
+    if (out->held_permille[POWER_LOCK_MODEM] > active) {
+        active = out->held_permille[POWER_LOCK_MODEM];
+    }
+    if (active > awake) {
+        active = awake;
+    }
+    out->avg_ma = (out->sleep_permille * POWER_MA_LIGHT_SLEEP +
+                   (awake - active) * POWER_MA_IDLE +
+                   active * POWER_MA_ACTIVE) / 1000.0f;
+}
+
+void power_log(void) {
+    int64_t now = esp_timer_get_time();
+    int64_t held[POWER_LOCK_COUNT];
+    uint32_t count[POWER_LOCK_COUNT];
+
+    portENTER_CRITICAL(&power_spin);
+    held_until(now, held);
+    int64_t slept = sleep_us;
+    for (int i = 0; i < POWER_LOCK_COUNT; i++) {
+        count[i] = locks[i].count;
+    }
+    portEXIT_CRITICAL(&power_spin);
+
+    ESP_LOGI(TAG, "🔋 asleep %u.%u%% since boot, master every %lu ms",
+             permille(slept, now) / 10, permille(slept, now) % 10, (unsigned long)master_period_ms);
+    for (int i = 0; i < POWER_LOCK_COUNT; i++) {
+        ESP_LOGI(TAG, "🔋 %-8s held %u.%u%%%s", lock_names[i],
+                 permille(held[i], now) / 10, permille(held[i], now) % 10, count[i] ? ", now" : "");
+    }
+}
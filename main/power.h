@@ -0,0 +1,82 @@
+#ifndef POWER_H
+#define POWER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "driver/gpio.h"
+#include "driver/uart.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// ===== Configuration =====
+
+#define POWER_MGMT_ENABLE       1       // 0: CPU stays at POWER_CPU_MAX_MHZ, the locks only count
+
+#define POWER_CPU_MAX_MHZ       160
+#define POWER_CPU_MIN_MHZ       40      // XTAL: the UARTs run from it, so their baud rates hold
+#define POWER_LIGHT_SLEEP       1       // Light sleep in idle when no lock is held
+
+#define POWER_WAKE_HOLD_MS      3000    // Awake after a modem pin woke us: for the rest of the URC,
+                                        // or the TCP retransmission of what was lost waking
+#define POWER_UART_WAKE_EDGES   3       // RX rising edges that wake us from UART1, the least the S3 takes
+#define POWER_UART_WAKE_HOLD_MS 100     // Awake after the master's wake preamble, for the frame after it
+#define POWER_MASTER_HOLD_MS    50      // Awake after a master frame, for the rest of its burst
+#define POWER_MASTER_GUARD_MS   20      // Awake this long before the next frame is due
+#define POWER_MASTER_IDLE_MS    5000    // Longer gaps aren't the master's period
+#define POWER_MODEM_HOLD_MS     2000    // Awake after broker traffic: the PUBACK or the rest of a message
+
+// ESP32-S3 module current per state, from the datasheet, for power_sample_t.avg_ma
+#define POWER_MA_LIGHT_SLEEP    0.24f
+#define POWER_MA_IDLE           13.0f   // Awake at POWER_CPU_MIN_MHZ, nothing running
+#define POWER_MA_ACTIVE         42.0f   // At POWER_CPU_MAX_MHZ, one core busy
+
+
+// Who keeps the chip out of light sleep
+typedef enum {
+    POWER_LOCK_DISPLAY = 0,     // A flush is on the SPI DMA
+    POWER_LOCK_MASTER,          // Master frames on UART1 are due
+    POWER_LOCK_MODEM,           // AT exchange, or broker traffic on UART2
+    POWER_LOCK_WAKE,            // Something woke us: POWER_WAKE_HOLD_MS or POWER_UART_WAKE_HOLD_MS
+    POWER_LOCK_COUNT
+} power_lock_id_t;
+
+// Time spent per state since the previous power_sample(), in 0.1 %
+typedef struct {
+    uint16_t sleep_permille;
+    uint16_t held_permille[POWER_LOCK_COUNT];
+    uint16_t master_period_ms;          // Learnt master frame period, 0: none yet
+    float avg_ma;                       // Estimate from the above and the POWER_MA_ figures
+} power_sample_t;
+
+
+// Before the tasks start: applies DFS and light sleep
+void power_init(void);
+
+// Counted: every power_lock() needs its power_unlock()
+void power_lock(power_lock_id_t id);
+void power_unlock(power_lock_id_t id);
+
+// Keep `id` held for `ms` from now, or longer if it already is. Task context only
+void power_hold(power_lock_id_t id, uint32_t ms);
+
+// master_rx_task got a frame: learns the period and wakes up ahead of the next one
+void power_master_frame(void);
+
+// Wake on `pin` going low, for a modem line that's only driven while the modem is powered
+void power_rx_wake(gpio_num_t pin, bool enable);
+
+// Wake on the master's preamble on `port`, once uart_init() has its pins set
+void power_uart_wake(uart_port_t port);
+
+void power_sample(power_sample_t *out);
+void power_log(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // POWER_H
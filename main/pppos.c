@@ -0,0 +1,504 @@
+#include "main.h"
+#include "modem.h"
+#include "mqtt.h"
+#include "pin_map.h"
+#include "display.h"
+#include "ui.h"
+#include "pppos.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "esp_netif_ppp.h"
+#include "esp_modem_api.h"
+#include "mqtt_client.h"
+#include "esp_timer.h"
+#include "link_health.h"
+#include "power.h"
+#include "ota.h"
+#include "trace.h"
+
+#if MQTT_TRANSPORT == MQTT_TRANSPORT_PPPOS
+
+static const char *TAG = "PPPOS";
+
+#define PPP_GOT_IP      BIT0
+
+typedef struct {
+    int msg_id;                 // 0: free, INFLIGHT_RESERVED: publish call under way
+    int64_t start_us;
+} inflight_t;
+
+#define INFLIGHT_RESERVED       -1
+
+static esp_modem_dce_t *dce = NULL;
+static esp_netif_t *ppp_netif = NULL;
+static esp_mqtt_client_handle_t client = NULL;
+static EventGroupHandle_t ppp_events = NULL;
+
+static inflight_t inflight[PPPOS_INFLIGHT_MAX];
+static int early_acks[PPPOS_INFLIGHT_MAX];      // PUBACKs that beat their publish call returning, 0: none
+static int early_next = 0;
+static portMUX_TYPE inflight_lock = portMUX_INITIALIZER_UNLOCKED;
+
+
+static void set_gsm_colour(uint32_t colour)
+{
+    lvgl_lock(LVGL_LOCK_WAIT_TIME);
+    lv_obj_set_style_text_color(ui_GSMTextArea, lv_color_hex(colour), LV_PART_MAIN | LV_STATE_DEFAULT);
+    lvgl_unlock();
+}
+
+
+///////////////////////////////// EVENTS /////////////////////////////////
+
+static void on_ip_event(void *arg, esp_event_base_t base, int32_t event_id, void *event_data)
+{
+    if (event_id == IP_EVENT_PPP_GOT_IP) {
+        ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
+        ESP_LOGI(TAG, "✅ PPP up, IP " IPSTR, IP2STR(&event->ip_info.ip));
+        xEventGroupSetBits(ppp_events, PPP_GOT_IP);
+    } else if (event_id == IP_EVENT_PPP_LOST_IP) {
+        // esp-mqtt reconnects by itself once the link is back
+        ESP_LOGW(TAG, "⚠️ PPP lost IP");
+        xEventGroupClearBits(ppp_events, PPP_GOT_IP);
+    }
+}
+
+static void on_published(int msg_id)
+{
+    int64_t now = esp_timer_get_time();
+    int64_t start = 0;
+
+    taskENTER_CRITICAL(&inflight_lock);
+    bool reserved = false;
+    for (int i = 0; i < PPPOS_INFLIGHT_MAX; i++) {
+        if (inflight[i].msg_id == msg_id) {
+            start = inflight[i].start_us;
+            inflight[i].msg_id = 0;
+            break;
+        }
+        reserved |= inflight[i].msg_id == INFLIGHT_RESERVED;
+    }
+    // Not known yet: pppos_mqtt_publish() clears its slot once it has the id
+    if (start == 0 && reserved) {
+        early_acks[early_next] = msg_id;
+        early_next = (early_next + 1) % PPPOS_INFLIGHT_MAX;
+    }
+    taskEXIT_CRITICAL(&inflight_lock);
+
+    if (start) {
+        modem_stats_acked((uint32_t)((now - start) / 1000));
+    }
+    link_ok();
+}
+
+// Long messages arrive in chunks and only the first one carries the topic
+static void on_data(esp_mqtt_event_handle_t event)
+{
+    if (event->current_data_offset == 0) {
+        char topic[MQTT_TOPIC_MAX];
+        int topic_len = event->topic_len < (int)sizeof(topic) - 1 ? event->topic_len : (int)sizeof(topic) - 1;
+        memcpy(topic, event->topic, topic_len);
+        topic[topic_len] = '\0';
+        mqtt_rx_begin(topic, event->total_data_len);
+    }
+
+    mqtt_rx_data(event->data, event->data_len);
+
+    if (event->current_data_offset + event->data_len >= event->total_data_len) {
+        mqtt_rx_end();
+    }
+}
+
+static void on_mqtt_event(void *arg, esp_event_base_t base, int32_t event_id, void *event_data)
+{
+    esp_mqtt_event_handle_t event = (esp_mqtt_event_handle_t)event_data;
+
+    // More broker traffic tends to follow: stay awake for it in one piece
+    power_hold(POWER_LOCK_MODEM, POWER_MODEM_HOLD_MS);
+
+    switch ((esp_mqtt_event_id_t)event_id) {
+    case MQTT_EVENT_CONNECTED:
+        ESP_LOGI(TAG, "✅ MQTT connected to ThingsBoard");
+
+        // Clean session: subscribe again on every connect
+        esp_mqtt_client_subscribe(client, MQTT_ATRR_SUBSCRIBE, 1);
+        esp_mqtt_client_subscribe(client, MQTT_RPC_REQUEST, 1);
+        esp_mqtt_client_subscribe(client, MQTT_ATTR_RESPONSE, 1);
+        esp_mqtt_client_subscribe(client, OTA_TOPIC_RESPONSE, 1);
+        if (!request_all_shared_attributes()) {
+            ESP_LOGE(TAG, "Failed to request shared attributes");
+        }
+
+        xEventGroupSetBits(systemEvents, MQTT_INIT);
+        set_gsm_colour(0x00FF00);
+        break;
+
+    case MQTT_EVENT_DISCONNECTED:
+        // esp-mqtt keeps reconnecting; the supervisor steps in if that keeps failing
+        ESP_LOGW(TAG, "⚠️ MQTT disconnected");
+        set_gsm_colour(0x40E0D0);
+        link_failed("MQTT session");
+        break;
+
+    case MQTT_EVENT_PUBLISHED:
+        on_published(event->msg_id);
+        break;
+
+    case MQTT_EVENT_DATA:
+        on_data(event);
+        break;
+
+    case MQTT_EVENT_ERROR:
+        ESP_LOGE(TAG, "❌ MQTT error, type %d", event->error_handle->error_type);
+        break;
+
+    default:
+        break;
+    }
+}
+
+
+////////////////////////////////// START //////////////////////////////////
+
+static bool pppos_mqtt_start(void)
+{
+    esp_mqtt_client_config_t mqtt_cfg = {
+        .broker.address.uri = "mqtt://" MQTT_BROKER,
+        .broker.address.port = MQTT_PORT,
+        .credentials.client_id = MQTT_CLIENT_ID,
+        .credentials.username = MQTT_USERNAME,
+        .credentials.authentication.password = MQTT_PASSWORD,
+        .session.keepalive = 60,            // Same as AT+CMQTTCONNECT
+        .task.stack_size = 2048*4,          // Runs the attribute and RPC handlers
+    };
+
+    client = esp_mqtt_client_init(&mqtt_cfg);
+    if (client == NULL) {
+        ESP_LOGE(TAG, "❌ MQTT client init failed");
+        return false;
+    }
+
+    esp_mqtt_client_register_event(client, ESP_EVENT_ANY_ID, on_mqtt_event, NULL);
+    if (esp_mqtt_client_start(client) != ESP_OK) {
+        ESP_LOGE(TAG, "❌ MQTT client start failed");
+        return false;
+    }
+
+    ESP_LOGI(TAG, "🌐 Connecting to broker %s:%d...", MQTT_BROKER, MQTT_PORT);
+    EventBits_t bits = xEventGroupWaitBits(systemEvents, MQTT_INIT, pdFALSE, pdFALSE,
+                                           pdMS_TO_TICKS(PPPOS_MQTT_TIMEOUT_MS));
+    if (!(bits & MQTT_INIT)) {
+        ESP_LOGE(TAG, "❌ No MQTT connection after %d ms", PPPOS_MQTT_TIMEOUT_MS);
+        return false;
+    }
+    return true;
+}
+
+bool pppos_start(void)
+{
+    // Both may already exist; anything else is fatal
+    ESP_ERROR_CHECK(esp_netif_init());
+    esp_err_t err = esp_event_loop_create_default();
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        ESP_ERROR_CHECK(err);
+    }
+
+    if (ppp_events == NULL) {
+        ppp_events = xEventGroupCreate();
+    }
+    xEventGroupClearBits(ppp_events, PPP_GOT_IP);
+    esp_event_handler_register(IP_EVENT, ESP_EVENT_ANY_ID, on_ip_event, NULL);
+
+    esp_netif_config_t netif_cfg = ESP_NETIF_DEFAULT_PPP();
+    ppp_netif = esp_netif_new(&netif_cfg);
+    if (ppp_netif == NULL) {
+        ESP_LOGE(TAG, "❌ PPP netif init failed");
+        return false;
+    }
+
+    esp_modem_dte_config_t dte_config = ESP_MODEM_DTE_DEFAULT_CONFIG();
+    dte_config.uart_config.port_num = SIM7600_UART_PORT;
+    dte_config.uart_config.baud_rate = SIM7600_BAUD_RATE;
+    dte_config.uart_config.tx_io_num = MODEM_TX;
+    dte_config.uart_config.rx_io_num = MODEM_RX;
+    dte_config.uart_config.rts_io_num = UART_PIN_NO_CHANGE;
+    dte_config.uart_config.cts_io_num = UART_PIN_NO_CHANGE;
+    dte_config.uart_config.flow_control = ESP_MODEM_FLOW_CONTROL_NONE;
+    dte_config.uart_config.source_clk = UART_SCLK_XTAL;     // APB changes with DFS, see power.h
+
+    // CGDCONT is set from this when dialling; the credentials go in with CGAUTH
+    esp_modem_dce_config_t dce_config = ESP_MODEM_DCE_DEFAULT_CONFIG(APN);
+
+    dce = esp_modem_new_dev(ESP_MODEM_DCE_SIM7600, &dte_config, &dce_config, ppp_netif);
+    if (dce == NULL) {
+        ESP_LOGE(TAG, "❌ esp_modem init failed");
+        return false;
+    }
+
+    int attempt;
+    for (attempt = 0; attempt < PPPOS_SYNC_ATTEMPTS; attempt++) {
+        if (esp_modem_sync(dce) == ESP_OK) {
+            break;
+        }
+        vTaskDelay(pdMS_TO_TICKS(1000));
+    }
+    if (attempt == PPPOS_SYNC_ATTEMPTS) {
+        ESP_LOGE(TAG, "❌ Modem not answering esp_modem");
+        return false;
+    }
+
+    // From here send_at_command() goes through esp_modem
+    if (!sim7080_wait_for_sim_and_signal(500, 3000) ||
+        !sim7600_wait_for_registration(80)) {
+        return false;
+    }
+    sim7600_pdp_setup();
+
+    ESP_LOGI(TAG, "📞 Dialling PPP over CMUX...");
+    if (esp_modem_set_mode(dce, ESP_MODEM_MODE_CMUX) != ESP_OK) {
+        ESP_LOGE(TAG, "❌ CMUX/data mode failed");
+        return false;
+    }
+
+    EventBits_t bits = xEventGroupWaitBits(ppp_events, PPP_GOT_IP, pdFALSE, pdFALSE,
+                                           pdMS_TO_TICKS(PPPOS_IP_TIMEOUT_MS));
+    if (!(bits & PPP_GOT_IP)) {
+        ESP_LOGE(TAG, "❌ No PPP IP after %d ms", PPPOS_IP_TIMEOUT_MS);
+        return false;
+    }
+    set_gsm_colour(0x40E0D0);
+
+    return pppos_mqtt_start();
+}
+
+void pppos_stop(void)
+{
+    if (client) {
+        esp_mqtt_client_destroy(client);
+        client = NULL;
+    }
+    // Also uninstalls the UART driver
+    if (dce) {
+        esp_modem_destroy(dce);
+        dce = NULL;
+    }
+    if (ppp_netif) {
+        esp_netif_destroy(ppp_netif);
+        ppp_netif = NULL;
+    }
+    esp_event_handler_unregister(IP_EVENT, ESP_EVENT_ANY_ID, on_ip_event);
+    xEventGroupClearBits(systemEvents, MQTT_INIT);
+}
+
+bool pppos_is_active(void)
+{
+    return dce != NULL;
+}
+
+void pppos_shutdown(void)
+{
+    if (client) {
+        esp_mqtt_client_disconnect(client);
+        esp_mqtt_client_stop(client);
+    }
+    // Command mode hangs up PPP and closes CMUX, then the modem can power itself off
+    if (dce && esp_modem_set_mode(dce, ESP_MODEM_MODE_COMMAND) == ESP_OK) {
+        char out[PPPOS_AT_OUT_SIZE];
+        if (esp_modem_at(dce, "AT+CPOF", out, 5000) != ESP_OK) {
+            ESP_LOGW(TAG, "⚠️ AT+CPOF not answered");
+        }
+    }
+    pppos_stop();
+}
+
+int pppos_mqtt_inflight(void)
+{
+    int count = 0;
+
+    taskENTER_CRITICAL(&inflight_lock);
+    for (int i = 0; i < PPPOS_INFLIGHT_MAX; i++) {
+        if (inflight[i].msg_id != 0) {
+            count++;
+        }
+    }
+    taskEXIT_CRITICAL(&inflight_lock);
+    return count;
+}
+
+bool pppos_mqtt_reconnect(void)
+{
+    if (client == NULL) {
+        return false;
+    }
+
+    xEventGroupClearBits(systemEvents, MQTT_INIT);
+    esp_mqtt_client_disconnect(client);
+    if (esp_mqtt_client_reconnect(client) != ESP_OK) {
+        ESP_LOGE(TAG, "❌ MQTT reconnect failed");
+        return false;
+    }
+
+    EventBits_t bits = xEventGroupWaitBits(systemEvents, MQTT_INIT, pdFALSE, pdFALSE,
+                                           pdMS_TO_TICKS(PPPOS_MQTT_TIMEOUT_MS));
+    return (bits & MQTT_INIT) != 0;
+}
+
+
+//////////////////////////////// AT + PUBLISH ////////////////////////////////
+
+const char *pppos_at_command(const char *command, int timeout_ms)
+{
+    static char response[PPPOS_AT_OUT_SIZE + 8];
+    char out[PPPOS_AT_OUT_SIZE];
+    out[0] = '\0';
+
+    if (xSemaphoreTake(at_mutex, pdMS_TO_TICKS(1000)) != pdTRUE) return NULL;
+
+    TRACE_STR(ESP_LOG_INFO, TEV_PPP_AT_CMD, command);
+    power_lock(POWER_LOCK_MODEM);
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = esp_modem_at(dce, command, out, timeout_ms);
+    power_unlock(POWER_LOCK_MODEM);
+
+    if (err == ESP_ERR_TIMEOUT) {
+        xSemaphoreGive(at_mutex);
+        ESP_LOGW(TAG, "❌ No response (timeout %d ms): %s", timeout_ms, command);
+        TRACE_STR(ESP_LOG_WARN, TEV_PPP_AT_TIMEOUT, command, timeout_ms);
+        return NULL;
+    }
+
+    // Same shape as the AT transport's response: lines, then the final result
+    snprintf(response, sizeof(response), "%s\n%s\n", out, err == ESP_OK ? "OK" : "ERROR");
+    xSemaphoreGive(at_mutex);
+
+    TRACE_STR(ESP_LOG_INFO, TEV_PPP_AT_DONE, out, (uint32_t)((esp_timer_get_time() - start) / 1000), err);
+    return response;
+}
+
+bool pppos_mqtt_publish(const char *topic, const void *payload, size_t len)
+{
+    if (client == NULL) {
+        return false;
+    }
+
+    // esp-mqtt is thread safe: no publish_mutex, the URC and GNSS traffic has its own channel
+    power_hold(POWER_LOCK_MODEM, POWER_MODEM_HOLD_MS);     // For the PUBACK
+    int64_t start = esp_timer_get_time();
+
+    // The slot is taken before publishing, the PUBACK can come in before the
+    // call returns. The oldest one when all are taken: their PUBACK got lost
+    taskENTER_CRITICAL(&inflight_lock);
+    int slot = -1;
+    bool lost = true;
+    for (int i = 0; i < PPPOS_INFLIGHT_MAX; i++) {
+        if (inflight[i].msg_id == 0) {
+            slot = i;
+            lost = false;
+            break;
+        }
+        if (inflight[i].msg_id != INFLIGHT_RESERVED && (slot < 0 || inflight[i].start_us < inflight[slot].start_us)) {
+            slot = i;
+        }
+    }
+    if (slot >= 0) {
+        inflight[slot].msg_id = INFLIGHT_RESERVED;
+        inflight[slot].start_us = start;
+    }
+    taskEXIT_CRITICAL(&inflight_lock);
+
+    if (lost && slot >= 0) {
+        link_failed("PUBACK");
+    }
+
+    int msg_id = esp_mqtt_client_publish(client, topic, payload, len, 1, 0);
+
+    taskENTER_CRITICAL(&inflight_lock);
+    bool acked = false;
+    for (int i = 0; msg_id > 0 && i < PPPOS_INFLIGHT_MAX; i++) {
+        if (early_acks[i] == msg_id) {
+            early_acks[i] = 0;
+            acked = true;
+        }
+    }
+    if (slot >= 0) {
+        inflight[slot].msg_id = msg_id > 0 && !acked ? msg_id : 0;
+    }
+    // The rest belonged to evicted publishes, no call can be waiting for them
+    bool reserved = false;
+    for (int i = 0; i < PPPOS_INFLIGHT_MAX; i++) {
+        reserved |= inflight[i].msg_id == INFLIGHT_RESERVED;
+    }
+    if (!reserved) {
+        memset(early_acks, 0, sizeof(early_acks));
+    }
+    taskEXIT_CRITICAL(&inflight_lock);
+
+    if (msg_id < 0) {
+        ESP_LOGE(TAG, "❌ Publish failed");
+        link_failed("MQTT publish");
+        return false;
+    }
+    if (acked) {
+        modem_stats_acked((uint32_t)((esp_timer_get_time() - start) / 1000));
+    }
+
+    TRACE_STR(ESP_LOG_INFO, TEV_MQTT_PUB, topic, len);
+    return true;
+}
+
+void pppos_stats_log(void)
+{
+    size_t peak;
+    uint32_t overflows;
+    if (dce == NULL || esp_modem_get_buffer_stats(dce, &peak, &overflows) != ESP_OK) {
+        return;
+    }
+    // Size CONFIG_ESP_MODEM_EXTRA_BUFFER_SIZE from the peak, overflows failed their command
+    ESP_LOGI(TAG, "📊 AT replies up to %u B, %lu overflowed", (unsigned)peak, (unsigned long)overflows);
+}
+
+#else
+
+bool pppos_start(void)
+{
+    return false;
+}
+
+void pppos_stop(void)
+{
+}
+
+bool pppos_is_active(void)
+{
+    return false;
+}
+
+void pppos_shutdown(void)
+{
+}
+
+int pppos_mqtt_inflight(void)
+{
+    return 0;
+}
+
+bool pppos_mqtt_reconnect(void)
+{
+    return false;
+}
+
+const char *pppos_at_command(const char *command, int timeout_ms)
+{
+    return NULL;
+}
+
+bool pppos_mqtt_publish(const char *topic, const void *payload, size_t len)
+{
+    return false;
+}
+
+void pppos_stats_log(void)
+{
+}
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef PPPOS_H
+#define PPPOS_H
+
+#include <stdbool.h>
+#include "modem.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// ===== Configuration =====
+
+#define PPPOS_IP_TIMEOUT_MS     60000   // PPP link up after dialling
+#define PPPOS_MQTT_TIMEOUT_MS   30000   // First CONNACK after the link is up
+#define PPPOS_SYNC_ATTEMPTS     10      // esp_modem talking to the modem at all
+#define PPPOS_AT_OUT_SIZE       128     // esp_modem_at copies at most this much
+#define PPPOS_INFLIGHT_MAX      4       // QoS 1 publishes timed until their PUBACK
+
+
+// === Public PPPoS Functions ===
+
+// Bring up esp_modem on the modem UART, dial PPP over CMUX and connect esp-mqtt.
+// Expects a freshly powered modem. On false call pppos_stop() to free the UART
+bool pppos_start(void);
+void pppos_stop(void);
+
+// True while esp_modem owns the modem UART
+bool pppos_is_active(void);
+
+// For deep sleep: MQTT DISCONNECT, PPP hang-up, AT+CPOF, then pppos_stop()
+void pppos_shutdown(void);
+
+// QoS 1 publishes still waiting for their PUBACK
+int pppos_mqtt_inflight(void);
+
+// Drop the MQTT session and wait up to PPPOS_MQTT_TIMEOUT_MS for a new one
+bool pppos_mqtt_reconnect(void);
+
+// send_at_command() over the CMUX command channel: the last response line, then OK or ERROR
+const char *pppos_at_command(const char *command, int timeout_ms);
+bool pppos_mqtt_publish(const char *topic, const void *payload, size_t len);
+
+// Logs the longest AT reply esp_modem had to buffer and the replies that didn't fit
+void pppos_stats_log(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PPPOS_H
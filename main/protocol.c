@@ -0,0 +1,127 @@
+#include "protocol.h"
+
+
+// ===== Schema =====
+
+#define POW10(n)    ((n) == 0 ? 1 : (n) == 1 ? 10 : (n) == 2 ? 100 : (n) == 3 ? 1000 : 10000)
+
+#define STATE_FIELDS(...)                   STATE_FIELDS_(__VA_ARGS__)
+#define STATE_FIELDS_(offset, key, json)    .state = (offset), .tlm_state_key = (key), .tlm_state_name = (json)
+
+#define CHANNEL(NAME, json, unit_, word_, signed_, none_, offset_, mul_, decimals_, shown_,            \
+                filter_, field_, state_, readout_)                                                      \
+    {                                                                                                   \
+        .name = json,                                                                                   \
+        .unit = unit_,                                                                                  \
+        .word = word_,                                                                                  \
+        .decimals = decimals_,                                                                          \
+        .shown = shown_,                                                                                \
+        .filter = filter_,                                                                              \
+        .sign = (signed_) ? 0x8000 : 0,                                                                 \
+        .none = none_,                                                                                  \
+        .offset = offset_,                                                                              \
+        .mul = mul_,                                                                                    \
+        .shown_div = POW10((decimals_) - (shown_)),                                                     \
+        .unit_div = POW10(decimals_),                                                                   \
+        .field = offsetof(sensor_data_t, field_),                                                       \
+        STATE_FIELDS(state_),                                                                           \
+        .tlm_key = TLM_KEY_##NAME,                                                                      \
+        .tlm_scale = TLM_SCALE_##NAME,                                                                  \
+        .readout = &readout_,                                                                           \
+    },
+
+// In MSG_IDS order, so each message's channels sit together
+const protocol_channel_t protocol_channels[PROTOCOL_CHANNEL_COUNT] = {
+#define X(name, id, handler, channels) channels(CHANNEL)
+    MSG_IDS(X)
+#undef X
+};
+
+// FIRST_<message> is where its channels start; the one after starts past them.
+// A message without channels starts where the next one does
+enum {
+#define C(...) + 1
+#define X(name, id, handler, channels) FIRST_##name, LAST_##name = FIRST_##name + (0 channels(C)) - 1,
+    MSG_IDS(X)
+#undef X
+#undef C
+};
+
+const protocol_span_t protocol_spans[MSG_ID_COUNT] = {
+#define C(...) + 1
+#define X(name, id, handler, channels) [id] = { FIRST_##name, 0 channels(C) },
+    MSG_IDS(X)
+#undef X
+#undef C
+};
+
+#define X(name, id, handler, channels) _Static_assert(id < MSG_ID_COUNT, "MSG_IDS: ids 0..MSG_ID_COUNT-1");
+MSG_IDS(X)
+#undef X
+
+_Static_assert(PROTOCOL_CHANNEL_COUNT <= UINT8_MAX, "protocol_span_t counts channels in a byte");
+_Static_assert(offsetof(DecodedMessage, data3) == offsetof(DecodedMessage, data0) + 3 * sizeof(uint16_t),
+               "protocol_channel_value() indexes data0..data3");
+
+
+// ===== Codec =====
+
+// Hex digit value + 1, 0 for anything else
+static const uint8_t hex_value[256] = {
+    ['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5, ['5'] = 6, ['6'] = 7, ['7'] = 8,
+    ['8'] = 9, ['9'] = 10,
+    ['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+    ['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+};
+
+static const char hex_digit[16] = "0123456789ABCDEF";
+
+// Four hex digits; `bad` collects a 0 for any that isn't one
+static inline uint16_t hex4(const char *p, uint8_t *bad) {
+    uint8_t a = hex_value[(uint8_t)p[0]], b = hex_value[(uint8_t)p[1]];
+    uint8_t c = hex_value[(uint8_t)p[2]], d = hex_value[(uint8_t)p[3]];
+    *bad |= !a | !b | !c | !d;
+    return (uint16_t)(((a - 1) << 12) | ((b - 1) << 8) | ((c - 1) << 4) | (d - 1));
+}
+
+bool protocol_decode(const char *frame, DecodedMessage *msg) {
+    uint8_t bad = (uint8_t)(frame[0] - '0') > 9 || frame[5] != '#';
+
+    msg->message_type = frame[0] - '0';
+    msg->message_id = hex4(frame + 1, &bad);
+    msg->data0 = hex4(frame + 6, &bad);
+    msg->data1 = hex4(frame + 10, &bad);
+    msg->data2 = hex4(frame + 14, &bad);
+    msg->data3 = hex4(frame + 18, &bad);
+    return !bad;
+}
+
+static inline void put_hex4(char *p, uint16_t v) {
+    p[0] = hex_digit[(v >> 12) & 0xF];
+    p[1] = hex_digit[(v >> 8) & 0xF];
+    p[2] = hex_digit[(v >> 4) & 0xF];
+    p[3] = hex_digit[v & 0xF];
+}
+
+void protocol_encode(char frame[PROTOCOL_FRAME_LEN + 1], int message_type, int message_id,
+                     uint16_t data0, uint16_t data1, uint16_t data2, uint16_t data3) {
+    frame[0] = message_type ? '1' : '0';
+    put_hex4(frame + 1, (uint16_t)message_id);
+    frame[5] = '#';
+    put_hex4(frame + 6, data0);
+    put_hex4(frame + 10, data1);
+    put_hex4(frame + 14, data2);
+    put_hex4(frame + 18, data3);
+    frame[PROTOCOL_FRAME_LEN] = '\0';
+}
+
+sensor_state_t protocol_channel_value(const protocol_channel_t *ch, const DecodedMessage *msg, int32_t *value) {
+    uint16_t word = (&msg->data0)[ch->word];
+    if (word == ch->none) {
+        return SENSOR_NO_DATA;
+    }
+    // Sign extension without a branch: 0x8000 flips to 0 and back down to -0x8000
+    int32_t raw = (int32_t)(word ^ ch->sign) - ch->sign;
+    *value = (raw + ch->offset) * ch->mul;
+    return SENSOR_OK;
+}
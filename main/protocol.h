@@ -0,0 +1,141 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "data.h"
+#include "filter.h"
+#include "message_ids.h"
+#include "telemetry_schema.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// ===== Frames =====
+
+// "%c%04X#%04X%04X%04X%04X": type, sequence and id, '#', data0..data3
+#define PROTOCOL_FRAME_LEN      22
+
+
+// ===== Channels =====
+//
+// The numbers the master sends, one line each. handle_channels() (data.c)
+// decodes, filters, stores and draws them and publish.c puts them in the
+// telemetry, all from these lines: a new channel is a line here, in the list
+// of its message in MSG_IDS, plus its sensor_data_t field, readout widget
+// and TLM_KEY_/TLM_SCALE_ (telemetry_schema.h, under the same NAME).
+//
+// A word becomes `(word + offset) * mul`, an integer in 10^-decimals of
+// `unit`; `none` is the word the master sends without a reading. The value
+// goes through `filter`, lands in the float `field` of sensor_data_t and on
+// the `readout` with `shown` decimals.
+//
+// C(NAME, "json name", "unit", word, signed, none, offset, mul, decimals, shown,
+//   filter, field, state, readout)
+
+#define PROTOCOL_BME280(C)                                                                              \
+    C(TEMPERATURE,   "Temperature",   "degC", 0, 0, PROTOCOL_NO_NONE, 0, 1, 2, 1,                      \
+      FILTER_TEMP,        temp,      PROTOCOL_NO_STATE, ui_BMETempTextArea)                             \
+    C(PRESSURE,      "Pressure",      "kPa",  1, 0, PROTOCOL_NO_NONE, 0, 1, 2, 1,                      \
+      PROTOCOL_NO_FILTER, pres,      PROTOCOL_NO_STATE, ui_BMEPresTextArea)                             \
+    C(HUMIDITY,      "Humidity",      "%RH",  2, 0, PROTOCOL_NO_NONE, 0, 1, 2, 1,                      \
+      PROTOCOL_NO_FILTER, rh,        PROTOCOL_NO_STATE, ui_BMEHumTextArea)
+
+#define PROTOCOL_BATT(C)                                                                                \
+    C(BATTERY_VOLTS, "Battery_volts", "V",    0, 0, 0xFFFF, 0, 1, 3, 1,                                \
+      PROTOCOL_NO_FILTER, batt_volt, PROTOCOL_NO_STATE, ui_BattVTextArea)
+
+// 0.1 degC above -50, filtered in 0.01 degC like the BME280
+#define PROTOCOL_PT1000(C)                                                                              \
+    C(PT1000,        "PT1000",        "degC", 0, 1, 0xFFFF, -500, 10, 2, 1,                            \
+      FILTER_PT1000,      pt1000,    PROTOCOL_STATE(pt1000_state, PT1000_STATE, "PT1000State"), ui_PT1000TextArea)
+
+#define PROTOCOL_NONE(C)
+
+#define PROTOCOL_NO_NONE        -1      // Every word is a reading
+#define PROTOCOL_NO_FILTER      -1
+#define PROTOCOL_NO_STATE       -1, 0, NULL
+
+// The channel's sensor_state_t in sensor_data_t, published under TLM_KEY_<key>
+#define PROTOCOL_STATE(field, key, name)    offsetof(sensor_data_t, field), TLM_KEY_##key, name
+
+typedef struct {
+    const char *name;                   // Its JSON telemetry key
+    const char *unit;
+    uint8_t word;                       // data0..data3
+    uint8_t decimals;
+    uint8_t shown;                      // Decimals on the readout
+    int8_t filter;                      // filter_channel_t or PROTOCOL_NO_FILTER
+    uint16_t sign;                      // 0x8000 when the word is two's complement
+    int32_t none;                       // Word without a reading, or PROTOCOL_NO_NONE
+    int32_t offset;
+    int32_t mul;
+    int32_t shown_div;                  // 10^(decimals - shown)
+    int32_t unit_div;                   // 10^decimals: value / unit_div is in `unit`
+    uint16_t field;                     // offsetof the float in sensor_data_t
+    int16_t state;                      // offsetof the sensor_state_t in sensor_data_t, or -1
+    uint8_t tlm_key;
+    uint8_t tlm_state_key;
+    uint32_t tlm_scale;
+    const char *tlm_state_name;
+    lv_obj_t **readout;
+} protocol_channel_t;
+
+// The channels of one message: protocol_channels[first] onwards
+typedef struct {
+    uint8_t first;
+    uint8_t count;
+} protocol_span_t;
+
+enum {
+#define C(...) + 1
+#define X(name, id, handler, channels) channels(C)
+    PROTOCOL_CHANNEL_COUNT = 0 MSG_IDS(X)
+#undef X
+#undef C
+};
+
+extern const protocol_channel_t protocol_channels[PROTOCOL_CHANNEL_COUNT];
+extern const protocol_span_t protocol_spans[MSG_ID_COUNT];
+
+
+// ===== Outputs =====
+
+// MSG_ID_OUTPUTS: data0 picks the output, data1 is its state.
+// O(index, field, readout), field a bool in sensor_data_t
+#define PROTOCOL_OUTPUTS(O)                                                     \
+    O(0, out1, ui_Out124VTextArea)                                              \
+    O(1, out2, ui_Out224VTextArea)                                              \
+    O(2, npn1, ui_Out1NPNTextArea1)                                             \
+    O(3, npn2, ui_Out2NPNTextArea2)
+
+
+// ===== Codec =====
+
+// A frame as the master sends it into `msg`. False if it isn't one: a
+// character out of place, as from a frame cut by a wakeup
+bool protocol_decode(const char *frame, DecodedMessage *msg);
+
+// A frame for the master into `frame`, terminated. `message_id` carries the
+// sequence number in its high byte
+void protocol_encode(char frame[PROTOCOL_FRAME_LEN + 1], int message_type, int message_id,
+                     uint16_t data0, uint16_t data1, uint16_t data2, uint16_t data3);
+
+// The value of `ch` in `msg`, in 10^-decimals of its unit.
+// SENSOR_NO_DATA, leaving `value` alone, for the word that means none
+sensor_state_t protocol_channel_value(const protocol_channel_t *ch, const DecodedMessage *msg, int32_t *value);
+
+// The channel's float in `data`
+static inline float *protocol_channel_field(const protocol_channel_t *ch, sensor_data_t *data) {
+    return (float *)((uint8_t *)data + ch->field);
+}
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PROTOCOL_H
@@ -8,6 +8,15 @@
 #include "data.h"
 #include "mqtt.h"
 #include "publish.h"
+#include "cbor.h"
+#include "telemetry_schema.h"
+#include "power.h"
+#include "diag.h"
+#include "filter.h"
+#include "protocol.h"
+#include "trace.h"
+#include <math.h>
+#include <sys/time.h>
 
 
 
@@ -16,181 +25,469 @@ static const char *TAG = "PUBLISH";
 #define MQTT_PUBLISH_FREQ      1 //interval for publishing data in minutes
 
 
+typedef struct {
+    sensor_data_t data;
+    int64_t ts;         // ms since the epoch, 0 while the clock isn't set
+    bool alarm;         // flush the batch as soon as this is in it
+    power_sample_t power;   // since the previous sample
+    const char *event;  // "Event", a string literal; NULL: none
+    bool drain;         // publish_drain(): flush, then give `drained`
+} publish_sample_t;
+
+static QueueHandle_t sample_queue = NULL;
+static SemaphoreHandle_t drained = NULL;
+static bool drain_ok = false;
+
+// The batch being built, still open: "[entry,entry,.." or a CBOR array without its break
+static char batch_buf[PUBLISH_BATCH_MAX_BYTES];
+static char entry_buf[PUBLISH_ENTRY_MAX_BYTES];
+#if PUBLISH_ENCODING == PUBLISH_ENCODING_CBOR && PUBLISH_CBOR_COMPARE
+static char json_buf[PUBLISH_ENTRY_MAX_BYTES];
+static size_t batch_json_len = 0;  // The same batch as JSON
+#endif
+static size_t batch_len = 0;
+static int batch_count = 0;
+static TickType_t batch_started = 0;
+static TickType_t last_flush = 0;
+static sensor_data_t batch_last;   // Entries after the first only carry what changed since this
+
+
 
 //functions//
-void publish_data(void) {
-    if (publish_trigger) {
-        //ESP_LOGW(TAG, "Publishing data triggered externally");
-        xSemaphoreGive(publish_trigger);
+static int64_t wall_time_ms(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    if (tv.tv_sec < PUBLISH_CLOCK_VALID_S) {
+        return 0;
     }
+    return (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
 }
 
+static void take_sample(publish_sample_t *sample, bool alarm) {
+    xSemaphoreTake(data_mutex, portMAX_DELAY);
+    sample->data = shared_sensor_data;
+    xSemaphoreGive(data_mutex);
 
-//Task thread
-void publish_task(void *pvParameter){
+    sample->ts = wall_time_ms();
+    sample->alarm = alarm;
+    sample->event = NULL;
+    sample->drain = false;
+    power_sample(&sample->power);
+}
 
-    publish_trigger = xSemaphoreCreateBinary();  // Create the publish trigger semaphore
-    
-    xEventGroupWaitBits(systemEvents, MQTT_INIT, pdFALSE, pdFALSE, portMAX_DELAY);
-    ESP_LOGW(TAG, "publish task active");
+static void queue_sample(bool alarm) {
+    if (sample_queue == NULL) {
+        return;
+    }
 
-    
-    
+    publish_sample_t sample;
+    take_sample(&sample, alarm);
 
-    const TickType_t publish_interval = 60000 * MQTT_PUBLISH_FREQ / portTICK_PERIOD_MS; //timeout for publishing data
+    if (xQueueSend(sample_queue, &sample, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "⚠️ Publish queue full, sample dropped");
+    }
+}
 
-    while(1){
+void publish_data(void) {
+    queue_sample(false);
+}
 
+void publish_alarm(void) {
+    queue_sample(true);
+}
 
-        // Wait for either external trigger or timeout for periodic publish
-        xSemaphoreTake(publish_trigger, publish_interval);
+bool publish_drain(const char *event, uint32_t timeout_ms) {
+    if (sample_queue == NULL || drained == NULL) {
+        return false;
+    }
 
+    publish_sample_t sample;
+    take_sample(&sample, true);
+    sample.event = event;
+    sample.drain = true;
 
-        sensor_data_t data;
-        GNSSLocation gnss_data;
+    // Behind everything queued so far, so that goes out first
+    xSemaphoreTake(drained, 0);
+    if (xQueueSend(sample_queue, &sample, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
+        ESP_LOGW(TAG, "⚠️ Publish queue full, nothing drained");
+        return false;
+    }
+    if (xSemaphoreTake(drained, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
+        ESP_LOGW(TAG, "⚠️ Publish queue not drained in %lu ms", (unsigned long)timeout_ms);
+        return false;
+    }
+    return drain_ok;
+}
 
-        //Get sensor and GNSS data
-        xSemaphoreTake(data_mutex, portMAX_DELAY);  // Lock the mutex before reading shared data
-        data = shared_sensor_data;  // Copy the shared sensor data to local variable
-        xSemaphoreGive(data_mutex);   // Release the mutex after reading
 
-        xSemaphoreTake(gnss_mutex, portMAX_DELAY);  // Lock the mutex before reading GNSS data
-        gnss_data = shared_gnss_data;  // Copy the GNSS data to local variable
-        xSemaphoreGive(gnss_mutex);   // Release the mutex after reading
+// Where the add_*_values() go: a cJSON object or an open CBOR map
+typedef struct {
+    cJSON *json;
+    cbor_writer_t *cbor;
+} values_t;
 
+static void put_number(values_t *v, int key, const char *name, double value, int scale) {
+    if (v->json) {
+        cJSON_AddNumberToObject(v->json, name, value);
+    } else {
+        cbor_put_uint(v->cbor, key);
+        cbor_put_int(v->cbor, llround(value * scale));
+    }
+}
 
-        // Get shared attribute data
-        float auxRange = 0, auxMax = 0, extRange = 0, extMax = 0;
-        int fillTime = 0, purgeTime = 0, sleepTimeout = 0, minDEFLevel = 0;
+static void put_string(values_t *v, int key, const char *name, const char *value) {
+    if (v->json) {
+        cJSON_AddStringToObject(v->json, name, value);
+    } else {
+        cbor_put_uint(v->cbor, key);
+        cbor_put_text(v->cbor, value);
+    }
+}
 
-        nvs_handle_t h;
-        if (nvs_open(NS_ATTR, NVS_READONLY, &h) == ESP_OK) {
-            size_t fsize = sizeof(float);
+static void put_bool(values_t *v, int key, const char *name, bool value) {
+    if (v->json) {
+        cJSON_AddBoolToObject(v->json, name, value);
+    } else {
+        cbor_put_uint(v->cbor, key);
+        cbor_put_bool(v->cbor, value);
+    }
+}
 
-            // Float values (stored as blobs)
-            if (nvs_get_blob(h, KEY_AUX_RANGE, &auxRange, &fsize) != ESP_OK)
-                ESP_LOGW(TAG, "Failed to get AUX_RANGE");
+// Key ids and scales come from telemetry_schema.h
+#define PUT_NUMBER(v, key, name, value) put_number(v, TLM_KEY_##key, name, value, TLM_SCALE_##key)
+#define PUT_STRING(v, key, name, value) put_string(v, TLM_KEY_##key, name, value)
+#define PUT_BOOL(v, key, name, value)   put_bool(v, TLM_KEY_##key, name, value)
+
+
+// Sensor keys of `data`; with `prev` only those that differ from it
+static void add_sensor_values(values_t *v, const sensor_data_t *data, const sensor_data_t *prev) {
+#define CHANGED(field) (prev == NULL || prev->field != data->field)
+#define CHANGED_STR(field) (prev == NULL || strcmp(prev->field, data->field) != 0)
+
+    if (CHANGED(int_tank))   PUT_NUMBER(v, INTERNAL_TANK, "Internal_Tank", data->int_tank);
+    if (CHANGED(ext_tank))   PUT_NUMBER(v, EXTERNAL_TANK, "External_Tank", data->ext_tank);
+    if (CHANGED(aux_tank))   PUT_NUMBER(v, AUX_TANK, "Aux_Tank", data->aux_tank);
+    if (CHANGED(int_tank_state)) PUT_STRING(v, INT_TANK_STATE, "IntTankState", sensor_state_str(data->int_tank_state));
+    if (CHANGED(ext_tank_state)) PUT_STRING(v, EXT_TANK_STATE, "ExtTankState", sensor_state_str(data->ext_tank_state));
+    if (CHANGED(aux_tank_state)) PUT_STRING(v, AUX_TANK_STATE, "AuxTankState", sensor_state_str(data->aux_tank_state));
+
+    // The master's channels, from protocol.h
+    for (int i = 0; i < PROTOCOL_CHANNEL_COUNT; i++) {
+        const protocol_channel_t *ch = &protocol_channels[i];
+        float value = *(const float *)((const uint8_t *)data + ch->field);
+        if (prev == NULL || *(const float *)((const uint8_t *)prev + ch->field) != value) {
+            put_number(v, ch->tlm_key, ch->name, value, ch->tlm_scale);
+        }
+        if (ch->state >= 0) {
+            sensor_state_t state = ((const uint8_t *)data)[ch->state];
+            if (prev == NULL || ((const uint8_t *)prev)[ch->state] != state) {
+                put_string(v, ch->tlm_state_key, ch->tlm_state_name, sensor_state_str(state));
+            }
+        }
+    }
 
-            fsize = sizeof(float);
-            if (nvs_get_blob(h, KEY_AUX_MAX, &auxMax, &fsize) != ESP_OK)
-                ESP_LOGW(TAG, "Failed to get AUX_MAX");
+    if (CHANGED_STR(status)) PUT_STRING(v, STATUS, "Status", data->status);
+    if (CHANGED_STR(mode))   PUT_STRING(v, MODE, "Mode", data->mode);
+    if (CHANGED(csq))        PUT_NUMBER(v, CSQ, "CSQ", data->csq);
+    if (CHANGED(can_status)) PUT_BOOL(v, CAN_STATUS, "CAN_Status", data->can_status);
 
-            fsize = sizeof(float);
-            if (nvs_get_blob(h, KEY_EXT_RANGE, &extRange, &fsize) != ESP_OK)
-                ESP_LOGW(TAG, "Failed to get EXT_RANGE");
+    //Outputs
+    if (CHANGED(out1))       PUT_BOOL(v, OUT1, "OUT1", data->out1);
+    if (CHANGED(out2))       PUT_BOOL(v, OUT2, "OUT2", data->out2);
+    if (CHANGED(npn1))       PUT_BOOL(v, NPN1, "NPN1", data->npn1);
+    if (CHANGED(npn2))       PUT_BOOL(v, NPN2, "NPN2", data->npn2);
 
-            fsize = sizeof(float);
-            if (nvs_get_blob(h, KEY_EXT_MAX, &extMax, &fsize) != ESP_OK)
-                ESP_LOGW(TAG, "Failed to get EXT_MAX");
+#undef CHANGED
+#undef CHANGED_STR
+}
 
-            // Integer values
-            if (nvs_get_i32(h, KEY_FILL_TIME, &fillTime) != ESP_OK)
-                ESP_LOGW(TAG, "Failed to get FILL_TIME");
+static void add_gnss_values(values_t *v) {
+    GNSSLocation gnss_data;
 
-            if (nvs_get_i32(h, KEY_PURGE_TIME, &purgeTime) != ESP_OK)
-                ESP_LOGW(TAG, "Failed to get PURGE_TIME");
+    xSemaphoreTake(gnss_mutex, portMAX_DELAY);  // Lock the mutex before reading GNSS data
+    gnss_data = shared_gnss_data;  // Copy the GNSS data to local variable
+    xSemaphoreGive(gnss_mutex);   // Release the mutex after reading
 
-            if (nvs_get_i32(h, KEY_SLEEP_TIMEOUT, &sleepTimeout) != ESP_OK)
-                ESP_LOGW(TAG, "Failed to get SLEEP_TIMEOUT");
+    PUT_NUMBER(v, LAT, "Lat", gnss_data.latitude);
+    PUT_NUMBER(v, LON, "Lon", gnss_data.longitude);
+    PUT_NUMBER(v, ALT, "Alt", gnss_data.altitude);
+    PUT_STRING(v, TIMESTAMP, "Timestamp", gnss_data.timestamp);
+}
 
-            if (nvs_get_i32(h, KEY_MIN_DEF_LEVEL, &minDEFLevel) != ESP_OK)
-                ESP_LOGW(TAG, "Failed to get MIN_DEF_LEVEL");
+static void add_settings_values(values_t *v) {
+    // Shared attribute data, 0 until the server set them
+    shared_settings_t s;
+    mqtt_settings_get(&s);
+    if (s.present != BIT(SETTING_COUNT) - 1) {
+        ESP_LOGW(TAG, "Settings 0x%04x of 0x%04x set", s.present, (unsigned)(BIT(SETTING_COUNT) - 1));
+    }
 
-            nvs_close(h);
-        } else {
-            ESP_LOGE(TAG, "Failed to open NVS namespace: %s", NS_ATTR);
-        }
+    float auxRange = s.aux_range, auxMax = s.aux_max, extRange = s.ext_range, extMax = s.ext_max;
+    int fillTime = s.fill_time, purgeTime = s.purge_time, sleepTimeout = s.sleep_timeout, minDEFLevel = s.min_def_level;
+
+    // Shared attributes
+    PUT_NUMBER(v, AUX_TANK_RANGE, "AuxTankRange", auxRange);
+    PUT_NUMBER(v, AUX_TANK_MAX, "AuxTankMax", auxMax);
+    PUT_NUMBER(v, EXT_TANK_RANGE, "ExtTankRange", extRange);
+    PUT_NUMBER(v, EXT_TANK_MAX, "ExtTankMax", extMax);
+
+    //Settings
+    PUT_NUMBER(v, FILL_TIME, "FillTime", fillTime);
+    PUT_NUMBER(v, PURGE_TIME, "PurgeTime", purgeTime);
+    PUT_NUMBER(v, SLEEP_TIMEOUT, "SleepTimeout", sleepTimeout);
+    PUT_NUMBER(v, MIN_DEF_LEVEL, "MinDEFLevel", minDEFLevel);
+
+    // Signal conditioning, 0 where filter.h defaults apply
+    PUT_NUMBER(v, TANK_MEDIAN, "TankMedian", s.tank_median);
+    PUT_NUMBER(v, TANK_EMA, "TankEma", s.tank_ema);
+    PUT_NUMBER(v, TANK_STEP, "TankStep", s.tank_step);
+    PUT_NUMBER(v, TEMP_MEDIAN, "TempMedian", s.temp_median);
+    PUT_NUMBER(v, TEMP_EMA, "TempEma", s.temp_ema);
+    PUT_NUMBER(v, TEMP_STEP, "TempStep", s.temp_step);
+}
 
+static void add_power_values(values_t *v, const power_sample_t *p) {
+    // Wake locks overlap, so these don't add up with PwrSleep to 100
+    PUT_NUMBER(v, PWR_SLEEP, "PwrSleep", p->sleep_permille / 10.0);
+    PUT_NUMBER(v, PWR_DISPLAY, "PwrDisplay", p->held_permille[POWER_LOCK_DISPLAY] / 10.0);
+    PUT_NUMBER(v, PWR_MASTER, "PwrMaster", p->held_permille[POWER_LOCK_MASTER] / 10.0);
+    PUT_NUMBER(v, PWR_MODEM, "PwrModem", p->held_permille[POWER_LOCK_MODEM] / 10.0);
+    PUT_NUMBER(v, PWR_CURRENT_EST, "PwrCurrentEst", p->avg_ma);
+}
 
+static void add_values(values_t *v, const publish_sample_t *sample, const sensor_data_t *prev) {
+    if (sample->event) {
+        PUT_STRING(v, EVENT, "Event", sample->event);
+    }
+    add_sensor_values(v, &sample->data, prev);
+    if (prev == NULL) {
+        add_gnss_values(v);
+        add_settings_values(v);
+        add_power_values(v, &sample->power);
+    }
+}
 
+#if PUBLISH_ENCODING == PUBLISH_ENCODING_JSON || PUBLISH_CBOR_COMPARE
 
-         // Create a cJSON object
-        cJSON *root = cJSON_CreateObject();
-        if (root == NULL) {
+// Print one JSON batch entry into `buf`. Without `prev` it's the full state.
+// Returns its length, 0 if nothing changed since `prev`, -1 on error
+static int render_json_entry(char *buf, size_t size, const publish_sample_t *sample, const sensor_data_t *prev) {
+    cJSON *values = cJSON_CreateObject();
+    if (values == NULL) {
         ESP_LOGE(TAG, "Failed to create cJSON object");
-        return;
+        return -1;
+    }
+
+    values_t v = { .json = values };
+    add_values(&v, sample, prev);
+
+    if (values->child == NULL) {
+        cJSON_Delete(values);
+        return 0;
+    }
+
+    // Without a clock ThingsBoard stamps the values itself when they arrive
+    cJSON *entry = values;
+    if (sample->ts != 0) {
+        entry = cJSON_CreateObject();
+        if (entry == NULL) {
+            ESP_LOGE(TAG, "Failed to create cJSON object");
+            cJSON_Delete(values);
+            return -1;
         }
+        cJSON_AddNumberToObject(entry, "ts", (double)sample->ts);
+        cJSON_AddItemToObject(entry, "values", values);
+    }
+
+    bool printed = cJSON_PrintPreallocated(entry, buf, size, false);
+    cJSON_Delete(entry);
 
-        // Add data to the JSON object
-        
-        cJSON_AddNumberToObject(root, "Internal_Tank", data.int_tank);
-        cJSON_AddNumberToObject(root, "External_Tank", data.ext_tank); 
-        cJSON_AddNumberToObject(root, "Aux_Tank", data.aux_tank);
-        cJSON_AddNumberToObject(root, "PT1000", data.pt1000);
-        cJSON_AddNumberToObject(root, "Battery_volts", data.batt_volt);
-        cJSON_AddNumberToObject(root, "Temperature", data.temp);
-        cJSON_AddNumberToObject(root, "Pressure", data.pres);
-        cJSON_AddNumberToObject(root, "Humidity", data.rh);
-        cJSON_AddStringToObject(root, "Status", data.status);
-        cJSON_AddStringToObject(root, "Mode", data.mode);
-        cJSON_AddNumberToObject(root, "CSQ", data.csq);
-        cJSON_AddBoolToObject(root, "CAN_Status", data.can_status);
-
-        //Outputs
-        cJSON_AddBoolToObject(root, "OUT1", data.out1);
-        cJSON_AddBoolToObject(root, "OUT2", data.out2);
-        cJSON_AddBoolToObject(root, "NPN1", data.npn1);
-        cJSON_AddBoolToObject(root, "NPN2", data.npn2);
-
-        //GNSS
-        cJSON_AddNumberToObject(root, "Lat", gnss_data.latitude);
-        cJSON_AddNumberToObject(root, "Lon", gnss_data.longitude);
-        cJSON_AddNumberToObject(root, "Alt", gnss_data.altitude);
-        cJSON_AddStringToObject(root, "Timestamp", gnss_data.timestamp);
-
-        // Shared attributes
-        cJSON_AddNumberToObject(root, "AuxTankRange", auxRange);
-        cJSON_AddNumberToObject(root, "AuxTankMax", auxMax);
-        cJSON_AddNumberToObject(root, "ExtTankRange", extRange);
-        cJSON_AddNumberToObject(root, "ExtTankMax", extMax);
-        
-        //Settings
-        cJSON_AddNumberToObject(root, "FillTime", fillTime);
-        cJSON_AddNumberToObject(root, "PurgeTime", purgeTime);
-        cJSON_AddNumberToObject(root, "SleepTimeout", sleepTimeout);
-        cJSON_AddNumberToObject(root, "MinDEFLevel", minDEFLevel);
-
-
-
-        
-         // Convert the cJSON object to a string
-        char *json_string = cJSON_PrintUnformatted(root);
-
-        //ESP_LOGE(TAG, "%s", json_string);
-
-        if (json_string == NULL) {
+    if (!printed) {
         ESP_LOGE(TAG, "Failed to print JSON string");
-        cJSON_Delete(root);
-        continue;
-        
-        }
+        return -1;
+    }
+    return strlen(buf);
+}
 
-        //verify the mqtt is up and running
-        xEventGroupWaitBits(systemEvents, MQTT_INIT, pdFALSE, pdFALSE, portMAX_DELAY);
-        
-        static int publish_fail_count = 0;  // Persistent between function calls
+#endif
 
-        if (!sim7600_mqtt_publish(MQTT_TOPIC_PUB, json_string)) {
-            publish_fail_count++;
-            ESP_LOGE(TAG, "Publish failed! Count: %d", publish_fail_count);
+#if PUBLISH_ENCODING == PUBLISH_ENCODING_CBOR
 
-            if (publish_fail_count >= 5) {
-                ESP_LOGE(TAG, "❌ Publish failed 5 times in a row — restarting ESP");
-                esp_restart();
-            }
-        } else {
-            publish_fail_count = 0;  // Reset counter on success
-            ESP_LOGW(TAG, "Published data!");
-        }
-        cJSON_Delete(root);
-        free(json_string);
+// As render_json_entry() but one map keyed by telemetry_schema.h
+static int render_cbor_entry(uint8_t *buf, size_t size, const publish_sample_t *sample, const sensor_data_t *prev) {
+    cbor_writer_t w;
+    cbor_init(&w, buf, size);
+
+    cbor_open_map(&w);
+    if (sample->ts != 0) {
+        cbor_put_uint(&w, TLM_KEY_TS);
+        cbor_put_uint(&w, (uint64_t)sample->ts);
+    }
+    size_t header = w.len;
+
+    values_t v = { .cbor = &w };
+    add_values(&v, sample, prev);
+
+    if (w.len == header && !w.overflow) {
+        return 0;
+    }
+    cbor_close(&w);
+
+    if (w.overflow) {
+        ESP_LOGE(TAG, "CBOR entry larger than %u B", (unsigned)size);
+        return -1;
+    }
+    return w.len;
+}
+
+#endif
+
+static int render_entry(const publish_sample_t *sample, const sensor_data_t *prev) {
+#if PUBLISH_ENCODING == PUBLISH_ENCODING_CBOR
+    return render_cbor_entry((uint8_t *)entry_buf, sizeof(entry_buf), sample, prev);
+#else
+    return render_json_entry(entry_buf, sizeof(entry_buf), sample, prev);
+#endif
+}
+
+#if PUBLISH_ENCODING == PUBLISH_ENCODING_CBOR
+#define BATCH_TOPIC     MQTT_TOPIC_PUB_CBOR
+#define BATCH_OPEN      0x9f    // indefinite length array
+#define BATCH_CLOSE     0xff    // break
+#else
+#define BATCH_TOPIC     MQTT_TOPIC_PUB
+#define BATCH_OPEN      '['
+#define BATCH_CLOSE     ']'
+#endif
+
+// True if the batch went out, or there was nothing to send. Without MQTT the
+// batch stays queued for the next flush
+static bool batch_flush(const char *reason) {
+    if (batch_count == 0) {
+        return true;
+    }
+
+    //verify the mqtt is up and running
+    EventBits_t bits = xEventGroupWaitBits(systemEvents, MQTT_INIT, pdFALSE, pdFALSE,
+                                           pdMS_TO_TICKS(PUBLISH_MQTT_WAIT_MS));
+    if (!(bits & MQTT_INIT)) {
+        ESP_LOGW(TAG, "No MQTT after %d ms, %d samples kept for the next %s flush",
+                 PUBLISH_MQTT_WAIT_MS, batch_count, reason);
+        return false;
+    }
+
+    batch_buf[batch_len++] = BATCH_CLOSE;
+    batch_buf[batch_len] = '\0';
+
+    //ESP_LOGE(TAG, "%s", batch_buf);
+
+    // The transport reports failures to the link supervisor, which recovers the modem
+    bool ok = sim7600_mqtt_publish_bytes(BATCH_TOPIC, batch_buf, batch_len);
+    if (!ok) {
+        ESP_LOGE(TAG, "Publish failed, %d samples dropped", batch_count);
+    } else {
+#if PUBLISH_ENCODING == PUBLISH_ENCODING_CBOR && PUBLISH_CBOR_COMPARE
+        TRACE_STR(ESP_LOG_INFO, TEV_PUB_BATCH_CBOR, reason, batch_count, batch_len, batch_json_len + 1);
+#else
+        TRACE_STR(ESP_LOG_INFO, TEV_PUB_BATCH, reason, batch_count, batch_len);
+#endif
+    }
+
+    batch_len = 0;
+    batch_count = 0;
+#if PUBLISH_ENCODING == PUBLISH_ENCODING_CBOR && PUBLISH_CBOR_COMPARE
+    batch_json_len = 0;
+#endif
+    last_flush = xTaskGetTickCount();
+    return ok;
+}
 
-        
+static void batch_add(const publish_sample_t *sample) {
+    const sensor_data_t *prev = batch_count ? &batch_last : NULL;
+    int len = render_entry(sample, prev);
+
+    // Separator, entry, closing bracket and terminator
+    if (len > 0 && batch_count && batch_len + len + 3 > sizeof(batch_buf)) {
+        if (!batch_flush("size") && batch_count) {
+            ESP_LOGW(TAG, "Batch full and not sent, sample dropped");
+            return;
+        }
+        prev = NULL;
+        len = render_entry(sample, prev);
+    }
+    if (len <= 0) {
+        return;
     }
 
+    if (batch_count == 0) {
+        batch_buf[batch_len++] = BATCH_OPEN;
+    }
+#if PUBLISH_ENCODING == PUBLISH_ENCODING_JSON
+    else {
+        batch_buf[batch_len++] = ',';
+    }
+#endif
+    memcpy(batch_buf + batch_len, entry_buf, len);
+    batch_len += len;
+
+#if PUBLISH_ENCODING == PUBLISH_ENCODING_CBOR && PUBLISH_CBOR_COMPARE
+    // What the JSON encoding would have sent, for the flush log
+    int json_len = render_json_entry(json_buf, sizeof(json_buf), sample, prev);
+    batch_json_len += json_len > 0 ? json_len + 1 : 0;
+#endif
+
+    if (batch_count++ == 0) {
+        batch_started = xTaskGetTickCount();
+    }
+    batch_last = sample->data;
+}
 
+// Ticks until `limit` has passed since `since`, 0 if it already has
+static TickType_t ticks_left(TickType_t since, TickType_t limit) {
+    TickType_t elapsed = xTaskGetTickCount() - since;
+    return elapsed >= limit ? 0 : limit - elapsed;
 }
 
 
+//Task thread
+void publish_task(void *pvParameter){
+
+    sample_queue = xQueueCreate(PUBLISH_QUEUE_LEN, sizeof(publish_sample_t));
+    diag_queue_register("sample", sample_queue);
+    drained = xSemaphoreCreateBinary();
 
+    xEventGroupWaitBits(systemEvents, MQTT_INIT, pdFALSE, pdFALSE, portMAX_DELAY);
+    ESP_LOGW(TAG, "publish task active");
 
+    const TickType_t publish_interval = 60000 * MQTT_PUBLISH_FREQ / portTICK_PERIOD_MS; //timeout for publishing data
+    const TickType_t batch_age = pdMS_TO_TICKS(PUBLISH_BATCH_AGE_MS);
+
+    last_flush = xTaskGetTickCount();
+
+    while(1){
+
+        // An open batch waits for its age limit, otherwise for the periodic publish
+        TickType_t wait = batch_count ? ticks_left(batch_started, batch_age)
+                                      : ticks_left(last_flush, publish_interval);
+
+        publish_sample_t sample;
+        if (xQueueReceive(sample_queue, &sample, wait) == pdTRUE) {
+            batch_add(&sample);
+            if (sample.drain) {
+                drain_ok = batch_flush("drain");
+                xSemaphoreGive(drained);
+            } else if (sample.alarm) {
+                batch_flush("alarm");
+            }
+            continue;
+        }
+
+        if (batch_count) {
+            batch_flush("age");
+        } else {
+            take_sample(&sample, false);
+            batch_add(&sample);
+            batch_flush("periodic");
+        }
+    }
+}
@@ -22,8 +22,40 @@
 #include "sdkconfig.h"
 
 
+// ===== Batching =====
+// Samples are stamped when publish_data() is called and sent together as one
+// ThingsBoard [{"ts":..,"values":{..}},..] array
+
+#define PUBLISH_QUEUE_LEN          16      // Samples waiting for the publish task
+#define PUBLISH_BATCH_MAX_BYTES    2048    // Flush before the payload grows past this
+#define PUBLISH_ENTRY_MAX_BYTES    1024    // One rendered {"ts":..,"values":{..}}
+#define PUBLISH_BATCH_AGE_MS       20000   // Flush this long after the first sample
+#define PUBLISH_MQTT_WAIT_MS       10000   // A flush waits this long for MQTT, then keeps the batch
+#define PUBLISH_CLOCK_VALID_S      1700000000  // Before this the wall clock wasn't set from GNSS
+
+// Payload encoding
+// PUBLISH_ENCODING_JSON - named keys on MQTT_TOPIC_PUB, what the device API takes
+// PUBLISH_ENCODING_CBOR - telemetry_schema.h integer keys on MQTT_TOPIC_PUB_CBOR,
+//                         named again by tools/thingsboard_cbor_converter.js
+#define PUBLISH_ENCODING_JSON      0
+#define PUBLISH_ENCODING_CBOR      1
+
+#define PUBLISH_ENCODING           PUBLISH_ENCODING_JSON
+
+#define PUBLISH_CBOR_COMPARE       1       // Also render each batch as JSON to log the size it saved
+
+
+// Queue a snapshot of shared_sensor_data for the next batch
 void publish_data(void);
 
+// As publish_data() but flushes the batch straight away (pump/fill/comm errors)
+void publish_alarm(void);
+
+// Queue a last sample with an "Event" string (a literal, e.g. "sleep"), flush
+// it with everything queued before it, and wait. False if that didn't go out
+// within `timeout_ms`, or the publish task isn't running
+bool publish_drain(const char *event, uint32_t timeout_ms);
+
 // Function prototype for the publish task
 void publish_task(void *pvParameter);
 
@@ -0,0 +1,83 @@
+#include "screens.h"
+#include "ui.h"
+#include "ui_mem.h"
+#include "history.h"
+#include "esp_log.h"
+
+static const char *TAG = "SCREENS";
+
+typedef struct {
+    const char *name;
+    lv_obj_t **obj;                     // Where build leaves the screen, NULL while it isn't built
+    void (*build)(void);
+    void (*destroy)(void);              // Deletes it, clearing `obj` and its widgets
+    bool stays;                         // Built by screens_init and never deleted
+} screen_t;
+
+static const screen_t screens[SCREEN_COUNT] = {
+    [SCREEN_SPLASH]  = { "splash",    &ui_SplashScreen, ui_SplashScreen_screen_init, ui_SplashScreen_screen_destroy },
+    [SCREEN_DATA]    = { "dashboard", &ui_DataScreen,   ui_DataScreen_screen_init,   ui_DataScreen_screen_destroy, true },
+    [SCREEN_HISTORY] = { "history",   &history_screen,  history_screen_build,        history_screen_destroy },
+};
+
+
+// With the LVGL lock, from lv_timer_handler(): LVGL is done with the screen
+// it unloaded only after the unload event
+static void screen_drop(void *arg) {
+    const screen_t *s = &screens[(uintptr_t)arg];
+    lv_obj_t *obj = *s->obj;
+    lv_disp_t *disp = lv_disp_get_default();
+
+    // Shown again in the meantime
+    if (obj == NULL || obj == lv_disp_get_scr_act(disp) || obj == disp->scr_to_load) {
+        return;
+    }
+    s->destroy();
+
+    lv_mem_monitor_t mem;
+    lv_mem_monitor(&mem);
+    ESP_LOGI(TAG, "🗑️ %s screen deleted, lv_mem %lu B free", s->name, (unsigned long)mem.free_size);
+}
+
+static void screen_unloaded(lv_event_t *e) {
+    lv_async_call(screen_drop, lv_event_get_user_data(e));
+}
+
+static void screen_build(screen_id_t id) {
+    const screen_t *s = &screens[id];
+
+    // With the dashboard on lv_mem: it all goes at once with the screen,
+    // the pools stay for the churn
+    ui_mem_pools_pause(true);
+    s->build();
+    ui_mem_pools_pause(false);
+
+    if (!s->stays) {
+        lv_obj_add_event_cb(*s->obj, screen_unloaded, LV_EVENT_SCREEN_UNLOADED, (void *)(uintptr_t)id);
+    }
+}
+
+void screens_init(void) {
+    lv_disp_t *disp = lv_disp_get_default();
+    lv_theme_t *theme = lv_theme_default_init(disp, lv_palette_main(LV_PALETTE_BLUE), lv_palette_main(LV_PALETTE_RED),
+                                              false, LV_FONT_DEFAULT);
+    lv_disp_set_theme(disp, theme);
+
+    for (int id = 0; id < SCREEN_COUNT; id++) {
+        if (screens[id].stays) {
+            screen_build(id);
+        }
+    }
+}
+
+void screens_show(screen_id_t id, lv_scr_load_anim_t anim, uint32_t time_ms) {
+    // Out of LVGL memory: the dashboard until ui_mem has its reserve back
+    if (*screens[id].obj == NULL && ui_mem_reserve_spent()) {
+        ESP_LOGW(TAG, "⚠️ LVGL memory low, %s screen not built", screens[id].name);
+        id = SCREEN_DATA;
+    }
+    if (*screens[id].obj == NULL) {
+        screen_build(id);
+    }
+    lv_scr_load_anim(*screens[id].obj, anim, time_ms, 0, false);
+}
@@ -0,0 +1,43 @@
+#ifndef SCREENS_H
+#define SCREENS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// Screens are built when they are shown and deleted once a change of screen
+// has taken them off the display, so the 32 KB LVGL heap holds the dashboard
+// and whatever is on it, not every screen there is. The dashboard is never
+// deleted: data.c draws on it from data_task whichever screen is shown.
+//
+// A new screen is a line in screens.c: a build function that leaves it in
+// its lv_obj_t and a destroy function that deletes it and clears that and
+// its widget pointers, as SquareLine's generated screens have.
+
+typedef enum {
+    SCREEN_SPLASH = 0,
+    SCREEN_DATA,
+    SCREEN_HISTORY,
+    SCREEN_COUNT,
+} screen_id_t;
+
+// The theme and the dashboard, before ui_mem_init(): the dashboard's objects
+// live as long as the device and go on lv_mem. With the LVGL lock
+void screens_init(void);
+
+// Builds `id` if it isn't and moves to it with `anim` over `time_ms`,
+// LV_SCR_LOAD_ANIM_NONE and 0 for at once. The screen it replaces goes
+// when the change is over. With the LVGL lock
+void screens_show(screen_id_t id, lv_scr_load_anim_t anim, uint32_t time_ms);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SCREENS_H
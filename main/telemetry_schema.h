@@ -0,0 +1,106 @@
+#ifndef TELEMETRY_SCHEMA_H
+#define TELEMETRY_SCHEMA_H
+
+// CBOR telemetry (PUBLISH_ENCODING_CBOR). The payload is an array of maps,
+// one per sample, keyed by the integers below instead of the JSON names.
+// Numbers go out as integers: the value times its TLM_SCALE_ rounded.
+//
+// tools/telemetry_decode.py reads the names and scales from this file,
+// so keep one key per line as `#define TLM_KEY_X  id  // "Name"`.
+// Ids are never reused: retire a key by deleting its line.
+
+#define TLM_KEY_TS              0   // "ts"             ms since the epoch, missing until GNSS set the clock
+
+// Sensors
+#define TLM_KEY_INTERNAL_TANK   1   // "Internal_Tank"
+#define TLM_KEY_EXTERNAL_TANK   2   // "External_Tank"
+#define TLM_KEY_AUX_TANK        3   // "Aux_Tank"
+#define TLM_KEY_PT1000          4   // "PT1000"
+#define TLM_KEY_BATTERY_VOLTS   5   // "Battery_volts"
+#define TLM_KEY_TEMPERATURE     6   // "Temperature"
+#define TLM_KEY_PRESSURE        7   // "Pressure"
+#define TLM_KEY_HUMIDITY        8   // "Humidity"
+#define TLM_KEY_STATUS          9   // "Status"         text
+#define TLM_KEY_MODE            10  // "Mode"           text
+#define TLM_KEY_CSQ             11  // "CSQ"
+#define TLM_KEY_CAN_STATUS      12  // "CAN_Status"     bool
+#define TLM_KEY_INT_TANK_STATE  35  // "IntTankState"   text, sensor_state_str() (filter.h)
+#define TLM_KEY_EXT_TANK_STATE  36  // "ExtTankState"   text
+#define TLM_KEY_AUX_TANK_STATE  37  // "AuxTankState"   text
+#define TLM_KEY_PT1000_STATE    38  // "PT1000State"    text
+
+// Outputs
+#define TLM_KEY_OUT1            13  // "OUT1"           bool
+#define TLM_KEY_OUT2            14  // "OUT2"           bool
+#define TLM_KEY_NPN1            15  // "NPN1"           bool
+#define TLM_KEY_NPN2            16  // "NPN2"           bool
+
+// GNSS
+#define TLM_KEY_LAT             17  // "Lat"
+#define TLM_KEY_LON             18  // "Lon"
+#define TLM_KEY_ALT             19  // "Alt"
+#define TLM_KEY_TIMESTAMP       20  // "Timestamp"      text
+
+// Shared attributes
+#define TLM_KEY_AUX_TANK_RANGE  21  // "AuxTankRange"
+#define TLM_KEY_AUX_TANK_MAX    22  // "AuxTankMax"
+#define TLM_KEY_EXT_TANK_RANGE  23  // "ExtTankRange"
+#define TLM_KEY_EXT_TANK_MAX    24  // "ExtTankMax"
+#define TLM_KEY_TANK_MEDIAN     39  // "TankMedian"
+#define TLM_KEY_TANK_EMA        40  // "TankEma"
+#define TLM_KEY_TANK_STEP       41  // "TankStep"
+#define TLM_KEY_TEMP_MEDIAN     42  // "TempMedian"
+#define TLM_KEY_TEMP_EMA        43  // "TempEma"
+#define TLM_KEY_TEMP_STEP       44  // "TempStep"
+
+// Settings
+#define TLM_KEY_FILL_TIME       25  // "FillTime"
+#define TLM_KEY_PURGE_TIME      26  // "PurgeTime"
+#define TLM_KEY_SLEEP_TIMEOUT   27  // "SleepTimeout"
+#define TLM_KEY_MIN_DEF_LEVEL   28  // "MinDEFLevel"
+
+// Power, over the time since the previous sample (power.h)
+#define TLM_KEY_PWR_SLEEP       29  // "PwrSleep"       % in light sleep
+#define TLM_KEY_PWR_DISPLAY     30  // "PwrDisplay"     % awake for display flushes
+#define TLM_KEY_PWR_MASTER      31  // "PwrMaster"      % awake for master frames
+#define TLM_KEY_PWR_MODEM       32  // "PwrModem"       % awake for the modem
+#define TLM_KEY_PWR_CURRENT_EST 33  // "PwrCurrentEst"  mA, estimated from the datasheet figures
+
+// Events
+#define TLM_KEY_EVENT           34  // "Event"          text, e.g. "sleep" in the last sample before deep sleep
+
+
+// Fixed point scale of every number, matching what the master sends
+#define TLM_SCALE_INTERNAL_TANK     10          // 0.1 %
+#define TLM_SCALE_EXTERNAL_TANK     10
+#define TLM_SCALE_AUX_TANK          10
+#define TLM_SCALE_PT1000            10          // 0.1 degC
+#define TLM_SCALE_BATTERY_VOLTS     1000        // mV
+#define TLM_SCALE_TEMPERATURE       100         // 0.01 degC
+#define TLM_SCALE_PRESSURE          100
+#define TLM_SCALE_HUMIDITY          100         // 0.01 %RH
+#define TLM_SCALE_CSQ               1
+#define TLM_SCALE_LAT               1000000     // microdegrees
+#define TLM_SCALE_LON               1000000
+#define TLM_SCALE_ALT               10          // 0.1 m
+#define TLM_SCALE_AUX_TANK_RANGE    100
+#define TLM_SCALE_AUX_TANK_MAX      100
+#define TLM_SCALE_EXT_TANK_RANGE    100
+#define TLM_SCALE_EXT_TANK_MAX      100
+#define TLM_SCALE_TANK_MEDIAN       1
+#define TLM_SCALE_TANK_EMA          1
+#define TLM_SCALE_TANK_STEP         1
+#define TLM_SCALE_TEMP_MEDIAN       1
+#define TLM_SCALE_TEMP_EMA          1
+#define TLM_SCALE_TEMP_STEP         1
+#define TLM_SCALE_FILL_TIME         1
+#define TLM_SCALE_PURGE_TIME        1
+#define TLM_SCALE_SLEEP_TIMEOUT     1
+#define TLM_SCALE_MIN_DEF_LEVEL     1
+#define TLM_SCALE_PWR_SLEEP         10          // 0.1 %
+#define TLM_SCALE_PWR_DISPLAY       10
+#define TLM_SCALE_PWR_MASTER        10
+#define TLM_SCALE_PWR_MODEM         10
+#define TLM_SCALE_PWR_CURRENT_EST   100         // 0.01 mA
+
+#endif // TELEMETRY_SCHEMA_H
@@ -0,0 +1,325 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "trace.h"
+#include "main.h"
+#include "modem.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_cpu.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#if TRACE_CONSOLE
+#include "esp_console.h"
+#endif
+
+
+static const char *TAG = "TRACE";
+
+#define TRACE_RTC_MAGIC     0x54524331  // "TRC1": rtc_tail survived a reset
+#define TRACE_CORES         portNUM_PROCESSORS
+
+_Static_assert((TRACE_RING_LEN & (TRACE_RING_LEN - 1)) == 0, "TRACE_RING_LEN not a power of two");
+_Static_assert((TRACE_RTC_LEN & (TRACE_RTC_LEN - 1)) == 0, "TRACE_RTC_LEN not a power of two");
+_Static_assert(TRACE_RTC_LEN <= TRACE_RING_LEN, "TRACE_RTC_LEN longer than the ring");
+
+typedef struct {
+    uint32_t head;                      // Events ever reserved, by atomic add
+    trace_event_t events[TRACE_RING_LEN];
+} trace_ring_t;
+
+// Slot n of a core's tail holds the ring's event n too: no second counter,
+// and no atomics on RTC memory
+typedef struct {
+    uint32_t magic;
+    trace_event_t events[TRACE_CORES][TRACE_RTC_LEN];
+} trace_tail_t;
+
+uint8_t trace_levels[TRACE_MOD_COUNT];
+
+static trace_ring_t rings[TRACE_CORES];
+RTC_NOINIT_ATTR static trace_tail_t rtc_tail;
+
+static trace_event_t previous[TRACE_CORES][TRACE_RTC_LEN];     // rtc_tail as it was at boot
+static bool previous_valid = false;
+static bool previous_crash = false;     // Unpublished, and the reset wasn't asked for
+static esp_reset_reason_t reset_reason;
+
+
+// ===== Recording =====
+
+void trace_init(void) {
+    reset_reason = esp_reset_reason();
+
+    // Power-on leaves RTC memory random; the magic would match by chance alone
+    if (rtc_tail.magic == TRACE_RTC_MAGIC && reset_reason != ESP_RST_POWERON) {
+        memcpy(previous, rtc_tail.events, sizeof(previous));
+        previous_valid = true;
+        previous_crash = reset_reason == ESP_RST_PANIC || reset_reason == ESP_RST_INT_WDT ||
+                         reset_reason == ESP_RST_TASK_WDT || reset_reason == ESP_RST_WDT ||
+                         reset_reason == ESP_RST_BROWNOUT;
+    }
+    memset(&rtc_tail, 0, sizeof(rtc_tail));
+    rtc_tail.magic = TRACE_RTC_MAGIC;
+
+    memset(trace_levels, TRACE_LEVEL_DEFAULT, sizeof(trace_levels));
+    TRACE(ESP_LOG_INFO, TEV_BOOT, reset_reason);
+
+    if (previous_crash) {
+        ESP_LOGW(TAG, "⚠️ Reset by %d: the events before it are kept, `trace previous`", reset_reason);
+    }
+}
+
+// Body first, seq last: a reader that sees the seq sees the whole event
+static void slot_write(trace_event_t *slot, const trace_event_t *e, uint32_t seq) {
+    __atomic_store_n(&slot->seq, 0, __ATOMIC_RELAXED);
+    memcpy((uint8_t *)slot + sizeof(slot->seq), (const uint8_t *)e + sizeof(e->seq), sizeof(*e) - sizeof(e->seq));
+    __atomic_store_n(&slot->seq, seq, __ATOMIC_RELEASE);
+}
+
+void trace_write(uint16_t id, esp_log_level_t level, const uint32_t *args, size_t count, const char *str) {
+    int core = esp_cpu_get_core_id();
+    trace_event_t e = {
+        .time_ms = (uint32_t)(esp_timer_get_time() / 1000),
+        .id = id,
+        .info = (level & 0x0f) | (core << 4),
+    };
+
+    size_t max_words = sizeof(e.data) / sizeof(uint32_t);
+    e.words = count < max_words ? count : max_words;
+    memcpy(e.data, args, e.words * sizeof(uint32_t));
+    // Not terminated when it fills the rest
+    for (size_t i = e.words * sizeof(uint32_t); str && *str && i < sizeof(e.data); i++) {
+        e.data[i] = *str++;
+    }
+
+    // A task moved to the other core since reading `core` still gets a slot of its own
+    trace_ring_t *ring = &rings[core];
+    uint32_t n = __atomic_fetch_add(&ring->head, 1, __ATOMIC_RELAXED);
+    slot_write(&ring->events[n & (TRACE_RING_LEN - 1)], &e, n + 1);
+    slot_write(&rtc_tail.events[core][n & (TRACE_RTC_LEN - 1)], &e, n + 1);
+}
+
+void trace_set_level(int module, esp_log_level_t level) {
+    if (module >= TRACE_MOD_COUNT) {
+        memset(trace_levels, level, sizeof(trace_levels));
+    } else if (module >= 0) {
+        trace_levels[module] = level;
+    }
+}
+
+
+// ===== Dumps =====
+
+typedef void (*trace_visit_t)(const void *data, size_t len, void *ctx);
+
+// Copies out of a ring that is being written: the seq, checked before and after, says it held still
+static bool slot_read(const trace_event_t *slot, uint32_t n, trace_event_t *out) {
+    if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != n + 1) {
+        return false;
+    }
+    memcpy(out, slot, sizeof(*out));
+    return __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) == n + 1 && out->seq == n + 1;
+}
+
+// The slots of one core's ring, or of its tail from the previous boot, and events ever written
+static const trace_event_t *ring_view(bool prev, int core, uint32_t *len, uint32_t *head) {
+    if (!prev) {
+        *len = TRACE_RING_LEN;
+        *head = __atomic_load_n(&rings[core].head, __ATOMIC_ACQUIRE);
+        return rings[core].events;
+    }
+    *len = TRACE_RTC_LEN;
+    *head = 0;
+    for (int i = 0; i < TRACE_RTC_LEN; i++) {
+        if (previous[core][i].seq > *head) {
+            *head = previous[core][i].seq;
+        }
+    }
+    return previous[core];
+}
+
+// Up to `limit` readable events, oldest first per core
+static uint16_t visit(bool prev, trace_visit_t fn, void *ctx, uint16_t limit) {
+    uint16_t count = 0;
+    trace_event_t e;
+
+    for (int core = 0; core < TRACE_CORES; core++) {
+        uint32_t len, head;
+        const trace_event_t *slots = ring_view(prev, core, &len, &head);
+
+        for (uint32_t n = head > len ? head - len : 0; n < head && count < limit; n++) {
+            if (slot_read(&slots[n & (len - 1)], n, &e)) {
+                if (fn) {
+                    fn(&e, sizeof(e), ctx);
+                }
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+static void dump_header(trace_dump_header_t *h, bool prev, uint16_t count) {
+    memset(h, 0, sizeof(*h));
+    memcpy(h->magic, TRACE_DUMP_MAGIC, sizeof(h->magic));
+    h->version = TRACE_DUMP_VERSION;
+    h->previous = prev;
+    h->reset_reason = reset_reason;
+    h->event_size = sizeof(trace_event_t);
+    h->now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    h->count = count;
+}
+
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+    size_t size;
+} dump_ctx_t;
+
+static void dump_append(const void *data, size_t len, void *ctx) {
+    dump_ctx_t *d = ctx;
+    if (d->len + len <= d->size) {
+        memcpy(d->buf + d->len, data, len);
+    }
+    d->len += len;
+}
+
+size_t trace_dump(bool prev, uint8_t *buf, size_t size) {
+    if (prev && !previous_valid) {
+        return 0;
+    }
+
+    dump_ctx_t d = { .buf = buf, .len = sizeof(trace_dump_header_t), .size = size };
+    uint16_t count = visit(prev, dump_append, &d, UINT16_MAX);
+    if (d.len > size) {
+        return 0;
+    }
+    // The count of what was copied: the live rings move on between two visits
+    dump_header((trace_dump_header_t *)buf, prev, count);
+    return d.len;
+}
+
+void trace_publish_crash(void) {
+#if TRACE_PUBLISH_CRASH
+    static uint8_t payload[sizeof(trace_dump_header_t) + sizeof(previous)];
+
+    if (!previous_crash) {
+        return;
+    }
+    size_t len = trace_dump(true, payload, sizeof(payload));
+    if (len == 0 || sim7600_mqtt_publish_bytes(MQTT_TOPIC_TRACE, payload, len)) {
+        ESP_LOGI(TAG, "📤 Events before the reset published, %u B", (unsigned)len);
+        previous_crash = false;
+    }
+#endif
+}
+
+
+// ===== Console =====
+
+#if TRACE_CONSOLE
+static const char *module_names[TRACE_MOD_COUNT] = {
+    [TRACE_MOD_TRACE] = "trace",
+    [TRACE_MOD_AT]    = "at",
+    [TRACE_MOD_PPP]   = "ppp",
+    [TRACE_MOD_MQTT]  = "mqtt",
+    [TRACE_MOD_PUB]   = "pub",
+};
+
+static const char *level_names[] = {
+    [ESP_LOG_NONE]    = "none",
+    [ESP_LOG_ERROR]   = "error",
+    [ESP_LOG_WARN]    = "warn",
+    [ESP_LOG_INFO]    = "info",
+    [ESP_LOG_DEBUG]   = "debug",
+    [ESP_LOG_VERBOSE] = "verbose",
+};
+
+// Hex lines behind "TRACE:", which trace_decode.py --log picks out of a console capture
+static void print_hex(const void *data, size_t len, void *ctx) {
+    const uint8_t *p = data;
+    printf("TRACE:");
+    for (size_t i = 0; i < len; i++) {
+        printf("%02x", p[i]);
+    }
+    printf("\n");
+}
+
+static void print_dump(bool prev) {
+    trace_dump_header_t h;
+    dump_header(&h, prev, visit(prev, NULL, NULL, UINT16_MAX));
+    print_hex(&h, sizeof(h), NULL);
+
+    // Slots overwritten while printing: padded, so the decoder still reads the header's count
+    trace_event_t e = { 0 };
+    for (uint16_t printed = visit(prev, print_hex, NULL, h.count); printed < h.count; printed++) {
+        print_hex(&e, sizeof(e), NULL);
+    }
+}
+
+static int parse_level(const char *s) {
+    for (int i = 0; i < (int)(sizeof(level_names) / sizeof(level_names[0])); i++) {
+        if (strcasecmp(s, level_names[i]) == 0) {
+            return i;
+        }
+    }
+    char *end;
+    long v = strtol(s, &end, 10);
+    return *end == '\0' && v >= ESP_LOG_NONE && v <= ESP_LOG_VERBOSE ? (int)v : -1;
+}
+
+static int trace_cmd(int argc, char **argv) {
+    const char *what = argc > 1 ? argv[1] : "levels";
+
+    if (strcmp(what, "dump") == 0) {
+        print_dump(false);
+        return 0;
+    }
+    if (strcmp(what, "previous") == 0) {
+        if (!previous_valid) {
+            printf("Nothing kept: this boot started from power-on\n");
+            return 1;
+        }
+        print_dump(true);
+        return 0;
+    }
+    if (strcmp(what, "level") == 0 && argc == 4) {
+        int module = -1;
+        for (int i = 0; i < TRACE_MOD_COUNT; i++) {
+            if (strcasecmp(argv[2], module_names[i]) == 0) {
+                module = i;
+            }
+        }
+        if (strcasecmp(argv[2], "all") == 0) {
+            module = TRACE_MOD_COUNT;
+        }
+        int level = parse_level(argv[3]);
+        if (module < 0 || level < 0) {
+            printf("Unknown module or level\n");
+            return 1;
+        }
+        trace_set_level(module, level);
+    } else if (strcmp(what, "levels") != 0) {
+        printf("Unknown: %s\n", what);
+        return 1;
+    }
+
+    for (int i = 0; i < TRACE_MOD_COUNT; i++) {
+        printf("%-8s %s\n", module_names[i], level_names[trace_levels[i]]);
+    }
+    return 0;
+}
+
+void trace_console_register(void) {
+    const esp_console_cmd_t cmd = {
+        .command = "trace",
+        .help = "Binary event log: levels per module, or a dump for tools/trace_decode.py",
+        .hint = "[levels|level <module|all> <none..verbose>|dump|previous]",
+        .func = trace_cmd,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+}
+#endif
@@ -0,0 +1,108 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_log.h"
+#include "trace_events.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// ===== Configuration =====
+
+#define TRACE_RING_LEN          128     // Events kept per core, a power of two
+#define TRACE_RTC_LEN           32      // Of those, kept in RTC memory across a reset, a power of two
+#define TRACE_DATA_BYTES        28      // Numeric arguments, then as much of the string as fits
+#define TRACE_LEVEL_DEFAULT     ESP_LOG_INFO
+#define TRACE_CONSOLE           1       // `trace` command, on the console diag.c starts
+#define TRACE_PUBLISH_CRASH     1       // The previous boot's tail on MQTT_TOPIC_TRACE after a crash
+
+
+// ===== Binary event log =====
+//
+// Hot paths record an event id and its arguments instead of formatting a
+// line through ESP_LOG and the UART0 console: a few dozen bytes copied into
+// the ring of the core the caller runs on, reserved with one atomic add, no
+// lock. tools/trace_decode.py turns a dump back into text, with the formats
+// in trace_events.h.
+//
+// Each event also goes to a smaller ring in RTC memory, so the events that
+// led up to a panic, watchdog or brownout can be read after the reset.
+
+typedef struct {
+    uint32_t seq;                       // Index in its ring + 1, 0 while being written
+    uint32_t time_ms;                   // Since boot
+    uint16_t id;                        // TEV_
+    uint8_t info;                       // Level in the low nibble, core in the high one
+    uint8_t words;                      // u32 arguments at the start of data, the string after
+    uint8_t data[TRACE_DATA_BYTES];
+} trace_event_t;
+
+// A dump, for trace_decode.py: this, then `count` trace_event_t
+typedef struct __attribute__((packed)) {
+    char magic[4];                      // TRACE_DUMP_MAGIC
+    uint8_t version;                    // TRACE_DUMP_VERSION
+    uint8_t previous;                   // 1: the RTC tail of the boot before this one
+    uint8_t reset_reason;               // esp_reset_reason_t of this boot
+    uint8_t event_size;                 // sizeof(trace_event_t)
+    uint32_t now_ms;
+    uint16_t count;
+    uint16_t reserved;
+} trace_dump_header_t;
+
+#define TRACE_DUMP_MAGIC        "TRC1"
+#define TRACE_DUMP_VERSION      1
+
+extern uint8_t trace_levels[TRACE_MOD_COUNT];
+
+#define TRACE_ENABLED(id, level)    ((level) <= trace_levels[((id) >> 8) % TRACE_MOD_COUNT])
+
+// TRACE(ESP_LOG_INFO, TEV_X, a, b): up to TRACE_DATA_BYTES / 4 numeric arguments
+#define TRACE(level, id, ...) do {                                              \
+        if (TRACE_ENABLED(id, level)) {                                         \
+            const uint32_t trace_args_[] = { 0, ##__VA_ARGS__ };                \
+            trace_write((id), (level), trace_args_ + 1,                         \
+                        sizeof(trace_args_) / sizeof(uint32_t) - 1, NULL);      \
+        }                                                                       \
+    } while (0)
+
+// The same with a string, cut to what fits after the numbers
+#define TRACE_STR(level, id, str, ...) do {                                     \
+        if (TRACE_ENABLED(id, level)) {                                         \
+            const uint32_t trace_args_[] = { 0, ##__VA_ARGS__ };                \
+            trace_write((id), (level), trace_args_ + 1,                         \
+                        sizeof(trace_args_) / sizeof(uint32_t) - 1, (str));     \
+        }                                                                       \
+    } while (0)
+
+
+// First thing in app_main: keeps the RTC tail of the previous boot and starts a new one
+void trace_init(void);
+
+// Behind TRACE() and TRACE_STR(); callable from any task or ISR
+void trace_write(uint16_t id, esp_log_level_t level, const uint32_t *args, size_t count, const char *str);
+
+// ESP_LOG_NONE .. ESP_LOG_VERBOSE for one module, or all with TRACE_MOD_COUNT
+void trace_set_level(int module, esp_log_level_t level);
+
+// A dump of the live rings, or of the previous boot's tail. Bytes written, 0 if it didn't fit
+size_t trace_dump(bool previous, uint8_t *buf, size_t size);
+
+// From diag_task while MQTT is up: the previous boot's tail, once, if it ended in a crash
+void trace_publish_crash(void);
+
+#if TRACE_CONSOLE
+// With the other console commands
+void trace_console_register(void);
+#endif
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TRACE_H
@@ -0,0 +1,36 @@
+#ifndef TRACE_EVENTS_H
+#define TRACE_EVENTS_H
+
+// Events for trace.h. The device stores only the id and the arguments:
+// tools/trace_decode.py formats them from the strings below, so keep one
+// event per line as `#define TEV_X  0xMMNN  // "format"`, MM its module.
+//
+// Formats take %u %d %x for the numeric arguments, in order, and one %s
+// for the string, wherever it sits. Ids are never reused: retire an event
+// by deleting its line.
+
+#define TRACE_MOD_TRACE         0
+#define TRACE_MOD_AT            1   // AT transport: commands, replies, URCs
+#define TRACE_MOD_PPP           2   // AT over the PPPoS command channel
+#define TRACE_MOD_MQTT          3   // Publishes and received messages, either transport
+#define TRACE_MOD_PUB           4   // publish_task batches
+#define TRACE_MOD_COUNT         5
+
+#define TEV_BOOT                0x0001  // "boot, reset reason %u"
+
+#define TEV_AT_CMD              0x0101  // ">> %s"
+#define TEV_AT_DONE             0x0102  // "<< %s after %u ms, %u B"
+#define TEV_AT_TIMEOUT          0x0103  // "no response in %u ms: %s"
+#define TEV_AT_URC              0x0104  // "URC %s"
+
+#define TEV_PPP_AT_CMD          0x0201  // ">> %s"
+#define TEV_PPP_AT_DONE         0x0202  // "<< %s after %u ms, esp_err 0x%x"
+#define TEV_PPP_AT_TIMEOUT      0x0203  // "no response in %u ms: %s"
+
+#define TEV_MQTT_PUB            0x0301  // "published %u B to %s"
+#define TEV_MQTT_RX             0x0302  // "receiving %u B on %s"
+
+#define TEV_PUB_BATCH           0x0401  // "published %u samples, %u B (%s)"
+#define TEV_PUB_BATCH_CBOR      0x0402  // "published %u samples, %u B CBOR, %u B as JSON (%s)"
+
+#endif // TRACE_EVENTS_H
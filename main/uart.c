@@ -6,11 +6,15 @@
 #include "uart.h"
 #include "data.h"
 #include "heartbeat.h"
+#include "message_ids.h"
+#include "protocol.h"
+#include "power.h"
+#include "diag.h"
 
 
 
 
-#define MESSAGE_LENGTH 22 
+#define MESSAGE_LENGTH PROTOCOL_FRAME_LEN
 
 static const char *TAG = "UART";
 
@@ -18,6 +22,43 @@ TaskHandle_t heartbeatTaskHandle = NULL;
 QueueHandle_t master_cmd_queue; // Queue for commands to be sent over UART
 
 
+// What master_cmd_queue carries: frames to send and the master's ACKs for them
+typedef enum {
+    LINK_SEND = 0,
+    LINK_ACK,
+} link_event_kind_t;
+
+typedef struct {
+    uint8_t kind;
+    uint8_t seq;                    // 0: no ACK expected
+    uint8_t message_id;             // LINK_ACK: what the master acknowledged
+    uint8_t result;                 // LINK_ACK: ack_results_t
+    char frame[MASTER_MSG_SIZE];
+    command_done_cb_t done;
+    void *arg;
+} link_event_t;
+
+_Static_assert(MASTER_MSG_SIZE > PROTOCOL_FRAME_LEN, "a frame and its terminator");
+
+// Sent and waiting for an ACK. Only master_tx_task touches these
+typedef struct {
+    uint8_t seq;                    // 0: free
+    uint8_t message_id;
+    uint8_t tries;
+    TickType_t sent;
+    char frame[MASTER_MSG_SIZE];
+    command_done_cb_t done;
+    void *arg;
+} inflight_cmd_t;
+
+static inflight_cmd_t inflight[MASTER_CMD_WINDOW];
+static SemaphoreHandle_t window_slots;  // Free entries of inflight[]
+#if MASTER_CMD_SEQ
+static portMUX_TYPE seq_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint8_t last_seq = 0;
+#endif
+
+
 // Function to initialize UART
 void uart_init() {
     const uart_config_t uart_config = {
@@ -26,11 +67,17 @@ void uart_init() {
         .parity = UART_PARITY_DISABLE,
         .stop_bits = UART_STOP_BITS_1,
         .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
-        .source_clk = UART_SCLK_DEFAULT,
+        .source_clk = UART_SCLK_XTAL,       // APB changes with DFS, see power.h
     };
     uart_param_config(UART_NUM, &uart_config);
     uart_set_pin(UART_NUM, UART1_TXD, UART1_RXD, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
     uart_driver_install(UART_NUM, UART_BUF_SIZE * 2, 0, 0, NULL, 0);
+    power_uart_wake(UART_NUM);      // The master sends MSG_WAKE_PREAMBLE, see message_ids.h
+
+    // Before the tasks start: the heartbeat and RPCs may send straight away
+    master_cmd_queue = xQueueCreate(MESSAGE_QUEUE_SIZE, sizeof(link_event_t));
+    diag_queue_register("master_cmd", master_cmd_queue);
+    window_slots = xSemaphoreCreateCounting(MASTER_CMD_WINDOW, MASTER_CMD_WINDOW);
     ESP_LOGW(TAG, "UART 1 initialized");
 }
 
@@ -44,6 +91,7 @@ void master_rx_task(void *param) {
         ESP_LOGE(TAG, "Failed to create message queue");
         return;
     }
+    diag_queue_register("message", message_queue);
 
     // Create the semaphore
     message_semaphore = xSemaphoreCreateBinary();
@@ -65,14 +113,25 @@ void master_rx_task(void *param) {
 
     while (1) {
         // Read message from UART
-        int len = uart_read_bytes(UART_NUM, received_message, 22, 10 / portTICK_PERIOD_MS);
+        int len = uart_read_bytes(UART_NUM, received_message, MESSAGE_LENGTH, 10 / portTICK_PERIOD_MS);
         //ESP_LOGW(TAG, "msg: %u" , len);
-        if (len == 22) {
+        if (len > 0) {
+            // Also what's left of a wake preamble: the frame after it is the same burst
+            power_master_frame();
+        }
+        if (len == MESSAGE_LENGTH) {
             received_message[len] = '\0';  // Null-terminate the received string
             // ESP_LOGI(TAG, "Received message: %s", received_message);
 
-            // Decode the message
-            decode_uart_message(received_message, &decoded_msg);
+            if (!protocol_decode(received_message, &decoded_msg)) {
+                ESP_LOGW(TAG, "Dropped malformed frame: %s", received_message);
+                continue;
+            }
+
+            if (decoded_msg.message_id == MSG_ID_ACK) {
+                master_link_ack(&decoded_msg);
+                continue;
+            }
             //ESP_LOGW(TAG, "Decoded message: %s", received_message);
             // Send the decoded message to the queue
             if (xQueueSend(message_queue, &decoded_msg, portMAX_DELAY) == pdTRUE) {
@@ -86,16 +145,165 @@ void master_rx_task(void *param) {
 }
 
 
+///////////////command link//////////////
+
+const char *command_result_str(command_result_t result) {
+    switch (result) {
+        case CMD_DELIVERED: return "delivered";
+        case CMD_REJECTED:  return "rejected";
+        case CMD_TIMEOUT:   return "timeout";
+        case CMD_BUSY:      return "busy";
+        case CMD_SENT:      return "sent";
+    }
+    return "unknown";
+}
+
+bool master_link_send(int message_id, int message_type, uint16_t data0, uint16_t data1,
+                      uint16_t data2, uint16_t data3, command_done_cb_t done, void *arg) {
+    link_event_t event = {
+        .kind = LINK_SEND,
+        .message_id = message_id & MSG_ID_MASK,
+        .done = done,
+        .arg = arg,
+    };
+
+#if MASTER_CMD_SEQ
+    if (done) {
+        if (xSemaphoreTake(window_slots, pdMS_TO_TICKS(MASTER_CMD_SLOT_WAIT_MS)) != pdTRUE) {
+            ESP_LOGW(TAG, "⚠️ %d commands unacknowledged, message %d not sent", MASTER_CMD_WINDOW, message_id);
+            done(CMD_BUSY, arg);
+            return false;
+        }
+
+        taskENTER_CRITICAL(&seq_lock);
+        last_seq = last_seq == UINT8_MAX ? 1 : last_seq + 1;
+        event.seq = last_seq;
+        taskEXIT_CRITICAL(&seq_lock);
+    }
+#endif
+
+    protocol_encode(event.frame, message_type, (event.seq << MSG_SEQ_SHIFT) | event.message_id,
+                    data0, data1, data2, data3);
+
+    if (xQueueSend(master_cmd_queue, &event, pdMS_TO_TICKS(MASTER_QUEUE_WAIT_MS)) != pdTRUE) {
+        ESP_LOGE("UART_SEND", "Failed to send message to queue");
+        if (done) {
+            if (event.seq != 0) {
+                xSemaphoreGive(window_slots);
+            }
+            done(CMD_BUSY, arg);
+        }
+        return false;
+    }
+    return true;
+}
+
+void master_link_ack(const DecodedMessage *ack) {
+    link_event_t event = {
+        .kind = LINK_ACK,
+        .seq = ack->data1,
+        .message_id = ack->data0 & MSG_ID_MASK,
+        .result = ack->data2,
+    };
+
+    // Ahead of queued frames, the retry timer is running
+    if (xQueueSendToFront(master_cmd_queue, &event, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "⚠️ ACK %u dropped, queue full", ack->data1);
+    }
+}
+
+static void command_done(inflight_cmd_t *cmd, command_result_t result) {
+    command_done_cb_t done = cmd->done;
+    void *arg = cmd->arg;
+
+    if (result != CMD_DELIVERED) {
+        ESP_LOGW(TAG, "⚠️ Command %s (seq %u): %s", cmd->frame, cmd->seq, command_result_str(result));
+    }
+
+    cmd->seq = 0;
+    xSemaphoreGive(window_slots);
+    done(result, arg);
+}
+
+static void command_ack(const link_event_t *event) {
+    for (int i = 0; i < MASTER_CMD_WINDOW; i++) {
+        inflight_cmd_t *cmd = &inflight[i];
+        if (cmd->seq != 0 && cmd->seq == event->seq && cmd->message_id == event->message_id) {
+            command_done(cmd, event->result == ACK_OK ? CMD_DELIVERED : CMD_REJECTED);
+            return;
+        }
+    }
+
+    // The ACK of a resend that crossed the first one
+    ESP_LOGD(TAG, "ACK for seq %u not waited for", event->seq);
+}
+
+static void command_track(const link_event_t *event) {
+    // window_slots guarantees a free entry
+    for (int i = 0; i < MASTER_CMD_WINDOW; i++) {
+        inflight_cmd_t *cmd = &inflight[i];
+        if (cmd->seq == 0) {
+            cmd->seq = event->seq;
+            cmd->message_id = event->message_id;
+            cmd->tries = 1;
+            cmd->sent = xTaskGetTickCount();
+            memcpy(cmd->frame, event->frame, sizeof(cmd->frame));
+            cmd->done = event->done;
+            cmd->arg = event->arg;
+            return;
+        }
+    }
+}
+
+// Resend or give up on what timed out. Returns the ticks until the next deadline
+static TickType_t command_retry(void) {
+    const TickType_t timeout = pdMS_TO_TICKS(MASTER_CMD_TIMEOUT_MS);
+    TickType_t wait = portMAX_DELAY;
+
+    for (int i = 0; i < MASTER_CMD_WINDOW; i++) {
+        inflight_cmd_t *cmd = &inflight[i];
+        if (cmd->seq == 0) {
+            continue;
+        }
+
+        TickType_t elapsed = xTaskGetTickCount() - cmd->sent;
+        if (elapsed >= timeout) {
+            if (cmd->tries >= MASTER_CMD_TRIES) {
+                command_done(cmd, CMD_TIMEOUT);
+                continue;
+            }
+            uart_write_bytes(UART_NUM, cmd->frame, strlen(cmd->frame));
+            cmd->tries++;
+            cmd->sent = xTaskGetTickCount();
+            elapsed = 0;
+        }
+
+        if (timeout - elapsed < wait) {
+            wait = timeout - elapsed;
+        }
+    }
+    return wait;
+}
+
+
 void master_tx_task(void *param){
-    char message[MASTER_MSG_SIZE];
-    master_cmd_queue = xQueueCreate(MESSAGE_QUEUE_SIZE, MASTER_MSG_SIZE);
+    link_event_t event;
+    TickType_t wait = portMAX_DELAY;
 
     while (1) {
-        if (xQueueReceive(master_cmd_queue, &message, portMAX_DELAY) == pdTRUE) {
-            //ESP_LOGI("MASTER_TX", "Sending command: %s", message);
-            uart_write_bytes(UART_NUM, message, strlen(message));
-            //uart_write_bytes(UART_NUM, "\r\n", 2);
-            
+        if (xQueueReceive(master_cmd_queue, &event, wait) == pdTRUE) {
+            if (event.kind == LINK_ACK) {
+                command_ack(&event);
+            } else {
+                //ESP_LOGI("MASTER_TX", "Sending command: %s", event.frame);
+                uart_write_bytes(UART_NUM, event.frame, strlen(event.frame));
+                if (event.seq != 0) {
+                    command_track(&event);
+                } else if (event.done) {
+                    event.done(CMD_SENT, event.arg);    // No MASTER_CMD_SEQ, no ACK to wait for
+                }
+            }
         }
+        wait = command_retry();
     }
-}
\ No newline at end of file
+}
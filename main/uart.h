@@ -18,6 +18,29 @@
 
 #define MASTER_MSG_SIZE 23
 
+// Acknowledged commands to the master, protocol in message_ids.h. The sequence
+// number changes the command frames: off until the master firmware that sends
+// MSG_ID_ACK is out, then on with it. Off, commands go out once as plain
+// frames and complete with CMD_SENT
+#define MASTER_CMD_SEQ              0
+
+#define MASTER_CMD_WINDOW           2       // Commands waiting for their ACK at once
+#define MASTER_CMD_TIMEOUT_MS       300     // Send again after this long without an ACK
+#define MASTER_CMD_TRIES            4       // Sends before giving up
+#define MASTER_CMD_SLOT_WAIT_MS     1000    // Wait this long for room in the window, then CMD_BUSY
+#define MASTER_QUEUE_WAIT_MS        100     // Wait this long for room in master_cmd_queue
+
+typedef enum {
+    CMD_DELIVERED = 0,          // The master acknowledged it with ACK_OK
+    CMD_REJECTED,               // The master acknowledged it with an error
+    CMD_TIMEOUT,                // No ACK after MASTER_CMD_TRIES sends
+    CMD_BUSY,                   // No room in the window or queue, never sent
+    CMD_SENT,                   // Written once without an ACK, MASTER_CMD_SEQ is off
+} command_result_t;
+
+// Called from master_tx_task once per command: keep it short
+typedef void (*command_done_cb_t)(command_result_t result, void *arg);
+
 
 // Function to initialize UART with specified parameters
 void uart_init(void);
@@ -27,5 +50,16 @@ void uart_init(void);
 void master_rx_task(void *param);
 void master_tx_task(void *param);
 
+// Queue a frame for the master. With `done` it gets a sequence number and is
+// sent until acknowledged, `done` gets the outcome. Without it, or without
+// MASTER_CMD_SEQ, there's no ACK
+bool master_link_send(int message_id, int message_type, uint16_t data0, uint16_t data1,
+                      uint16_t data2, uint16_t data3, command_done_cb_t done, void *arg);
+
+// An MSG_ID_ACK from the master
+void master_link_ack(const DecodedMessage *ack);
+
+const char *command_result_str(command_result_t result);
+
 
 #endif // UART_H
@@ -0,0 +1,304 @@
+#include "main.h"
+#include "display.h"
+#include "ui_mem.h"
+#include "esp_timer.h"
+
+static const char *TAG = "UI_MEM";
+
+
+typedef struct free_block {
+    struct free_block *next;
+} free_block_t;
+
+typedef struct {
+    uint8_t *start;
+    uint8_t *end;
+    free_block_t *free_list;
+    ui_mem_pool_stats_t stats;
+} mem_pool_t;
+
+// Block counts cover the short lived allocations of a screen update with
+// headroom. The screens stay on lv_mem (see ui_mem_init, ui_mem_pools_pause)
+#define POOL_16_CNT     32
+#define POOL_32_CNT     16
+#define POOL_64_CNT     16
+#define POOL_128_CNT    16
+
+static uint8_t pool_16[POOL_16_CNT * 16] __attribute__((aligned(8)));
+static uint8_t pool_32[POOL_32_CNT * 32] __attribute__((aligned(8)));
+static uint8_t pool_64[POOL_64_CNT * 64] __attribute__((aligned(8)));
+static uint8_t pool_128[POOL_128_CNT * 128] __attribute__((aligned(8)));
+
+static mem_pool_t pools[UI_MEM_POOL_CNT] = {
+    { pool_16,  pool_16 + sizeof(pool_16),   NULL, { 16,  POOL_16_CNT,  0, 0, 0 } },
+    { pool_32,  pool_32 + sizeof(pool_32),   NULL, { 32,  POOL_32_CNT,  0, 0, 0 } },
+    { pool_64,  pool_64 + sizeof(pool_64),   NULL, { 64,  POOL_64_CNT,  0, 0, 0 } },
+    { pool_128, pool_128 + sizeof(pool_128), NULL, { 128, POOL_128_CNT, 0, 0, 0 } },
+};
+
+static bool pools_ready = false;
+static bool pools_paused = false;
+
+// LVGL uses most allocations without a NULL check and LV_ASSERT_MALLOC halts
+// on the rest: a failure gives this back to lv_mem and is tried again
+static void *reserve = NULL;
+
+static uint32_t oom_cnt = 0;
+static uint32_t oom_last_size = 0;
+static int64_t oom_last_alert_us = 0;
+static uint32_t oom_reported = 0;
+
+
+// The real LVGL heap, reached through the linker's --wrap
+void *__real_lv_mem_alloc(size_t size);
+void __real_lv_mem_free(void *data);
+void *__real_lv_mem_realloc(void *data_p, size_t new_size);
+
+
+///////////////////////////////// POOLS /////////////////////////////////
+
+void ui_mem_init(void)
+{
+    for (int i = 0; i < UI_MEM_POOL_CNT; i++) {
+        mem_pool_t *p = &pools[i];
+        p->free_list = NULL;
+        // Thread the blocks back to front so the first allocation gets the lowest address
+        for (uint8_t *b = p->end - p->stats.block_size; b >= p->start; b -= p->stats.block_size) {
+            free_block_t *fb = (free_block_t *)b;
+            fb->next = p->free_list;
+            p->free_list = fb;
+        }
+    }
+    pools_ready = true;
+    reserve = __real_lv_mem_alloc(UI_MEM_RESERVE_BYTES);
+}
+
+void ui_mem_pools_pause(bool pause)
+{
+    pools_paused = pause;
+}
+
+bool ui_mem_reserve_spent(void)
+{
+    return pools_ready && reserve == NULL;
+}
+
+static mem_pool_t *pool_of(const void *data)
+{
+    const uint8_t *d = data;
+    for (int i = 0; i < UI_MEM_POOL_CNT; i++) {
+        if (d >= pools[i].start && d < pools[i].end) {
+            return &pools[i];
+        }
+    }
+    return NULL;
+}
+
+static void *pool_alloc(size_t size)
+{
+    if (!pools_ready || pools_paused) {
+        return NULL;
+    }
+
+    for (int i = 0; i < UI_MEM_POOL_CNT; i++) {
+        mem_pool_t *p = &pools[i];
+        if (size > p->stats.block_size) {
+            continue;
+        }
+        if (p->free_list == NULL) {
+            // Full: let the next size class or lv_mem take it
+            p->stats.overflow++;
+            continue;
+        }
+        free_block_t *fb = p->free_list;
+        p->free_list = fb->next;
+        if (++p->stats.used > p->stats.peak) {
+            p->stats.peak = p->stats.used;
+        }
+        return fb;
+    }
+    return NULL;
+}
+
+static void pool_free(mem_pool_t *p, void *data)
+{
+    free_block_t *fb = data;
+    fb->next = p->free_list;
+    p->free_list = fb;
+    p->stats.used--;
+}
+
+static void report_oom(size_t size)
+{
+    oom_cnt++;
+    oom_last_size = size;
+
+    // Rate limited: a full heap tends to fail every frame
+    int64_t now = esp_timer_get_time();
+    if (oom_reported == 0 || now - oom_last_alert_us >= (int64_t)UI_MEM_ALERT_INTERVAL_MS * 1000) {
+        ESP_LOGE(TAG, "🚨 LVGL out of memory: %u B requested, %lu failures since boot",
+                 (unsigned)size, (unsigned long)oom_cnt);
+        oom_last_alert_us = now;
+        oom_reported = oom_cnt;
+    }
+}
+
+// Back to lv_mem for a failed `size` byte request, true if there was a reserve to give
+static bool reserve_release(size_t size)
+{
+    report_oom(size);
+    if (reserve == NULL) {
+        return false;
+    }
+    __real_lv_mem_free(reserve);
+    reserve = NULL;
+    return true;
+}
+
+// With the LVGL lock held, once the heap has room for the reserve again
+static void reserve_retake(void)
+{
+    if (reserve == NULL) {
+        lv_mem_monitor_t mon;
+        lv_mem_monitor(&mon);
+        if (mon.free_biggest_size < UI_MEM_RESERVE_BYTES + UI_MEM_FREE_WARN_BYTES) {
+            return;
+        }
+        reserve = __real_lv_mem_alloc(UI_MEM_RESERVE_BYTES);
+        if (reserve) {
+            ESP_LOGW(TAG, "⚠️ LVGL memory reserve restored");
+        }
+    }
+}
+
+
+///////////////////////////// LV_MEM WRAPPERS /////////////////////////////
+
+// LVGL calls these with the LVGL lock held, so no locking of our own
+
+void *__wrap_lv_mem_alloc(size_t size)
+{
+    if (size == 0) {
+        return __real_lv_mem_alloc(0);
+    }
+
+    void *data = pool_alloc(size);
+    if (data == NULL) {
+        data = __real_lv_mem_alloc(size);
+        if (data == NULL && reserve_release(size)) {
+            data = __real_lv_mem_alloc(size);
+        }
+    }
+    return data;
+}
+
+void __wrap_lv_mem_free(void *data)
+{
+    mem_pool_t *p = pool_of(data);
+    if (p) {
+        pool_free(p, data);
+    } else {
+        __real_lv_mem_free(data);
+    }
+}
+
+void *__wrap_lv_mem_realloc(void *data_p, size_t new_size)
+{
+    mem_pool_t *p = pool_of(data_p);
+
+    if (p == NULL) {
+        if (data_p == NULL) {
+            return __wrap_lv_mem_alloc(new_size);
+        }
+        void *data = __real_lv_mem_realloc(data_p, new_size);
+        if (data == NULL && new_size != 0 && reserve_release(new_size)) {
+            data = __real_lv_mem_realloc(data_p, new_size);
+        }
+        return data;
+    }
+
+    if (new_size == 0) {
+        pool_free(p, data_p);
+        return __real_lv_mem_alloc(0);
+    }
+
+    // Still fits the block: nothing to do
+    if (new_size <= p->stats.block_size) {
+        return data_p;
+    }
+
+    void *data = __wrap_lv_mem_alloc(new_size);
+    if (data) {
+        memcpy(data, data_p, p->stats.block_size);
+        pool_free(p, data_p);
+    }
+    return data;
+}
+
+
+//////////////////////////////// MONITOR ////////////////////////////////
+
+bool ui_mem_get_stats(ui_mem_stats_t *stats)
+{
+    if (!lvgl_lock(LVGL_LOCK_WAIT_TIME)) {
+        return false;
+    }
+
+    lv_mem_monitor_t mon;
+    lv_mem_monitor(&mon);
+
+    stats->total_size = mon.total_size;
+    stats->free_size = mon.free_size;
+    stats->free_biggest = mon.free_biggest_size;
+    stats->max_used = mon.max_used;
+    stats->frag_pct = mon.frag_pct;
+    stats->used_pct = mon.used_pct;
+    stats->oom_cnt = oom_cnt;
+    stats->oom_last_size = oom_last_size;
+    for (int i = 0; i < UI_MEM_POOL_CNT; i++) {
+        stats->pools[i] = pools[i].stats;
+    }
+
+    lvgl_unlock();
+    return true;
+}
+
+void ui_mem_monitor_task(void *pvParameter)
+{
+    xEventGroupWaitBits(systemEvents, DISPLAY_INIT, pdFALSE, pdFALSE, portMAX_DELAY);
+
+    ui_mem_stats_t stats;
+
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(UI_MEM_MONITOR_PERIOD_MS));
+
+        if (!ui_mem_get_stats(&stats)) {
+            continue;
+        }
+
+        ESP_LOGI(TAG, "heap %lu/%lu B used (peak %lu), biggest free %lu B, frag %u%%",
+                 (unsigned long)(stats.total_size - stats.free_size), (unsigned long)stats.total_size,
+                 (unsigned long)stats.max_used, (unsigned long)stats.free_biggest, stats.frag_pct);
+        for (int i = 0; i < UI_MEM_POOL_CNT; i++) {
+            ui_mem_pool_stats_t *p = &stats.pools[i];
+            ESP_LOGI(TAG, "pool %3u B: %u/%u used (peak %u), %lu overflowed",
+                     p->block_size, p->used, p->block_cnt, p->peak, (unsigned long)p->overflow);
+        }
+
+        if (stats.frag_pct > UI_MEM_FRAG_WARN_PCT || stats.free_biggest < UI_MEM_FREE_WARN_BYTES) {
+            ESP_LOGW(TAG, "⚠️ LVGL heap getting tight: biggest free block %lu B, frag %u%%",
+                     (unsigned long)stats.free_biggest, stats.frag_pct);
+        }
+
+        if (lvgl_lock(LVGL_LOCK_WAIT_TIME)) {
+            // Failures since the last alert that the rate limit swallowed
+            if (stats.oom_cnt != oom_reported) {
+                ESP_LOGE(TAG, "🚨 LVGL out of memory: %lu failures since boot, last request %lu B",
+                         (unsigned long)stats.oom_cnt, (unsigned long)stats.oom_last_size);
+                oom_reported = stats.oom_cnt;
+            }
+            reserve_retake();
+            lvgl_unlock();
+        }
+    }
+}
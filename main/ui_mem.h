@@ -0,0 +1,73 @@
+#ifndef UI_MEM_H
+#define UI_MEM_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <esp_log.h>
+#include "lvgl.h"
+
+/*
+ * Size-class pools in front of the LVGL heap.
+ *
+ * lv_mem_alloc/free/realloc are wrapped at link time (see CMakeLists.txt).
+ * Small requests are served from fixed-block pools so the short lived
+ * allocations LVGL makes on every update (label text, local style arrays,
+ * anims, timers) don't fragment the 32 KB TLSF heap. Everything else and any
+ * pool overflow goes to the built-in lv_mem heap, so CONFIG_LV_MEM_CUSTOM
+ * must stay off.
+ */
+
+#if LV_MEM_CUSTOM
+#error "ui_mem wraps the built-in LVGL heap, CONFIG_LV_MEM_CUSTOM must be off"
+#endif
+
+#define UI_MEM_POOL_CNT             4           // size classes: 16, 32, 64, 128 bytes
+
+#define UI_MEM_MONITOR_PERIOD_MS    (60 * 1000) // how often the heap stats are logged
+#define UI_MEM_ALERT_INTERVAL_MS    (60 * 1000) // at most one out-of-memory alert per interval
+#define UI_MEM_FRAG_WARN_PCT        40          // warn above this fragmentation
+#define UI_MEM_FREE_WARN_BYTES      4096        // warn when the biggest free block drops below this
+#define UI_MEM_RESERVE_BYTES        1024        // held back on lv_mem for the first allocation that fails
+
+typedef struct {
+    uint16_t block_size;
+    uint16_t block_cnt;
+    uint16_t used;
+    uint16_t peak;
+    uint32_t overflow;                          // requests that fell through to lv_mem because the pool was full
+} ui_mem_pool_stats_t;
+
+typedef struct {
+    uint32_t total_size;                        // lv_mem heap
+    uint32_t free_size;
+    uint32_t free_biggest;
+    uint32_t max_used;                          // peak use since boot
+    uint8_t  frag_pct;
+    uint8_t  used_pct;
+    uint32_t oom_cnt;                           // failed allocations since boot, the reserve caught the first
+    uint32_t oom_last_size;
+    ui_mem_pool_stats_t pools[UI_MEM_POOL_CNT];
+} ui_mem_stats_t;
+
+// Start serving small allocations from the pools. Call it with the LVGL lock
+// held once screens_init() is done: the objects created before that live as long as
+// the screens and are packed tightly on lv_mem, the pools are left for churn.
+void ui_mem_init(void);
+
+// While paused everything goes to lv_mem, for a screen built after
+// ui_mem_init() (screens.c). With the LVGL lock held
+void ui_mem_pools_pause(bool pause);
+
+// True once an allocation needed the reserve, until the monitor takes it back.
+// Nothing new should be built meanwhile (screens_show). With the LVGL lock held
+bool ui_mem_reserve_spent(void);
+
+// Fill `stats`. Takes the LVGL lock, don't call it with the lock held.
+bool ui_mem_get_stats(ui_mem_stats_t *stats);
+
+void ui_mem_monitor_task(void *pvParameter);
+
+#endif // UI_MEM_H
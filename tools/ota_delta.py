@@ -0,0 +1,173 @@
+#!/usr/bin/env python3
+"""Make and check OTA delta packages (main/ota.h).
+
+A delta rebuilds new.bin from the image the device runs, so only what
+changed goes over the modem. Upload the .delta as the ThingsBoard package
+instead of the .bin: its checksum and size are the delta file's.
+
+  ota_delta.py make base.bin new.bin out.delta   the delta, and its size against new.bin
+  ota_delta.py apply base.bin in.delta out.bin   what the device will write, to compare
+  ota_delta.py info in.delta                     header and op counts
+
+base.bin has to be exactly the image on the devices: the device refuses a
+delta whose base app_elf_sha256 isn't its own.
+"""
+
+import argparse
+import hashlib
+import struct
+import sys
+
+MAGIC = b'ESPD'
+VERSION = 1
+OP_END, OP_COPY, OP_INSERT = 0, 1, 2
+
+HEADER = struct.Struct('<4sB3x32sI')    # ota_delta_header_t
+ELF_SHA_OFFSET = 24 + 8 + 144           # esp_image_header_t, segment header, into esp_app_desc_t
+
+BLOCK = 16          # Bytes hashed to find a match
+STEP = 4            # Of the base: code moves by whole instructions
+MIN_COPY = 24       # Shorter matches cost more as a COPY than as bytes
+
+
+def elf_sha256(image):
+    if image[0] != 0xE9:
+        sys.exit('not an app image: no 0xE9 magic')
+    return image[ELF_SHA_OFFSET:ELF_SHA_OFFSET + 32]
+
+
+def make(base, new):
+    """Ops as (OP_COPY, offset, length) and (OP_INSERT, bytes), greedy"""
+    index = {}
+    for i in range(0, len(base) - BLOCK + 1, STEP):
+        index.setdefault(base[i:i + BLOCK], i)
+
+    ops = []
+    literal = bytearray()
+    i = 0
+    while i < len(new):
+        start = index.get(new[i:i + BLOCK])
+        length = 0
+        if start is not None:
+            while i + length < len(new) and start + length < len(base) and new[i + length] == base[start + length]:
+                length += 1
+        if length >= MIN_COPY:
+            if literal:
+                ops.append((OP_INSERT, bytes(literal)))
+                literal.clear()
+            ops.append((OP_COPY, start, length))
+            i += length
+        else:
+            literal.append(new[i])
+            i += 1
+    if literal:
+        ops.append((OP_INSERT, bytes(literal)))
+    return ops
+
+
+def encode(base, new, ops):
+    out = bytearray(HEADER.pack(MAGIC, VERSION, elf_sha256(base), len(new)))
+    for op in ops:
+        if op[0] == OP_COPY:
+            out += struct.pack('<BII', OP_COPY, op[1], op[2])
+        else:
+            out += struct.pack('<BI', OP_INSERT, len(op[1])) + op[1]
+    out.append(OP_END)
+    return bytes(out)
+
+
+def decode(delta):
+    """(header fields, ops), checked the way the device checks"""
+    if len(delta) < HEADER.size:
+        sys.exit('delta too short')
+    magic, version, base_sha, size = HEADER.unpack_from(delta)
+    if magic != MAGIC or version != VERSION:
+        sys.exit('not a version %d delta' % VERSION)
+
+    ops = []
+    p = HEADER.size
+    while True:
+        op = delta[p]
+        p += 1
+        if op == OP_END:
+            break
+        if op == OP_COPY:
+            ops.append((OP_COPY,) + struct.unpack_from('<II', delta, p))
+            p += 8
+        elif op == OP_INSERT:
+            (length,) = struct.unpack_from('<I', delta, p)
+            ops.append((OP_INSERT, delta[p + 4:p + 4 + length]))
+            p += 4 + length
+        else:
+            sys.exit('unknown op %d at %d' % (op, p - 1))
+    if p != len(delta):
+        sys.exit('data after the end op')
+    return (base_sha, size), ops
+
+
+def apply(base, delta):
+    (base_sha, size), ops = decode(delta)
+    if base_sha != elf_sha256(base):
+        sys.exit('delta made for another base image')
+    out = bytearray()
+    for op in ops:
+        if op[0] == OP_COPY:
+            if op[1] + op[2] > len(base):
+                sys.exit('copy past the base image')
+            out += base[op[1]:op[1] + op[2]]
+        else:
+            out += op[1]
+    if len(out) != size:
+        sys.exit('made %d B, header says %d' % (len(out), size))
+    return bytes(out)
+
+
+def read(path):
+    with open(path, 'rb') as f:
+        return f.read()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest='cmd', required=True)
+    p = sub.add_parser('make')
+    p.add_argument('base')
+    p.add_argument('new')
+    p.add_argument('out')
+    p = sub.add_parser('apply')
+    p.add_argument('base')
+    p.add_argument('delta')
+    p.add_argument('out')
+    p = sub.add_parser('info')
+    p.add_argument('delta')
+    args = parser.parse_args()
+
+    if args.cmd == 'make':
+        base, new = read(args.base), read(args.new)
+        elf_sha256(new)
+        delta = encode(base, new, make(base, new))
+        if apply(base, delta) != new:
+            sys.exit('delta does not rebuild the new image')
+        with open(args.out, 'wb') as f:
+            f.write(delta)
+        print('%s: %d B, %.1f%% of %d B' % (args.out, len(delta), 100.0 * len(delta) / len(new), len(new)))
+        print('fw_checksum (SHA256): %s' % hashlib.sha256(delta).hexdigest())
+
+    elif args.cmd == 'apply':
+        image = apply(read(args.base), read(args.delta))
+        with open(args.out, 'wb') as f:
+            f.write(image)
+        print('%s: %d B, SHA256 %s' % (args.out, len(image), hashlib.sha256(image).hexdigest()))
+
+    else:
+        delta = read(args.delta)
+        (base_sha, size), ops = decode(delta)
+        copied = sum(op[2] for op in ops if op[0] == OP_COPY)
+        inserted = sum(len(op[1]) for op in ops if op[0] == OP_INSERT)
+        print('base app_elf_sha256 %s' % base_sha.hex())
+        print('image %d B: %d B copied, %d B inserted, %d ops' % (size, copied, inserted, len(ops)))
+        print('fw_checksum (SHA256): %s' % hashlib.sha256(delta).hexdigest())
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+"""Stand-in for ThingsBoard's firmware update, against a local mosquitto.
+
+Point MQTT_BROKER (main/modem.h) at the broker, then
+
+  ota_server.py --host 192.168.1.10 firmware.bin --version 1.2.3
+  ota_server.py new.delta --version 1.2.3 --drop 40
+
+It does what ThingsBoard does when a package is assigned: publishes the
+fw_* shared attributes, answers the device's attribute request with them,
+and serves v2/fw/request/<id>/chunk/<n> (the payload is the chunk size)
+on v2/fw/response/<id>/chunk/<n>. fw_state from the telemetry is printed.
+
+--drop N ignores the first request for chunk N, and every one after
+--drop-every requests, to check the device asks again and carries on.
+
+Needs paho-mqtt (pip install paho-mqtt).
+"""
+
+import argparse
+import hashlib
+import json
+import os
+import re
+import time
+
+import paho.mqtt.client as mqtt
+
+TOPIC_ATTRIBUTES = 'v1/devices/me/attributes'
+TOPIC_ATTR_REQUEST = 'v1/devices/me/attributes/request/+'
+TOPIC_ATTR_RESPONSE = 'v1/devices/me/attributes/response/%s'
+TOPIC_TELEMETRY = 'v1/devices/me/telemetry'
+TOPIC_CHUNK_REQUEST = 'v2/fw/request/+/chunk/+'
+TOPIC_CHUNK_RESPONSE = 'v2/fw/response/%s/chunk/%s'
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('package', help='app image or ota_delta.py delta')
+    parser.add_argument('--version', required=True, help='fw_version: the device skips its own')
+    parser.add_argument('--title', default='auto_def_slave')
+    parser.add_argument('--host', default='localhost')
+    parser.add_argument('--port', type=int, default=1883)
+    parser.add_argument('--drop', type=int, default=None, metavar='N', help='ignore requests for chunk N')
+    parser.add_argument('--drop-every', type=int, default=0, metavar='K', help='and every Kth request after it')
+    args = parser.parse_args()
+
+    with open(args.package, 'rb') as f:
+        package = f.read()
+    shared = {
+        'fw_title': args.title,
+        'fw_version': args.version,
+        'fw_checksum': hashlib.sha256(package).hexdigest(),
+        'fw_checksum_algorithm': 'SHA256',
+        'fw_size': len(package),
+    }
+    served = {'requests': 0, 'bytes': 0, 'started': None}
+    dropped = set()
+
+    def on_connect(client, userdata, flags, *rest):
+        client.subscribe([(TOPIC_ATTR_REQUEST, 1), (TOPIC_TELEMETRY, 1), (TOPIC_CHUNK_REQUEST, 1)])
+        client.publish(TOPIC_ATTRIBUTES, json.dumps(shared), qos=1)
+        print('package %s: %d B, %s' % (os.path.basename(args.package), len(package), shared['fw_checksum']))
+
+    def on_message(client, userdata, msg):
+        if msg.topic.startswith('v1/devices/me/attributes/request/'):
+            request_id = msg.topic.rsplit('/', 1)[1]
+            client.publish(TOPIC_ATTR_RESPONSE % request_id, json.dumps({'shared': shared}), qos=1)
+            return
+
+        if msg.topic == TOPIC_TELEMETRY:
+            try:
+                data = json.loads(msg.payload)
+            except ValueError:
+                return
+            if isinstance(data, dict) and 'fw_state' in data:
+                print('device: %s %s %s' % (data.get('current_fw_version'), data['fw_state'],
+                                            data.get('fw_error', '')))
+            return
+
+        m = re.match(r'v2/fw/request/(\d+)/chunk/(\d+)$', msg.topic)
+        if not m:
+            return
+        request_id, index = m.group(1), int(m.group(2))
+        size = int(msg.payload or 0) or len(package)
+        served['requests'] += 1
+        served['started'] = served['started'] or time.time()
+
+        if args.drop is not None and index >= args.drop:
+            first = index == args.drop and index not in dropped
+            if first or (args.drop_every and served['requests'] % args.drop_every == 0):
+                dropped.add(index)
+                print('chunk %d: dropped' % index)
+                return
+
+        chunk = package[index * size:(index + 1) * size]
+        served['bytes'] += len(chunk)
+        client.publish(TOPIC_CHUNK_RESPONSE % (request_id, index), chunk, qos=1)
+        if (index + 1) * size >= len(package):
+            seconds = time.time() - served['started']
+            print('last chunk %d served: %d B in %d requests, %.0f s' % (index, served['bytes'],
+                                                                        served['requests'], seconds))
+
+    try:
+        client = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2)
+    except AttributeError:
+        client = mqtt.Client()      # paho-mqtt 1.x
+    client.on_connect = on_connect
+    client.on_message = on_message
+    client.connect(args.host, args.port)
+    client.loop_forever()
+
+
+if __name__ == '__main__':
+    main()
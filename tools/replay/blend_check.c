@@ -0,0 +1,176 @@
+/*
+ * main/blend.c against LVGL: random fills, image copies, masks, opacities
+ * and clips through blend_fast() and lv_draw_sw_blend_basic(), which mixes
+ * with lv_color_mix(), on copies of the same buffer. Every pixel must match.
+ * LVGL is built from the firmware's sdkconfig, so the reference rounds with
+ * its LV_COLOR_MIX_ROUND_OFS.
+ *
+ *   blend_check [cases] [seed]          200000 cases, seed 1 by default
+ *
+ * Exits 1 on the first case that differs, with what it was.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "blend.h"
+#include "esp_timer.h"
+
+
+#define CHECK_CASES         200000
+#define CHECK_BUF_MAX       64          // Largest draw buffer side
+#define CHECK_AREA_MAX      (CHECK_BUF_MAX * 3 / 2)     // Blend areas reach past the buffer
+
+static uint32_t rng_state;
+
+static uint32_t rng(void) {
+    // xorshift32: the same cases for a seed on every host
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static int32_t rng_range(int32_t lo, int32_t hi) {
+    return lo + (int32_t)(rng() % (uint32_t)(hi - lo + 1));
+}
+
+// LVGL's tick is esp_timer's here as on the device; nothing in a blend reads it
+int64_t esp_timer_get_time(void) {
+    return 0;
+}
+
+static void headless_flush(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_map) {
+    lv_disp_flush_ready(drv);
+}
+
+// Opacities LVGL skips (lv_draw_sw_blend) never get here; the rest weighted to the edges
+static lv_opa_t random_opa(void) {
+    switch (rng() % 4) {
+        case 0:  return LV_OPA_COVER;
+        case 1:  return (lv_opa_t)rng_range(LV_OPA_MAX, LV_OPA_COVER);
+        case 2:  return (lv_opa_t)rng_range(LV_OPA_MIN + 1, LV_OPA_MIN + 8);
+        default: return (lv_opa_t)rng_range(LV_OPA_MIN + 1, LV_OPA_COVER);
+    }
+}
+
+static void random_area(lv_area_t *a, int32_t lo, int32_t hi, int32_t max_size) {
+    a->x1 = rng_range(lo, hi);
+    a->y1 = rng_range(lo, hi);
+    a->x2 = a->x1 + rng_range(0, max_size - 1);
+    a->y2 = a->y1 + rng_range(0, max_size - 1);
+}
+
+int main(int argc, char **argv) {
+    long cases = argc > 1 ? atol(argv[1]) : CHECK_CASES;
+    rng_state = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 1;
+    if (cases <= 0 || rng_state == 0) {
+        fprintf(stderr, "usage: %s [cases > 0] [seed != 0]\n", argv[0]);
+        return 2;
+    }
+
+    static lv_disp_draw_buf_t draw_buf;
+    static lv_color_t disp_buf[CHECK_BUF_MAX * CHECK_BUF_MAX];
+    static lv_disp_drv_t disp_drv;
+
+    lv_init();
+    lv_disp_draw_buf_init(&draw_buf, disp_buf, NULL, CHECK_BUF_MAX * CHECK_BUF_MAX);
+    lv_disp_drv_init(&disp_drv);
+    disp_drv.draw_buf = &draw_buf;
+    disp_drv.flush_cb = headless_flush;
+    disp_drv.hor_res = CHECK_BUF_MAX;
+    disp_drv.ver_res = CHECK_BUF_MAX;
+    disp_drv.antialiasing = 1;
+    disp_drv.draw_ctx_init = blend_draw_ctx_init;
+    lv_disp_t *disp = lv_disp_drv_register(&disp_drv);
+    _lv_refr_set_disp_refreshing(disp);     // Both blends ask it for set_px_cb and screen_transp
+
+    static lv_color_t fast_buf[CHECK_BUF_MAX * CHECK_BUF_MAX];
+    static lv_color_t ref_buf[CHECK_BUF_MAX * CHECK_BUF_MAX];
+    static lv_color_t src[CHECK_AREA_MAX * CHECK_AREA_MAX];
+    static lv_opa_t mask[CHECK_AREA_MAX * CHECK_AREA_MAX];
+    static const lv_draw_mask_res_t mask_results[] = {
+        LV_DRAW_MASK_RES_CHANGED, LV_DRAW_MASK_RES_FULL_COVER, LV_DRAW_MASK_RES_TRANSP,
+    };
+    static const char *kinds[] = { "fill", "map" };
+
+    lv_draw_sw_ctx_t ctx;
+    lv_draw_sw_init_ctx(&disp_drv, &ctx.base_draw);
+
+    long counts[2] = { 0 };
+    for (long i = 0; i < cases; i++) {
+        // The draw buffer somewhere on the display, clipped inside it
+        lv_area_t buf_area, clip_area, blend_area, mask_area;
+        random_area(&buf_area, -8, 8, CHECK_BUF_MAX);
+        clip_area.x1 = rng_range(buf_area.x1, buf_area.x2);
+        clip_area.y1 = rng_range(buf_area.y1, buf_area.y2);
+        clip_area.x2 = rng_range(clip_area.x1, buf_area.x2);
+        clip_area.y2 = rng_range(clip_area.y1, buf_area.y2);
+        random_area(&blend_area, buf_area.x1 - 16, buf_area.x2, CHECK_AREA_MAX);
+        if (lv_area_get_size(&blend_area) > CHECK_AREA_MAX * CHECK_AREA_MAX) {
+            blend_area.x2 = blend_area.x1 + CHECK_AREA_MAX - 1;
+            blend_area.y2 = blend_area.y1 + CHECK_AREA_MAX - 1;
+        }
+
+        // Noise, or a few colours black among them as backgrounds are: runs of
+        // the same colour take other paths in both blends
+        int32_t buf_px = lv_area_get_size(&buf_area);
+        bool flat = rng() % 2;
+        uint16_t palette[4] = { 0x0000, (uint16_t)rng(), (uint16_t)rng(), 0xFFFF };
+        for (int32_t p = 0; p < buf_px; p++) {
+            fast_buf[p].full = flat ? palette[rng() % 8 ? 0 : rng() % 4] : (uint16_t)rng();
+        }
+        memcpy(ref_buf, fast_buf, buf_px * sizeof(lv_color_t));
+
+        lv_draw_sw_blend_dsc_t dsc = {
+            .blend_area = &blend_area,
+            .color.full = (uint16_t)rng(),
+            .opa = random_opa(),
+            .blend_mode = rng() % 8 ? LV_BLEND_MODE_NORMAL : (lv_blend_mode_t)rng_range(0, LV_BLEND_MODE_MULTIPLY),
+        };
+        int32_t area_px = lv_area_get_size(&blend_area);
+        bool map = rng() % 2;
+        if (map) {
+            for (int32_t p = 0; p < area_px; p++) {
+                src[p].full = (uint16_t)rng();
+            }
+            dsc.src_buf = src;
+        }
+        if (rng() % 3 == 0) {
+            mask_area = blend_area;
+            for (int32_t p = 0; p < area_px; p++) {
+                uint32_t r = rng();
+                mask[p] = r % 4 == 0 ? LV_OPA_TRANSP : r % 4 == 1 ? LV_OPA_COVER : (lv_opa_t)(r >> 8);
+            }
+            dsc.mask_buf = mask;
+            dsc.mask_area = &mask_area;
+            dsc.mask_res = mask_results[rng() % 3];
+        } else {
+            dsc.mask_res = LV_DRAW_MASK_RES_FULL_COVER;
+        }
+
+        ctx.base_draw.buf_area = &buf_area;
+        ctx.base_draw.clip_area = &clip_area;
+        ctx.base_draw.buf = fast_buf;
+        blend_fast(&ctx.base_draw, &dsc);
+        ctx.base_draw.buf = ref_buf;
+        lv_draw_sw_blend_basic(&ctx.base_draw, &dsc);
+        counts[map]++;
+
+        for (int32_t p = 0; p < buf_px; p++) {
+            if (fast_buf[p].full != ref_buf[p].full) {
+                int32_t w = lv_area_get_width(&buf_area);
+                printf("case %ld (%s, opa %u, mode %d, mask %s): pixel %ld,%ld is 0x%04x, LVGL gives 0x%04x\n",
+                       i, kinds[map], dsc.opa, dsc.blend_mode,
+                       dsc.mask_buf ? (dsc.mask_res == LV_DRAW_MASK_RES_CHANGED ? "changed" :
+                                       dsc.mask_res == LV_DRAW_MASK_RES_TRANSP ? "transp" : "cover") : "none",
+                       (long)(buf_area.x1 + p % w), (long)(buf_area.y1 + p / w),
+                       fast_buf[p].full, ref_buf[p].full);
+                return 1;
+            }
+        }
+    }
+
+    printf("blend_fast matches lv_draw_sw_blend_basic: %ld fills, %ld maps\n", counts[0], counts[1]);
+    return 0;
+}
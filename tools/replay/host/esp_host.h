@@ -0,0 +1,149 @@
+#ifndef ESP_HOST_H
+#define ESP_HOST_H
+
+/*
+ * Just enough of ESP-IDF and FreeRTOS for main/data.c and what it pulls in
+ * to build on Linux. There is one task: semaphores and the LVGL lock are
+ * always free, critical sections are empty, and time is the replay's
+ * virtual clock (replay.c), which vTaskDelay moves on without sleeping.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "sdkconfig.h"
+
+
+// ===== esp_err / esp_log =====
+
+typedef int esp_err_t;
+
+#define ESP_OK                  0
+#define ESP_FAIL                -1
+#define ESP_ERR_NO_MEM          0x101
+#define ESP_ERR_INVALID_ARG     0x102
+#define ESP_ERR_INVALID_STATE   0x103
+#define ESP_ERR_NOT_FOUND       0x105
+#define ESP_ERR_TIMEOUT         0x107
+
+#define ESP_ERROR_CHECK(x)      do { (void)(x); } while (0)
+
+typedef enum {
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE,
+} esp_log_level_t;
+
+// Warnings and errors only, the replay report goes to stdout
+extern bool host_log_quiet;
+#define HOST_LOG(letter, tag, fmt, ...) do {                                    \
+        if (!host_log_quiet) {                                                  \
+            fprintf(stderr, letter " (%s) " fmt "\n", tag, ##__VA_ARGS__);      \
+        }                                                                       \
+    } while (0)
+
+#define ESP_LOGE(tag, fmt, ...) HOST_LOG("E", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) HOST_LOG("W", tag, fmt, ##__VA_ARGS__)
+#define HOST_LOG_OFF(tag, fmt, ...) do {                                        \
+        if (0) {                                                                \
+            fprintf(stderr, "%s " fmt, tag, ##__VA_ARGS__);                     \
+        }                                                                       \
+    } while (0)
+
+#define ESP_LOGI(tag, fmt, ...) HOST_LOG_OFF(tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) HOST_LOG_OFF(tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGV(tag, fmt, ...) HOST_LOG_OFF(tag, fmt, ##__VA_ARGS__)
+
+#define BIT(n)                  (1UL << (n))
+
+#define IRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+
+
+// ===== esp_timer =====
+
+int64_t esp_timer_get_time(void);
+
+
+// ===== FreeRTOS =====
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint32_t EventBits_t;
+typedef void *QueueHandle_t;
+typedef void *SemaphoreHandle_t;
+typedef void *EventGroupHandle_t;
+typedef void *TaskHandle_t;
+typedef struct { int unused; } portMUX_TYPE;
+
+#define pdTRUE                  1
+#define pdFALSE                 0
+#define pdPASS                  pdTRUE
+#define portMAX_DELAY           0xffffffffUL
+#define configTICK_RATE_HZ      100
+#define portTICK_PERIOD_MS      (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(ms) / portTICK_PERIOD_MS)
+#define portNUM_PROCESSORS      1
+
+#define portMUX_INITIALIZER_UNLOCKED    { 0 }
+#define taskENTER_CRITICAL(mux)         ((void)(mux))
+#define taskEXIT_CRITICAL(mux)          ((void)(mux))
+#define portENTER_CRITICAL(mux)         ((void)(mux))
+#define portEXIT_CRITICAL(mux)          ((void)(mux))
+
+static inline BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t ticks) { return pdTRUE; }
+static inline BaseType_t xSemaphoreGive(SemaphoreHandle_t s) { return pdTRUE; }
+static inline BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks) { return pdFALSE; }
+static inline BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks) { return pdTRUE; }
+
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits);
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits);
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group);
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear,
+                                BaseType_t all, TickType_t ticks);
+
+
+// ===== Drivers =====
+
+typedef int gpio_num_t;
+typedef int uart_port_t;
+typedef int i2c_port_t;
+typedef int spi_host_device_t;
+typedef uint32_t nvs_handle_t;
+
+#define GPIO_NUM_1      1
+#define GPIO_NUM_2      2
+#define GPIO_NUM_3      3
+#define GPIO_NUM_4      4
+#define GPIO_NUM_5      5
+#define GPIO_NUM_6      6
+#define GPIO_NUM_7      7
+#define GPIO_NUM_17     17
+#define GPIO_NUM_18     18
+#define GPIO_NUM_21     21
+#define GPIO_NUM_34     34
+#define GPIO_NUM_35     35
+#define GPIO_NUM_36     36
+
+#define UART_NUM_1      1
+#define UART_NUM_2      2
+#define SPI2_HOST       1
+
+
+// ===== Opaque handles of the components data.c's headers mention =====
+
+typedef struct cJSON cJSON;
+typedef struct esp_netif_obj esp_netif_t;
+typedef struct esp_mqtt_client *esp_mqtt_client_handle_t;
+typedef struct esp_modem_dce_wrap esp_modem_dce_t;
+
+#endif // ESP_HOST_H
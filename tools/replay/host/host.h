@@ -0,0 +1,21 @@
+#ifndef HOST_H
+#define HOST_H
+
+#include <stdint.h>
+
+// The virtual clock: capture time, in µs. esp_timer_get_time() and so
+// LV_TICK_CUSTOM read it, vTaskDelay() moves it on
+extern int64_t host_clock_us;
+
+// Calls data.c made out of the pipeline, for the report
+typedef struct {
+    uint32_t publish_data;
+    uint32_t publish_alarm;
+    uint32_t history_add;
+    uint32_t deep_sleep_request;
+    uint32_t task_delay_ms;         // vTaskDelay() inside handlers, skipped on the host
+} host_calls_t;
+
+extern host_calls_t host_calls;
+
+#endif // HOST_H
@@ -0,0 +1,127 @@
+#include "main.h"
+#include "display.h"
+#include "data.h"
+#include "mqtt.h"
+#include "publish.h"
+#include "history.h"
+#include "deep_sleep.h"
+#include "host.h"
+
+/*
+ * What data.c, filter.c and ui_mem.c call outside the pipeline. Nothing
+ * leaves the process: publishes, history and sleep requests are counted
+ * for the report, settings read as not set, so the filters and tank scaling
+ * run on their defaults.
+ */
+
+bool host_log_quiet = false;
+int64_t host_clock_us = 0;
+host_calls_t host_calls;
+
+sensor_data_t shared_sensor_data;
+SemaphoreHandle_t data_mutex;
+SemaphoreHandle_t xLVGLSemaphore;
+EventGroupHandle_t systemEvents;
+
+static EventBits_t event_bits;
+
+
+// ===== esp_timer / FreeRTOS =====
+
+int64_t esp_timer_get_time(void) {
+    return host_clock_us;
+}
+
+void vTaskDelay(TickType_t ticks) {
+    host_calls.task_delay_ms += ticks * portTICK_PERIOD_MS;
+    host_clock_us += (int64_t)ticks * portTICK_PERIOD_MS * 1000;
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return (TickType_t)(host_clock_us / 1000 / portTICK_PERIOD_MS);
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits) {
+    return event_bits |= bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits) {
+    EventBits_t before = event_bits;
+    event_bits &= ~bits;
+    return before;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group) {
+    return event_bits;
+}
+
+// Nothing else runs to set them: whatever is set now is all there will be
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear,
+                                BaseType_t all, TickType_t ticks) {
+    return event_bits;
+}
+
+
+// ===== display.c =====
+
+bool lvgl_lock(TickType_t timeout) {
+    return true;
+}
+
+void lvgl_unlock(void) {
+}
+
+
+// ===== mqtt.c =====
+
+void mqtt_settings_get(shared_settings_t *out) {
+    memset(out, 0, sizeof(*out));
+    out->version = SETTINGS_VERSION;
+}
+
+esp_err_t mqtt_get_aux_range(float *out_val) {
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t mqtt_get_aux_max(float *out_val) {
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t mqtt_get_ext_range(float *out_val) {
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t mqtt_get_ext_max(float *out_val) {
+    return ESP_ERR_NOT_FOUND;
+}
+
+
+// ===== publish.c / history.c / deep_sleep.c =====
+
+void publish_data(void) {
+    host_calls.publish_data++;
+}
+
+void publish_alarm(void) {
+    host_calls.publish_alarm++;
+}
+
+void history_add(int16_t int_tank, int16_t ext_tank, int16_t aux_tank) {
+    host_calls.history_add++;
+}
+
+// The chart is never shown here
+lv_obj_t *history_screen = NULL;
+
+void history_screen_build(void) {
+    history_screen = lv_obj_create(NULL);
+}
+
+void history_screen_destroy(void) {
+    lv_obj_del(history_screen);
+    history_screen = NULL;
+}
+
+void deep_sleep_request(void) {
+    host_calls.deep_sleep_request++;
+}
@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+"""A synthetic master UART capture for the replay harness.
+
+  make_capture.py capture.txt                  10 minutes, one cycle a second
+  make_capture.py --minutes 60 --period 500 --seed 7 capture.txt
+
+One line per frame, its time in ms first, as replay reads them. Each cycle
+the master sends what it sends on the bench: heartbeat, BME280, tank
+levels, battery, PT1000 and one of the outputs, spaced a few ms apart.
+Levels and temperatures random walk, with the occasional slosh, open loop
+and status change, so the filters and every readout get exercised. The
+same seed gives the same capture, for comparing runs.
+"""
+
+import argparse
+import random
+
+# message_ids.h
+MSG_ID_HEARTBEAT = 0
+MSG_ID_BME280 = 1
+MSG_ID_TANK_LEVEL = 2
+MSG_ID_MODE = 3
+MSG_ID_COMMS = 4
+MSG_ID_BATT = 6
+MSG_ID_OUTPUTS = 7
+MSG_ID_PT1000 = 10
+MSG_ID_STATUS = 11
+MSG_ID_ACK = 14
+MSG_TYPE_DATA = 1
+
+STATUSES = 10               # status_messages_t up to PUMP_ERROR
+FRAME_GAP_MS = 3            # Between the frames of one cycle, 22 bytes at 115200 baud is about 2 ms
+
+
+def frame(message_id, data0=0, data1=0, data2=0, data3=0, message_type=MSG_TYPE_DATA):
+    """As uart.c formats them: "%c%04X#%04X%04X%04X%04X" """
+    words = [d & 0xFFFF for d in (data0, data1, data2, data3)]
+    return '%d%04X#%04X%04X%04X%04X' % (message_type, message_id, *words)
+
+
+def walk(value, step, low, high, rng):
+    return min(high, max(low, value + rng.uniform(-step, step)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('out')
+    parser.add_argument('--minutes', type=float, default=10)
+    parser.add_argument('--period', type=int, default=1000, help='ms between cycles')
+    parser.add_argument('--seed', type=int, default=1)
+    args = parser.parse_args()
+
+    rng = random.Random(args.seed)
+    temp, pres, rh = 21.0, 1013.0, 45.0
+    pt1000 = 20.0
+    batt = 12.6
+    int_tank, ext_ma, aux_ma = 60.0, 12.0, 8.0
+    status = 0
+    output = 0
+    cycles = int(args.minutes * 60000 / args.period)
+
+    with open(args.out, 'w') as f:
+        for cycle in range(cycles):
+            t = cycle * args.period
+            temp = walk(temp, 0.05, -20, 60, rng)
+            pres = walk(pres, 0.2, 950, 1050, rng)
+            rh = walk(rh, 0.3, 5, 95, rng)
+            pt1000 = walk(pt1000, 0.2, -40, 120, rng)
+            batt = walk(batt, 0.01, 11.0, 14.4, rng)
+            int_tank = walk(int_tank, 0.5, 0, 100, rng)
+            ext_ma = walk(ext_ma, 0.1, 4, 20, rng)
+            aux_ma = walk(aux_ma, 0.1, 4, 20, rng)
+
+            ext = ext_ma + (rng.uniform(-1.5, 1.5) if rng.random() < 0.05 else 0)     # Slosh
+            aux = 0.0 if rng.random() < 0.01 else aux_ma                              # Open loop
+
+            frames = [
+                frame(MSG_ID_HEARTBEAT),
+                frame(MSG_ID_BME280, round(temp * 100), round(pres * 10), round(rh * 100)),
+                frame(MSG_ID_TANK_LEVEL, round(int_tank), round(aux * 100), round(ext * 100)),
+                frame(MSG_ID_BATT, round(batt * 1000)),
+                frame(MSG_ID_PT1000, round((pt1000 + 50) * 10)),
+                frame(MSG_ID_OUTPUTS, output, rng.random() < 0.5),
+            ]
+            output = (output + 1) % 4
+            if rng.random() < 0.02:
+                status = rng.randrange(STATUSES)
+                frames.append(frame(MSG_ID_STATUS, status))
+            if rng.random() < 0.01:
+                frames.append(frame(MSG_ID_MODE, rng.randrange(2)))
+                frames.append(frame(MSG_ID_ACK, MSG_ID_MODE, rng.randrange(1, 256)))
+
+            for i, text in enumerate(frames):
+                f.write('%d %s\n' % (t + i * FRAME_GAP_MS, text))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,697 @@
+/*
+ * Replays master UART captures through the firmware's frame pipeline on a
+ * Linux host: protocol_decode() (main/protocol.c) and handle_message() from main/data.c,
+ * drawing on the real dashboard (components/ui) with the device's LVGL
+ * configuration and blend kernels, on a headless 320x240 display.
+ *
+ *   replay capture.txt                  as fast as it goes
+ *   replay --speed 10 capture.txt       ten times the capture's own pace
+ *   replay --json now.json --baseline base.json capture.txt
+ *   replay --boot capture.txt           from a cold boot: the splash first
+ *
+ * Time in the pipeline is the capture's: esp_timer, the LVGL tick and the
+ * display task's refresh loop run on a virtual clock set from the frame
+ * timestamps. Latencies are host wall time around each call.
+ */
+
+#include <ctype.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "main.h"
+#include "display.h"
+#include "data.h"
+#include "blend.h"
+#include "ui_mem.h"
+#include "ui_glyph_cache.h"
+#include "screens.h"
+#include "message_ids.h"
+#include "protocol.h"
+#include "host.h"
+
+
+// ===== Configuration =====
+
+#define REPLAY_FRAME_LEN            22          // What master_rx_task reads per frame
+#define REPLAY_IDS                  16          // Message ids with a row of their own, the rest share one
+#define REPLAY_PERIOD_MS            100         // Frame spacing without timestamps in the capture
+#define REPLAY_DRAIN_MS             1000        // Display time after the last frame, for what it left to draw
+#define REPLAY_TOLERANCE_PCT        20          // --baseline: slower than this is a regression
+#define REPLAY_NOISE_NS             200         // --baseline: and by more than this, the host's jitter
+#define REPLAY_NOISE_BYTES          256         // --baseline: LVGL heap growth up to this is alignment and luck
+#define REPLAY_SPEED_MAX            100
+
+#define DISP_HOR_RES                320         // As display.c sets up the ILI9341
+#define DISP_VER_RES                240
+#define DISP_BUF_SIZE               (320 * 40)
+
+
+// ===== Capture =====
+
+typedef struct {
+    int64_t t_us;                               // Since the first frame of the capture
+    char text[REPLAY_FRAME_LEN + 1];
+} frame_t;
+
+typedef struct {
+    frame_t *frames;
+    size_t count;
+    size_t cap;
+} capture_t;
+
+// "%c%04X#%04X%04X%04X%04X" as uart.c sends and the master answers
+static bool is_frame(const char *p, size_t len) {
+    if (len < REPLAY_FRAME_LEN || !isdigit((unsigned char)p[0]) || p[5] != '#') {
+        return false;
+    }
+    for (int i = 1; i < REPLAY_FRAME_LEN; i++) {
+        if (i != 5 && !isxdigit((unsigned char)p[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void capture_add(capture_t *c, int64_t t_us, const char *text) {
+    if (c->count == c->cap) {
+        c->cap = c->cap ? c->cap * 2 : 1024;
+        c->frames = realloc(c->frames, c->cap * sizeof(frame_t));
+        if (!c->frames) {
+            fprintf(stderr, "out of memory\n");
+            exit(2);
+        }
+    }
+    frame_t *f = &c->frames[c->count++];
+    f->t_us = t_us;
+    memcpy(f->text, text, REPLAY_FRAME_LEN);
+    f->text[REPLAY_FRAME_LEN] = '\0';
+}
+
+// The first number before the frame on a line is its time: ms, or s with a
+// decimal point. "[1234] ", "1.234 " and ESP_LOG's "I (1234) tag: " all work
+static bool line_time(const char *line, const char *frame, int64_t *t_us) {
+    for (const char *p = line; p < frame; p++) {
+        if (!isdigit((unsigned char)*p)) {
+            continue;
+        }
+        char *end;
+        double v = strtod(p, &end);
+        *t_us = memchr(p, '.', end - p) ? (int64_t)(v * 1e6) : (int64_t)(v * 1e3);
+        return true;
+    }
+    return false;
+}
+
+// Frames in a text capture one per line, or anywhere in a raw UART stream
+static bool capture_load(const char *path, bool raw, int period_ms, capture_t *c) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *data = malloc(size + 1);
+    if (!data || fread(data, 1, size, f) != (size_t)size) {
+        fprintf(stderr, "%s: read failed\n", path);
+        fclose(f);
+        free(data);
+        return false;
+    }
+    fclose(f);
+    data[size] = '\0';
+
+    int64_t period_us = (int64_t)period_ms * 1000;
+    int64_t first = -1;
+    int64_t last = -period_us;
+
+    for (char *line = data; line < data + size; ) {
+        char *eol = raw ? data + size : memchr(line, '\n', data + size - line);
+        if (!eol) {
+            eol = data + size;
+        }
+        for (char *p = line; p + REPLAY_FRAME_LEN <= eol; p++) {
+            if (!is_frame(p, eol - p)) {
+                continue;
+            }
+            int64_t t;
+            if (raw || !line_time(line, p, &t)) {
+                t = last + period_us;
+            } else {
+                if (first < 0) {
+                    first = t;
+                }
+                t -= first;
+                if (t < last) {
+                    t = last + period_us;       // The log restarted: carry on from where it was
+                }
+            }
+            capture_add(c, t, p);
+            last = t;
+            p += REPLAY_FRAME_LEN - 1;
+            if (!raw) {
+                break;
+            }
+        }
+        line = eol + 1;
+    }
+    free(data);
+
+    if (c->count == 0) {
+        fprintf(stderr, "%s: no master frames in it\n", path);
+        return false;
+    }
+    return true;
+}
+
+
+// ===== Measurements =====
+
+typedef struct {
+    uint32_t *ns;
+    size_t count;
+    size_t cap;
+    uint64_t sum;
+    uint32_t max;
+} samples_t;
+
+typedef struct {
+    samples_t handler;
+    uint64_t invalidations;
+} id_stats_t;
+
+static id_stats_t id_stats[REPLAY_IDS + 1];    // The last one for ids past REPLAY_IDS
+static samples_t decode_ns;
+static samples_t render_ns;
+static uint32_t acks;
+static uint32_t malformed;
+
+static uint64_t invalidations;                  // Areas handed to _lv_inv_area since start
+static uint64_t flushed_px;
+static uint64_t flushed_areas;
+
+static const char *id_names[REPLAY_IDS + 1] = {
+    [MSG_ID_HEARTBEAT]      = "heartbeat",
+    [MSG_ID_BME280]         = "bme280",
+    [MSG_ID_TANK_LEVEL]     = "tank_level",
+    [MSG_ID_MODE]           = "mode",
+    [MSG_ID_COMMS]          = "comms",
+    [MSG_ID_SPARE]          = "spare",
+    [MSG_ID_BATT]           = "batt",
+    [MSG_ID_OUTPUTS]        = "outputs",
+    [MSG_ID_420_INPUTS]     = "420_inputs",
+    [MSG_ID_ANALOG_INPUTS]  = "analog_inputs",
+    [MSG_ID_PT1000]         = "pt1000",
+    [MSG_ID_STATUS]         = "status",
+    [MSG_ID_SYSTEM]         = "system",
+    [MSG_ID_SETTINGS]       = "settings",
+    [MSG_ID_ACK]            = "ack",
+    [15]                    = "id_15",
+    [REPLAY_IDS]            = "other",
+};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void samples_add(samples_t *s, uint64_t ns) {
+    if (s->count == s->cap) {
+        s->cap = s->cap ? s->cap * 2 : 256;
+        s->ns = realloc(s->ns, s->cap * sizeof(uint32_t));
+        if (!s->ns) {
+            fprintf(stderr, "out of memory\n");
+            exit(2);
+        }
+    }
+    uint32_t v = ns > UINT32_MAX ? UINT32_MAX : (uint32_t)ns;
+    s->ns[s->count++] = v;
+    s->sum += v;
+    if (v > s->max) {
+        s->max = v;
+    }
+}
+
+static void samples_reset(samples_t *s) {
+    s->count = 0;
+    s->sum = 0;
+    s->max = 0;
+}
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static double samples_mean(const samples_t *s) {
+    return s->count ? (double)s->sum / s->count : 0.0;
+}
+
+// Sorts the samples, so after the run only
+static uint32_t samples_p99(samples_t *s) {
+    if (s->count == 0) {
+        return 0;
+    }
+    qsort(s->ns, s->count, sizeof(uint32_t), cmp_u32);
+    return s->ns[(s->count - 1) * 99 / 100];
+}
+
+// Every lv_obj_invalidate() of a widget ends up here, before the refresh
+// merges the areas (-Wl,--wrap in CMakeLists.txt)
+void __real__lv_inv_area(lv_disp_t *disp, const lv_area_t *area_p);
+
+void __wrap__lv_inv_area(lv_disp_t *disp, const lv_area_t *area_p) {
+    if (area_p) {
+        invalidations++;
+    }
+    __real__lv_inv_area(disp, area_p);
+}
+
+
+// ===== Display =====
+
+static lv_disp_t *disp;
+static int64_t next_display_us;                 // When the display task's next lv_timer_handler() is due
+static lv_mem_monitor_t boot_mem;               // The LVGL heap once display_boot() is done
+static uint32_t mem_peak;                       // Most of it in use after any display pass or frame
+
+// lv_mem's own max_used counts requested bytes, not what the heap gives out
+static void mem_sample(void) {
+    lv_mem_monitor_t mem;
+    lv_mem_monitor(&mem);
+    if (mem.total_size - mem.free_size > mem_peak) {
+        mem_peak = mem.total_size - mem.free_size;
+    }
+}
+
+static void headless_flush(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_map) {
+    flushed_px += (uint64_t)lv_area_get_size(area);
+    flushed_areas++;
+    lv_disp_flush_ready(drv);
+}
+
+static void display_init(void) {
+    static lv_disp_draw_buf_t draw_buf;
+    static lv_color_t buf_1[DISP_BUF_SIZE];
+    static lv_color_t buf_2[DISP_BUF_SIZE];
+    static lv_disp_drv_t disp_drv;
+
+    lv_init();
+    lv_disp_draw_buf_init(&draw_buf, buf_1, buf_2, DISP_BUF_SIZE);
+    lv_disp_drv_init(&disp_drv);
+    disp_drv.draw_buf = &draw_buf;
+    disp_drv.flush_cb = headless_flush;
+    disp_drv.hor_res = DISP_HOR_RES;
+    disp_drv.ver_res = DISP_VER_RES;
+    disp_drv.antialiasing = 1;
+    disp_drv.draw_ctx_init = blend_draw_ctx_init;
+    disp = lv_disp_drv_register(&disp_drv);
+}
+
+// One pass of run_display_task's loop; how long it would sleep after it
+static uint32_t display_step(void) {
+    uint64_t px = flushed_px;
+    uint64_t start = now_ns();
+    uint32_t wait_ms = lv_timer_handler();
+    if (flushed_px != px) {
+        samples_add(&render_ns, now_ns() - start);
+    }
+    mem_sample();
+
+    if (disp->inv_p == 0 && lv_anim_count_running() == 0) {
+        wait_ms = DISPLAY_IDLE_WAIT_MS;
+    }
+    if (wait_ms < DISPLAY_MIN_WAIT_MS) {
+        wait_ms = DISPLAY_MIN_WAIT_MS;
+    } else if (wait_ms > DISPLAY_IDLE_WAIT_MS) {
+        wait_ms = DISPLAY_IDLE_WAIT_MS;
+    }
+    return wait_ms;
+}
+
+// The display task's passes up to capture time `t_us`, then the clock to it
+static void display_until(int64_t t_us) {
+    while (next_display_us <= t_us) {
+        if (host_clock_us < next_display_us) {
+            host_clock_us = next_display_us;
+        }
+        next_display_us = host_clock_us + (int64_t)display_step() * 1000;
+    }
+    if (host_clock_us < t_us) {
+        host_clock_us = t_us;
+    }
+}
+
+
+// What run_display_task shows before the first frame: the dashboard at once,
+// as out of deep sleep, or with --boot the splash and the slide over it
+static void display_boot(bool boot) {
+    screens_init();
+    ui_glyph_cache_preload(&lv_font_montserrat_14, UI_GLYPH_ATLAS_CHARS);
+    ui_mem_init();
+    if (!boot) {
+        screens_show(SCREEN_DATA, LV_SCR_LOAD_ANIM_NONE, 0);
+        lv_refr_now(disp);
+        return;
+    }
+
+    screens_show(SCREEN_SPLASH, LV_SCR_LOAD_ANIM_NONE, 0);
+    lv_refr_now(disp);
+    display_until(host_clock_us + DISPLAY_SPLASH_MS * 1000LL);
+    screens_show(SCREEN_DATA, LV_SCR_LOAD_ANIM_MOVE_LEFT, DISPLAY_SPLASH_ANIM_MS);
+    display_until(host_clock_us + DISPLAY_SPLASH_ANIM_MS * 1000LL + REPLAY_DRAIN_MS * 1000LL);
+}
+
+
+// ===== Replay =====
+
+typedef struct {
+    const char *capture;
+    bool raw;
+    int speed;                                  // 0: as fast as it goes
+    int period_ms;
+    int repeat;
+    const char *json;
+    const char *baseline;
+    int tolerance_pct;
+    bool boot;
+} options_t;
+
+// --speed: wait until `t_us` of capture time is due in wall time
+static void pace(const options_t *opt, uint64_t wall_start, int64_t t_us) {
+    if (opt->speed == 0) {
+        return;
+    }
+    uint64_t due = wall_start + (uint64_t)t_us * 1000 / opt->speed;
+    uint64_t now = now_ns();
+    if (due > now) {
+        struct timespec ts = { .tv_sec = (due - now) / 1000000000ULL, .tv_nsec = (due - now) % 1000000000ULL };
+        nanosleep(&ts, NULL);
+    }
+}
+
+// What master_rx_task and data_task do with a frame
+static void replay_frame(const frame_t *f) {
+    DecodedMessage msg;
+
+    uint64_t start = now_ns();
+    bool ok = protocol_decode(f->text, &msg);
+    samples_add(&decode_ns, now_ns() - start);
+
+    if (!ok) {
+        malformed++;                            // master_rx_task drops these
+        return;
+    }
+
+    if (msg.message_id == MSG_ID_ACK) {
+        acks++;                                 // master_link_ack(), not the data pipeline
+        return;
+    }
+
+    id_stats_t *s = &id_stats[msg.message_id >= 0 && msg.message_id < REPLAY_IDS ? msg.message_id : REPLAY_IDS];
+    uint64_t inv = invalidations;
+    start = now_ns();
+    handle_message(&msg);
+    samples_add(&s->handler, now_ns() - start);
+    s->invalidations += invalidations - inv;
+    mem_sample();
+}
+
+// Wall time of the replay in ns
+static uint64_t replay(const options_t *opt, const capture_t *c) {
+    int64_t span_us = c->frames[c->count - 1].t_us + (int64_t)opt->period_ms * 1000;
+    int64_t base_us = host_clock_us;
+    uint64_t wall_start = now_ns();
+
+    for (int r = 0; r < opt->repeat; r++) {
+        for (size_t i = 0; i < c->count; i++) {
+            int64_t t_us = base_us + r * span_us + c->frames[i].t_us;
+            display_until(t_us);
+            pace(opt, wall_start, t_us - base_us);
+            replay_frame(&c->frames[i]);
+        }
+    }
+    display_until(host_clock_us + REPLAY_DRAIN_MS * 1000);
+    return now_ns() - wall_start;
+}
+
+
+// ===== Report =====
+
+typedef struct {
+    char key[48];
+    double value;
+    bool gated;                                 // Compared with --baseline, higher is worse
+    double noise;                               // Increases up to this are never a regression
+} metric_t;
+
+#define REPLAY_METRICS_MAX  (12 + (REPLAY_IDS + 2) * 3)
+
+static metric_t metrics[REPLAY_METRICS_MAX];
+static int metric_count;
+
+static void metric(const char *key, double value, bool gated, double noise) {
+    if (metric_count < REPLAY_METRICS_MAX) {
+        metric_t *m = &metrics[metric_count++];
+        snprintf(m->key, sizeof(m->key), "%s", key);
+        m->value = value;
+        m->gated = gated;
+        m->noise = noise;
+    }
+}
+
+static void report(const options_t *opt, const capture_t *c, uint64_t wall_ns) {
+    size_t frames = c->count * opt->repeat;
+    double wall_s = wall_ns / 1e9;
+    double capture_s = (c->frames[c->count - 1].t_us + (int64_t)opt->period_ms * 1000) / 1e6;
+    size_t handled = frames - acks - malformed;
+
+    printf("%s: %zu frames over %.1f s", opt->capture, c->count, capture_s);
+    if (opt->repeat > 1) {
+        printf(", %d times", opt->repeat);
+    }
+    printf("\n");
+    if (opt->speed) {
+        printf("replayed at x%d in %.3f s: %.0f frames/s\n", opt->speed, wall_s, frames / wall_s);
+    } else {
+        printf("replayed as fast as it goes in %.3f s: %.0f frames/s\n", wall_s, frames / wall_s);
+    }
+    metric("frames", frames, false, 0);
+    metric("frames_per_s", frames / wall_s, false, 0);
+
+    printf("protocol_decode: %.0f ns mean, %u ns max\n", samples_mean(&decode_ns), decode_ns.max);
+    metric("decode_ns", samples_mean(&decode_ns), true, REPLAY_NOISE_NS);
+
+    printf("\n%-14s %8s %10s %10s %10s %12s\n", "handler", "frames", "mean us", "p99 us", "max us", "inval/frame");
+    samples_t all = { 0 };
+    uint64_t all_inv = 0;
+    for (int id = 0; id <= REPLAY_IDS; id++) {
+        id_stats_t *s = &id_stats[id];
+        if (s->handler.count == 0) {
+            continue;
+        }
+        for (size_t i = 0; i < s->handler.count; i++) {
+            samples_add(&all, s->handler.ns[i]);
+        }
+        all_inv += s->invalidations;
+
+        double mean = samples_mean(&s->handler) / 1e3;
+        double p99 = samples_p99(&s->handler) / 1e3;
+        double inv = (double)s->invalidations / s->handler.count;
+        printf("%-14s %8zu %10.2f %10.2f %10.2f %12.2f\n", id_names[id], s->handler.count, mean, p99,
+               s->handler.max / 1e3, inv);
+
+        char key[48];
+        snprintf(key, sizeof(key), "handler.%s.mean_us", id_names[id]);
+        metric(key, mean, true, REPLAY_NOISE_NS / 1e3);
+        snprintf(key, sizeof(key), "handler.%s.p99_us", id_names[id]);
+        metric(key, p99, false, 0);
+        snprintf(key, sizeof(key), "handler.%s.invalidations", id_names[id]);
+        metric(key, inv, true, 0);
+    }
+    double all_mean = samples_mean(&all) / 1e3;
+    double inv_per_frame = handled ? (double)all_inv / handled : 0.0;
+    printf("%-14s %8zu %10.2f %10.2f %10.2f %12.2f\n", "all", all.count, all_mean, samples_p99(&all) / 1e3,
+           all.max / 1e3, inv_per_frame);
+    if (acks) {
+        printf("(%u ACK frames decoded only, they go to master_link_ack)\n", acks);
+    }
+    if (malformed) {
+        printf("(%u malformed frames dropped)\n", malformed);
+    }
+    metric("handler_mean_us", all_mean, true, REPLAY_NOISE_NS / 1e3);
+    metric("invalidations_per_frame", inv_per_frame, true, 0);
+    free(all.ns);
+
+    double render_mean = samples_mean(&render_ns) / 1e3;
+    double px_per_refresh = render_ns.count ? (double)flushed_px / render_ns.count : 0.0;
+    printf("\nrender: %zu refreshes, %.0f px and %.1f areas each, %.1f us mean, %.1f us max\n",
+           render_ns.count, px_per_refresh, render_ns.count ? (double)flushed_areas / render_ns.count : 0.0,
+           render_mean, render_ns.max / 1e3);
+    metric("render_mean_us", render_mean, true, REPLAY_NOISE_NS / 1e3);
+    metric("px_per_refresh", px_per_refresh, true, 0);
+
+    // The 32 KB lv_mem heap; ui_mem's pools are static and not in it
+    lv_mem_monitor_t mem;
+    lv_mem_monitor(&mem);
+    uint32_t used = mem.total_size - mem.free_size;
+    printf("lv_mem: %u B peak, %u B after boot, %u B at the end, %u B biggest free, of %u\n",
+           (unsigned)mem_peak, (unsigned)(boot_mem.total_size - boot_mem.free_size), (unsigned)used,
+           (unsigned)mem.free_biggest_size, (unsigned)mem.total_size);
+    metric("lv_mem_peak", mem_peak, true, REPLAY_NOISE_BYTES);
+    metric("lv_mem_used", used, true, REPLAY_NOISE_BYTES);
+
+    printf("out of the pipeline: %u publish_data, %u publish_alarm, %u history_add, %u deep_sleep_request",
+           host_calls.publish_data, host_calls.publish_alarm, host_calls.history_add, host_calls.deep_sleep_request);
+    if (host_calls.task_delay_ms) {
+        printf(", %u ms of vTaskDelay not waited", host_calls.task_delay_ms);
+    }
+    printf("\n");
+}
+
+// Flat: one "key": value per line, which is all load_baseline() reads
+static bool write_json(const char *path) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    fprintf(f, "{\n");
+    for (int i = 0; i < metric_count; i++) {
+        fprintf(f, "  \"%s\": %.3f%s\n", metrics[i].key, metrics[i].value, i + 1 < metric_count ? "," : "");
+    }
+    fprintf(f, "}\n");
+    fclose(f);
+    return true;
+}
+
+// Regressions against an earlier --json, or -1 if it can't be read
+static int compare_baseline(const char *path, int tolerance_pct) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+
+    int regressions = 0;
+    char line[128];
+    printf("\nagainst %s, %d %% tolerance:\n", path, tolerance_pct);
+    while (fgets(line, sizeof(line), f)) {
+        char key[48];
+        double base;
+        if (sscanf(line, " \"%47[^\"]\": %lf", key, &base) != 2) {
+            continue;
+        }
+        for (int i = 0; i < metric_count; i++) {
+            metric_t *m = &metrics[i];
+            if (!m->gated || strcmp(m->key, key) != 0) {
+                continue;
+            }
+            double limit = base * (100 + tolerance_pct) / 100.0;
+            if (m->value > limit && m->value - base > m->noise) {
+                printf("  REGRESSION %-36s %10.3f -> %10.3f (%+.0f %%)\n", key, base, m->value,
+                       base > 0 ? (m->value / base - 1) * 100 : 100.0);
+                regressions++;
+            }
+        }
+    }
+    fclose(f);
+    if (!regressions) {
+        printf("  no regressions\n");
+    }
+    return regressions;
+}
+
+
+// ===== Main =====
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s [options] capture\n"
+            "  --raw              capture is the bare UART stream, frames back to back\n"
+            "  --speed N          1-%d times the capture's pace; 0, the default, as fast as it goes\n"
+            "  --period MS        frame spacing where the capture has no times (%d)\n"
+            "  --repeat N         replay the capture N times\n"
+            "  --json FILE        write the measurements\n"
+            "  --baseline FILE    compare with an earlier --json, exit 1 on a regression\n"
+            "  --tolerance PCT    how much slower counts as one (%d)\n"
+            "  --boot             start from a cold boot, splash and all, not from deep sleep\n"
+            "  --verbose          let the firmware's warnings through\n",
+            argv0, REPLAY_SPEED_MAX, REPLAY_PERIOD_MS, REPLAY_TOLERANCE_PCT);
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    options_t opt = {
+        .period_ms = REPLAY_PERIOD_MS,
+        .repeat = 1,
+        .tolerance_pct = REPLAY_TOLERANCE_PCT,
+    };
+    static const struct option long_options[] = {
+        { "raw",       no_argument,       NULL, 'r' },
+        { "speed",     required_argument, NULL, 's' },
+        { "period",    required_argument, NULL, 'p' },
+        { "repeat",    required_argument, NULL, 'n' },
+        { "json",      required_argument, NULL, 'j' },
+        { "baseline",  required_argument, NULL, 'b' },
+        { "tolerance", required_argument, NULL, 't' },
+        { "boot",      no_argument,       NULL, 'B' },
+        { "verbose",   no_argument,       NULL, 'v' },
+        { NULL, 0, NULL, 0 },
+    };
+
+    host_log_quiet = true;
+    int c;
+    while ((c = getopt_long(argc, argv, "", long_options, NULL)) != -1) {
+        switch (c) {
+            case 'r': opt.raw = true; break;
+            case 's': opt.speed = atoi(optarg); break;
+            case 'p': opt.period_ms = atoi(optarg); break;
+            case 'n': opt.repeat = atoi(optarg); break;
+            case 'j': opt.json = optarg; break;
+            case 'b': opt.baseline = optarg; break;
+            case 't': opt.tolerance_pct = atoi(optarg); break;
+            case 'B': opt.boot = true; break;
+            case 'v': host_log_quiet = false; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (optind != argc - 1 || opt.speed < 0 || opt.speed > REPLAY_SPEED_MAX || opt.period_ms <= 0 ||
+        opt.repeat <= 0 || opt.tolerance_pct < 0) {
+        usage(argv[0]);
+    }
+    opt.capture = argv[optind];
+
+    capture_t capture = { 0 };
+    if (!capture_load(opt.capture, opt.raw, opt.period_ms, &capture)) {
+        return 2;
+    }
+
+    display_init();
+    next_display_us = host_clock_us;
+    display_boot(opt.boot);
+    lv_mem_monitor(&boot_mem);
+    samples_reset(&render_ns);                  // The first full frame isn't the pipeline's
+    flushed_px = 0;
+    flushed_areas = 0;
+    next_display_us = host_clock_us;
+
+    uint64_t wall_ns = replay(&opt, &capture);
+    report(&opt, &capture, wall_ns);
+
+    if (opt.json && !write_json(opt.json)) {
+        return 2;
+    }
+    if (opt.baseline) {
+        int regressions = compare_baseline(opt.baseline, opt.tolerance_pct);
+        if (regressions < 0) {
+            return 2;
+        }
+        return regressions ? 1 : 0;
+    }
+    return 0;
+}
@@ -0,0 +1,45 @@
+#!/usr/bin/env python3
+"""sdkconfig.h for the host build, from the project's sdkconfig.
+
+  sdkconfig_h.py ../../sdkconfig build/sdkconfig.h
+
+What ESP-IDF's confgen writes for the options the replay harness compiles
+against: `y` becomes 1, numbers and strings are kept, options that are not
+set are left out. LVGL reads its configuration from it through
+lv_conf_kconfig.h, so the host draws with the device's colour depth, heap,
+refresh period and fonts.
+"""
+
+import re
+import sys
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+    lines = ['/* Generated by tools/replay/sdkconfig_h.py from %s */' % sys.argv[1], '#pragma once', '']
+    with open(sys.argv[1]) as f:
+        for line in f:
+            m = re.match(r'(CONFIG_\w+)=(.*)$', line.strip())
+            if not m:
+                continue
+            name, value = m.groups()
+            if value == 'y':
+                value = '1'
+            elif value == 'n':
+                continue
+            lines.append('#define %s %s' % (name, value))
+
+    text = '\n'.join(lines) + '\n'
+    try:
+        with open(sys.argv[2]) as f:
+            if f.read() == text:
+                return      # Unchanged: don't rebuild LVGL
+    except OSError:
+        pass
+    with open(sys.argv[2], 'w') as f:
+        f.write(text)
+
+
+if __name__ == '__main__':
+    main()
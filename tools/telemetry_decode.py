@@ -0,0 +1,316 @@
+#!/usr/bin/env python3
+"""Decode CBOR telemetry (PUBLISH_ENCODING_CBOR) back into ThingsBoard JSON.
+
+The key ids, names and scales are read from main/telemetry_schema.h, the
+same header the firmware encodes with.
+
+  telemetry_decode.py payload.bin          decoded JSON, as the device API would get it
+  telemetry_decode.py --hex 9fbf0018...    the payload as hex instead of a file
+  telemetry_decode.py --sizes *.bin        CBOR against JSON size per message
+  telemetry_decode.py --converter          print the ThingsBoard uplink converter
+
+The converter is tools/thingsboard_cbor_converter.js: regenerate it with
+--converter whenever telemetry_schema.h changes.
+"""
+
+import argparse
+import json
+import os
+import re
+import struct
+import sys
+
+SCHEMA = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'main', 'telemetry_schema.h')
+
+
+def load_schema(path=SCHEMA):
+    """{id: (name, scale)} from telemetry_schema.h"""
+    keys = {}
+    scales = {}
+    with open(path) as f:
+        for line in f:
+            m = re.match(r'#define\s+TLM_KEY_(\w+)\s+(\d+)\s*//\s*"(\w+)"', line)
+            if m:
+                keys[m.group(1)] = (int(m.group(2)), m.group(3))
+                continue
+            m = re.match(r'#define\s+TLM_SCALE_(\w+)\s+(\d+)', line)
+            if m:
+                scales[m.group(1)] = int(m.group(2))
+
+    schema = {}
+    for macro, (key, name) in keys.items():
+        if key in schema:
+            raise ValueError('TLM_KEY_%s reuses id %d' % (macro, key))
+        schema[key] = (name, scales.get(macro, 1))
+    return schema
+
+
+class CborDecoder:
+    """The subset cbor.c writes, plus definite lengths and floats"""
+
+    BREAK = object()
+
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def _take(self, n):
+        if self.pos + n > len(self.data):
+            raise ValueError('truncated at byte %d' % self.pos)
+        chunk = self.data[self.pos:self.pos + n]
+        self.pos += n
+        return chunk
+
+    def _argument(self, info):
+        if info < 24:
+            return info
+        if info == 31:
+            return None
+        size = {24: 1, 25: 2, 26: 4, 27: 8}.get(info)
+        if size is None:
+            raise ValueError('bad additional info %d at byte %d' % (info, self.pos - 1))
+        return int.from_bytes(self._take(size), 'big')
+
+    def _items(self, count):
+        while True:
+            if count is not None:
+                if count == 0:
+                    return
+                count -= 1
+            item = self.item()
+            if item is self.BREAK:
+                if count is not None:
+                    raise ValueError('break inside a definite length item')
+                return
+            yield item
+
+    def item(self):
+        initial = self._take(1)[0]
+        major, info = initial >> 5, initial & 0x1f
+
+        if major == 7:
+            if info == 20:
+                return False
+            if info == 21:
+                return True
+            if info in (22, 23):
+                return None
+            if info == 25:
+                return struct.unpack('>e', self._take(2))[0]
+            if info == 26:
+                return struct.unpack('>f', self._take(4))[0]
+            if info == 27:
+                return struct.unpack('>d', self._take(8))[0]
+            if info == 31:
+                return self.BREAK
+            raise ValueError('unsupported simple value %d' % info)
+
+        arg = self._argument(info)
+        if major == 0:
+            return arg
+        if major == 1:
+            return -1 - arg
+        if major in (2, 3):
+            if arg is None:
+                raise ValueError('indefinite strings are not supported')
+            raw = self._take(arg)
+            return raw.decode('utf-8') if major == 3 else raw
+        if major == 4:
+            return list(self._items(arg))
+        if major == 5:
+            items = list(self._items(None if arg is None else arg * 2))
+            return dict(zip(items[0::2], items[1::2]))
+        raise ValueError('unsupported major type %d' % major)
+
+
+def decode(payload, schema):
+    """ThingsBoard telemetry: [{"ts": .., "values": {..}}, ..] or bare values without a clock"""
+    dec = CborDecoder(payload)
+    batch = dec.item()
+    if dec.pos != len(payload):
+        raise ValueError('%d trailing bytes' % (len(payload) - dec.pos))
+    if not isinstance(batch, list):
+        raise ValueError('expected an array of samples')
+
+    out = []
+    for sample in batch:
+        values = {}
+        ts = None
+        for key, value in sample.items():
+            if key == 0:
+                ts = value
+                continue
+            name, scale = schema.get(key, ('key_%d' % key, 1))
+            if scale != 1 and isinstance(value, int) and not isinstance(value, bool):
+                value = value / scale
+            values[name] = value
+        out.append({'ts': ts, 'values': values} if ts is not None else values)
+    return out
+
+
+def cjson_number(value, single=True):
+    """A number the way cJSON prints it. Sensor values are floats on the device"""
+    if single:
+        value = struct.unpack('<f', struct.pack('<f', value))[0]
+    if value == int(value) and -2**31 <= value < 2**31:
+        return '%d' % value
+    text = '%1.15g' % value
+    if float(text) != value:
+        text = '%1.17g' % value
+    return text
+
+
+def cjson_dumps(obj, single=True):
+    """cJSON_PrintUnformatted of the decoded samples"""
+    if isinstance(obj, bool):
+        return 'true' if obj else 'false'
+    if isinstance(obj, (int, float)):
+        return cjson_number(obj, single)
+    if isinstance(obj, str):
+        return json.dumps(obj, ensure_ascii=False)
+    if isinstance(obj, list):
+        return '[' + ','.join(cjson_dumps(o, single) for o in obj) + ']'
+    return '{' + ','.join('%s:%s' % (json.dumps(k), cjson_dumps(v, single and k != 'ts'))
+                          for k, v in obj.items()) + '}'
+
+
+def json_size(entries):
+    """What the JSON encoding puts on the wire for the same samples"""
+    return len(cjson_dumps(entries).encode('utf-8'))
+
+
+CONVERTER = r'''// ThingsBoard uplink data converter for the CBOR telemetry on
+// MQTT_TOPIC_PUB_CBOR ("tlm/<client id>/cbor"). Generated by
+// tools/telemetry_decode.py --converter from main/telemetry_schema.h.
+
+var KEYS = %(keys)s;
+
+function cborDecode(bytes) {
+    var pos = 0;
+    var BREAK = {};
+
+    function take() {
+        if (pos >= bytes.length) throw new Error('truncated CBOR');
+        return bytes[pos++] & 0xff;
+    }
+    function argument(info) {
+        if (info < 24) return info;
+        if (info === 31) return null;
+        var size = {24: 1, 25: 2, 26: 4, 27: 8}[info];
+        if (!size) throw new Error('bad additional info ' + info);
+        var value = 0;
+        for (var i = 0; i < size; i++) value = value * 256 + take();
+        return value;
+    }
+    function item() {
+        var initial = take();
+        var major = initial >> 5, info = initial & 0x1f;
+        if (major === 7) {
+            if (info === 20) return false;
+            if (info === 21) return true;
+            if (info === 22 || info === 23) return null;
+            if (info === 31) return BREAK;
+            throw new Error('unsupported simple value ' + info);
+        }
+        var arg = argument(info);
+        if (major === 0) return arg;
+        if (major === 1) return -1 - arg;
+        if (major === 3) {
+            var text = '';
+            for (var i = 0; i < arg; i++) text += String.fromCharCode(take());
+            return decodeURIComponent(escape(text));
+        }
+        if (major === 4 || major === 5) {
+            var list = [];
+            var count = arg === null ? -1 : (major === 5 ? arg * 2 : arg);
+            while (count !== 0) {
+                var next = item();
+                if (next === BREAK) break;
+                list.push(next);
+                if (count > 0) count--;
+            }
+            if (major === 4) return list;
+            var map = {};
+            for (var j = 0; j < list.length; j += 2) map[list[j]] = list[j + 1];
+            return map;
+        }
+        throw new Error('unsupported major type ' + major);
+    }
+    return item();
+}
+
+var telemetry = [];
+var samples = cborDecode(payload);
+for (var s = 0; s < samples.length; s++) {
+    var values = {};
+    var ts = null;
+    for (var id in samples[s]) {
+        var value = samples[s][id];
+        if (id === '0') {
+            ts = value;
+            continue;
+        }
+        var key = KEYS[id] || ['key_' + id, 1];
+        if (key[1] !== 1 && typeof value === 'number') value = value / key[1];
+        values[key[0]] = value;
+    }
+    telemetry.push(ts !== null ? {ts: ts, values: values} : values);
+}
+
+return {
+    deviceName: metadata.topic.split('/')[1],
+    deviceType: 'default',
+    telemetry: telemetry
+};
+'''
+
+
+def converter(schema):
+    keys = ',\n    '.join('%d: [%s, %d]' % (key, json.dumps(name), scale)
+                          for key, (name, scale) in sorted(schema.items()) if key != 0)
+    return CONVERTER % {'keys': '{\n    ' + keys + '\n}'}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('payloads', nargs='*', help='payload files, - for stdin')
+    parser.add_argument('--hex', action='store_true', help='the arguments are hex strings, not files')
+    parser.add_argument('--sizes', action='store_true', help='print CBOR and JSON sizes per message')
+    parser.add_argument('--converter', action='store_true', help='print the ThingsBoard converter')
+    parser.add_argument('--schema', default=SCHEMA, help='telemetry_schema.h to use')
+    args = parser.parse_args()
+
+    schema = load_schema(args.schema)
+
+    if args.converter:
+        sys.stdout.write(converter(schema))
+        return 0
+
+    total_cbor = total_json = 0
+    for arg in args.payloads or ['-']:
+        if args.hex:
+            payload = bytes.fromhex(arg)
+        elif arg == '-':
+            payload = sys.stdin.buffer.read()
+        else:
+            with open(arg, 'rb') as f:
+                payload = f.read()
+
+        entries = decode(payload, schema)
+        if args.sizes:
+            size = json_size(entries)
+            total_cbor += len(payload)
+            total_json += size
+            print('%-24s %3d samples %6d B CBOR %6d B JSON %3d%%' %
+                  (arg[:24], len(entries), len(payload), size, 100 * len(payload) // size))
+        else:
+            print(json.dumps(entries, indent=2))
+
+    if args.sizes and len(args.payloads) > 1:
+        print('%-24s %18d B CBOR %6d B JSON %3d%%' %
+              ('total', total_cbor, total_json, 100 * total_cbor // total_json))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
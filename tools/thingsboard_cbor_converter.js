@@ -0,0 +1,128 @@
+// ThingsBoard uplink data converter for the CBOR telemetry on
+// MQTT_TOPIC_PUB_CBOR ("tlm/<client id>/cbor"). Generated by
+// tools/telemetry_decode.py --converter from main/telemetry_schema.h.
+
+var KEYS = {
+    1: ["Internal_Tank", 10],
+    2: ["External_Tank", 10],
+    3: ["Aux_Tank", 10],
+    4: ["PT1000", 10],
+    5: ["Battery_volts", 1000],
+    6: ["Temperature", 100],
+    7: ["Pressure", 100],
+    8: ["Humidity", 100],
+    9: ["Status", 1],
+    10: ["Mode", 1],
+    11: ["CSQ", 1],
+    12: ["CAN_Status", 1],
+    13: ["OUT1", 1],
+    14: ["OUT2", 1],
+    15: ["NPN1", 1],
+    16: ["NPN2", 1],
+    17: ["Lat", 1000000],
+    18: ["Lon", 1000000],
+    19: ["Alt", 10],
+    20: ["Timestamp", 1],
+    21: ["AuxTankRange", 100],
+    22: ["AuxTankMax", 100],
+    23: ["ExtTankRange", 100],
+    24: ["ExtTankMax", 100],
+    25: ["FillTime", 1],
+    26: ["PurgeTime", 1],
+    27: ["SleepTimeout", 1],
+    28: ["MinDEFLevel", 1],
+    29: ["PwrSleep", 10],
+    30: ["PwrDisplay", 10],
+    31: ["PwrMaster", 10],
+    32: ["PwrModem", 10],
+    33: ["PwrCurrentEst", 100],
+    34: ["Event", 1],
+    35: ["IntTankState", 1],
+    36: ["ExtTankState", 1],
+    37: ["AuxTankState", 1],
+    38: ["PT1000State", 1],
+    39: ["TankMedian", 1],
+    40: ["TankEma", 1],
+    41: ["TankStep", 1],
+    42: ["TempMedian", 1],
+    43: ["TempEma", 1],
+    44: ["TempStep", 1]
+};
+
+function cborDecode(bytes) {
+    var pos = 0;
+    var BREAK = {};
+
+    function take() {
+        if (pos >= bytes.length) throw new Error('truncated CBOR');
+        return bytes[pos++] & 0xff;
+    }
+    function argument(info) {
+        if (info < 24) return info;
+        if (info === 31) return null;
+        var size = {24: 1, 25: 2, 26: 4, 27: 8}[info];
+        if (!size) throw new Error('bad additional info ' + info);
+        var value = 0;
+        for (var i = 0; i < size; i++) value = value * 256 + take();
+        return value;
+    }
+    function item() {
+        var initial = take();
+        var major = initial >> 5, info = initial & 0x1f;
+        if (major === 7) {
+            if (info === 20) return false;
+            if (info === 21) return true;
+            if (info === 22 || info === 23) return null;
+            if (info === 31) return BREAK;
+            throw new Error('unsupported simple value ' + info);
+        }
+        var arg = argument(info);
+        if (major === 0) return arg;
+        if (major === 1) return -1 - arg;
+        if (major === 3) {
+            var text = '';
+            for (var i = 0; i < arg; i++) text += String.fromCharCode(take());
+            return decodeURIComponent(escape(text));
+        }
+        if (major === 4 || major === 5) {
+            var list = [];
+            var count = arg === null ? -1 : (major === 5 ? arg * 2 : arg);
+            while (count !== 0) {
+                var next = item();
+                if (next === BREAK) break;
+                list.push(next);
+                if (count > 0) count--;
+            }
+            if (major === 4) return list;
+            var map = {};
+            for (var j = 0; j < list.length; j += 2) map[list[j]] = list[j + 1];
+            return map;
+        }
+        throw new Error('unsupported major type ' + major);
+    }
+    return item();
+}
+
+var telemetry = [];
+var samples = cborDecode(payload);
+for (var s = 0; s < samples.length; s++) {
+    var values = {};
+    var ts = null;
+    for (var id in samples[s]) {
+        var value = samples[s][id];
+        if (id === '0') {
+            ts = value;
+            continue;
+        }
+        var key = KEYS[id] || ['key_' + id, 1];
+        if (key[1] !== 1 && typeof value === 'number') value = value / key[1];
+        values[key[0]] = value;
+    }
+    telemetry.push(ts !== null ? {ts: ts, values: values} : values);
+}
+
+return {
+    deviceName: metadata.topic.split('/')[1],
+    deviceType: 'default',
+    telemetry: telemetry
+};
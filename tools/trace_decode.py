@@ -0,0 +1,154 @@
+#!/usr/bin/env python3
+"""Format binary event log dumps (main/trace.h) as text.
+
+The event ids and formats are read from main/trace_events.h, the same
+header the firmware records with.
+
+  trace_decode.py dump.bin            a dump as published on trace/<client id>
+  trace_decode.py --log console.txt   every `trace dump` / `trace previous` in a console capture
+  trace_decode.py --raw dump.bin      also the level, core and id of each event
+
+Events of both cores are merged by time. Times are seconds since the boot
+the dump was taken in; a dump of the previous boot's tail says so.
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+EVENTS = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'main', 'trace_events.h')
+
+HEADER = struct.Struct('<4sBBBBIHH')    # trace_dump_header_t
+EVENT_HEAD = struct.Struct('<IIHBB')    # trace_event_t up to data
+MAGIC = b'TRC1'
+VERSION = 1
+
+LEVELS = {0: 'N', 1: 'E', 2: 'W', 3: 'I', 4: 'D', 5: 'V'}
+
+# esp_reset_reason_t
+RESET_REASONS = {
+    0: 'unknown', 1: 'power-on', 2: 'external', 3: 'software', 4: 'panic', 5: 'interrupt watchdog',
+    6: 'task watchdog', 7: 'other watchdog', 8: 'deep sleep', 9: 'brownout', 10: 'SDIO',
+}
+
+
+def load_events(path=EVENTS):
+    """({id: (name, format)}, {module number: name}) from trace_events.h"""
+    events = {}
+    modules = {}
+    with open(path) as f:
+        for line in f:
+            m = re.match(r'#define\s+TEV_(\w+)\s+(0x[0-9a-fA-F]+)\s*//\s*"(.*)"', line)
+            if m:
+                events[int(m.group(2), 16)] = (m.group(1), m.group(3))
+                continue
+            m = re.match(r'#define\s+TRACE_MOD_(\w+)\s+(\d+)', line)
+            if m and m.group(1) != 'COUNT':
+                modules[int(m.group(2))] = m.group(1)
+    return events, modules
+
+
+def format_event(fmt, words, text):
+    """The C format with its %u %d %x taking the words in order, %s the string"""
+    args = []
+    conversions = re.findall(r'%[-0-9.]*l*([udxXsc%])', fmt)
+    i = 0
+    for conv in conversions:
+        if conv == '%':
+            continue
+        if conv == 's':
+            args.append(text)
+            continue
+        value = words[i] if i < len(words) else 0
+        i += 1
+        if conv == 'd':
+            value = value - (1 << 32) if value & 0x80000000 else value
+        args.append(value)
+    python_fmt = re.sub(r'%([-0-9.]*)l*([udxXsc])', lambda m: '%' + m.group(1) + ('d' if m.group(2) == 'u' else m.group(2)), fmt)
+    try:
+        return python_fmt % tuple(args)
+    except (TypeError, ValueError):
+        return '%s %r %r' % (fmt, words, text)
+
+
+def decode(dump, events, modules, raw=False, out=sys.stdout):
+    if len(dump) < HEADER.size:
+        sys.exit('dump too short')
+    magic, version, previous, reset_reason, event_size, now_ms, count, _ = HEADER.unpack_from(dump)
+    if magic != MAGIC or version != VERSION:
+        sys.exit('not a version %d trace dump' % VERSION)
+
+    data_size = event_size - EVENT_HEAD.size
+    reason = RESET_REASONS.get(reset_reason, str(reset_reason))
+    if previous:
+        print('# tail of the boot before this one, which ended by %s reset' % reason, file=out)
+    else:
+        print('# taken %.3f s after a %s reset' % (now_ms / 1000.0, reason), file=out)
+
+    rows = []
+    for i in range(count):
+        offset = HEADER.size + i * event_size
+        if offset + event_size > len(dump):
+            print('# %d events missing, dump cut short' % (count - i), file=out)
+            break
+        seq, time_ms, event_id, info, nwords = EVENT_HEAD.unpack_from(dump, offset)
+        if seq == 0:
+            continue        # Overwritten while the console printed it
+        data = dump[offset + EVENT_HEAD.size:offset + event_size]
+        nwords = min(nwords, data_size // 4)
+        words = list(struct.unpack_from('<%dI' % nwords, data))
+        text = data[nwords * 4:].split(b'\0', 1)[0].decode('utf-8', 'replace')
+        rows.append((time_ms, info >> 4, seq, info & 0x0f, event_id, words, text))
+
+    for time_ms, core, seq, level, event_id, words, text in sorted(rows):
+        name, fmt = events.get(event_id, ('0x%04x' % event_id, '%s'))
+        module = modules.get(event_id >> 8, str(event_id >> 8))
+        line = format_event(fmt, words, text)
+        prefix = '%10.3f %s %-5s' % (time_ms / 1000.0, LEVELS.get(level, '?'), module)
+        if raw:
+            prefix += ' c%d #%-6d %-14s' % (core, seq, name)
+        print('%s %s' % (prefix, line), file=out)
+
+
+def dumps_in_log(path):
+    """The `TRACE:` hex lines of a console capture, one dump per header"""
+    dumps = []
+    with open(path, errors='replace') as f:
+        for line in f:
+            m = re.search(r'TRACE:([0-9a-fA-F]+)', line)
+            if not m:
+                continue
+            chunk = bytes.fromhex(m.group(1))
+            if chunk[:4] == MAGIC:
+                dumps.append(bytearray())
+            if dumps:
+                dumps[-1] += chunk
+    return [bytes(d) for d in dumps]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('file')
+    parser.add_argument('--log', action='store_true', help='file is a console capture')
+    parser.add_argument('--raw', action='store_true', help='show level, core, sequence and event name')
+    args = parser.parse_args()
+
+    events, modules = load_events()
+    if args.log:
+        dumps = dumps_in_log(args.file)
+        if not dumps:
+            sys.exit('no TRACE: lines in %s' % args.file)
+    else:
+        with open(args.file, 'rb') as f:
+            dumps = [f.read()]
+
+    for i, dump in enumerate(dumps):
+        if i:
+            print()
+        decode(dump, events, modules, args.raw)
+
+
+if __name__ == '__main__':
+    main()